@@ -1020,6 +1020,8 @@ public:
   bool runOnFunction(Function &F) override;
 
   void getAnalysisUsage(AnalysisUsage &AU) const override;
+
+  bool isParallelSafe() const override { return true; }
 };
 
 FunctionPass *createAAResultsWrapperPass();
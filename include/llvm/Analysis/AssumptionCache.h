@@ -23,6 +23,7 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/ValueHandle.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/Mutex.h"
 #include <memory>
 
 namespace llvm {
@@ -157,6 +158,9 @@ class AssumptionCacheTracker : public ImmutablePass {
                    FunctionCallbackVH::DMI> FunctionCallsMap;
   FunctionCallsMap AssumptionCaches;
 
+  /// Guards AssumptionCaches when function passes run in parallel.
+  sys::Mutex CachesLock;
+
 public:
   /// \brief Get the cached assumptions for a function.
   ///
@@ -175,6 +179,8 @@ public:
     return false;
   }
 
+  bool isParallelSafe() const override { return true; }
+
   static char ID; // Pass identification, replacement for typeid
 };
 
@@ -250,6 +250,7 @@ public:
 
   bool runOnFunction(Function &F) override;
   void getAnalysisUsage(AnalysisUsage &AU) const override;
+  bool isParallelSafe() const override { return true; }
 };
 
 FunctionPass *createBasicAAWrapperPass();
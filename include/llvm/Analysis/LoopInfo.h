@@ -758,6 +758,8 @@ public:
   void print(raw_ostream &O, const Module *M = nullptr) const override;
 
   void getAnalysisUsage(AnalysisUsage &AU) const override;
+
+  bool isParallelSafe() const override { return true; }
 };
 
 } // End llvm namespace
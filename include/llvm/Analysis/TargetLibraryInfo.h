@@ -321,6 +321,8 @@ public:
 
   TargetLibraryInfo &getTLI() { return TLI; }
   const TargetLibraryInfo &getTLI() const { return TLI; }
+
+  bool isParallelSafe() const override { return true; }
 };
 
 } // end namespace llvm
@@ -27,7 +27,10 @@
 #include "llvm/IR/Intrinsics.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/DataTypes.h"
+#include "llvm/Support/Mutex.h"
 #include <functional>
+#include <map>
+#include <thread>
 
 namespace llvm {
 
@@ -906,6 +909,11 @@ class TargetTransformInfoWrapperPass : public ImmutablePass {
   TargetIRAnalysis TIRA;
   Optional<TargetTransformInfo> TTI;
 
+  /// The result of the last getTTI call of each thread while function passes
+  /// run in parallel, so that they do not overwrite each other's TTI.
+  std::map<std::thread::id, Optional<TargetTransformInfo>> ParallelTTIs;
+  sys::Mutex ParallelTTIsLock;
+
   virtual void anchor();
 
 public:
@@ -920,6 +928,8 @@ public:
   explicit TargetTransformInfoWrapperPass(TargetIRAnalysis TIRA);
 
   TargetTransformInfo &getTTI(Function &F);
+
+  bool isParallelSafe() const override { return true; }
 };
 
 /// \brief Create an analysis pass wrapper around a TTI object.
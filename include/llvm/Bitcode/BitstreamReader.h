@@ -15,6 +15,7 @@
 #ifndef LLVM_BITCODE_BITSTREAMREADER_H
 #define LLVM_BITCODE_BITSTREAMREADER_H
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/Bitcode/BitCodes.h"
 #include "llvm/Support/Endian.h"
 #include "llvm/Support/StreamingMemoryObject.h"
@@ -42,6 +43,11 @@ public:
 private:
   std::unique_ptr<MemoryObject> BitcodeBytes;
 
+  /// The same bytes as BitcodeBytes when they are all in memory, such as a
+  /// mapped file, so that cursors can read words and blobs from them
+  /// directly.  Empty when the bitcode is streamed.
+  ArrayRef<uint8_t> DirectBytes;
+
   std::vector<BlockInfo> BlockInfoRecords;
 
   /// This is set to true if we don't care about the block/record name
@@ -68,6 +74,7 @@ public:
 
   BitstreamReader &operator=(BitstreamReader &&Other) {
     BitcodeBytes = std::move(Other.BitcodeBytes);
+    DirectBytes = Other.DirectBytes;
     // Explicitly swap block info, so that nothing gets destroyed twice.
     std::swap(BlockInfoRecords, Other.BlockInfoRecords);
     IgnoreBlockInfoNames = Other.IgnoreBlockInfoNames;
@@ -77,10 +84,15 @@ public:
   void init(const unsigned char *Start, const unsigned char *End) {
     assert(((End-Start) & 3) == 0 &&"Bitcode stream not a multiple of 4 bytes");
     BitcodeBytes.reset(getNonStreamedMemoryObject(Start, End));
+    DirectBytes = makeArrayRef(Start, End);
   }
 
   MemoryObject &getBitcodeBytes() { return *BitcodeBytes; }
 
+  /// Return the bitcode if it is all in memory, or an empty array if it is
+  /// streamed.
+  ArrayRef<uint8_t> getDirectBytes() const { return DirectBytes; }
+
   /// This is called by clients that want block/record name information.
   void CollectBlockInfoNames() { IgnoreBlockInfoNames = false; }
   bool isIgnoringBlockInfoNames() { return IgnoreBlockInfoNames; }
@@ -218,6 +230,9 @@ public:
 
   bool canSkipToPos(size_t pos) const {
     // pos can be skipped to if it is a valid address or one byte past the end.
+    ArrayRef<uint8_t> Bytes = BitStream->getDirectBytes();
+    if (!Bytes.empty())
+      return pos <= Bytes.size();
     return pos == 0 || BitStream->getBitcodeBytes().isValidAddress(
         static_cast<uint64_t>(pos - 1));
   }
@@ -317,6 +332,18 @@ public:
     if (Size != 0 && NextChar >= Size)
       report_fatal_error("Unexpected end of file");
 
+    // Read a whole word straight from memory when possible.  Only the tail of
+    // the bitcode goes through the MemoryObject.
+    ArrayRef<uint8_t> Bytes = BitStream->getDirectBytes();
+    if (NextChar + sizeof(word_t) <= Bytes.size()) {
+      CurWord =
+          support::endian::read<word_t, support::little, support::unaligned>(
+              Bytes.data() + NextChar);
+      NextChar += sizeof(word_t);
+      BitsInCurWord = sizeof(word_t) * 8;
+      return;
+    }
+
     // Read the next word from the stream.
     uint8_t Array[sizeof(word_t)] = {0};
 
@@ -503,6 +530,10 @@ public:
   /// Read the current record and discard it.
   void skipRecord(unsigned AbbrevID);
 
+  /// Read the current record into \p Vals and return its code.  If \p Blob
+  /// is non-null and the record ends in a blob, \p Blob is pointed at the
+  /// blob's bytes in the reader's buffer.  Streamed readers have no such
+  /// buffer and append the bytes to \p Vals instead.
   unsigned readRecord(unsigned AbbrevID, SmallVectorImpl<uint64_t> &Vals,
                       StringRef *Blob = nullptr);
 
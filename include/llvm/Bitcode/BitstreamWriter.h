@@ -101,6 +101,17 @@ public:
   /// \brief Retrieve the current position in the stream, in bits.
   uint64_t GetCurrentBitNo() const { return GetBufferOffset() * 8 + CurBit; }
 
+  /// \brief Backpatch a 32-bit field that was emitted as zero at bit position
+  /// \p BitNo, which does not need to be word aligned.  The field must already
+  /// have been flushed to the output.
+  void BackpatchField32(uint64_t BitNo, uint32_t NewValue) {
+    uint64_t Bits = uint64_t(NewValue) << (BitNo & 7);
+    for (uint64_t ByteNo = BitNo / 8; Bits; ++ByteNo, Bits >>= 8) {
+      assert(ByteNo < Out.size() && "Backpatching bits that are not flushed");
+      Out[ByteNo] |= char(Bits & 0xff);
+    }
+  }
+
   //===--------------------------------------------------------------------===//
   // Basic Primitives for emitting bits to the stream.
   //===--------------------------------------------------------------------===//
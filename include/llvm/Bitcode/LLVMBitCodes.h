@@ -42,7 +42,9 @@ namespace bitc {
 
     TYPE_BLOCK_ID_NEW,
 
-    USELIST_BLOCK_ID
+    USELIST_BLOCK_ID,
+
+    FUNCTION_SUMMARY_BLOCK_ID
   };
 
 
@@ -73,6 +75,29 @@ namespace bitc {
 
     MODULE_CODE_GCNAME      = 11,  // GCNAME: [strchr x N]
     MODULE_CODE_COMDAT      = 12,  // COMDAT: [selection_kind, name]
+
+    // FNSUMMARY_OFFSET: [offset]  Word offset of the FUNCTION_SUMMARY block.
+    MODULE_CODE_FNSUMMARY_OFFSET = 13,
+  };
+
+  /// FUNCTION_SUMMARY blocks describe the function definitions of a module, or
+  /// of several modules in a combined index.  Names are defined once by NAME
+  /// records and referred to by their index; modules likewise by the index of
+  /// their MODULE_PATH record.  Offsets are bit offsets of function blocks.
+  enum FunctionSummaryCodes {
+    FS_CODE_NAME            = 1, // NAME:        [namechar x N]
+    FS_CODE_MODULE_PATH     = 2, // MODULE_PATH: [namechar x N]
+    // PERMODULE_ENTRY: [valueid, nameid, linkage, flags, instcount, offset,
+    //                   calleenameid x N]
+    FS_CODE_PERMODULE_ENTRY = 3,
+    // COMBINED_ENTRY:  [modid, nameid, linkage, flags, instcount, offset,
+    //                   calleenameid x N]
+    FS_CODE_COMBINED_ENTRY  = 4
+  };
+
+  /// Flags of a FUNCTION_SUMMARY entry.
+  enum FunctionSummaryFlags {
+    FS_FLAG_REFERS_TO_LOCALS = 1 << 0
   };
 
   /// PARAMATTR blocks have code for defining a parameter attribute set.
@@ -24,6 +24,7 @@
 namespace llvm {
   class BitstreamWriter;
   class DataStreamer;
+  class FunctionInfoIndex;
   class LLVMContext;
   class Module;
   class ModulePass;
@@ -31,7 +32,9 @@ namespace llvm {
 
   /// Read the header of the specified bitcode buffer and prepare for lazy
   /// deserialization of function bodies. If ShouldLazyLoadMetadata is true,
-  /// lazily load metadata as well. If successful, this moves Buffer. On
+  /// lazily load metadata as well: materializing a function reads only the
+  /// metadata that it refers to, and named metadata is read by
+  /// Module::materializeMetadata(). If successful, this moves Buffer. On
   /// error, this *does not* move Buffer.
   ErrorOr<std::unique_ptr<Module>>
   getLazyBitcodeModule(std::unique_ptr<MemoryBuffer> &&Buffer,
@@ -58,6 +61,18 @@ namespace llvm {
   parseBitcodeFile(MemoryBufferRef Buffer, LLVMContext &Context,
                    DiagnosticHandlerFunction DiagnosticHandler = nullptr);
 
+  /// Return true if \p Buffer contains a module with a function summary, or
+  /// a combined function index.
+  bool hasFunctionSummary(MemoryBufferRef Buffer,
+                          DiagnosticHandlerFunction DiagnosticHandler = nullptr);
+
+  /// Read the function index from \p Buffer, which contains either a module
+  /// with a function summary or a combined function index.  The functions of
+  /// a module are recorded under the buffer identifier as module path.
+  ErrorOr<std::unique_ptr<FunctionInfoIndex>>
+  getFunctionInfoIndex(MemoryBufferRef Buffer,
+                       DiagnosticHandlerFunction DiagnosticHandler = nullptr);
+
   /// \brief Write the specified module to the specified raw output stream.
   ///
   /// For streams where it matters, the given stream should be in "binary"
@@ -66,8 +81,17 @@ namespace llvm {
   /// If \c ShouldPreserveUseListOrder, encode the use-list order for each \a
   /// Value in \c M.  These will be reconstructed exactly when \a M is
   /// deserialized.
+  ///
+  /// If \c EmitFunctionSummary, emit a summary of the functions defined in
+  /// \c M, for use by ThinLTO.
   void WriteBitcodeToFile(const Module *M, raw_ostream &Out,
-                          bool ShouldPreserveUseListOrder = false);
+                          bool ShouldPreserveUseListOrder = false,
+                          bool EmitFunctionSummary = false);
+
+  /// \brief Write the specified combined function index to the specified raw
+  /// output stream.
+  void WriteFunctionSummaryToFile(const FunctionInfoIndex &Index,
+                                  raw_ostream &Out);
 
   /// isBitcodeWrapper - Return true if the given bytes are the magic bytes
   /// for an LLVM IR bitcode wrapper.
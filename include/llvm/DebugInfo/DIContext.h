@@ -117,7 +117,8 @@ class DIContext {
 public:
   enum DIContextKind {
     CK_DWARF,
-    CK_PDB
+    CK_PDB,
+    CK_Index
   };
   DIContextKind getKind() const { return Kind; }
 
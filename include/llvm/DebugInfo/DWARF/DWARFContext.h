@@ -21,10 +21,14 @@
 #include "llvm/DebugInfo/DWARF/DWARFDebugRangeList.h"
 #include "llvm/DebugInfo/DWARF/DWARFSection.h"
 #include "llvm/DebugInfo/DWARF/DWARFTypeUnit.h"
+#include <atomic>
+#include <mutex>
 #include <vector>
 
 namespace llvm {
 
+class ThreadPool;
+
 // In place of applying the relocations to the data we've read from disk we use
 // a separate mapping table to the side and checking that at locations in the
 // dwarf where we expect relocated values. This adds a bit of complexity to the
@@ -51,9 +55,25 @@ class DWARFContext : public DIContext {
   std::unique_ptr<DWARFDebugAbbrev> AbbrevDWO;
   std::unique_ptr<DWARFDebugLocDWO> LocDWO;
 
+  /// Memory used by the parsed DIEs of all the units, and the limit above
+  /// which address queries release those of the least recently used units
+  /// (0 for no limit).
+  std::atomic<uint64_t> DIEMemoryUsage;
+  uint64_t DIEMemoryLimit;
+  /// Counts address queries, to order units by their last use.
+  uint64_t UseTick;
+
   DWARFContext(DWARFContext &) = delete;
   DWARFContext &operator=(DWARFContext &) = delete;
 
+  friend class DWARFUnit;
+  /// Called by the units of this context when they parse or release DIEs.
+  void updateDIEMemoryUsage(int64_t Delta) { DIEMemoryUsage += Delta; }
+
+  /// Release the DIEs of the least recently used units until the memory they
+  /// use is within the limit.
+  void releaseDIEsOverLimit();
+
   /// Read compile units from the debug_info section (if necessary)
   /// and store them in CUs.
   void parseCompileUnits();
@@ -71,7 +91,9 @@ class DWARFContext : public DIContext {
   void parseDWOTypeUnits();
 
 public:
-  DWARFContext() : DIContext(CK_DWARF) {}
+  DWARFContext()
+      : DIContext(CK_DWARF), DIEMemoryUsage(0), DIEMemoryLimit(0),
+        UseTick(0) {}
 
   static bool classof(const DIContext *DICtx) {
     return DICtx->getKind() == CK_DWARF;
@@ -143,6 +165,22 @@ public:
     return DWOCUs[index].get();
   }
 
+  /// Load the sections and parse the DIEs and the line tables of all the
+  /// compile units up front, on up to \p NumThreads threads (0 for one per
+  /// hardware thread), instead of one unit at a time as they are needed.
+  /// If a DIE memory limit is set, the units are parsed in order as long as
+  /// their DIEs are expected to fit.
+  void extractCompileUnitsInParallel(unsigned NumThreads = 0);
+
+  /// Limit the memory used by the parsed DIEs of the units of this context to
+  /// about \p Bytes, or remove the limit if it is 0.  When an address query
+  /// finds the limit exceeded, the DIEs of the least recently queried units
+  /// are released, which invalidates pointers to them.
+  void setDIEMemoryLimit(uint64_t Bytes) { DIEMemoryLimit = Bytes; }
+
+  /// Get the memory used by the parsed DIEs of the units of this context.
+  uint64_t getDIEMemoryUsage() const { return DIEMemoryUsage; }
+
   /// Get a pointer to the parsed DebugAbbrev object.
   const DWARFDebugAbbrev *getDebugAbbrev();
 
@@ -204,6 +242,10 @@ public:
   virtual const DWARFSection& getAppleNamespacesSection() = 0;
   virtual const DWARFSection& getAppleObjCSection() = 0;
 
+  /// Make the contents of all the sections available ahead of their first
+  /// use, doing the work that can be done concurrently on \p Pool.
+  virtual void loadSections(ThreadPool &Pool) {}
+
   static bool isSupportedVersion(unsigned version) {
     return version == 2 || version == 3 || version == 4;
   }
@@ -218,7 +260,8 @@ private:
 
 /// DWARFContextInMemory is the simplest possible implementation of a
 /// DWARFContext. It assumes all content is available in memory and stores
-/// pointers to it.
+/// pointers to it.  Compressed sections are decompressed the first time they
+/// are accessed.
 class DWARFContextInMemory : public DWARFContext {
   virtual void anchor();
   bool IsLittleEndian;
@@ -245,54 +288,130 @@ class DWARFContextInMemory : public DWARFContext {
   DWARFSection LocDWOSection;
   StringRef StringDWOSection;
   StringRef StringOffsetDWOSection;
-  StringRef RangeDWOSection;
   StringRef AddrSection;
   DWARFSection AppleNamesSection;
   DWARFSection AppleTypesSection;
   DWARFSection AppleNamespacesSection;
   DWARFSection AppleObjCSection;
 
-  SmallVector<SmallString<32>, 4> UncompressedSections;
+  /// A zlib-compressed section, and the field that gets its contents.
+  struct CompressedSection {
+    StringRef Compressed;
+    uint64_t UncompressedSize;
+    StringRef *Data;
+    SmallString<0> Uncompressed;
+  };
+  std::vector<std::unique_ptr<CompressedSection>> CompressedSections;
+  /// The compressed sections not accessed yet, by the field they will be
+  /// decompressed into.
+  DenseMap<const StringRef *, CompressedSection *> PendingSections;
+  std::atomic<bool> HasPendingSections;
+  std::mutex PendingSectionsMutex;
+  std::atomic<uint64_t> UncompressedSectionsSize;
+
+  void uncompressSection(CompressedSection &Section);
+  void uncompressPendingSection(StringRef *Data);
+
+  StringRef uncompressed(StringRef &Data) {
+    if (HasPendingSections)
+      uncompressPendingSection(&Data);
+    return Data;
+  }
+  const DWARFSection &uncompressed(DWARFSection &Section) {
+    uncompressed(Section.Data);
+    return Section;
+  }
+  const TypeSectionMap &uncompressed(TypeSectionMap &Sections) {
+    if (HasPendingSections)
+      for (auto &Section : Sections)
+        uncompressPendingSection(&Section.second.Data);
+    return Sections;
+  }
 
 public:
   DWARFContextInMemory(const object::ObjectFile &Obj,
     const LoadedObjectInfo *L = nullptr);
+
+  /// Get the memory used by the sections decompressed so far.
+  uint64_t getUncompressedSectionsSize() const {
+    return UncompressedSectionsSize;
+  }
+
+  void loadSections(ThreadPool &Pool) override;
+
   bool isLittleEndian() const override { return IsLittleEndian; }
   uint8_t getAddressSize() const override { return AddressSize; }
-  const DWARFSection &getInfoSection() override { return InfoSection; }
-  const TypeSectionMap &getTypesSections() override { return TypesSections; }
-  StringRef getAbbrevSection() override { return AbbrevSection; }
-  const DWARFSection &getLocSection() override { return LocSection; }
-  StringRef getARangeSection() override { return ARangeSection; }
-  StringRef getDebugFrameSection() override { return DebugFrameSection; }
-  const DWARFSection &getLineSection() override { return LineSection; }
-  StringRef getStringSection() override { return StringSection; }
-  StringRef getRangeSection() override { return RangeSection; }
-  StringRef getPubNamesSection() override { return PubNamesSection; }
-  StringRef getPubTypesSection() override { return PubTypesSection; }
-  StringRef getGnuPubNamesSection() override { return GnuPubNamesSection; }
-  StringRef getGnuPubTypesSection() override { return GnuPubTypesSection; }
-  const DWARFSection& getAppleNamesSection() override { return AppleNamesSection; }
-  const DWARFSection& getAppleTypesSection() override { return AppleTypesSection; }
-  const DWARFSection& getAppleNamespacesSection() override { return AppleNamespacesSection; }
-  const DWARFSection& getAppleObjCSection() override { return AppleObjCSection; }
+  const DWARFSection &getInfoSection() override {
+    return uncompressed(InfoSection);
+  }
+  const TypeSectionMap &getTypesSections() override {
+    return uncompressed(TypesSections);
+  }
+  StringRef getAbbrevSection() override { return uncompressed(AbbrevSection); }
+  const DWARFSection &getLocSection() override {
+    return uncompressed(LocSection);
+  }
+  StringRef getARangeSection() override { return uncompressed(ARangeSection); }
+  StringRef getDebugFrameSection() override {
+    return uncompressed(DebugFrameSection);
+  }
+  const DWARFSection &getLineSection() override {
+    return uncompressed(LineSection);
+  }
+  StringRef getStringSection() override { return uncompressed(StringSection); }
+  StringRef getRangeSection() override { return uncompressed(RangeSection); }
+  StringRef getPubNamesSection() override {
+    return uncompressed(PubNamesSection);
+  }
+  StringRef getPubTypesSection() override {
+    return uncompressed(PubTypesSection);
+  }
+  StringRef getGnuPubNamesSection() override {
+    return uncompressed(GnuPubNamesSection);
+  }
+  StringRef getGnuPubTypesSection() override {
+    return uncompressed(GnuPubTypesSection);
+  }
+  const DWARFSection& getAppleNamesSection() override {
+    return uncompressed(AppleNamesSection);
+  }
+  const DWARFSection& getAppleTypesSection() override {
+    return uncompressed(AppleTypesSection);
+  }
+  const DWARFSection& getAppleNamespacesSection() override {
+    return uncompressed(AppleNamespacesSection);
+  }
+  const DWARFSection& getAppleObjCSection() override {
+    return uncompressed(AppleObjCSection);
+  }
 
   // Sections for DWARF5 split dwarf proposal.
-  const DWARFSection &getInfoDWOSection() override { return InfoDWOSection; }
+  const DWARFSection &getInfoDWOSection() override {
+    return uncompressed(InfoDWOSection);
+  }
   const TypeSectionMap &getTypesDWOSections() override {
-    return TypesDWOSections;
+    return uncompressed(TypesDWOSections);
+  }
+  StringRef getAbbrevDWOSection() override {
+    return uncompressed(AbbrevDWOSection);
+  }
+  const DWARFSection &getLineDWOSection() override {
+    return uncompressed(LineDWOSection);
+  }
+  const DWARFSection &getLocDWOSection() override {
+    return uncompressed(LocDWOSection);
+  }
+  StringRef getStringDWOSection() override {
+    return uncompressed(StringDWOSection);
   }
-  StringRef getAbbrevDWOSection() override { return AbbrevDWOSection; }
-  const DWARFSection &getLineDWOSection() override { return LineDWOSection; }
-  const DWARFSection &getLocDWOSection() override { return LocDWOSection; }
-  StringRef getStringDWOSection() override { return StringDWOSection; }
   StringRef getStringOffsetDWOSection() override {
-    return StringOffsetDWOSection;
+    return uncompressed(StringOffsetDWOSection);
   }
-  StringRef getRangeDWOSection() override { return RangeDWOSection; }
-  StringRef getAddrSection() override {
-    return AddrSection;
+  StringRef getRangeDWOSection() override {
+    // FIXME: Use the other dwo range section when we emit it.
+    return getRangeSection();
   }
+  StringRef getAddrSection() override { return uncompressed(AddrSection); }
 };
 
 }
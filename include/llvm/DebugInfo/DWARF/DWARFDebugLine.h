@@ -10,6 +10,7 @@
 #ifndef LLVM_LIB_DEBUGINFO_DWARFDEBUGLINE_H
 #define LLVM_LIB_DEBUGINFO_DWARFDEBUGLINE_H
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/DebugInfo/DIContext.h"
 #include "llvm/DebugInfo/DWARF/DWARFRelocMap.h"
 #include "llvm/Support/DataExtractor.h"
@@ -20,6 +21,7 @@
 namespace llvm {
 
 class raw_ostream;
+class ThreadPool;
 
 class DWARFDebugLine {
 public:
@@ -224,6 +226,12 @@ public:
   const LineTable *getOrParseLineTable(DataExtractor debug_line_data,
                                        uint32_t offset);
 
+  /// Parse the line tables at each (offset, address size) pair of \p Tables
+  /// that have not been parsed yet, concurrently on \p Pool.
+  void parseLineTables(StringRef DebugLineData, bool IsLittleEndian,
+                       ArrayRef<std::pair<uint32_t, uint8_t>> Tables,
+                       ThreadPool &Pool);
+
 private:
   struct ParsingState {
     ParsingState(struct LineTable *LT);
@@ -123,6 +123,9 @@ class DWARFUnit {
   uint64_t BaseAddr;
   // The compile unit debug information entry items.
   std::vector<DWARFDebugInfoEntryMinimal> DieArray;
+  // When the unit was last looked up by an address query of the context, for
+  // releasing the DIEs of the least recently used units first.
+  uint64_t LastUse = 0;
 
   class DWOHolder {
     object::OwningBinary<object::ObjectFile> DWOFile;
@@ -205,6 +208,13 @@ public:
 
   void collectAddressRanges(DWARFAddressRangesVector &CURanges);
 
+  /// getDWOUnit - returns the unit of the .dwo file that this unit refers
+  /// to, or null if there is none or it cannot be loaded.
+  DWARFUnit *getDWOUnit() {
+    parseDWO();
+    return DWO ? DWO->getUnit() : nullptr;
+  }
+
   /// getInlinedChainForAddress - fetches inlined chain for a given address.
   /// Returns empty chain if there is no subprogram containing address. The
   /// chain is valid as long as parsed compile unit DIEs are not cleared.
@@ -220,6 +230,24 @@ public:
     return DieArray.size();
   }
 
+  /// \brief Returns the memory used by the parsed DIEs of the unit.
+  size_t getDIEMemoryUsage() const {
+    return DieArray.capacity() * sizeof(DWARFDebugInfoEntryMinimal);
+  }
+
+  /// \brief Returns an estimate of the memory that the DIEs of the unit will
+  /// use once they are all parsed.
+  size_t estimateDIEMemoryUsage() const {
+    return (getDebugInfoSize() / 14 + 1) * sizeof(DWARFDebugInfoEntryMinimal);
+  }
+
+  /// \brief Releases the parsed DIEs of the unit, except for the unit DIE.
+  /// Pointers to them become invalid; they are parsed again when needed.
+  void releaseDIEs() { clearDIEs(true); }
+
+  uint64_t getLastUse() const { return LastUse; }
+  void setLastUse(uint64_t Tick) { LastUse = Tick; }
+
   /// \brief Return the index of a DIE inside the unit's DIE vector.
   ///
   /// It is illegal to call this method with a DIE that hasn't be
@@ -18,10 +18,16 @@
 #include "IndirectionUtils.h"
 #include "LambdaResolver.h"
 #include "LogicalDylib.h"
+#include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Transforms/Utils/Cloning.h"
+#include <atomic>
 #include <list>
+#include <map>
+#include <mutex>
 #include <set>
 
 #include "llvm/Support/Debug.h"
@@ -36,6 +42,17 @@ namespace orc {
 /// added to the layer below. When a stub is called it triggers the extraction
 /// of the function body from the original module. The extracted body is then
 /// compiled and executed.
+///
+///   If the layer is given a thread pool, it also compiles speculatively: once
+/// a function has been compiled, the functions of the same module that it
+/// calls directly are queued for compilation on the pool, most called first,
+/// and so on transitively. Each function body pointer is updated with a
+/// single atomic store once its code is ready, so that threads running JIT'd
+/// code never see a partially written pointer. A stub that is hit while its
+/// function is being compiled in the background waits for that compile
+/// instead of starting its own. The layer serializes all the work on its
+/// modules, so their LLVMContext must not be used outside of the layer while
+/// background compiles may be running.
 template <typename BaseLayerT, typename CompileCallbackMgrT,
           typename PartitioningFtor =
             std::function<std::set<Function*>(Function&)>>
@@ -79,6 +96,10 @@ private:
   struct LogicalModuleResources {
     std::shared_ptr<Module> SourceModule;
     std::set<const Function*> StubsToClone;
+    // The addresses of the functions compiled so far.
+    std::map<const Function*, TargetAddress> CompiledAddrs;
+    // The functions queued for compilation in the background.
+    std::map<const Function*, std::shared_future<void>> BackgroundCompiles;
   };
 
   struct LogicalDylibResources {
@@ -99,10 +120,17 @@ public:
   typedef typename LogicalDylibList::iterator ModuleSetHandleT;
 
   /// @brief Construct a compile-on-demand layer instance.
+  ///
+  ///   If \p CompileThreads is not null, the likely callees of the compiled
+  /// functions are compiled ahead of time on it.
   CompileOnDemandLayer(BaseLayerT &BaseLayer, CompileCallbackMgrT &CallbackMgr,
-                       bool CloneStubsIntoPartitions)
+                       bool CloneStubsIntoPartitions,
+                       ThreadPool *CompileThreads = nullptr)
       : BaseLayer(BaseLayer), CompileCallbackMgr(CallbackMgr),
-        CloneStubsIntoPartitions(CloneStubsIntoPartitions) {}
+        CloneStubsIntoPartitions(CloneStubsIntoPartitions),
+        CompileThreads(CompileThreads) {}
+
+  ~CompileOnDemandLayer() { waitForBackgroundCompiles(); }
 
   /// @brief Add a module to the compile-on-demand layer.
   template <typename ModuleSetT, typename MemoryManagerPtrT,
@@ -114,6 +142,7 @@ public:
     assert(MemMgr == nullptr &&
            "User supplied memory managers not supported with COD yet.");
 
+    std::lock_guard<std::recursive_mutex> Lock(LayerMutex);
     LogicalDylibs.push_back(CODLogicalDylib(BaseLayer));
     auto &LDResources = LogicalDylibs.back().getDylibResources();
 
@@ -140,8 +169,11 @@ public:
   /// @brief Remove the module represented by the given handle.
   ///
   ///   This will remove all modules in the layers below that were derived from
-  /// the module represented by H.
+  /// the module represented by H. Waits for the background compiles of all
+  /// the modules of the layer first.
   void removeModuleSet(ModuleSetHandleT H) {
+    waitForBackgroundCompiles();
+    std::lock_guard<std::recursive_mutex> Lock(LayerMutex);
     LogicalDylibs.erase(H);
   }
 
@@ -150,6 +182,7 @@ public:
   /// @param ExportedSymbolsOnly If true, search only for exported symbols.
   /// @return A handle for the given named symbol, if it exists.
   JITSymbol findSymbol(StringRef Name, bool ExportedSymbolsOnly) {
+    std::lock_guard<std::recursive_mutex> Lock(LayerMutex);
     return BaseLayer.findSymbol(Name, ExportedSymbolsOnly);
   }
 
@@ -157,9 +190,17 @@ public:
   ///        below this one.
   JITSymbol findSymbolIn(ModuleSetHandleT H, const std::string &Name,
                          bool ExportedSymbolsOnly) {
+    std::lock_guard<std::recursive_mutex> Lock(LayerMutex);
     return H->findSymbol(Name, ExportedSymbolsOnly);
   }
 
+  /// @brief Wait for the functions queued for compilation in the background
+  ///        to be compiled.
+  void waitForBackgroundCompiles() {
+    if (CompileThreads)
+      CompileThreads->wait(BackgroundCompileGroup);
+  }
+
 private:
 
   void addLogicalModule(CODLogicalDylib &LD, std::shared_ptr<Module> SrcM) {
@@ -207,7 +248,7 @@ private:
       makeStub(*StubF, *FnBodyPtr);
       CCInfo.setCompileAction(
         [this, &LD, LMH, &F]() {
-          return this->extractAndCompile(LD, LMH, F);
+          return this->compileOnCall(LD, LMH, F);
         });
     }
 
@@ -249,19 +290,85 @@ private:
     return MangledName;
   }
 
+  // The compile action of the stub of F. Compiles F on the calling thread,
+  // unless it is queued for compilation in the background, in which case this
+  // waits for it.
+  TargetAddress compileOnCall(CODLogicalDylib &LD, LogicalModuleHandle LMH,
+                              Function &F) {
+    std::shared_future<void> BackgroundCompile;
+    {
+      std::lock_guard<std::recursive_mutex> Lock(LayerMutex);
+      auto &LMResources = LD.getLogicalModuleResources(LMH);
+      auto I = LMResources.BackgroundCompiles.find(&F);
+      if (I == LMResources.BackgroundCompiles.end()) {
+        DEBUG_WITH_TYPE("orc-cod", dbgs() << "Compiling " << F.getName()
+                                          << " on call\n");
+        return extractAndCompile(LD, LMH, F);
+      }
+      BackgroundCompile = I->second;
+    }
+    BackgroundCompile.wait();
+    std::lock_guard<std::recursive_mutex> Lock(LayerMutex);
+    return LD.getLogicalModuleResources(LMH).CompiledAddrs[&F];
+  }
+
+  // Queue the compilation of the not yet compiled functions of Callees on the
+  // compile threads. Must be called with the layer locked.
+  void compileInBackground(CODLogicalDylib &LD, LogicalModuleHandle LMH,
+                           ArrayRef<Function*> Callees) {
+    auto &LMResources = LD.getLogicalModuleResources(LMH);
+    for (auto *Callee : Callees) {
+      if (Callee->isDeclaration())
+        continue;
+      auto &BackgroundCompile = LMResources.BackgroundCompiles[Callee];
+      if (BackgroundCompile.valid())
+        continue;
+      // The task cannot start before the layer is unlocked, so it sees the
+      // future that it belongs to.
+      BackgroundCompile = CompileThreads->async(
+          BackgroundCompileGroup, [this, &LD, LMH, Callee]() {
+            std::lock_guard<std::recursive_mutex> Lock(LayerMutex);
+            // It may have been compiled with another partition since.
+            if (Callee->isDeclaration())
+              return;
+            DEBUG_WITH_TYPE("orc-cod", dbgs() << "Compiling "
+                                              << Callee->getName()
+                                              << " in the background\n");
+            this->extractAndCompile(LD, LMH, *Callee);
+          });
+    }
+  }
+
+  // Must be called with the layer locked.
   TargetAddress extractAndCompile(CODLogicalDylib &LD,
                                   LogicalModuleHandle LMH,
                                   Function &F) {
-    Module &SrcM = *LD.getLogicalModuleResources(LMH).SourceModule;
+    auto &LMResources = LD.getLogicalModuleResources(LMH);
+    Module &SrcM = *LMResources.SourceModule;
 
-    // If F is a declaration we must already have compiled it.
+    // If F is a declaration we must already have compiled it, as part of
+    // another partition or in the background.
     if (F.isDeclaration())
-      return 0;
+      return LMResources.CompiledAddrs[&F];
 
     // Grab the name of the function being called here.
     std::string CalledFnName = Mangle(F.getName(), SrcM.getDataLayout());
 
     auto Partition = LD.getDylibResources().Partitioner(F);
+
+    // Before the bodies are moved out of SrcM, find the functions of SrcM
+    // that the partition calls, and how often, to compile them ahead.
+    MapVector<Function*, unsigned> CallCounts;
+    if (CompileThreads)
+      for (auto *SubF : Partition)
+        for (auto &BB : *SubF)
+          for (auto &I : BB)
+            if (auto CS = CallSite(&I))
+              if (auto *Callee = dyn_cast<Function>(
+                      CS.getCalledValue()->stripPointerCasts()))
+                if (!Callee->isDeclaration())
+                  ++CallCounts[Callee];
+
     auto PartitionH = emitPartition(LD, LMH, Partition);
 
     TargetAddress CalledAddr = 0;
@@ -287,7 +394,25 @@ private:
       if (SubF == &F)
         CalledAddr = FnBodyAddr;
 
-      memcpy(FnPtrAddr, &FnBodyAddr, sizeof(uintptr_t));
+      // Other threads may be calling through the pointer: update it with a
+      // single store, after the body is complete.
+      reinterpret_cast<std::atomic<uintptr_t>*>(FnPtrAddr)->store(
+          static_cast<uintptr_t>(FnBodyAddr), std::memory_order_release);
+      LMResources.CompiledAddrs[SubF] = FnBodyAddr;
+    }
+
+    if (!CallCounts.empty()) {
+      std::vector<std::pair<Function*, unsigned>> Callees(CallCounts.begin(),
+                                                          CallCounts.end());
+      std::stable_sort(Callees.begin(), Callees.end(),
+                       [](const std::pair<Function*, unsigned> &LHS,
+                          const std::pair<Function*, unsigned> &RHS) {
+                         return LHS.second > RHS.second;
+                       });
+      std::vector<Function*> Ordered;
+      for (auto &Callee : Callees)
+        Ordered.push_back(Callee.first);
+      compileInBackground(LD, LMH, Ordered);
     }
 
     return CalledAddr;
@@ -345,6 +470,11 @@ private:
   CompileCallbackMgrT &CompileCallbackMgr;
   LogicalDylibList LogicalDylibs;
   bool CloneStubsIntoPartitions;
+  ThreadPool *CompileThreads;
+  TaskGroup BackgroundCompileGroup;
+  // Guards the modules of the layer and the layers below. Recursive because
+  // the symbol resolvers of the modules may call back into the layer.
+  std::recursive_mutex LayerMutex;
 };
 
 } // End namespace orc.
@@ -0,0 +1,72 @@
+//===- PersistentObjectCache.h - Content-hashed on-disk cache ---*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Defines an ObjectCache that keeps compiled objects in a directory, keyed by
+// a hash of the module's bitcode and of the target, so that they can be
+// reused by later processes.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_EXECUTIONENGINE_ORC_PERSISTENTOBJECTCACHE_H
+#define LLVM_EXECUTIONENGINE_ORC_PERSISTENTOBJECTCACHE_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include <mutex>
+#include <string>
+
+namespace llvm {
+
+class TargetMachine;
+
+namespace orc {
+
+/// @brief ObjectCache that stores objects in a directory on disk.
+///
+///   An object is looked up by the MD5 hash of the bitcode of its module and
+/// of a description of the target it is compiled for, so a module that has
+/// not changed is only compiled once, by whichever process comes first. Pass
+/// an instance to IRCompileLayer::setObjectCache.
+///
+///   Several processes can share the directory. An object is written to a
+/// temporary file that is renamed into place, so readers never see a partial
+/// object, and a LockFileManager lock keeps processes that compiled the same
+/// module at the same time from writing it twice.
+class PersistentObjectCache : public ObjectCache {
+public:
+  /// @brief Create a cache in \p CacheDir for objects compiled by \p TM: its
+  ///        triple, CPU, features, optimization level, relocation model and
+  ///        code model are part of the key.
+  PersistentObjectCache(std::string CacheDir, const TargetMachine &TM);
+
+  /// @brief Create a cache in \p CacheDir for objects compiled for the target
+  ///        described by \p TargetKey.
+  PersistentObjectCache(std::string CacheDir, std::string TargetKey);
+
+  void notifyObjectCompiled(const Module *M, MemoryBufferRef Obj) override;
+  std::unique_ptr<MemoryBuffer> getObject(const Module *M) override;
+
+  /// @brief Returns the path at which the object of \p M is cached.
+  std::string getCachePath(const Module &M) const;
+
+private:
+  std::string CacheDir;
+  std::string TargetKey;
+
+  // The paths computed by getObject() for the modules that missed, to be
+  // used by notifyObjectCompiled(): the module may be changed when it is
+  // compiled.
+  std::mutex PendingPathsMutex;
+  DenseMap<const Module *, std::string> PendingPaths;
+};
+
+} // End namespace orc.
+} // End namespace llvm.
+
+#endif // LLVM_EXECUTIONENGINE_ORC_PERSISTENTOBJECTCACHE_H
@@ -32,6 +32,7 @@ namespace object {
 
 class RuntimeDyldImpl;
 class RuntimeDyldCheckerImpl;
+class ThreadPool;
 
 class RuntimeDyld {
   friend class RuntimeDyldCheckerImpl;
@@ -129,6 +130,14 @@ public:
     /// Override to return true to enable the reserveAllocationSpace callback.
     virtual bool needsToReserveAllocationSpace() { return false; }
 
+    /// This method is called after RuntimeDyld has loaded \p Obj into the
+    /// sections allocated by this memory manager, but before relocations
+    /// are resolved.  Memory managers that hand out sections at a different
+    /// address than the one the code will run from can use it to call
+    /// RTDyld.mapSectionAddress for the new sections.
+    virtual void notifyObjectLoaded(RuntimeDyld &RTDyld,
+                                    const object::ObjectFile &Obj) {}
+
     /// Register the EH frames with the runtime so that c++ exceptions work.
     ///
     /// \p Addr parameter provides the local address of the EH frame section
@@ -241,6 +250,13 @@ public:
     this->ProcessAllSections = ProcessAllSections;
   }
 
+  /// Resolve relocations on \p Pool.  Relocations that patch different
+  /// sections are then applied concurrently, for the object formats and
+  /// targets that allow it.  Symbol lookups through the resolver still
+  /// happen on the thread that calls resolveRelocations.  Passing null
+  /// resolves relocations on the calling thread only, which is the default.
+  void setThreadPool(ThreadPool *Pool);
+
 private:
   // RuntimeDyldImpl is the actual class. RuntimeDyld is just the public
   // interface.
@@ -248,6 +264,7 @@ private:
   MemoryManager &MemMgr;
   SymbolResolver &Resolver;
   bool ProcessAllSections;
+  ThreadPool *Pool;
   RuntimeDyldCheckerImpl *Checker;
 };
 
@@ -0,0 +1,196 @@
+//===- SlabMemoryManager.h - Slab-based memory manager for JITs -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file contains the declaration of a memory manager that carves JITed
+// sections from large, shared slabs and returns them when it is destroyed.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_EXECUTIONENGINE_SLABMEMORYMANAGER_H
+#define LLVM_EXECUTIONENGINE_SLABMEMORYMANAGER_H
+
+#include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
+#include "llvm/Support/Memory.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <vector>
+
+namespace llvm {
+
+/// A thread-safe pool of code and data memory for JITs that create and
+/// discard many small objects.
+///
+/// Requests are rounded up to a power of two size class, and each class is
+/// served from slabs that hold blocks of that size only, with a free list of
+/// the blocks that were returned.  A slab is unmapped once all of its blocks
+/// are free, unless it is the last slab of its class, and requests too large
+/// for a slab get a mapping of their own.
+///
+/// When the host supports it, code slabs are mapped twice: code is written
+/// through a read/write view and run from a read/execute view, so no page is
+/// ever both writable and executable and making code executable does not
+/// involve changing any protections.  Otherwise code blocks are at least a
+/// page long and are mprotected on their own when they are made executable.
+class SlabMemoryPool {
+  SlabMemoryPool(const SlabMemoryPool &) = delete;
+  void operator=(const SlabMemoryPool &) = delete;
+
+public:
+  enum class MemoryKind { Code, Data };
+
+  /// A block of memory handed out by the pool.  The block is written through
+  /// Address and, if it holds code, run from ExecAddress.  The two are equal
+  /// for data and for code that is not dual-mapped.
+  struct Block {
+    Block() : Address(nullptr), ExecAddress(nullptr), Size(0) {}
+    uint8_t *Address;
+    uint8_t *ExecAddress;
+    uintptr_t Size;
+  };
+
+  /// Counters describing how well the pool uses the memory it maps.
+  struct Statistics {
+    Statistics()
+        : NumAllocations(0), BytesRequested(0), BytesAllocated(0),
+          BytesMapped(0), NumSlabs(0), NumLargeBlocks(0) {}
+
+    /// Number of blocks allocated since the pool was created.
+    uint64_t NumAllocations;
+    /// Sum of the sizes requested for the live blocks.
+    uint64_t BytesRequested;
+    /// Sum of the size classes of the live blocks.
+    uint64_t BytesAllocated;
+    /// Bytes currently mapped by the pool, counting each dual-mapped byte
+    /// once.
+    uint64_t BytesMapped;
+    unsigned NumSlabs;
+    unsigned NumLargeBlocks;
+  };
+
+  static const size_t DefaultSlabSize = 1 << 20;
+
+  /// Creates a pool that maps memory \p SlabSize bytes at a time.  If
+  /// \p DualMapCode is false, or the host cannot map memory twice, code is
+  /// mapped once and made executable with mprotect.
+  explicit SlabMemoryPool(size_t SlabSize = DefaultSlabSize,
+                          bool DualMapCode = true);
+  ~SlabMemoryPool();
+
+  /// Returns the pool used by default constructed SlabMemoryManagers.
+  static SlabMemoryPool &getDefault();
+
+  /// Allocates a writable block of at least \p Size bytes, aligned to
+  /// \p Alignment, which must be a power of two.  If \p Alignment is zero a
+  /// default alignment of 16 will be used.
+  Block allocate(MemoryKind Kind, uintptr_t Size, unsigned Alignment,
+                 std::error_code &EC);
+
+  /// Returns \p B, which must have been allocated from this pool, to the
+  /// pool.
+  void deallocate(const Block &B);
+
+  /// Makes the code in \p B executable from its ExecAddress.
+  std::error_code makeExecutable(const Block &B);
+
+  bool isCodeDualMapped() const { return DualMapCode; }
+
+  Statistics getStatistics() const;
+
+private:
+  struct Slab;
+
+  Block allocateLarge(MemoryKind Kind, uintptr_t Size, unsigned Alignment,
+                      std::error_code &EC);
+  Slab *createSlab(MemoryKind Kind, size_t BlockSize, size_t MapSize,
+                   std::error_code &EC);
+  void releaseSlab(Slab &S);
+  Slab &findSlab(const uint8_t *Address);
+  std::vector<Slab *> &getAvailable(MemoryKind Kind, unsigned SizeClass);
+
+  const size_t SlabSize;
+  const size_t PageSize;
+  bool DualMapCode;
+  unsigned MinSizeClass[2];
+  unsigned MaxSizeClass;
+
+  mutable std::mutex PoolMutex;
+  /// All slabs and large blocks, by the address of their writable view.
+  std::map<uintptr_t, std::unique_ptr<Slab>> Slabs;
+  /// For each kind and size class, the slabs that have free blocks.
+  std::vector<std::vector<Slab *>> Available[2];
+  Statistics Stats;
+};
+
+/// A memory manager that allocates the sections of the objects loaded
+/// through it from a SlabMemoryPool and returns them to the pool when it is
+/// destroyed.
+///
+/// Orc's ObjectLinkingLayer owns one memory manager per object set, so
+/// giving each set its own SlabMemoryManager returns the set's memory to the
+/// pool as soon as the set is removed.  Many managers can share one pool.
+///
+/// Code sections are made executable by finalizeMemory.  When the pool
+/// dual-maps code, notifyObjectLoaded tells RuntimeDyld to relocate code for
+/// the executable view of its memory, so the addresses RuntimeDyld reports
+/// for code symbols are in that view.  Read-only data is left writable.  EH
+/// frames that are still registered when the manager is destroyed are
+/// deregistered before their memory is returned.
+class SlabMemoryManager : public RTDyldMemoryManager {
+  SlabMemoryManager(const SlabMemoryManager &) = delete;
+  void operator=(const SlabMemoryManager &) = delete;
+
+public:
+  /// Creates a memory manager that allocates from the default pool.
+  SlabMemoryManager();
+  explicit SlabMemoryManager(SlabMemoryPool &Pool);
+  ~SlabMemoryManager() override;
+
+  uint8_t *allocateCodeSection(uintptr_t Size, unsigned Alignment,
+                               unsigned SectionID,
+                               StringRef SectionName) override;
+
+  uint8_t *allocateDataSection(uintptr_t Size, unsigned Alignment,
+                               unsigned SectionID, StringRef SectionName,
+                               bool IsReadOnly) override;
+
+  void registerEHFrames(uint8_t *Addr, uint64_t LoadAddr, size_t Size) override;
+  void deregisterEHFrames(uint8_t *Addr, uint64_t LoadAddr,
+                          size_t Size) override;
+
+  using RTDyldMemoryManager::notifyObjectLoaded;
+  void notifyObjectLoaded(RuntimeDyld &RTDyld,
+                          const object::ObjectFile &Obj) override;
+
+  bool finalizeMemory(std::string *ErrMsg = nullptr) override;
+
+private:
+  struct EHFrame {
+    uint8_t *Addr;
+    uint64_t LoadAddr;
+    size_t Size;
+  };
+
+  SlabMemoryPool &Pool;
+  std::vector<SlabMemoryPool::Block> CodeBlocks;
+  std::vector<SlabMemoryPool::Block> DataBlocks;
+  /// CodeBlocks[0, NumMappedCodeBlocks) have been mapped to their executable
+  /// address in RuntimeDyld, CodeBlocks[0, NumFinalizedCodeBlocks) have been
+  /// made executable.
+  size_t NumMappedCodeBlocks;
+  size_t NumFinalizedCodeBlocks;
+  /// The EH frames that are still registered, to be deregistered before
+  /// their memory goes back to the pool.
+  std::vector<EHFrame> RegisteredEHFrames;
+};
+
+} // end namespace llvm
+
+#endif // LLVM_EXECUTIONENGINE_SLABMEMORYMANAGER_H
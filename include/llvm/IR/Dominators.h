@@ -228,6 +228,8 @@ public:
     AU.setPreservesAll();
   }
 
+  bool isParallelSafe() const override { return true; }
+
   void releaseMemory() override { DT.releaseMemory(); }
 
   void print(raw_ostream &OS, const Module *M = nullptr) const override;
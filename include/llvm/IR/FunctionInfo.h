@@ -0,0 +1,155 @@
+//===-- llvm/IR/FunctionInfo.h - Function summary index ---------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+/// @file
+/// This file contains the declarations of the classes that make up the
+/// function index used by ThinLTO: a summary of every function defined in a
+/// set of modules, which lets a backend decide what to import from other
+/// modules without loading them.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_IR_FUNCTIONINFO_H
+#define LLVM_IR_FUNCTIONINFO_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/GlobalValue.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+class Function;
+
+/// \brief Summary of a function definition, computed when its module is
+/// written to bitcode.
+class FunctionSummary {
+  /// Linkage of the function in its defining module.
+  GlobalValue::LinkageTypes Linkage = GlobalValue::ExternalLinkage;
+
+  /// Number of instructions in the body, used as a size estimate.
+  unsigned InstCount = 0;
+
+  /// True if the body refers to internal or private symbols of its module,
+  /// or to block addresses.  Such a body cannot simply be copied into another
+  /// module.
+  bool RefersToLocals = false;
+
+  /// Names of the functions that the body calls directly.
+  std::vector<std::string> Calls;
+
+public:
+  FunctionSummary() = default;
+  FunctionSummary(GlobalValue::LinkageTypes Linkage, unsigned InstCount,
+                  bool RefersToLocals)
+      : Linkage(Linkage), InstCount(InstCount),
+        RefersToLocals(RefersToLocals) {}
+
+  /// Compute the summary of the body of \p F.
+  static FunctionSummary compute(const Function &F);
+
+  GlobalValue::LinkageTypes getLinkage() const { return Linkage; }
+  unsigned getInstCount() const { return InstCount; }
+  bool refersToLocals() const { return RefersToLocals; }
+
+  const std::vector<std::string> &calls() const { return Calls; }
+  void addCall(StringRef Callee) { Calls.push_back(Callee); }
+
+  /// Return true if the body may be copied into another module for
+  /// inlining, with available_externally linkage.  The definition must be
+  /// visible and not replaceable at link time.
+  bool isEligibleForImport() const {
+    return !RefersToLocals && !GlobalValue::isLocalLinkage(Linkage) &&
+           !GlobalValue::mayBeOverridden(Linkage) &&
+           !GlobalValue::isAvailableExternallyLinkage(Linkage);
+  }
+};
+
+/// \brief A summarized function together with where its body can be found.
+class FunctionInfo {
+  FunctionSummary Summary;
+
+  /// Path of the module defining the function.  This refers to an entry in
+  /// the module path table of the owning index.
+  StringRef ModulePath;
+
+  /// Bit offset of the function block within its module's bitcode.
+  uint64_t BitcodeIndex;
+
+public:
+  FunctionInfo(FunctionSummary Summary, StringRef ModulePath,
+               uint64_t BitcodeIndex)
+      : Summary(std::move(Summary)), ModulePath(ModulePath),
+        BitcodeIndex(BitcodeIndex) {}
+
+  const FunctionSummary &summary() const { return Summary; }
+  StringRef modulePath() const { return ModulePath; }
+  void setModulePath(StringRef Path) { ModulePath = Path; }
+  uint64_t bitcodeIndex() const { return BitcodeIndex; }
+};
+
+/// Summaries of every definition of a function name.  There may be several
+/// when the function is linkonce or weak, or local to several modules.
+typedef std::vector<std::unique_ptr<FunctionInfo>> FunctionInfoList;
+
+/// \brief Index of the functions defined in one module (a per-module index)
+/// or in all the modules of a link (a combined index).
+class FunctionInfoIndex {
+  /// Map from function name to its definitions.
+  StringMap<FunctionInfoList> FunctionMap;
+
+  /// Map from the path of each module in the index to its id.
+  StringMap<uint64_t> ModulePathStringTable;
+
+public:
+  typedef StringMap<FunctionInfoList>::const_iterator const_iterator;
+
+  FunctionInfoIndex() = default;
+  FunctionInfoIndex(const FunctionInfoIndex &) = delete;
+  FunctionInfoIndex &operator=(const FunctionInfoIndex &) = delete;
+
+  const_iterator begin() const { return FunctionMap.begin(); }
+  const_iterator end() const { return FunctionMap.end(); }
+  bool empty() const { return FunctionMap.empty(); }
+
+  /// Record a definition of \p Name.  Its module path must already be in the
+  /// module path table.
+  void addFunctionInfo(StringRef Name, std::unique_ptr<FunctionInfo> Info);
+
+  /// Return the definitions of \p Name, or null if there are none.
+  const FunctionInfoList *findFunctionInfoList(StringRef Name) const;
+
+  /// Return a definition of \p Name whose body may be imported into the
+  /// module at \p ImporterPath, or null if there is none.
+  const FunctionInfo *findImportCandidate(StringRef Name,
+                                          StringRef ImporterPath) const;
+
+  /// Add \p Path to the module path table with id \p ModId.  Returns the
+  /// copy of the path owned by the index.
+  StringRef addModulePath(StringRef Path, uint64_t ModId);
+
+  const StringMap<uint64_t> &modulePaths() const {
+    return ModulePathStringTable;
+  }
+
+  /// Return the id of the module at \p Path.
+  uint64_t getModuleId(StringRef Path) const {
+    return ModulePathStringTable.lookup(Path);
+  }
+
+  /// Move all the functions and modules of \p Other into this index.  The
+  /// modules of \p Other are renumbered after the ones already present.
+  void mergeFrom(std::unique_ptr<FunctionInfoIndex> Other);
+};
+
+} // end namespace llvm
+
+#endif
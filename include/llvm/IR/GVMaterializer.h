@@ -18,6 +18,7 @@
 #ifndef LLVM_IR_GVMATERIALIZER_H
 #define LLVM_IR_GVMATERIALIZER_H
 
+#include "llvm/ADT/ArrayRef.h"
 #include <system_error>
 #include <vector>
 
@@ -26,6 +27,7 @@ class Function;
 class GlobalValue;
 class Module;
 class StructType;
+class ThreadPool;
 
 class GVMaterializer {
 protected:
@@ -42,6 +44,12 @@ public:
   ///
   virtual std::error_code materialize(GlobalValue *GV) = 0;
 
+  /// Make sure the given functions are fully read.  If \p Pool is not null,
+  /// the GVMaterializer may use it to do part of the work concurrently; the
+  /// IR itself is always built on the calling thread.
+  virtual std::error_code materializeFunctions(ArrayRef<Function *> Fns,
+                                               ThreadPool *Pool);
+
   /// If the given GlobalValue is read in, and if the GVMaterializer supports
   /// it, release the memory for the GV, and set it up to be materialized
   /// lazily. If the Materializer doesn't support this capability, this method
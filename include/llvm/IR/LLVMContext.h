@@ -162,6 +162,10 @@ public:
   /// any global mutex or cannot block the execution in another LLVM context.
   void yield();
 
+  /// \brief Return true while function passes run on several functions of
+  /// this context at the same time (see -parallel-function-passes).
+  bool isRunningFunctionPassesInParallel() const;
+
   /// emitError - Emit an error message to the currently installed error handler
   /// with optional location information.  This function returns, so code should
   /// be prepared to drop the erroneous construct on the floor and "not crash".
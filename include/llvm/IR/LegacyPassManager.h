@@ -80,6 +80,12 @@ public:
   ///
   bool run(Function &F);
 
+  /// runOnFunctions - Execute all of the passes scheduled for execution on
+  /// every function of the module, in module order, as run does for one
+  /// function.  Unlike a loop over run, this lets the passes run on several
+  /// functions at the same time (see -parallel-function-passes).
+  bool runOnFunctions();
+
   /// doInitialization - Run all of the initializers for the function passes.
   ///
   bool doInitialization();
@@ -201,6 +201,10 @@ public:
   /// Find analysis usage information for the pass P.
   AnalysisUsage *findAnalysisUsage(Pass *P);
 
+  /// Drop the analysis usage information cached for the pass P, which is
+  /// about to be deleted without being managed by this top level manager.
+  void forgetAnalysisUsage(Pass *P);
+
   virtual ~PMTopLevelManager();
 
   /// Add immutable pass and initialize it.
@@ -272,7 +276,8 @@ private:
 class PMDataManager {
 public:
 
-  explicit PMDataManager() : TPM(nullptr), Depth(0) {
+  explicit PMDataManager()
+      : TPM(nullptr), VisibleParentAnalyses(nullptr), Depth(0) {
     initializeAnalysisInfo();
   }
 
@@ -387,6 +392,11 @@ protected:
   // then PMT_Last active pass mangers.
   DenseMap<AnalysisID, Pass *> *InheritedAnalysis[PMT_Last];
 
+  // If set, analyses provided by parent managers are only visible to the
+  // passes of this manager if they are in this set. Used by the per-thread
+  // copies of a function pass manager (see -parallel-function-passes).
+  const SmallPtrSetImpl<Pass *> *VisibleParentAnalyses;
+
   /// isPassDebuggingExecutionsOrMore - Return true if -debug-pass=Executions
   /// or higher is specified.
   bool isPassDebuggingExecutionsOrMore() const;
@@ -471,6 +481,16 @@ public:
   PassManagerType getPassManagerType() const override {
     return PMT_FunctionPassManager;
   }
+
+private:
+  /// Return true if the passes of this manager can be run on several
+  /// functions at the same time, as requested by -parallel-function-passes.
+  bool canRunInParallel();
+
+  /// Run the passes over the functions of M, on several threads when the
+  /// analyses they use can be shared.  The result is the same as the one of a
+  /// serial run.
+  bool runOnModuleInParallel(Module &M);
 };
 
 Timer *getPassTimer(Pass *);
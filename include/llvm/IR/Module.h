@@ -33,6 +33,7 @@ class GVMaterializer;
 class LLVMContext;
 class RandomNumberGenerator;
 class StructType;
+class ThreadPool;
 
 template<> struct ilist_traits<Function>
   : public SymbolTableListTraits<Function, Module> {
@@ -489,6 +490,13 @@ public:
   /// returns true and fills in the optional string with information about the
   /// problem. If successful, this returns false.
   std::error_code materialize(GlobalValue *GV);
+
+  /// Make sure the given functions are fully read.  This is faster than
+  /// materializing them one by one: the bitcode reader reads the bodies in
+  /// file order and, if \p Pool is not null, decodes them on the pool while
+  /// the IR is built on the calling thread.
+  std::error_code materializeFunctions(ArrayRef<Function *> Fns,
+                                       ThreadPool *Pool = nullptr);
   /// If the GlobalValue is read in, and if the GVMaterializer supports it,
   /// release the memory for the function, and set it up to be materialized
   /// lazily. If !isDematerializable(), this method is a no-op.
@@ -502,6 +510,8 @@ public:
   /// Materializer.
   std::error_code materializeAllPermanently();
 
+  /// Make sure the named metadata, and the metadata that it refers to, has
+  /// been read.
   std::error_code materializeMetadata();
 
 /// @}
@@ -20,6 +20,7 @@
 #include "llvm/Support/CBindingWrapping.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/Compiler.h"
+#include <atomic>
 
 namespace llvm {
 
@@ -37,6 +38,7 @@ class GlobalVariable;
 class InlineAsm;
 class Instruction;
 class LLVMContext;
+class LLVMContextImpl;
 class Module;
 class ModuleSlotTracker;
 class StringRef;
@@ -72,6 +74,7 @@ class Value {
 
   friend class ValueAsMetadata; // Allow access to IsUsedByMD.
   friend class ValueHandleBase;
+  friend class LLVMContextImpl; // Allow access to NumParallelContexts.
 
   const unsigned char SubclassID;   // Subclass identifier (for isa/dyn_cast)
   unsigned char HasValueHandle : 1; // Has a ValueHandle pointing to this?
@@ -332,7 +335,40 @@ public:
   unsigned getNumUses() const;
 
   /// \brief This method should only be used by the Use class.
-  void addUse(Use &U) { U.addToList(&UseList); }
+  void addUse(Use &U) {
+    if (LLVM_UNLIKELY(NumParallelContexts.load(std::memory_order_relaxed)) &&
+        hasSharedUseList())
+      return addSharedUse(U);
+    U.addToList(&UseList);
+  }
+
+  /// \brief This method should only be used by the Use class.
+  void removeUse(Use &U) {
+    if (LLVM_UNLIKELY(NumParallelContexts.load(std::memory_order_relaxed)) &&
+        hasSharedUseList())
+      return removeSharedUse(U);
+    U.removeFromList();
+  }
+
+private:
+  /// \brief The number of contexts whose function passes currently run on
+  /// several threads.  Use lists are only updated out of line while it is not
+  /// zero.
+  static std::atomic<unsigned> NumParallelContexts;
+
+  /// \brief Return true if the use list of this value can be reached from
+  /// more than one function.
+  ///
+  /// Constants, globals, inline asm and metadata wrappers are shared by all
+  /// the functions of a context, so their use lists are guarded by the context
+  /// lock while function passes run concurrently.
+  bool hasSharedUseList() const {
+    return SubclassID >= FunctionVal && SubclassID < InstructionVal;
+  }
+  void addSharedUse(Use &U);
+  void removeSharedUse(Use &U);
+
+public:
 
   /// \brief Concrete subclass of this.
   ///
@@ -535,11 +571,16 @@ inline raw_ostream &operator<<(raw_ostream &OS, const Value &V) {
 }
 
 void Use::set(Value *V) {
-  if (Val) removeFromList();
+  if (Val) Val->removeUse(*this);
   Val = V;
   if (V) V->addUse(*this);
 }
 
+Use::~Use() {
+  if (Val)
+    Val->removeUse(*this);
+}
+
 template <class Compare> void Value::sortUseList(Compare Cmp) {
   if (!UseList || !UseList->Next)
     // No need to sort 0 or 1 uses.
@@ -48,6 +48,7 @@ namespace llvm {
   class LLVMContext;
   class DiagnosticInfo;
   class GlobalValue;
+  class LTOCacheKey;
   class Mangler;
   class MemoryBuffer;
   class TargetLibraryInfo;
@@ -99,6 +100,13 @@ struct LTOCodeGenerator {
   /// LTOCodeGenerator::writeMergedModules().
   void parseCodeGenDebugOptions();
 
+  /// Add to \p Key the settings that determine the output of
+  /// LTOCodeGenerator::compilexxx() for a given merged module: the compiler
+  /// version, target options, CPU and features, optimization levels, codegen
+  /// options and preserved symbols.  Returns false if some setting cannot be
+  /// hashed, in which case the output must not be cached.
+  bool addToCacheKey(LTOCacheKey &Key) const;
+
   /// Write the merged module to the file specified by the given path.  Return
   /// true on success.
   bool writeMergedModules(const char *Path, std::string &ErrMsg);
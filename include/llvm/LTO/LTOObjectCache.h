@@ -0,0 +1,75 @@
+//===-LTOObjectCache.h - On-disk cache of LTO object files -------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the LTOObjectCache class, which keeps the object files
+// produced by LTO code generation on disk so that a relink whose inputs did not
+// change can skip optimization and code generation.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LTO_LTOOBJECTCACHE_H
+#define LLVM_LTO_LTOOBJECTCACHE_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MD5.h"
+#include <atomic>
+#include <memory>
+#include <string>
+
+namespace llvm {
+class MemoryBuffer;
+
+/// Accumulates everything that determines the contents of an object file into
+/// a key for LTOObjectCache.
+class LTOCacheKey {
+  MD5 Hasher;
+
+public:
+  /// Add \p Data to the key.  Its length is included, so that consecutive
+  /// strings cannot be confused with a different split of the same bytes.
+  void add(StringRef Data);
+  void add(uint64_t Value);
+
+  /// Return the key, as a hexadecimal string.  The key cannot be extended
+  /// afterwards.
+  std::string final();
+};
+
+/// An on-disk cache of object files, one file per key, in a directory that may
+/// be shared by concurrent links.
+///
+/// The cache is best effort: failing to read or write an entry just counts as
+/// a miss.  Entries are named "llvmcache-<key>", which lets CachePruning limit
+/// the size and age of the directory.
+class LTOObjectCache {
+public:
+  /// Use \p Directory, which is created if it does not exist.
+  explicit LTOObjectCache(StringRef Directory);
+
+  /// Return the object file cached under \p Key, or null if there is none.
+  std::unique_ptr<MemoryBuffer> lookup(StringRef Key);
+
+  /// Cache \p Object under \p Key, replacing any previous entry.
+  void insert(StringRef Key, StringRef Object);
+
+  /// The number of lookups that did and did not find an entry.
+  unsigned getNumHits() const { return NumHits; }
+  unsigned getNumMisses() const { return NumMisses; }
+
+private:
+  std::string getEntryPath(StringRef Key) const;
+
+  std::string Directory;
+  std::atomic<unsigned> NumHits;
+  std::atomic<unsigned> NumMisses;
+};
+
+} // end namespace llvm
+
+#endif
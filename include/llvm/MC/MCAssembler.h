@@ -650,12 +650,18 @@ private:
                                const MCAsmLayout &Layout) const;
 
   /// \brief Perform one layout iteration and return true if any offsets
-  /// were adjusted.
-  bool layoutOnce(MCAsmLayout &Layout);
-
-  /// \brief Perform one layout iteration of the given section and return true
-  /// if any offsets were adjusted.
-  bool layoutSectionOnce(MCAsmLayout &Layout, MCSection &Sec);
+  /// were adjusted. If \p CheckAll is false, only the fragments which refer to
+  /// other sections are checked for relaxation.
+  bool layoutOnce(MCAsmLayout &Layout, bool CheckAll);
+
+  /// \brief Relax the given section until its layout stops changing and return
+  /// true if any offsets were adjusted. After the first sweep, only the
+  /// fragments whose values depend on moved offsets are checked again.
+  bool layoutSection(MCAsmLayout &Layout, MCSection &Sec, bool CheckAll);
+
+  /// \brief Relax the given fragment if needed and return true if its size
+  /// may have changed.
+  bool relaxFragment(MCAsmLayout &Layout, MCFragment &F);
 
   bool relaxInstruction(MCAsmLayout &Layout, MCRelaxableFragment &IF);
 
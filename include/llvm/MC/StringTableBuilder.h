@@ -16,6 +16,8 @@
 
 namespace llvm {
 
+class ThreadPool;
+
 /// \brief Utility for building string tables with deduplicated suffixes.
 class StringTableBuilder {
   SmallString<256> StringTable;
@@ -23,7 +25,8 @@ class StringTableBuilder {
 
 public:
   /// \brief Add a string to the builder. Returns a StringRef to the internal
-  /// copy of s. Can only be used before the table is finalized.
+  /// copy of s. Adding a string that is already in the builder is cheap and
+  /// returns the same copy. Can only be used before the table is finalized.
   StringRef add(StringRef s) {
     assert(!isFinalized());
     return StringIndexMap.insert(std::make_pair(s, 0)).first->first();
@@ -36,8 +39,9 @@ public:
   };
 
   /// \brief Analyze the strings and build the final table. No more strings can
-  /// be added after this point.
-  void finalize(Kind kind);
+  /// be added after this point. If \p Pool is not null, the strings are sorted
+  /// and merged on it. The table is the same either way.
+  void finalize(Kind kind, ThreadPool *Pool = nullptr);
 
   /// \brief Retrieve the string table data. Can only be used after the table
   /// is finalized.
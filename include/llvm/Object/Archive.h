@@ -14,6 +14,7 @@
 #ifndef LLVM_OBJECT_ARCHIVE_H
 #define LLVM_OBJECT_ARCHIVE_H
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/iterator_range.h"
 #include "llvm/Object/Binary.h"
@@ -21,6 +22,8 @@
 #include "llvm/Support/ErrorOr.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Mutex.h"
+#include <atomic>
 
 namespace llvm {
 namespace object {
@@ -204,7 +207,11 @@ public:
     return v->isArchive();
   }
 
-  // check if a symbol is in the archive
+  /// Find the member which defines the symbol \p name, or child_end() if no
+  /// member does. If the symbol table lists \p name more than once, the first
+  /// entry wins. The first call builds a hash index over the whole symbol
+  /// table, which is linear in its size; later calls share the index and take
+  /// constant time.
   child_iterator findSym(StringRef name) const;
 
   bool hasSymbolTable() const;
@@ -223,6 +230,14 @@ private:
   unsigned Format : 2;
   unsigned IsThin : 1;
   mutable std::vector<std::unique_ptr<MemoryBuffer>> ThinBuffers;
+
+  /// Map from each symbol name to its first entry in the symbol table. It is
+  /// built lazily by findSym, under SymbolMapLock.
+  mutable DenseMap<StringRef, Symbol> SymbolMap;
+  mutable std::atomic<bool> SymbolMapBuilt;
+  mutable sys::Mutex SymbolMapLock;
+
+  void buildSymbolMap() const;
 };
 
 }
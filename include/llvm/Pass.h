@@ -115,6 +115,26 @@ public:
   ///
   virtual bool doFinalization(Module &) { return false; }
 
+  /// isParallelSafe - Return true if this pass may be run on several functions
+  /// of a module at the same time (see -parallel-function-passes).  A pass
+  /// that says so promises that:
+  ///
+  ///  - an instance created by its PassRegistry constructor behaves exactly
+  ///    like the instance that was added to the pass manager.  The copies are
+  ///    initialized but not finalized, so doFinalization must not depend on
+  ///    what runOnFunction did;
+  ///  - it only modifies the function it runs on.  It may create constants,
+  ///    types, metadata, attributes, declarations and private globals, but it
+  ///    does not modify or delete other globals, and does not inspect the use
+  ///    lists of constants or globals;
+  ///  - it only queries the analyses it lists in getAnalysisUsage;
+  ///  - any analysis state it shares between functions is synchronized.
+  ///
+  /// The context serializes the changes to shared values, and puts the use
+  /// lists and the globals in the order a serial run would have left them, so
+  /// the result does not depend on the number of threads.
+  virtual bool isParallelSafe() const { return false; }
+
   /// print - Print out the internal state of the pass.  This is called by
   /// Analyze to print out the contents of an analysis.  Otherwise it is not
   /// necessary to implement this method.  Beware that the module pointer MAY be
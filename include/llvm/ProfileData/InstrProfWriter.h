@@ -42,7 +42,8 @@ public:
   std::error_code addFunctionCounts(StringRef FunctionName,
                                     uint64_t FunctionHash,
                                     ArrayRef<uint64_t> Counters);
-  /// Write the profile to \c OS
+  /// Write the profile to \c OS.  The output depends only on the counts
+  /// added, not on the order in which they were added.
   void write(raw_fd_ostream &OS);
   /// Write the profile, returning the raw data. For testing.
   std::unique_ptr<MemoryBuffer> writeBuffer();
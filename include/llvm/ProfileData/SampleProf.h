@@ -59,6 +59,18 @@ static inline uint64_t SPMagic() {
 
 static inline uint64_t SPVersion() { return 100; }
 
+/// Magic number of the indexed binary format.  Unlike the plain binary
+/// format, it is stored as a little-endian 64-bit word rather than as a
+/// ULEB128.
+static inline uint64_t SPIndexedMagic() {
+  return uint64_t('S') << (64 - 8) | uint64_t('P') << (64 - 16) |
+         uint64_t('R') << (64 - 24) | uint64_t('O') << (64 - 32) |
+         uint64_t('F') << (64 - 40) | uint64_t('I') << (64 - 48) |
+         uint64_t('X') << (64 - 56) | uint64_t(0x81);
+}
+
+static inline uint64_t SPIndexedVersion() { return 1; }
+
 /// Represents the relative location of an instruction.
 ///
 /// Instruction locations are specified by the line offset from the
@@ -25,6 +25,7 @@
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/ErrorOr.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/OnDiskHashTable.h"
 #include "llvm/Support/raw_ostream.h"
 
 namespace llvm {
@@ -55,9 +56,11 @@ namespace sampleprof {
 ///      protection against source code shuffling, line numbers should
 ///      be relative to the start of the function.
 ///
-/// The reader supports two file formats: text and binary. The text format
-/// is useful for debugging and testing, while the binary format is more
-/// compact. They can both be used interchangeably.
+/// The reader supports three file formats: text, binary and indexed. The
+/// text format is useful for debugging and testing, while the binary format
+/// is more compact. The indexed format lets a compilation decode only the
+/// functions of the module being compiled. They can all be used
+/// interchangeably.
 class SampleProfileReader {
 public:
   SampleProfileReader(std::unique_ptr<MemoryBuffer> B, LLVMContext &C)
@@ -71,6 +74,11 @@ public:
   /// \brief Read sample profiles from the associated file.
   virtual std::error_code read() = 0;
 
+  /// \brief Read the sample profiles of the functions defined in \p M.
+  ///
+  /// Readers that cannot look up a single function read the whole file.
+  virtual std::error_code readProfilesFor(const Module &M) { return read(); }
+
   /// \brief Print the profile for \p FName on stream \p OS.
   void dumpFunctionProfile(StringRef FName, raw_ostream &OS = dbgs());
 
@@ -153,6 +161,10 @@ protected:
   /// \returns the read value.
   ErrorOr<StringRef> readString();
 
+  /// \brief Read the samples of one function, following its name, into
+  /// \p FProfile.
+  std::error_code readProfile(FunctionSamples &FProfile);
+
   /// \brief Return true if we've reached the end of file.
   bool at_eof() const { return Data >= End; }
 
@@ -163,6 +175,75 @@ protected:
   const uint8_t *End;
 };
 
+/// Trait for lookups into the on-disk hash table of the indexed format.  The
+/// data of each function is its name and the binary encoding of its samples,
+/// which is decoded only when the function is needed.
+class SampleProfileLookupTrait {
+public:
+  typedef std::pair<StringRef, StringRef> data_type;
+
+  typedef StringRef internal_key_type;
+  typedef StringRef external_key_type;
+  typedef uint64_t hash_value_type;
+  typedef uint64_t offset_type;
+
+  static bool EqualKey(StringRef A, StringRef B) { return A == B; }
+  static StringRef GetInternalKey(StringRef K) { return K; }
+
+  static hash_value_type ComputeHash(StringRef K);
+
+  static std::pair<offset_type, offset_type>
+  ReadKeyDataLength(const unsigned char *&D) {
+    using namespace support;
+    offset_type KeyLen = endian::readNext<offset_type, little, unaligned>(D);
+    offset_type DataLen = endian::readNext<offset_type, little, unaligned>(D);
+    return std::make_pair(KeyLen, DataLen);
+  }
+
+  static StringRef ReadKey(const unsigned char *D, offset_type N) {
+    return StringRef((const char *)D, N);
+  }
+
+  static data_type ReadData(StringRef K, const unsigned char *D,
+                            offset_type N) {
+    return std::make_pair(K, StringRef((const char *)D, N));
+  }
+};
+
+typedef OnDiskIterableChainedHashTable<SampleProfileLookupTrait>
+    SampleProfileReaderIndex;
+
+/// \brief Reader for the indexed binary format.
+///
+/// The file is a hash table from function name to the samples of the
+/// function, in the encoding of the binary format.  It is meant to be
+/// mapped rather than read, so that a compilation only touches the pages
+/// holding the functions of its module.
+class SampleProfileReaderIndexed : public SampleProfileReaderBinary {
+public:
+  SampleProfileReaderIndexed(std::unique_ptr<MemoryBuffer> B, LLVMContext &C)
+      : SampleProfileReaderBinary(std::move(B), C) {}
+
+  /// \brief Read and validate the file header, and set up the index.
+  std::error_code readHeader() override;
+
+  /// \brief Read the sample profiles of every function in the index.
+  std::error_code read() override;
+
+  /// \brief Read the sample profiles of the functions defined in \p M.
+  std::error_code readProfilesFor(const Module &M) override;
+
+  /// \brief Return true if \p Buffer is in the format supported by this class.
+  static bool hasFormat(const MemoryBuffer &Buffer);
+
+private:
+  /// \brief Decode the samples of \p FName from \p Encoded.
+  std::error_code readFunction(StringRef FName, StringRef Encoded);
+
+  /// \brief The hash table of the file.
+  std::unique_ptr<SampleProfileReaderIndex> Index;
+};
+
 } // End namespace sampleprof
 
 } // End namespace llvm
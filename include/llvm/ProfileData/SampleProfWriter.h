@@ -13,6 +13,7 @@
 #ifndef LLVM_PROFILEDATA_SAMPLEPROFWRITER_H
 #define LLVM_PROFILEDATA_SAMPLEPROFWRITER_H
 
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Module.h"
@@ -25,7 +26,13 @@ namespace llvm {
 
 namespace sampleprof {
 
-enum SampleProfileFormat { SPF_None = 0, SPF_Text, SPF_Binary, SPF_GCC };
+enum SampleProfileFormat {
+  SPF_None = 0,
+  SPF_Text,
+  SPF_Binary,
+  SPF_GCC,
+  SPF_Indexed
+};
 
 /// \brief Sample-based profile writer. Base class.
 class SampleProfileWriter {
@@ -59,16 +66,16 @@ public:
 
   /// \brief Write all the sample profiles in the given map of samples.
   ///
+  /// The functions are written in name order, so the output does not depend
+  /// on the order in which they were added to \p ProfileMap.
+  ///
   /// \returns true if the file was updated successfully. False, otherwise.
-  bool write(StringMap<FunctionSamples> &ProfileMap) {
-    for (auto &I : ProfileMap) {
-      StringRef FName = I.first();
-      FunctionSamples &Profile = I.second;
-      if (!write(FName, Profile))
-        return false;
-    }
-    return true;
-  }
+  bool write(StringMap<FunctionSamples> &ProfileMap);
+
+  /// \brief Finish the file once every function has been written.
+  ///
+  /// \returns an error code indicating whether the file was written.
+  virtual std::error_code finalize();
 
   /// \brief Profile writer factory. Create a new writer based on the value of
   /// \p Format.
@@ -103,6 +110,27 @@ public:
   }
 };
 
+/// \brief Sample-based profile writer (indexed format).
+///
+/// The hash table of the indexed format can only be laid out once every
+/// function is known, so the functions are encoded as they are written and
+/// the file is only emitted by finalize().
+class SampleProfileWriterIndexed : public SampleProfileWriter {
+public:
+  SampleProfileWriterIndexed(StringRef F, std::error_code &EC)
+      : SampleProfileWriter(F, EC, sys::fs::F_None) {}
+
+  bool write(StringRef F, const FunctionSamples &S) override;
+  std::error_code finalize() override;
+  bool write(const Module &M, StringMap<FunctionSamples> &P) {
+    return SampleProfileWriter::write(M, P);
+  }
+
+private:
+  /// \brief Binary encoding of the samples of each function written so far.
+  StringMap<std::string> EncodedProfiles;
+};
+
 } // End namespace sampleprof
 
 } // End namespace llvm
@@ -0,0 +1,72 @@
+//=- CachePruning.h - Helper to manage the pruning of a cache dir -*- C++ -*-=//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements pruning of a directory intended for cache storage,
+// using various policies.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_SUPPORT_CACHEPRUNING_H
+#define LLVM_SUPPORT_CACHEPRUNING_H
+
+#include "llvm/ADT/StringRef.h"
+#include <string>
+
+namespace llvm {
+
+/// Handle pruning a directory provided by the user. Only the files whose name
+/// starts with "llvmcache-" are considered part of the cache; other files in
+/// the directory are left alone.
+///
+/// \code
+///   CachePruning(CacheDir).setMaxSize(1 << 30).setEntryExpiration(7 * 86400)
+///       .prune();
+/// \endcode
+class CachePruning {
+public:
+  /// Prepare to prune \p Path.
+  explicit CachePruning(StringRef Path) : Path(Path) {}
+
+  /// Define the pruning interval, in seconds.  Pruning is skipped if it
+  /// already ran less than this long ago, as recorded by the modification
+  /// time of a "llvmcache.timestamp" file in the directory.  0 means always.
+  CachePruning &setPruningInterval(unsigned Seconds) {
+    Interval = Seconds;
+    return *this;
+  }
+
+  /// Define the expiration, in seconds, for an entry that has not been
+  /// written or used since.  0 disables expiration.
+  CachePruning &setEntryExpiration(unsigned Seconds) {
+    Expiration = Seconds;
+    return *this;
+  }
+
+  /// Define the maximum total size of the entries, in bytes.  The least
+  /// recently used entries are removed until the cache fits.  0 disables the
+  /// limit.
+  CachePruning &setMaxSize(uint64_t Bytes) {
+    MaxSize = Bytes;
+    return *this;
+  }
+
+  /// Perform pruning using the supplied options.  Returns true if the
+  /// directory was examined, false if pruning was skipped or failed.
+  bool prune();
+
+private:
+  std::string Path;
+  unsigned Interval = 0;
+  unsigned Expiration = 0;
+  uint64_t MaxSize = 0;
+};
+
+} // end namespace llvm
+
+#endif
@@ -109,6 +109,22 @@ namespace sys {
     static std::error_code protectMappedMemory(const MemoryBlock &Block,
                                                unsigned Flags);
 
+    /// This method allocates \p NumBytes bytes of memory and maps them
+    /// twice: once read/write into \p RWBlock and once read/execute into
+    /// \p RXBlock.  Stores through the first view are visible through the
+    /// second, so a JIT can write code without ever having a mapping that is
+    /// both writable and executable, and without changing protections.
+    /// Each view must be released with releaseMappedMemory.
+    ///
+    /// \r error_success if the function was successful, errc::not_supported
+    /// if the host cannot map memory twice, or an error_code describing the
+    /// failure if an error occurred.
+    ///
+    /// @brief Allocate dual-mapped memory.
+    static std::error_code allocateDualMappedMemory(size_t NumBytes,
+                                                    MemoryBlock &RWBlock,
+                                                    MemoryBlock &RXBlock);
+
     /// This method allocates a block of Read/Write/Execute memory that is
     /// suitable for executing dynamically generated code (e.g. JIT). An
     /// attempt to allocate \p NumBytes bytes of virtual memory is made.
@@ -0,0 +1,157 @@
+//===-- llvm/Support/ThreadPool.h - A work-stealing ThreadPool --*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines a work-stealing thread pool that tools and libraries can
+// share instead of spawning their own threads.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_SUPPORT_THREADPOOL_H
+#define LLVM_SUPPORT_THREADPOOL_H
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/thread.h"
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace llvm {
+
+/// A set of tasks submitted to a ThreadPool that can be waited for as a unit,
+/// independently of any other work running in the pool.
+///
+/// A group must outlive every task that was submitted to it.
+class TaskGroup {
+  friend class ThreadPool;
+
+  /// Number of tasks in the group that have not finished yet.  Guarded by the
+  /// owning pool's lock.
+  unsigned Pending = 0;
+
+public:
+  TaskGroup() = default;
+  TaskGroup(const TaskGroup &) = delete;
+  TaskGroup &operator=(const TaskGroup &) = delete;
+};
+
+/// A work-stealing thread pool.
+///
+/// Every worker owns a deque of tasks.  Tasks submitted from a worker go to
+/// that worker's deque, which it drains in LIFO order for locality.  Tasks
+/// submitted from any other thread are distributed round-robin.  A worker
+/// whose deque is empty steals the oldest task from another worker.
+///
+/// When LLVM is built without thread support, no threads are created and
+/// async() runs each task before it returns.
+class ThreadPool {
+public:
+  typedef std::function<void()> TaskTy;
+  typedef std::packaged_task<void()> PackagedTaskTy;
+
+  /// Construct a pool with one worker per hardware thread of the host.
+  ThreadPool();
+
+  /// Construct a pool with \p ThreadCount workers.  A count of zero is
+  /// treated as one.
+  explicit ThreadPool(unsigned ThreadCount);
+
+  /// Blocking destructor: the pool waits for all the tasks to complete.
+  ~ThreadPool();
+
+  /// Asynchronous submission of a task to the pool.  The returned future can
+  /// be used to wait for the task to finish.
+  template <typename Function, typename... Args>
+  std::shared_future<void> async(Function &&F, Args &&... ArgList) {
+    auto Task =
+        std::bind(std::forward<Function>(F), std::forward<Args>(ArgList)...);
+    return asyncImpl(std::move(Task), nullptr);
+  }
+
+  /// Asynchronous submission of a task that belongs to \p Group.
+  template <typename Function, typename... Args>
+  std::shared_future<void> async(TaskGroup &Group, Function &&F,
+                                 Args &&... ArgList) {
+    auto Task =
+        std::bind(std::forward<Function>(F), std::forward<Args>(ArgList)...);
+    return asyncImpl(std::move(Task), &Group);
+  }
+
+  /// Blocking wait for all the tasks in the pool to complete.  This must not
+  /// be called from one of the pool's tasks.
+  void wait();
+
+  /// Blocking wait for all the tasks in \p Group to complete.  When called
+  /// from inside one of the pool's tasks, the caller runs other queued tasks
+  /// while it waits, so nested groups cannot deadlock the pool.
+  void wait(TaskGroup &Group);
+
+  /// Returns the number of worker threads.
+  unsigned getThreadCount() const { return ThreadCount; }
+
+private:
+  struct Task;
+  struct WorkQueue;
+
+  /// Wrap \p Task so it can be waited for and queue it.
+  std::shared_future<void> asyncImpl(TaskTy Task, TaskGroup *Group);
+
+  /// Take a task that has been reserved by decrementing QueuedTasks, looking
+  /// first in the deque of worker \p Self (if any) and then stealing.
+  Task takeReservedTask(unsigned Self);
+
+  /// Run \p T and update the bookkeeping of the pool and of its group.
+  void runTask(Task &T);
+
+  /// The body of worker thread \p Index.
+  void workerLoop(unsigned Index);
+
+  unsigned ThreadCount;
+
+  /// Per-worker task deques.  Without thread support there are none.
+  std::vector<std::unique_ptr<WorkQueue>> Queues;
+
+  /// Next deque to receive a task submitted from outside the pool.
+  unsigned NextQueue = 0;
+
+#if LLVM_ENABLE_THREADS
+  std::vector<llvm::thread> Threads;
+#endif
+
+  /// Lock guarding the counters below.
+  std::mutex Mutex;
+
+  /// Signaled when a task is queued or the pool is shutting down.
+  std::condition_variable WorkAvailable;
+
+  /// Signaled when a task group or the whole pool becomes idle.
+  std::condition_variable Completion;
+
+  /// Number of tasks sitting in the deques that no thread has reserved.
+  unsigned QueuedTasks = 0;
+
+  /// Number of tasks that have been submitted but have not finished.
+  unsigned OutstandingTasks = 0;
+
+  /// Set when the pool is being destroyed.
+  bool ShuttingDown = false;
+};
+
+/// Call \p Fn with each index below \p Count and wait for all the calls to
+/// return.  The calls run as tasks of \p Pool if it is not null, and on the
+/// calling thread otherwise.  This may be called from one of the pool's tasks.
+void forEachIndex(ThreadPool *Pool, unsigned Count,
+                  function_ref<void(unsigned)> Fn);
+
+} // namespace llvm
+
+#endif // LLVM_SUPPORT_THREADPOOL_H
@@ -34,6 +34,11 @@ namespace llvm {
   /// the thread stack.
   void llvm_execute_on_thread(void (*UserFn)(void*), void *UserData,
                               unsigned RequestedStackSize = 0);
+
+  /// Get the number of threads the host can run concurrently, which is the
+  /// default size of a ThreadPool.  Returns 1 if LLVM is compiled without
+  /// support for multi-threading or the number cannot be determined.
+  unsigned hardware_concurrency();
 }
 
 #endif
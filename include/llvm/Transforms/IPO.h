@@ -77,6 +77,12 @@ ModulePass *createGlobalDCEPass();
 ///
 ModulePass *createEliminateAvailableExternallyPass();
 
+//===----------------------------------------------------------------------===//
+/// createFunctionImportPass - This pass imports small functions from other
+/// modules, as found through the function index given by -summary-file.
+///
+ModulePass *createFunctionImportPass();
+
 //===----------------------------------------------------------------------===//
 /// createGVExtractionPass - If deleteFn is true, this pass deletes
 /// the specified global values. Otherwise, it deletes as much of the module as
@@ -0,0 +1,72 @@
+//===- llvm/Transforms/IPO/FunctionImport.h - ThinLTO importing -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the FunctionImporter, which copies into a module the
+// bodies of small functions defined in other modules, as found through a
+// combined function index, so that they can be inlined.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TRANSFORMS_IPO_FUNCTIONIMPORT_H
+#define LLVM_TRANSFORMS_IPO_FUNCTIONIMPORT_H
+
+#include "llvm/ADT/StringRef.h"
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace llvm {
+class FunctionInfoIndex;
+class Module;
+
+/// Imports functions from other modules into a module, based on the
+/// summaries in a function index.
+///
+/// Imported functions get available_externally linkage: they can be inlined
+/// and analyzed, but are still emitted only by the module that defines them.
+/// That lets every module of a program be optimized separately, and in
+/// parallel, instead of merging all of them into one.
+class FunctionImporter {
+public:
+  /// Loads, lazily, the module at the given path of the index.  It must use
+  /// the context of the module that imports.  Returns null on error.
+  typedef std::function<std::unique_ptr<Module>(StringRef Path)>
+      ModuleLoaderTy;
+
+  /// Create an importer that reads summaries from \p Index and loads modules
+  /// with \p ModuleLoader.  Functions of more than \p InstLimit instructions
+  /// are not imported.
+  FunctionImporter(const FunctionInfoIndex &Index, ModuleLoaderTy ModuleLoader,
+                   unsigned InstLimit);
+
+  /// Create an importer that uses the -import-instr-limit threshold.
+  FunctionImporter(const FunctionInfoIndex &Index, ModuleLoaderTy ModuleLoader);
+
+  /// The names of the functions to import, by the path of the module that
+  /// defines them.
+  typedef std::map<std::string, std::vector<std::string>> ImportListTy;
+
+  /// Compute the functions that importFunctions() would import into \p M,
+  /// without loading any other module.
+  ImportListTy computeImportList(const Module &M) const;
+
+  /// Import functions into \p M.  Returns true if anything was imported.
+  bool importFunctions(Module &M);
+
+private:
+  const FunctionInfoIndex &Index;
+  ModuleLoaderTy ModuleLoader;
+  unsigned InstLimit;
+};
+
+} // end namespace llvm
+
+#endif
@@ -29,6 +29,7 @@
 namespace llvm {
 
 class Module;
+class LLVMContext;
 class Function;
 class Instruction;
 class Pass;
@@ -61,6 +62,16 @@ Module *
 CloneModule(const Module *M, ValueToValueMapTy &VMap,
             std::function<bool(const GlobalValue *)> ShouldCloneDefinition);
 
+/// Return a copy of the specified module that lives in the context \p Ctx.
+///
+/// Types, constants, attributes and metadata are uniqued per context, so
+/// every one of them that the module references is recreated in \p Ctx.
+/// This makes it possible to hand a module to a different thread without
+/// serializing it.  The source module must be fully materialized, and its
+/// context may be modified while cloning, so the caller has to own it.
+std::unique_ptr<Module> CloneModuleIntoContext(const Module *M,
+                                               LLVMContext &Ctx);
+
 /// ClonedCodeInfo - This struct can be used to capture information about code
 /// being cloned, while it is being cloned.
 struct ClonedCodeInfo {
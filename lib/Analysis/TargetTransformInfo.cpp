@@ -14,6 +14,7 @@
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Operator.h"
 #include "llvm/Support/ErrorHandling.h"
@@ -378,8 +379,17 @@ TargetTransformInfoWrapperPass::TargetTransformInfoWrapperPass(
 }
 
 TargetTransformInfo &TargetTransformInfoWrapperPass::getTTI(Function &F) {
-  TTI = TIRA.run(F);
-  return *TTI;
+  if (!F.getContext().isRunningFunctionPassesInParallel()) {
+    ParallelTTIs.clear();
+    TTI = TIRA.run(F);
+    return *TTI;
+  }
+
+  sys::ScopedLock Lock(ParallelTTIsLock);
+  Optional<TargetTransformInfo> &ThreadTTI =
+      ParallelTTIs[std::this_thread::get_id()];
+  ThreadTTI = TIRA.run(F);
+  return *ThreadTTI;
 }
 
 ImmutablePass *
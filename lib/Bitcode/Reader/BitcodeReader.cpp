@@ -20,6 +20,7 @@
 #include "llvm/IR/DebugInfoMetadata.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/DiagnosticPrinter.h"
+#include "llvm/IR/FunctionInfo.h"
 #include "llvm/IR/GVMaterializer.h"
 #include "llvm/IR/InlineAsm.h"
 #include "llvm/IR/IntrinsicInst.h"
@@ -28,14 +29,28 @@
 #include "llvm/IR/OperandTraits.h"
 #include "llvm/IR/Operator.h"
 #include "llvm/IR/ValueHandle.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/DataStream.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <atomic>
 #include <deque>
 using namespace llvm;
 
+static cl::opt<bool> LazyMetadataNodes(
+    "bitcode-lazy-metadata-nodes", cl::init(true), cl::Hidden,
+    cl::desc("When metadata is loaded lazily, read each node only when it is "
+             "first referenced"));
+
+static cl::opt<unsigned> DecodeThreads(
+    "bitcode-decode-threads", cl::init(0), cl::Hidden,
+    cl::desc("Decode function bodies on this many threads while a whole "
+             "module is materialized (0 means on the reading thread)"));
+
 namespace {
 enum {
   SWITCH_INST_MAGIC = 0x4B5 // May 2012 => 1205 => Hex
@@ -109,6 +124,13 @@ class BitcodeReaderMDValueList {
   unsigned MaxFwdRef;
   std::vector<TrackingMDRef> MDValuePtrs;
 
+  /// When metadata is loaded lazily, the bit position of the record of each
+  /// node that has not been read yet, by ID, or zero.
+  std::vector<uint64_t> LazyRecords;
+
+  /// Lazily loaded nodes that have been referenced and are waiting to be read.
+  std::vector<unsigned> PendingLazyRecords;
+
   LLVMContext &Context;
 public:
   BitcodeReaderMDValueList(LLVMContext &C)
@@ -118,7 +140,11 @@ public:
   unsigned size() const       { return MDValuePtrs.size(); }
   void resize(unsigned N)     { MDValuePtrs.resize(N); }
   void push_back(Metadata *MD) { MDValuePtrs.emplace_back(MD); }
-  void clear()                { MDValuePtrs.clear();  }
+  void clear() {
+    MDValuePtrs.clear();
+    LazyRecords.clear();
+    PendingLazyRecords.clear();
+  }
   Metadata *back() const      { return MDValuePtrs.back(); }
   void pop_back()             { MDValuePtrs.pop_back(); }
   bool empty() const          { return MDValuePtrs.empty(); }
@@ -136,8 +162,133 @@ public:
   Metadata *getValueFwdRef(unsigned Idx);
   void assignValue(Metadata *MD, unsigned Idx);
   void tryToResolveCycles();
+
+  /// Record that the node \p Idx is read from the record at \p BitNo when it
+  /// is first referenced.
+  void setLazyRecord(unsigned Idx, uint64_t BitNo);
+
+  /// Return the bit position of the record of \p Idx if it is still to be
+  /// read lazily, or zero.
+  uint64_t getLazyRecord(unsigned Idx) const {
+    return Idx < LazyRecords.size() ? LazyRecords[Idx] : 0;
+  }
+
+  /// Take \p Idx off the nodes that are still to be read lazily, and return
+  /// the bit position of its record.
+  uint64_t takeLazyRecord(unsigned Idx) {
+    uint64_t BitNo = getLazyRecord(Idx);
+    if (BitNo)
+      LazyRecords[Idx] = 0;
+    return BitNo;
+  }
+
+  /// Take the next node that has been referenced but not read yet.  Returns
+  /// false if there is none.
+  bool takePendingLazyRecord(unsigned &Idx, uint64_t &BitNo);
+};
+
+/// The top-level records of a function block, decoded ahead of time.
+///
+/// Decoding the bitstream does not touch the LLVMContext, so it can be done by
+/// other threads while the reading thread builds the IR, which it must do
+/// alone.  Nested blocks are left in the stream and only their positions are
+/// recorded.
+class DecodedFunctionBlock {
+  struct Entry {
+    /// One of the BitstreamEntry kinds.
+    unsigned Kind;
+    /// The record code, or the block ID of a nested block.
+    unsigned ID;
+    /// The first operand of a record in Ops, or the bit just after the ID of
+    /// a nested block.
+    uint64_t Start;
+    unsigned NumOps;
+  };
+  std::vector<Entry> Entries;
+  std::vector<uint64_t> Ops;
+  unsigned Next = 0;
+  bool Valid = false;
+
+public:
+  /// Decode the function block whose ID ends at \p BitNo, with a cursor of
+  /// its own on \p Reader.  Leaves the block invalid if it has records that
+  /// cannot be represented, in which case it must be read from the stream.
+  void decode(BitstreamReader &Reader, uint64_t BitNo);
+
+  bool isValid() const { return Valid; }
+
+  /// Return the next entry, like BitstreamCursor::advance().  A nested block
+  /// is returned with \p Cursor positioned where its reading starts.
+  BitstreamEntry advance(BitstreamCursor &Cursor);
+
+  /// Read the operands of the record just returned by advance(), like
+  /// BitstreamCursor::readRecord().
+  unsigned readRecord(SmallVectorImpl<uint64_t> &Record);
 };
 
+void DecodedFunctionBlock::decode(BitstreamReader &Reader, uint64_t BitNo) {
+  BitstreamCursor Cursor(Reader);
+  Cursor.JumpToBit(BitNo);
+  if (Cursor.EnterSubBlock(bitc::FUNCTION_BLOCK_ID))
+    return;
+
+  SmallVector<uint64_t, 64> Record;
+  while (1) {
+    BitstreamEntry Entry = Cursor.advance();
+    switch (Entry.Kind) {
+    case BitstreamEntry::Error:
+    case BitstreamEntry::EndBlock:
+      Entries.push_back({Entry.Kind, 0, 0, 0});
+      Valid = true;
+      return;
+    case BitstreamEntry::SubBlock:
+      Entries.push_back({Entry.Kind, Entry.ID, Cursor.GetCurrentBitNo(), 0});
+      if (Cursor.SkipBlock()) {
+        Entries.push_back({BitstreamEntry::Error, 0, 0, 0});
+        Valid = true;
+        return;
+      }
+      continue;
+    case BitstreamEntry::Record:
+      break;
+    }
+
+    Record.clear();
+    StringRef Blob;
+    unsigned Code = Cursor.readRecord(Entry.ID, Record, &Blob);
+    // Function records have no blobs; give up rather than lose one.
+    if (!Blob.empty())
+      return;
+    Entries.push_back({Entry.Kind, Code, Ops.size(), (unsigned)Record.size()});
+    Ops.insert(Ops.end(), Record.begin(), Record.end());
+  }
+}
+
+BitstreamEntry DecodedFunctionBlock::advance(BitstreamCursor &Cursor) {
+  assert(Valid && Next < Entries.size() && "Read past the end of the block");
+  const Entry &E = Entries[Next];
+  switch (E.Kind) {
+  case BitstreamEntry::Error:
+    return BitstreamEntry::getError();
+  case BitstreamEntry::EndBlock:
+    return BitstreamEntry::getEndBlock();
+  case BitstreamEntry::SubBlock:
+    ++Next;
+    Cursor.JumpToBit(E.Start);
+    return BitstreamEntry::getSubBlock(E.ID);
+  case BitstreamEntry::Record:
+    return BitstreamEntry::getRecord(0);
+  }
+  llvm_unreachable("Unknown entry kind");
+}
+
+unsigned DecodedFunctionBlock::readRecord(SmallVectorImpl<uint64_t> &Record) {
+  const Entry &E = Entries[Next++];
+  assert(E.Kind == BitstreamEntry::Record && "Not at a record");
+  Record.append(Ops.begin() + E.Start, Ops.begin() + E.Start + E.NumOps);
+  return E.ID;
+}
+
 class BitcodeReader : public GVMaterializer {
   LLVMContext &Context;
   DiagnosticHandlerFunction DiagnosticHandler;
@@ -194,11 +345,24 @@ class BitcodeReader : public GVMaterializer {
   /// where to find deferred function body in the stream.
   DenseMap<Function*, uint64_t> DeferredFunctionInfo;
 
+  /// Bit offset of the function summary block, or zero if the module has
+  /// none.  The summary records where every function body is.
+  uint64_t FunctionSummaryBit = 0;
+
   /// When Metadata block is initially scanned when parsing the module, we may
   /// choose to defer parsing of the metadata. This vector contains info about
   /// which Metadata blocks are deferred.
   std::vector<uint64_t> DeferredMetadataInfo;
 
+  /// When the deferred metadata is indexed, this cursor is left inside the
+  /// METADATA_BLOCK that defines the lazily loaded nodes, with all its
+  /// abbreviations, to read their records.
+  BitstreamCursor MetadataCursor;
+
+  /// Bit positions of the METADATA_NAME records of the named metadata that is
+  /// still to be read.
+  std::vector<uint64_t> LazyNamedMetadata;
+
   /// These are basic blocks forward-referenced by block addresses.  They are
   /// inserted lazily into functions when they're loaded.  The basic block ID is
   /// its index into the vector.
@@ -244,6 +408,8 @@ public:
 
   bool isDematerializable(const GlobalValue *GV) const override;
   std::error_code materialize(GlobalValue *GV) override;
+  std::error_code materializeFunctions(ArrayRef<Function *> Fns,
+                                       ThreadPool *Pool) override;
   std::error_code materializeModule(Module *M) override;
   std::vector<StructType *> getIdentifiedStructTypes() const override;
   void dematerialize(GlobalValue *GV) override;
@@ -373,12 +539,20 @@ private:
   std::error_code parseValueSymbolTable();
   std::error_code parseConstants();
   std::error_code rememberAndSkipFunctionBody();
+  std::error_code parseFunctionSummaryOffsets();
   /// Save the positions of the Metadata blocks and skip parsing the blocks.
   std::error_code rememberAndSkipMetadata();
-  std::error_code parseFunctionBody(Function *F);
+  std::error_code parseFunctionBody(Function *F,
+                                    DecodedFunctionBlock *Decoded = nullptr);
   std::error_code globalCleanup();
   std::error_code resolveGlobalAndAliasInits();
   std::error_code parseMetadata();
+  std::error_code parseMetadataRecords(BitstreamCursor &Cursor,
+                                       unsigned &NextMDValueNo, bool OneRecord);
+  std::error_code indexDeferredMetadata();
+  std::error_code indexMetadataBlock(uint64_t BitPos);
+  std::error_code loadPendingMetadata();
+  std::error_code loadLazyMDString(unsigned ID);
   std::error_code parseMetadataAttachment(Function &F);
   ErrorOr<std::string> parseModuleTriple();
   std::error_code parseUseLists();
@@ -493,6 +667,8 @@ void BitcodeReader::freeState() {
   std::vector<Function*>().swap(FunctionsWithBodies);
   DeferredFunctionInfo.clear();
   DeferredMetadataInfo.clear();
+  MetadataCursor.init(nullptr);
+  LazyNamedMetadata.clear();
   MDKindMap.clear();
 
   assert(BasicBlockFwdRefs.empty() && "Unresolved blockaddress fwd references");
@@ -998,12 +1174,37 @@ Metadata *BitcodeReaderMDValueList::getValueFwdRef(unsigned Idx) {
   }
   ++NumFwdRefs;
 
+  // A node that is loaded lazily is read once it has been referenced.
+  if (getLazyRecord(Idx))
+    PendingLazyRecords.push_back(Idx);
+
   // Create and return a placeholder, which will later be RAUW'd.
   Metadata *MD = MDNode::getTemporary(Context, None).release();
   MDValuePtrs[Idx].reset(MD);
   return MD;
 }
 
+void BitcodeReaderMDValueList::setLazyRecord(unsigned Idx, uint64_t BitNo) {
+  assert(BitNo && "Lazy record at the start of the stream");
+  if (Idx >= size())
+    resize(Idx + 1);
+  if (Idx >= LazyRecords.size())
+    LazyRecords.resize(Idx + 1);
+  LazyRecords[Idx] = BitNo;
+}
+
+bool BitcodeReaderMDValueList::takePendingLazyRecord(unsigned &Idx,
+                                                     uint64_t &BitNo) {
+  while (!PendingLazyRecords.empty()) {
+    Idx = PendingLazyRecords.back();
+    PendingLazyRecords.pop_back();
+    // Strings may have been read already, as soon as they were needed.
+    if ((BitNo = takeLazyRecord(Idx)))
+      return true;
+  }
+  return false;
+}
+
 void BitcodeReaderMDValueList::tryToResolveCycles() {
   if (!AnyFwdRefs)
     // Nothing to do.
@@ -1656,8 +1857,20 @@ std::error_code BitcodeReader::parseMetadata() {
   if (Stream.EnterSubBlock(bitc::METADATA_BLOCK_ID))
     return error("Invalid record");
 
+  return parseMetadataRecords(Stream, NextMDValueNo, /*OneRecord=*/false);
+}
+
+/// Parse the records of a METADATA_BLOCK from \p Cursor up to the end of the
+/// block or, if \p OneRecord, only the record at its current position.  Nodes
+/// are given IDs from \p NextMDValueNo, which is incremented.
+std::error_code BitcodeReader::parseMetadataRecords(BitstreamCursor &Cursor,
+                                                    unsigned &NextMDValueNo,
+                                                    bool OneRecord) {
   SmallVector<uint64_t, 64> Record;
 
+  // Lazily loaded strings are read as soon as they are needed; an error doing
+  // so is returned once the current record has been parsed.
+  std::error_code LazyStringEC;
   auto getMD =
       [&](unsigned ID) -> Metadata *{ return MDValueList.getValueFwdRef(ID); };
   auto getMDOrNull = [&](unsigned ID) -> Metadata *{
@@ -1668,6 +1881,10 @@ std::error_code BitcodeReader::parseMetadata() {
   auto getMDString = [&](unsigned ID) -> MDString *{
     // This requires that the ID is not really a forward reference.  In
     // particular, the MDString must already have been resolved.
+    if (ID && !LazyStringEC)
+      LazyStringEC = loadLazyMDString(ID - 1);
+    if (LazyStringEC)
+      return nullptr;
     return cast_or_null<MDString>(getMDOrNull(ID));
   };
 
@@ -1676,23 +1893,30 @@ std::error_code BitcodeReader::parseMetadata() {
 
   // Read all the records.
   while (1) {
-    BitstreamEntry Entry = Stream.advanceSkippingSubblocks();
+    Record.clear();
+    StringRef Blob;
+    unsigned Code;
+    if (OneRecord) {
+      Code = Cursor.readRecord(Cursor.ReadCode(), Record, &Blob);
+    } else {
+      BitstreamEntry Entry = Cursor.advanceSkippingSubblocks();
 
-    switch (Entry.Kind) {
-    case BitstreamEntry::SubBlock: // Handled for us already.
-    case BitstreamEntry::Error:
-      return error("Malformed block");
-    case BitstreamEntry::EndBlock:
-      MDValueList.tryToResolveCycles();
-      return std::error_code();
-    case BitstreamEntry::Record:
-      // The interesting case.
-      break;
-    }
+      switch (Entry.Kind) {
+      case BitstreamEntry::SubBlock: // Handled for us already.
+      case BitstreamEntry::Error:
+        return error("Malformed block");
+      case BitstreamEntry::EndBlock:
+        // Read the lazily loaded nodes that the block refers to.  This also
+        // resolves cycles.
+        return loadPendingMetadata();
+      case BitstreamEntry::Record:
+        // The interesting case.
+        break;
+      }
 
-    // Read a record.
-    Record.clear();
-    unsigned Code = Stream.readRecord(Entry.ID, Record);
+      // Read a record.
+      Code = Cursor.readRecord(Entry.ID, Record, &Blob);
+    }
     bool IsDistinct = false;
     switch (Code) {
     default:  // Default behavior: ignore.
@@ -1701,9 +1925,9 @@ std::error_code BitcodeReader::parseMetadata() {
       // Read name of the named metadata.
       SmallString<8> Name(Record.begin(), Record.end());
       Record.clear();
-      Code = Stream.ReadCode();
+      Code = Cursor.ReadCode();
 
-      unsigned NextBitCode = Stream.readRecord(Code, Record);
+      unsigned NextBitCode = Cursor.readRecord(Code, Record);
       if (NextBitCode != bitc::METADATA_NAMED_NODE)
         return error("METADATA_NAME not followed by METADATA_NAMED_NODE");
 
@@ -2085,7 +2309,9 @@ std::error_code BitcodeReader::parseMetadata() {
       break;
     }
     case bitc::METADATA_STRING: {
-      std::string String(Record.begin(), Record.end());
+      // Long strings are blobs, which point into the bitcode.
+      std::string String =
+          Blob.data() ? Blob.str() : std::string(Record.begin(), Record.end());
       llvm::UpgradeMDStringConstant(String);
       Metadata *MD = MDString::get(Context, String);
       MDValueList.assignValue(MD, NextMDValueNo++);
@@ -2104,6 +2330,10 @@ std::error_code BitcodeReader::parseMetadata() {
       break;
     }
     }
+    if (LazyStringEC)
+      return LazyStringEC;
+    if (OneRecord)
+      return std::error_code();
   }
 #undef GET_OR_DISTINCT
 }
@@ -2751,17 +2981,185 @@ std::error_code BitcodeReader::rememberAndSkipMetadata() {
   return std::error_code();
 }
 
-std::error_code BitcodeReader::materializeMetadata() {
+/// Return true if a record of a METADATA_BLOCK with code \p Code defines the
+/// next metadata ID.
+static bool isMetadataNodeRecord(unsigned Code) {
+  switch (Code) {
+  default:
+    return false;
+  case bitc::METADATA_STRING:
+  case bitc::METADATA_VALUE:
+  case bitc::METADATA_NODE:
+  case bitc::METADATA_DISTINCT_NODE:
+  case bitc::METADATA_LOCATION:
+  case bitc::METADATA_OLD_NODE:
+  case bitc::METADATA_OLD_FN_NODE:
+  case bitc::METADATA_GENERIC_DEBUG:
+  case bitc::METADATA_SUBRANGE:
+  case bitc::METADATA_ENUMERATOR:
+  case bitc::METADATA_BASIC_TYPE:
+  case bitc::METADATA_FILE:
+  case bitc::METADATA_DERIVED_TYPE:
+  case bitc::METADATA_COMPOSITE_TYPE:
+  case bitc::METADATA_SUBROUTINE_TYPE:
+  case bitc::METADATA_COMPILE_UNIT:
+  case bitc::METADATA_SUBPROGRAM:
+  case bitc::METADATA_LEXICAL_BLOCK:
+  case bitc::METADATA_LEXICAL_BLOCK_FILE:
+  case bitc::METADATA_NAMESPACE:
+  case bitc::METADATA_TEMPLATE_TYPE:
+  case bitc::METADATA_TEMPLATE_VALUE:
+  case bitc::METADATA_GLOBAL_VAR:
+  case bitc::METADATA_LOCAL_VAR:
+  case bitc::METADATA_EXPRESSION:
+  case bitc::METADATA_OBJC_PROPERTY:
+  case bitc::METADATA_IMPORTED_ENTITY:
+  case bitc::METADATA_MODULE:
+    return true;
+  }
+}
+
+/// Index the deferred METADATA_BLOCK at \p BitPos: its nodes are read only
+/// when they are first referenced, and its named metadata by
+/// materializeMetadata().  Only one block can be indexed; the nodes of any
+/// other one are read now.
+std::error_code BitcodeReader::indexMetadataBlock(uint64_t BitPos) {
+  BitstreamCursor Cursor(*Stream.getBitStreamReader());
+  Cursor.JumpToBit(BitPos);
+  if (Cursor.EnterSubBlock(bitc::METADATA_BLOCK_ID))
+    return error("Invalid record");
+
+  // Nothing is recorded until the whole block has been scanned, so that it
+  // can still be read normally.
+  std::vector<uint64_t> Nodes, Names;
+  SmallVector<uint64_t, 8> Kinds;
+  SmallVector<uint64_t, 64> Record;
+  while (1) {
+    uint64_t EntryBit = Cursor.GetCurrentBitNo();
+    // Stay in the block at its end, with its abbreviations.
+    BitstreamEntry Entry =
+        Cursor.advance(BitstreamCursor::AF_DontPopBlockAtEnd |
+                       BitstreamCursor::AF_DontAutoprocessAbbrevs);
+    if (Entry.Kind == BitstreamEntry::EndBlock)
+      break;
+    if (Entry.Kind == BitstreamEntry::Error)
+      return error("Malformed block");
+    if (Entry.Kind == BitstreamEntry::SubBlock) {
+      if (Cursor.SkipBlock())
+        return error("Malformed block");
+      continue;
+    }
+    if (Entry.ID == bitc::DEFINE_ABBREV) {
+      Cursor.ReadAbbrevRecord();
+      continue;
+    }
+
+    Record.clear();
+    StringRef Blob;
+    unsigned Code = Cursor.readRecord(Entry.ID, Record, &Blob);
+    if (Code == bitc::METADATA_NAME)
+      Names.push_back(EntryBit);
+    else if (Code == bitc::METADATA_KIND)
+      Kinds.push_back(EntryBit);
+    else if (isMetadataNodeRecord(Code))
+      Nodes.push_back(EntryBit);
+  }
+
+  bool HasLazyRecords = !Nodes.empty() || !Names.empty();
+  if (HasLazyRecords && MetadataCursor.getBitStreamReader()) {
+    Stream.JumpToBit(BitPos);
+    return parseMetadata();
+  }
+
+  unsigned NextMDValueNo = MDValueList.size();
+  for (uint64_t KindBit : Kinds) {
+    Cursor.JumpToBit(KindBit);
+    if (std::error_code EC =
+            parseMetadataRecords(Cursor, NextMDValueNo, /*OneRecord=*/true))
+      return EC;
+  }
+  if (!HasLazyRecords)
+    return std::error_code();
+
+  for (uint64_t NodeBit : Nodes)
+    MDValueList.setLazyRecord(NextMDValueNo++, NodeBit);
+  LazyNamedMetadata.insert(LazyNamedMetadata.end(), Names.begin(), Names.end());
+  MetadataCursor = std::move(Cursor);
+  return std::error_code();
+}
+
+/// Prepare the deferred metadata blocks to be read lazily, as function bodies
+/// and named metadata refer to their nodes.  If that is disabled, read them
+/// now.
+std::error_code BitcodeReader::indexDeferredMetadata() {
   for (uint64_t BitPos : DeferredMetadataInfo) {
+    if (LazyMetadataNodes) {
+      if (std::error_code EC = indexMetadataBlock(BitPos))
+        return EC;
+      continue;
+    }
     // Move the bit stream to the saved position.
     Stream.JumpToBit(BitPos);
     if (std::error_code EC = parseMetadata())
       return EC;
   }
+  if (!DeferredMetadataInfo.empty())
+    IsMetadataMaterialized = true;
   DeferredMetadataInfo.clear();
   return std::error_code();
 }
 
+/// Read the lazily loaded nodes that have been referenced, and the ones that
+/// they refer to in turn, then resolve cycles.
+std::error_code BitcodeReader::loadPendingMetadata() {
+  unsigned ID;
+  uint64_t BitNo;
+  while (MDValueList.takePendingLazyRecord(ID, BitNo)) {
+    MetadataCursor.JumpToBit(BitNo);
+    unsigned NextMDValueNo = ID;
+    if (std::error_code EC = parseMetadataRecords(MetadataCursor, NextMDValueNo,
+                                                  /*OneRecord=*/true))
+      return EC;
+  }
+  MDValueList.tryToResolveCycles();
+  return std::error_code();
+}
+
+/// Read the string \p ID now if it is loaded lazily, as its users cannot
+/// refer to a placeholder.
+std::error_code BitcodeReader::loadLazyMDString(unsigned ID) {
+  uint64_t BitNo = MDValueList.getLazyRecord(ID);
+  if (!BitNo)
+    return std::error_code();
+
+  SmallVector<uint64_t, 64> Record;
+  MetadataCursor.JumpToBit(BitNo);
+  if (MetadataCursor.readRecord(MetadataCursor.ReadCode(), Record) !=
+      bitc::METADATA_STRING)
+    return error("Invalid record");
+  MDValueList.takeLazyRecord(ID);
+  MetadataCursor.JumpToBit(BitNo);
+  unsigned NextMDValueNo = ID;
+  return parseMetadataRecords(MetadataCursor, NextMDValueNo,
+                              /*OneRecord=*/true);
+}
+
+std::error_code BitcodeReader::materializeMetadata() {
+  if (std::error_code EC = indexDeferredMetadata())
+    return EC;
+
+  // Named metadata is part of the module, so read it all.
+  for (uint64_t BitNo : LazyNamedMetadata) {
+    MetadataCursor.JumpToBit(BitNo);
+    unsigned NextMDValueNo = MDValueList.size();
+    if (std::error_code EC = parseMetadataRecords(MetadataCursor, NextMDValueNo,
+                                                  /*OneRecord=*/true))
+      return EC;
+  }
+  LazyNamedMetadata.clear();
+  return loadPendingMetadata();
+}
+
 void BitcodeReader::setStripDebugInfo() { StripDebugInfo = true; }
 
 /// When we see the block for a function body, remember where it is and then
@@ -2784,6 +3182,65 @@ std::error_code BitcodeReader::rememberAndSkipFunctionBody() {
   return std::error_code();
 }
 
+/// Record where every function body is, using the offsets in the function
+/// summary, so that materializing a function does not have to scan the bodies
+/// that precede it.
+std::error_code BitcodeReader::parseFunctionSummaryOffsets() {
+  uint64_t CurBit = Stream.GetCurrentBitNo();
+  if (!Stream.canSkipToPos(FunctionSummaryBit / 8))
+    return error("Invalid function summary offset");
+  Stream.JumpToBit(FunctionSummaryBit);
+  BitstreamEntry Entry =
+      Stream.advance(BitstreamCursor::AF_DontAutoprocessAbbrevs);
+  if (Entry.Kind != BitstreamEntry::SubBlock ||
+      Entry.ID != bitc::FUNCTION_SUMMARY_BLOCK_ID ||
+      Stream.EnterSubBlock(bitc::FUNCTION_SUMMARY_BLOCK_ID))
+    return error("Malformed block");
+
+  // Collect the [valueid, offset] pairs first: looking at the function blocks
+  // moves the cursor out of the summary block.
+  SmallVector<std::pair<uint64_t, uint64_t>, 64> BodyOffsets;
+  SmallVector<uint64_t, 64> Record;
+  while (1) {
+    Entry = Stream.advanceSkippingSubblocks();
+    if (Entry.Kind == BitstreamEntry::EndBlock)
+      break;
+    if (Entry.Kind != BitstreamEntry::Record)
+      return error("Malformed block");
+
+    Record.clear();
+    if (Stream.readRecord(Entry.ID, Record) != bitc::FS_CODE_PERMODULE_ENTRY)
+      continue;
+    // PERMODULE_ENTRY: [valueid, nameid, linkage, flags, instcount, offset, ...]
+    if (Record.size() < 6)
+      return error("Invalid record");
+    BodyOffsets.push_back(std::make_pair(Record[0], Record[5]));
+  }
+
+  for (const auto &BodyOffset : BodyOffsets) {
+    Function *F = BodyOffset.first < ValueList.size()
+                      ? dyn_cast_or_null<Function>(ValueList[BodyOffset.first])
+                      : nullptr;
+    auto DFII = DeferredFunctionInfo.find(F);
+    if (!F || DFII == DeferredFunctionInfo.end())
+      return error("Invalid function summary");
+
+    // The offset is the start of the function block; the reader remembers the
+    // position just past its block ID, as rememberAndSkipFunctionBody does.
+    if (!Stream.canSkipToPos(BodyOffset.second / 8))
+      return error("Invalid function summary offset");
+    Stream.JumpToBit(BodyOffset.second);
+    Entry = Stream.advance(BitstreamCursor::AF_DontAutoprocessAbbrevs);
+    if (Entry.Kind != BitstreamEntry::SubBlock ||
+        Entry.ID != bitc::FUNCTION_BLOCK_ID)
+      return error("Malformed block");
+    DFII->second = Stream.GetCurrentBitNo();
+  }
+
+  Stream.JumpToBit(CurBit);
+  return std::error_code();
+}
+
 std::error_code BitcodeReader::globalCleanup() {
   // Patch the initializers for globals and aliases up.
   resolveGlobalAndAliasInits();
@@ -2879,6 +3336,10 @@ std::error_code BitcodeReader::parseModule(bool Resume,
           std::reverse(FunctionsWithBodies.begin(), FunctionsWithBodies.end());
           if (std::error_code EC = globalCleanup())
             return EC;
+          // A streamed module does not have the summary at hand yet.
+          if (FunctionSummaryBit && Buffer)
+            if (std::error_code EC = parseFunctionSummaryOffsets())
+              return EC;
           SeenFirstFunctionBody = true;
         }
 
@@ -2962,6 +3423,12 @@ std::error_code BitcodeReader::parseModule(bool Resume,
       SectionTable.push_back(S);
       break;
     }
+    case bitc::MODULE_CODE_FNSUMMARY_OFFSET: { // FNSUMMARY_OFFSET: [offset]
+      if (Record.size() < 1)
+        return error("Invalid record");
+      FunctionSummaryBit = Record[0] * 32;
+      break;
+    }
     case bitc::MODULE_CODE_GCNAME: {  // SECTIONNAME: [strchr x N]
       std::string S;
       if (convertToString(Record, 0, S))
@@ -3386,8 +3853,9 @@ static std::error_code typeCheckLoadStoreInst(DiagnosticHandlerFunction DH,
 }
 
 /// Lazily parse the specified function body block.
-std::error_code BitcodeReader::parseFunctionBody(Function *F) {
-  if (Stream.EnterSubBlock(bitc::FUNCTION_BLOCK_ID))
+std::error_code BitcodeReader::parseFunctionBody(Function *F,
+                                                 DecodedFunctionBlock *Decoded) {
+  if (!Decoded && Stream.EnterSubBlock(bitc::FUNCTION_BLOCK_ID))
     return error("Invalid record");
 
   InstructionList.clear();
@@ -3415,7 +3883,8 @@ std::error_code BitcodeReader::parseFunctionBody(Function *F) {
   // Read all the records.
   SmallVector<uint64_t, 64> Record;
   while (1) {
-    BitstreamEntry Entry = Stream.advance();
+    BitstreamEntry Entry =
+        Decoded ? Decoded->advance(Stream) : Stream.advance();
 
     switch (Entry.Kind) {
     case BitstreamEntry::Error:
@@ -3461,7 +3930,8 @@ std::error_code BitcodeReader::parseFunctionBody(Function *F) {
     // Read a record.
     Record.clear();
     Instruction *I = nullptr;
-    unsigned BitCode = Stream.readRecord(Entry.ID, Record);
+    unsigned BitCode = Decoded ? Decoded->readRecord(Record)
+                               : Stream.readRecord(Entry.ID, Record);
     switch (BitCode) {
     default: // Default behavior: reject
       return error("Invalid value");
@@ -4613,6 +5083,10 @@ std::error_code BitcodeReader::parseFunctionBody(Function *F) {
 
 OutOfRecordLoop:
 
+  // Read the module-level metadata that the function refers to.
+  if (std::error_code EC = loadPendingMetadata())
+    return EC;
+
   // Check the function list for unresolved values.
   if (Argument *A = dyn_cast<Argument>(ValueList.back())) {
     if (!A->getParent()) {
@@ -4659,33 +5133,128 @@ std::error_code BitcodeReader::findFunctionInStream(
 void BitcodeReader::releaseBuffer() { Buffer.release(); }
 
 std::error_code BitcodeReader::materialize(GlobalValue *GV) {
-  if (std::error_code EC = materializeMetadata())
+  if (std::error_code EC = indexDeferredMetadata())
     return EC;
 
   Function *F = dyn_cast<Function>(GV);
   // If it's not a function or is already material, ignore the request.
   if (!F || !F->isMaterializable())
     return std::error_code();
+  return materializeFunctions(F, nullptr);
+}
 
-  DenseMap<Function*, uint64_t>::iterator DFII = DeferredFunctionInfo.find(F);
-  assert(DFII != DeferredFunctionInfo.end() && "Deferred function not found!");
-  // If its position is recorded as 0, its body is somewhere in the stream
-  // but we haven't seen it yet.
-  if (DFII->second == 0)
-    if (std::error_code EC = findFunctionInStream(F, DFII))
-      return EC;
+std::error_code BitcodeReader::materializeFunctions(ArrayRef<Function *> Fns,
+                                                    ThreadPool *Pool) {
+  // Function bodies read just the metadata that they refer to.
+  if (std::error_code EC = indexDeferredMetadata())
+    return EC;
 
-  // Move the bit stream to the saved position of the deferred function body.
-  Stream.JumpToBit(DFII->second);
+  // Find the bodies that are still to be read, in stream order.  Decoding on
+  // the pool needs them all up front.  Otherwise the bodies that have not
+  // been seen yet, which follow the others in the stream, are found as they
+  // are read, like materialize() does.
+  bool FindAll = Pool && Buffer;
+  std::vector<std::pair<uint64_t, Function *>> Bodies, Unseen;
+  for (Function *F : Fns) {
+    if (!F->isMaterializable())
+      continue;
+    DenseMap<Function*, uint64_t>::iterator DFII = DeferredFunctionInfo.find(F);
+    assert(DFII != DeferredFunctionInfo.end() && "Deferred function not found!");
+    // If its position is recorded as 0, its body is somewhere in the stream
+    // but we haven't seen it yet.
+    if (DFII->second == 0) {
+      if (!FindAll) {
+        Unseen.push_back(std::make_pair(0, F));
+        continue;
+      }
+      if (std::error_code EC = findFunctionInStream(F, DFII))
+        return EC;
+    }
+    Bodies.push_back(std::make_pair(DFII->second, F));
+  }
+  std::sort(Bodies.begin(), Bodies.end());
+  Bodies.erase(std::unique(Bodies.begin(), Bodies.end()), Bodies.end());
+  Bodies.insert(Bodies.end(), Unseen.begin(), Unseen.end());
+
+  // Have the pool decode the bodies while this thread builds their IR.  Each
+  // body is decoded by whichever of a task and this thread claims it first:
+  // this thread never waits for a task that has not started, so it cannot
+  // deadlock when it is itself running on the pool.  Decoded records take
+  // several times the space of the bitcode, so the tasks are only allowed a
+  // few bodies ahead.  A streamed module can only be read from this thread.
+  struct DecodeSlot {
+    std::atomic<bool> Claimed;
+    std::shared_future<void> Done;
+    DecodedFunctionBlock Block;
+  };
+  std::unique_ptr<DecodeSlot[]> Slots;
+  TaskGroup Group;
+  unsigned NumSubmitted = 0;
+  auto submitDecodes = [&](unsigned End) {
+    End = std::min<unsigned>(End, Bodies.size());
+    for (; NumSubmitted < End; ++NumSubmitted) {
+      DecodeSlot &Slot = Slots[NumSubmitted];
+      BitstreamReader &Reader = *StreamFile;
+      uint64_t BitNo = Bodies[NumSubmitted].first;
+      Slot.Done = Pool->async(Group, [&Slot, &Reader, BitNo] {
+        if (!Slot.Claimed.exchange(true))
+          Slot.Block.decode(Reader, BitNo);
+      });
+    }
+  };
+  auto finishDecodes = [&] {
+    if (!Slots)
+      return;
+    for (unsigned I = 0; I != NumSubmitted; ++I)
+      Slots[I].Claimed = true;
+    Pool->wait(Group);
+  };
+  unsigned Window = 0;
+  if (FindAll && Bodies.size() > 1) {
+    Slots.reset(new DecodeSlot[Bodies.size()]);
+    for (unsigned I = 0, E = Bodies.size(); I != E; ++I)
+      Slots[I].Claimed = false;
+    Window = 4 * Pool->getThreadCount();
+  }
 
-  if (std::error_code EC = parseFunctionBody(F))
-    return EC;
-  F->setIsMaterializable(false);
+  for (unsigned I = 0, E = Bodies.size(); I != E; ++I) {
+    Function *F = Bodies[I].second;
+    if (!Bodies[I].first) {
+      // Finding an earlier body may have read this one as well.
+      if (!F->isMaterializable())
+        continue;
+      auto DFII = DeferredFunctionInfo.find(F);
+      if (DFII->second == 0)
+        if (std::error_code EC = findFunctionInStream(F, DFII))
+          return EC;
+      Bodies[I].first = DFII->second;
+    }
+    DecodedFunctionBlock *Decoded = nullptr;
+    if (Slots)
+      submitDecodes(I + 1 + Window);
+    if (Slots && Slots[I].Claimed.exchange(true)) {
+      Slots[I].Done.wait();
+      if (Slots[I].Block.isValid())
+        Decoded = &Slots[I].Block;
+    }
+
+    // Move the bit stream to the saved position of the deferred function body.
+    Stream.JumpToBit(Bodies[I].first);
+    std::error_code EC = parseFunctionBody(F, Decoded);
+    if (Decoded)
+      *Decoded = DecodedFunctionBlock();
+    if (EC) {
+      finishDecodes();
+      return EC;
+    }
+    F->setIsMaterializable(false);
 
-  if (StripDebugInfo)
-    stripDebugInfo(*F);
+    if (StripDebugInfo)
+      stripDebugInfo(*F);
+  }
+  finishDecodes();
 
-  // Upgrade any old intrinsic calls in the function.
+  // Upgrade any old intrinsic calls in the functions.
   for (auto &I : UpgradedIntrinsics) {
     for (auto UI = I.first->user_begin(), UE = I.first->user_end(); UI != UE;) {
       User *U = *UI;
@@ -4695,7 +5264,7 @@ std::error_code BitcodeReader::materialize(GlobalValue *GV) {
     }
   }
 
-  // Bring in any functions that this function forward-referenced via
+  // Bring in any functions that these functions forward-referenced via
   // blockaddresses.
   return materializeForwardReferencedFunctions();
 }
@@ -4736,13 +5305,15 @@ std::error_code BitcodeReader::materializeModule(Module *M) {
   // Promise to materialize all forward references.
   WillMaterializeAllForwardRefs = true;
 
-  // Iterate over the module, deserializing any functions that are still on
-  // disk.
-  for (Module::iterator F = TheModule->begin(), E = TheModule->end();
-       F != E; ++F) {
-    if (std::error_code EC = materialize(F))
-      return EC;
-  }
+  // Deserialize any functions that are still on disk.
+  std::vector<Function *> Fns;
+  for (Function &F : *TheModule)
+    Fns.push_back(&F);
+  std::unique_ptr<ThreadPool> Pool;
+  if (DecodeThreads)
+    Pool.reset(new ThreadPool(DecodeThreads));
+  if (std::error_code EC = materializeFunctions(Fns, Pool.get()))
+    return EC;
   // At this point, if there are any function bodies, the current bit is
   // pointing to the END_BLOCK record after them. Now make sure the rest
   // of the bits in the module have been read.
@@ -4833,6 +5404,248 @@ BitcodeReader::initLazyStream(std::unique_ptr<DataStreamer> Streamer) {
   return std::error_code();
 }
 
+//===----------------------------------------------------------------------===//
+// Function summary reader
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// Reads the function summary of a module, or a combined function index,
+/// without parsing any IR.
+class FunctionIndexBitcodeReader {
+  DiagnosticHandlerFunction DiagnosticHandler;
+  MemoryBufferRef Buffer;
+  std::unique_ptr<BitstreamReader> StreamFile;
+  BitstreamCursor Stream;
+
+  /// Names defined by the NAME records of the summary block, by id.
+  std::vector<std::string> Names;
+
+  /// Module paths defined by the MODULE_PATH records, as owned by the index.
+  std::vector<StringRef> ModulePaths;
+
+public:
+  FunctionIndexBitcodeReader(MemoryBufferRef Buffer,
+                             DiagnosticHandlerFunction DiagnosticHandler);
+
+  std::error_code error(const Twine &Message);
+
+  /// Return true if the buffer has a function summary.
+  ErrorOr<bool> hasSummary();
+
+  /// Read the function summary into \p Index.
+  std::error_code parseSummaryInto(FunctionInfoIndex &Index);
+
+private:
+  std::error_code initStream();
+  std::error_code findSummaryBlock(bool &Found, bool &IsCombined);
+  std::error_code parseSummaryBlock(FunctionInfoIndex &Index, bool IsCombined);
+  std::error_code getName(uint64_t ID, StringRef &Name);
+};
+} // end anonymous namespace
+
+FunctionIndexBitcodeReader::FunctionIndexBitcodeReader(
+    MemoryBufferRef Buffer, DiagnosticHandlerFunction DiagnosticHandler)
+    : DiagnosticHandler(DiagnosticHandler), Buffer(Buffer) {
+  if (!this->DiagnosticHandler)
+    this->DiagnosticHandler = [](const DiagnosticInfo &) {};
+}
+
+std::error_code FunctionIndexBitcodeReader::error(const Twine &Message) {
+  return ::error(DiagnosticHandler,
+                 make_error_code(BitcodeError::CorruptedBitcode), Message);
+}
+
+std::error_code FunctionIndexBitcodeReader::initStream() {
+  const unsigned char *BufPtr = (const unsigned char *)Buffer.getBufferStart();
+  const unsigned char *BufEnd = BufPtr + Buffer.getBufferSize();
+
+  if (Buffer.getBufferSize() & 3)
+    return error("Invalid bitcode signature");
+
+  if (isBitcodeWrapper(BufPtr, BufEnd))
+    if (SkipBitcodeWrapperHeader(BufPtr, BufEnd, true))
+      return error("Invalid bitcode wrapper header");
+
+  StreamFile.reset(new BitstreamReader(BufPtr, BufEnd));
+  Stream.init(&*StreamFile);
+
+  // Sniff for the signature.
+  if (Stream.Read(8) != 'B' ||
+      Stream.Read(8) != 'C' ||
+      Stream.Read(4) != 0x0 ||
+      Stream.Read(4) != 0xC ||
+      Stream.Read(4) != 0xE ||
+      Stream.Read(4) != 0xD)
+    return error("Invalid bitcode signature");
+  return std::error_code();
+}
+
+/// Position the cursor just inside the function summary block, if there is
+/// one.  The block is either nested in the module block, or at the top level
+/// of a combined index.
+std::error_code FunctionIndexBitcodeReader::findSummaryBlock(bool &Found,
+                                                             bool &IsCombined) {
+  Found = false;
+  IsCombined = true;
+  SmallVector<uint64_t, 64> Record;
+  while (!Stream.AtEndOfStream()) {
+    BitstreamEntry Entry = Stream.advance();
+    switch (Entry.Kind) {
+    case BitstreamEntry::Error:
+      return error("Malformed block");
+    case BitstreamEntry::EndBlock:
+      // The end of a module without a summary.
+      return std::error_code();
+    case BitstreamEntry::Record:
+      if (IsCombined) {
+        Stream.skipRecord(Entry.ID);
+        continue;
+      }
+      // Go straight to the summary of a module if we know where it is.
+      Record.clear();
+      if (Stream.readRecord(Entry.ID, Record) ==
+              bitc::MODULE_CODE_FNSUMMARY_OFFSET &&
+          Record.size() == 1) {
+        if (!Stream.canSkipToPos(Record[0] * 4))
+          return error("Invalid function summary offset");
+        Stream.JumpToBit(Record[0] * 32);
+      }
+      continue;
+    case BitstreamEntry::SubBlock:
+      break;
+    }
+
+    if (Entry.ID == bitc::FUNCTION_SUMMARY_BLOCK_ID) {
+      if (Stream.EnterSubBlock(bitc::FUNCTION_SUMMARY_BLOCK_ID))
+        return error("Malformed block");
+      Found = true;
+      return std::error_code();
+    }
+    if (Entry.ID == bitc::MODULE_BLOCK_ID) {
+      if (Stream.EnterSubBlock(bitc::MODULE_BLOCK_ID))
+        return error("Malformed block");
+      IsCombined = false;
+      continue;
+    }
+    if (Entry.ID == bitc::BLOCKINFO_BLOCK_ID) {
+      if (Stream.ReadBlockInfoBlock())
+        return error("Malformed block");
+      continue;
+    }
+    if (Stream.SkipBlock())
+      return error("Malformed block");
+  }
+  return std::error_code();
+}
+
+ErrorOr<bool> FunctionIndexBitcodeReader::hasSummary() {
+  if (std::error_code EC = initStream())
+    return EC;
+  bool Found, IsCombined;
+  if (std::error_code EC = findSummaryBlock(Found, IsCombined))
+    return EC;
+  return Found;
+}
+
+std::error_code FunctionIndexBitcodeReader::getName(uint64_t ID,
+                                                    StringRef &Name) {
+  if (ID >= Names.size())
+    return error("Invalid function summary name");
+  Name = Names[ID];
+  return std::error_code();
+}
+
+std::error_code
+FunctionIndexBitcodeReader::parseSummaryBlock(FunctionInfoIndex &Index,
+                                              bool IsCombined) {
+  StringRef OwnModulePath;
+  if (!IsCombined)
+    OwnModulePath = Index.addModulePath(Buffer.getBufferIdentifier(), 0);
+
+  SmallVector<uint64_t, 64> Record;
+  while (1) {
+    BitstreamEntry Entry = Stream.advanceSkippingSubblocks();
+    switch (Entry.Kind) {
+    case BitstreamEntry::SubBlock: // Handled for us already.
+    case BitstreamEntry::Error:
+      return error("Malformed block");
+    case BitstreamEntry::EndBlock:
+      return std::error_code();
+    case BitstreamEntry::Record:
+      // The interesting case.
+      break;
+    }
+
+    Record.clear();
+    unsigned Code = Stream.readRecord(Entry.ID, Record);
+    switch (Code) {
+    default: // Default behavior: ignore.
+      break;
+    case bitc::FS_CODE_NAME: { // NAME: [namechar x N]
+      std::string S;
+      if (convertToString(Record, 0, S))
+        return error("Invalid record");
+      Names.push_back(std::move(S));
+      break;
+    }
+    case bitc::FS_CODE_MODULE_PATH: { // MODULE_PATH: [namechar x N]
+      std::string S;
+      if (convertToString(Record, 0, S))
+        return error("Invalid record");
+      ModulePaths.push_back(Index.addModulePath(S, ModulePaths.size()));
+      break;
+    }
+    // PERMODULE_ENTRY: [valueid, nameid, linkage, flags, instcount, offset,
+    //                   calleenameid x N]
+    // COMBINED_ENTRY:  [modid, nameid, linkage, flags, instcount, offset,
+    //                   calleenameid x N]
+    case bitc::FS_CODE_PERMODULE_ENTRY:
+    case bitc::FS_CODE_COMBINED_ENTRY: {
+      if (Record.size() < 6)
+        return error("Invalid record");
+      bool IsCombinedEntry = Code == bitc::FS_CODE_COMBINED_ENTRY;
+      if (IsCombinedEntry != IsCombined)
+        return error("Invalid function summary entry");
+
+      StringRef ModulePath = OwnModulePath;
+      if (IsCombined) {
+        if (Record[0] >= ModulePaths.size())
+          return error("Invalid function summary module id");
+        ModulePath = ModulePaths[Record[0]];
+      }
+      StringRef Name;
+      if (std::error_code EC = getName(Record[1], Name))
+        return EC;
+
+      FunctionSummary Summary(getDecodedLinkage(Record[2]), Record[4],
+                              Record[3] & bitc::FS_FLAG_REFERS_TO_LOCALS);
+      for (unsigned I = 6, E = Record.size(); I != E; ++I) {
+        StringRef Callee;
+        if (std::error_code EC = getName(Record[I], Callee))
+          return EC;
+        Summary.addCall(Callee);
+      }
+      Index.addFunctionInfo(Name, llvm::make_unique<FunctionInfo>(
+                                      std::move(Summary), ModulePath,
+                                      Record[5]));
+      break;
+    }
+    }
+  }
+}
+
+std::error_code
+FunctionIndexBitcodeReader::parseSummaryInto(FunctionInfoIndex &Index) {
+  if (std::error_code EC = initStream())
+    return EC;
+  bool Found, IsCombined;
+  if (std::error_code EC = findSummaryBlock(Found, IsCombined))
+    return EC;
+  if (!Found)
+    return error("Could not find function summary");
+  return parseSummaryBlock(Index, IsCombined);
+}
+
 namespace {
 class BitcodeErrorCategoryType : public std::error_category {
   const char *name() const LLVM_NOEXCEPT override {
@@ -4954,3 +5767,20 @@ llvm::getBitcodeTargetTriple(MemoryBufferRef Buffer, LLVMContext &Context,
     return "";
   return Triple.get();
 }
+
+bool llvm::hasFunctionSummary(MemoryBufferRef Buffer,
+                              DiagnosticHandlerFunction DiagnosticHandler) {
+  FunctionIndexBitcodeReader R(Buffer, DiagnosticHandler);
+  ErrorOr<bool> HasSummary = R.hasSummary();
+  return HasSummary && HasSummary.get();
+}
+
+ErrorOr<std::unique_ptr<FunctionInfoIndex>>
+llvm::getFunctionInfoIndex(MemoryBufferRef Buffer,
+                           DiagnosticHandlerFunction DiagnosticHandler) {
+  FunctionIndexBitcodeReader R(Buffer, DiagnosticHandler);
+  auto Index = llvm::make_unique<FunctionInfoIndex>();
+  if (std::error_code EC = R.parseSummaryInto(*Index))
+    return EC;
+  return std::move(Index);
+}
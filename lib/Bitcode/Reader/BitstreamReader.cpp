@@ -233,17 +233,21 @@ unsigned BitstreamCursor::readRecord(unsigned AbbrevID,
       break;
     }
 
-    // Otherwise, inform the streamer that we need these bytes in memory.
-    const char *Ptr = (const char*)
-      BitStream->getBitcodeBytes().getPointer(CurBitPos/8, NumElts);
-
-    // If we can return a reference to the data, do so to avoid copying it.
-    if (Blob) {
-      *Blob = StringRef(Ptr, NumElts);
+    // A streamed reader cannot hand out pointers into its buffer, so copy the
+    // bytes into Vals; callers asking for a blob must accept either form.
+    ArrayRef<uint8_t> Bytes = BitStream->getDirectBytes();
+    if (Bytes.empty()) {
+      SmallVector<uint8_t, 64> Buf(NumElts);
+      BitStream->getBitcodeBytes().readBytes(Buf.data(), NumElts,
+                                             CurBitPos / 8);
+      Vals.append(Buf.begin(), Buf.end());
+    } else if (Blob) {
+      // If we can return a reference to the data, do so to avoid copying it.
+      *Blob = StringRef((const char *)Bytes.data() + CurBitPos / 8, NumElts);
     } else {
       // Otherwise, unpack into Vals with zero extension.
-      for (; NumElts; --NumElts)
-        Vals.push_back((unsigned char)*Ptr++);
+      Vals.append(Bytes.begin() + CurBitPos / 8,
+                  Bytes.begin() + CurBitPos / 8 + NumElts);
     }
     // Skip over tail padding.
     JumpToBit(NewEnd);
@@ -19,6 +19,7 @@
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DebugInfoMetadata.h"
 #include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/FunctionInfo.h"
 #include "llvm/IR/InlineAsm.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
@@ -30,6 +31,7 @@
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/Program.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
 #include <cctype>
 #include <map>
 using namespace llvm;
@@ -486,8 +488,8 @@ static void WriteTypeTable(const ValueEnumerator &VE, BitstreamWriter &Stream) {
   Stream.ExitBlock();
 }
 
-static unsigned getEncodedLinkage(const GlobalValue &GV) {
-  switch (GV.getLinkage()) {
+static unsigned getEncodedLinkage(GlobalValue::LinkageTypes Linkage) {
+  switch (Linkage) {
   case GlobalValue::ExternalLinkage:
     return 0;
   case GlobalValue::WeakAnyLinkage:
@@ -514,6 +516,10 @@ static unsigned getEncodedLinkage(const GlobalValue &GV) {
   llvm_unreachable("Invalid linkage");
 }
 
+static unsigned getEncodedLinkage(const GlobalValue &GV) {
+  return getEncodedLinkage(GV.getLinkage());
+}
+
 static unsigned getEncodedVisibility(const GlobalValue &GV) {
   switch (GV.getVisibility()) {
   case GlobalValue::DefaultVisibility:   return 0;
@@ -1170,7 +1176,7 @@ static void WriteModuleMetadata(const Module *M,
 
   Stream.EnterSubblock(bitc::METADATA_BLOCK_ID, 3);
 
-  unsigned MDSAbbrev = 0;
+  unsigned MDSAbbrev = 0, MDSBlobAbbrev = 0;
   if (VE.hasMDString()) {
     // Abbrev for METADATA_STRING.
     BitCodeAbbrev *Abbv = new BitCodeAbbrev();
@@ -1178,6 +1184,13 @@ static void WriteModuleMetadata(const Module *M,
     Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Array));
     Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, 8));
     MDSAbbrev = Stream.EmitAbbrev(Abbv);
+
+    // Abbrev for long METADATA_STRINGs, as blobs that readers can use where
+    // they are instead of decoding them character by character.
+    Abbv = new BitCodeAbbrev();
+    Abbv->Add(BitCodeAbbrevOp(bitc::METADATA_STRING));
+    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Blob));
+    MDSBlobAbbrev = Stream.EmitAbbrev(Abbv);
   }
 
   // Initialize MDNode abbreviations.
@@ -1245,6 +1258,15 @@ static void WriteModuleMetadata(const Module *M,
       continue;
     }
     const MDString *MDS = cast<MDString>(MD);
+    // The alignment of a blob costs up to seven bytes, which only pays off
+    // for longer strings.
+    if (MDS->getLength() >= 32) {
+      Record.push_back(bitc::METADATA_STRING);
+      Stream.EmitRecordWithBlob(MDSBlobAbbrev, Record, MDS->getString());
+      Record.clear();
+      continue;
+    }
+
     // Code: [strchar x N]
     Record.append(MDS->bytes_begin(), MDS->bytes_end());
 
@@ -2410,9 +2432,107 @@ static void WriteBlockInfo(const ValueEnumerator &VE, BitstreamWriter &Stream) {
   Stream.ExitBlock();
 }
 
+namespace {
+/// Assigns ids to the names used in a FUNCTION_SUMMARY block, emitting a NAME
+/// record the first time each name is used.
+class SummaryNameTable {
+  BitstreamWriter &Stream;
+  unsigned Abbrev;
+  StringMap<unsigned> IDs;
+
+public:
+  SummaryNameTable(BitstreamWriter &Stream, unsigned Abbrev)
+      : Stream(Stream), Abbrev(Abbrev) {}
+
+  unsigned getID(StringRef Name) {
+    auto Insertion = IDs.insert(std::make_pair(Name, IDs.size()));
+    if (Insertion.second)
+      WriteStringRecord(bitc::FS_CODE_NAME, Name, Abbrev, Stream);
+    return Insertion.first->second;
+  }
+};
+} // end anonymous namespace
+
+static unsigned createSummaryNameAbbrev(BitstreamWriter &Stream) {
+  BitCodeAbbrev *Abbv = new BitCodeAbbrev();
+  Abbv->Add(BitCodeAbbrevOp(bitc::FS_CODE_NAME));
+  Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Array));
+  Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Char6));
+  return Stream.EmitAbbrev(Abbv);
+}
+
+/// Emit a FUNCTION_SUMMARY entry for the function \p Name, which is owned by
+/// the value or module with id \p OwnerID.
+static void WriteFunctionSummaryEntry(unsigned Code, uint64_t OwnerID,
+                                      StringRef Name,
+                                      const FunctionSummary &Summary,
+                                      uint64_t BitcodeIndex,
+                                      SummaryNameTable &Names,
+                                      BitstreamWriter &Stream) {
+  SmallVector<uint64_t, 64> Vals;
+  Vals.push_back(OwnerID);
+  Vals.push_back(Names.getID(Name));
+  Vals.push_back(getEncodedLinkage(Summary.getLinkage()));
+  Vals.push_back(Summary.refersToLocals() ? bitc::FS_FLAG_REFERS_TO_LOCALS
+                                          : 0);
+  Vals.push_back(Summary.getInstCount());
+  Vals.push_back(BitcodeIndex);
+  for (const std::string &Callee : Summary.calls())
+    Vals.push_back(Names.getID(Callee));
+  Stream.EmitRecord(Code, Vals);
+}
+
+/// Emit the summary of every named function definition in \p M.
+/// \p FunctionBodyOffsets holds the bit offset of each function block.
+static void WritePerModuleFunctionSummary(
+    const Module *M, const ValueEnumerator &VE,
+    const DenseMap<const Function *, uint64_t> &FunctionBodyOffsets,
+    BitstreamWriter &Stream) {
+  Stream.EnterSubblock(bitc::FUNCTION_SUMMARY_BLOCK_ID, 3);
+  SummaryNameTable Names(Stream, createSummaryNameAbbrev(Stream));
+
+  for (const Function &F : *M) {
+    // Unnamed functions cannot be referred to from other modules.
+    if (F.isDeclaration() || !F.hasName())
+      continue;
+    WriteFunctionSummaryEntry(bitc::FS_CODE_PERMODULE_ENTRY, VE.getValueID(&F),
+                              F.getName(), FunctionSummary::compute(F),
+                              FunctionBodyOffsets.lookup(&F), Names, Stream);
+  }
+  Stream.ExitBlock();
+}
+
+/// Emit the summaries of all the modules in \p Index.
+static void WriteCombinedFunctionSummary(const FunctionInfoIndex &Index,
+                                         BitstreamWriter &Stream) {
+  Stream.EnterSubblock(bitc::FUNCTION_SUMMARY_BLOCK_ID, 3);
+  SummaryNameTable Names(Stream, createSummaryNameAbbrev(Stream));
+
+  // Modules are numbered by the order of their MODULE_PATH records.
+  std::vector<std::pair<uint64_t, StringRef>> ModulePaths;
+  for (const auto &Entry : Index.modulePaths())
+    ModulePaths.push_back(std::make_pair(Entry.second, Entry.first()));
+  std::sort(ModulePaths.begin(), ModulePaths.end());
+  StringMap<unsigned> ModuleIDs;
+  for (const auto &Entry : ModulePaths) {
+    unsigned ModuleID = ModuleIDs.size();
+    ModuleIDs[Entry.second] = ModuleID;
+    WriteStringRecord(bitc::FS_CODE_MODULE_PATH, Entry.second, 0, Stream);
+  }
+
+  for (const auto &Entry : Index)
+    for (const auto &Info : Entry.second)
+      WriteFunctionSummaryEntry(bitc::FS_CODE_COMBINED_ENTRY,
+                                ModuleIDs.lookup(Info->modulePath()),
+                                Entry.first(), Info->summary(),
+                                Info->bitcodeIndex(), Names, Stream);
+  Stream.ExitBlock();
+}
+
 /// WriteModule - Emit the specified module to the bitstream.
 static void WriteModule(const Module *M, BitstreamWriter &Stream,
-                        bool ShouldPreserveUseListOrder) {
+                        bool ShouldPreserveUseListOrder,
+                        bool EmitFunctionSummary, uint64_t BitcodeStartBit) {
   Stream.EnterSubblock(bitc::MODULE_BLOCK_ID, 3);
 
   SmallVector<unsigned, 1> Vals;
@@ -2457,10 +2577,41 @@ static void WriteModule(const Module *M, BitstreamWriter &Stream,
   if (VE.shouldPreserveUseListOrder())
     WriteUseListBlock(nullptr, VE, Stream);
 
+  // The function summary follows the function bodies, so leave room for its
+  // offset here, where a lazy reader will see it before any body.
+  bool HasFunctionBodies =
+      std::any_of(M->begin(), M->end(),
+                  [](const Function &F) { return !F.isDeclaration(); });
+  uint64_t SummaryOffsetPlaceholder = 0;
+  if (EmitFunctionSummary && HasFunctionBodies) {
+    BitCodeAbbrev *Abbv = new BitCodeAbbrev();
+    Abbv->Add(BitCodeAbbrevOp(bitc::MODULE_CODE_FNSUMMARY_OFFSET));
+    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, 32));
+    unsigned SummaryOffsetAbbrev = Stream.EmitAbbrev(Abbv);
+    uint64_t Vals[] = {0};
+    Stream.EmitRecord(bitc::MODULE_CODE_FNSUMMARY_OFFSET, Vals,
+                      SummaryOffsetAbbrev);
+    SummaryOffsetPlaceholder = Stream.GetCurrentBitNo() - 32;
+  }
+
   // Emit function bodies.
+  DenseMap<const Function *, uint64_t> FunctionBodyOffsets;
   for (Module::const_iterator F = M->begin(), E = M->end(); F != E; ++F)
-    if (!F->isDeclaration())
+    if (!F->isDeclaration()) {
+      if (EmitFunctionSummary)
+        FunctionBodyOffsets[&*F] = Stream.GetCurrentBitNo() - BitcodeStartBit;
       WriteFunction(*F, VE, Stream);
+    }
+
+  if (EmitFunctionSummary) {
+    if (HasFunctionBodies) {
+      // Blocks are 32-bit aligned, so the offset is stored in words.
+      uint64_t SummaryOffset = Stream.GetCurrentBitNo() - BitcodeStartBit;
+      assert((SummaryOffset & 31) == 0 && "Block is not 32-bit aligned");
+      Stream.BackpatchField32(SummaryOffsetPlaceholder, SummaryOffset / 32);
+    }
+    WritePerModuleFunctionSummary(M, VE, FunctionBodyOffsets, Stream);
+  }
 
   Stream.ExitBlock();
 }
@@ -2535,10 +2686,20 @@ static void EmitDarwinBCHeaderAndTrailer(SmallVectorImpl<char> &Buffer,
     Buffer.push_back(0);
 }
 
+static void WriteBitcodeHeader(BitstreamWriter &Stream) {
+  Stream.Emit((unsigned)'B', 8);
+  Stream.Emit((unsigned)'C', 8);
+  Stream.Emit(0x0, 4);
+  Stream.Emit(0xC, 4);
+  Stream.Emit(0xE, 4);
+  Stream.Emit(0xD, 4);
+}
+
 /// WriteBitcodeToFile - Write the specified module to the specified output
 /// stream.
 void llvm::WriteBitcodeToFile(const Module *M, raw_ostream &Out,
-                              bool ShouldPreserveUseListOrder) {
+                              bool ShouldPreserveUseListOrder,
+                              bool EmitFunctionSummary) {
   SmallVector<char, 0> Buffer;
   Buffer.reserve(256*1024);
 
@@ -2551,17 +2712,14 @@ void llvm::WriteBitcodeToFile(const Module *M, raw_ostream &Out,
   // Emit the module into the buffer.
   {
     BitstreamWriter Stream(Buffer);
+    uint64_t BitcodeStartBit = Stream.GetCurrentBitNo();
 
     // Emit the file header.
-    Stream.Emit((unsigned)'B', 8);
-    Stream.Emit((unsigned)'C', 8);
-    Stream.Emit(0x0, 4);
-    Stream.Emit(0xC, 4);
-    Stream.Emit(0xE, 4);
-    Stream.Emit(0xD, 4);
+    WriteBitcodeHeader(Stream);
 
     // Emit the module.
-    WriteModule(M, Stream, ShouldPreserveUseListOrder);
+    WriteModule(M, Stream, ShouldPreserveUseListOrder, EmitFunctionSummary,
+                BitcodeStartBit);
   }
 
   if (TT.isOSDarwin())
@@ -2570,3 +2728,19 @@ void llvm::WriteBitcodeToFile(const Module *M, raw_ostream &Out,
   // Write the generated bitstream to "Out".
   Out.write((char*)&Buffer.front(), Buffer.size());
 }
+
+/// WriteFunctionSummaryToFile - Write the specified combined function index to
+/// the specified output stream.
+void llvm::WriteFunctionSummaryToFile(const FunctionInfoIndex &Index,
+                                      raw_ostream &Out) {
+  SmallVector<char, 0> Buffer;
+  Buffer.reserve(256 * 1024);
+
+  {
+    BitstreamWriter Stream(Buffer);
+    WriteBitcodeHeader(Stream);
+    WriteCombinedFunctionSummary(Index, Stream);
+  }
+
+  Out.write((char *)&Buffer.front(), Buffer.size());
+}
@@ -12,15 +12,13 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/CodeGen/ParallelCG.h"
-#include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Module.h"
-#include "llvm/Support/ErrorOr.h"
-#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/TargetRegistry.h"
-#include "llvm/Support/thread.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Target/TargetMachine.h"
+#include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/Transforms/Utils/SplitModule.h"
 
 using namespace llvm;
@@ -56,40 +54,37 @@ llvm::splitCodeGen(std::unique_ptr<Module> M,
     return M;
   }
 
-  std::vector<thread> Threads;
-  SplitModule(std::move(M), OSs.size(), [&](std::unique_ptr<Module> MPart) {
-    // We want to clone the module in a new context to multi-thread the codegen.
-    // We do it by serializing partition modules to bitcode (while still on the
-    // main thread, in order to avoid data races) and spinning up new threads
-    // which deserialize the partitions into separate contexts.
-    // FIXME: Provide a more direct way to do this in LLVM.
-    SmallVector<char, 0> BC;
-    raw_svector_ostream BCOS(BC);
-    WriteBitcodeToFile(MPart.get(), BCOS);
+  // Create ThreadPool in nested scope so that threads will be joined
+  // on destruction.
+  {
+    ThreadPool CodegenThreadPool(OSs.size());
+    unsigned ThreadCount = 0;
+    SplitModule(std::move(M), OSs.size(), [&](std::unique_ptr<Module> MPart) {
+      // We want to clone the module in a new context to multi-thread the
+      // codegen.  We do it by cloning each partition straight into a fresh
+      // context (while still on the main thread, in order to avoid data races)
+      // and handing the new context and module over to the thread pool.
+      auto Ctx = llvm::make_unique<LLVMContext>();
+      std::unique_ptr<Module> MPartInCtx =
+          CloneModuleIntoContext(MPart.get(), *Ctx);
+      MPart.reset();
 
-    llvm::raw_pwrite_stream *ThreadOS = OSs[Threads.size()];
-    Threads.emplace_back(
-        [TheTarget, CPU, Features, Options, RM, CM, OL,
-         ThreadOS](const SmallVector<char, 0> &BC) {
-          LLVMContext Ctx;
-          ErrorOr<std::unique_ptr<Module>> MOrErr =
-              parseBitcodeFile(MemoryBufferRef(StringRef(BC.data(), BC.size()),
-                                               "<split-module>"),
-                               Ctx);
-          if (!MOrErr)
-            report_fatal_error("Failed to read bitcode");
-          std::unique_ptr<Module> MPartInCtx = std::move(MOrErr.get());
-
-          codegen(MPartInCtx.get(), *ThreadOS, TheTarget, CPU, Features,
-                  Options, RM, CM, OL);
-        },
-        // Pass BC using std::move to ensure that it get moved rather than
-        // copied into the thread's context.
-        std::move(BC));
-  });
-
-  for (thread &T : Threads)
-    T.join();
+      llvm::raw_pwrite_stream *ThreadOS = OSs[ThreadCount++];
+      // Pool tasks are stored as std::function, which needs a copyable
+      // callable, so share ownership of the context and module with the task.
+      std::shared_ptr<LLVMContext> SharedCtx(std::move(Ctx));
+      std::shared_ptr<Module> SharedM(std::move(MPartInCtx));
+      CodegenThreadPool.async(
+          [TheTarget, CPU, Features, Options, RM, CM, OL, ThreadOS, SharedCtx,
+           SharedM]() mutable {
+            codegen(SharedM.get(), *ThreadOS, TheTarget, CPU, Features,
+                    Options, RM, CM, OL);
+            // The module has to go before the context that owns it.
+            SharedM.reset();
+            SharedCtx.reset();
+          });
+    });
+  }
 
   return {};
 }
@@ -16,6 +16,8 @@
 #include "llvm/Support/Dwarf.h"
 #include "llvm/Support/Format.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
 using namespace llvm;
@@ -376,10 +378,86 @@ DWARFCompileUnit *DWARFContext::getCompileUnitForOffset(uint32_t Offset) {
 }
 
 DWARFCompileUnit *DWARFContext::getCompileUnitForAddress(uint64_t Address) {
+  // This is where every address query starts, so no DIE of a unit is in use
+  // yet and they may be released.
+  if (DIEMemoryLimit && DIEMemoryUsage > DIEMemoryLimit)
+    releaseDIEsOverLimit();
   // First, get the offset of the compile unit.
   uint32_t CUOffset = getDebugAranges()->findAddress(Address);
   // Retrieve the compile unit.
-  return getCompileUnitForOffset(CUOffset);
+  DWARFCompileUnit *CU = getCompileUnitForOffset(CUOffset);
+  if (CU)
+    CU->setLastUse(++UseTick);
+  return CU;
+}
+
+void DWARFContext::releaseDIEsOverLimit() {
+  std::vector<DWARFUnit *> Units;
+  auto AddUnits = [&Units](ArrayRef<std::unique_ptr<DWARFCompileUnit>> CUs) {
+    for (const auto &U : CUs)
+      if (U->getDIEMemoryUsage() > sizeof(DWARFDebugInfoEntryMinimal))
+        Units.push_back(U.get());
+  };
+  AddUnits(CUs);
+  AddUnits(DWOCUs);
+  for (const auto &Section : TUs)
+    for (const auto &U : Section)
+      if (U->getDIEMemoryUsage() > sizeof(DWARFDebugInfoEntryMinimal))
+        Units.push_back(U.get());
+  for (const auto &Section : DWOTUs)
+    for (const auto &U : Section)
+      if (U->getDIEMemoryUsage() > sizeof(DWARFDebugInfoEntryMinimal))
+        Units.push_back(U.get());
+
+  std::sort(Units.begin(), Units.end(), [](DWARFUnit *LHS, DWARFUnit *RHS) {
+    return LHS->getLastUse() < RHS->getLastUse();
+  });
+  for (DWARFUnit *U : Units) {
+    if (DIEMemoryUsage <= DIEMemoryLimit)
+      break;
+    U->releaseDIEs();
+  }
+}
+
+void DWARFContext::extractCompileUnitsInParallel(unsigned NumThreads) {
+  ThreadPool Pool(NumThreads ? NumThreads : hardware_concurrency());
+  loadSections(Pool);
+  parseCompileUnits();
+
+  // The DIEs of each unit are independent of the other units'.
+  uint64_t Budget = UINT64_MAX;
+  if (DIEMemoryLimit)
+    Budget = DIEMemoryLimit > DIEMemoryUsage ? DIEMemoryLimit - DIEMemoryUsage
+                                             : 0;
+  TaskGroup Group;
+  for (const auto &CU : CUs) {
+    if (CU->getDIEMemoryUsage() > sizeof(DWARFDebugInfoEntryMinimal))
+      continue;
+    uint64_t Estimate = CU->estimateDIEMemoryUsage();
+    if (Estimate > Budget)
+      break;
+    Budget -= Estimate;
+    DWARFCompileUnit *U = CU.get();
+    Pool.async(Group, [U] { U->getUnitDIE(false); });
+  }
+  Pool.wait(Group);
+
+  // Line tables may be shared between units, so they are parsed separately.
+  if (!Line)
+    Line.reset(new DWARFDebugLine(&getLineSection().Relocs));
+  std::vector<std::pair<uint32_t, uint8_t>> LineTables;
+  for (const auto &CU : CUs) {
+    const auto *UnitDIE = CU->getUnitDIE();
+    if (!UnitDIE)
+      continue;
+    unsigned StmtOffset = UnitDIE->getAttributeValueAsSectionOffset(
+        CU.get(), DW_AT_stmt_list, -1U);
+    if (StmtOffset != -1U && !Line->getLineTable(StmtOffset))
+      LineTables.push_back(
+          std::make_pair(StmtOffset, CU->getAddressByteSize()));
+  }
+  Line->parseLineTables(getLineSection().Data, isLittleEndian(), LineTables,
+                        Pool);
 }
 
 static bool getFunctionNameForAddress(DWARFCompileUnit *CU, uint64_t Address,
@@ -543,7 +621,13 @@ static bool consumeCompressedDebugSectionHeader(StringRef &data,
 DWARFContextInMemory::DWARFContextInMemory(const object::ObjectFile &Obj,
     const LoadedObjectInfo *L)
     : IsLittleEndian(Obj.isLittleEndian()),
-      AddressSize(Obj.getBytesInAddress()) {
+      AddressSize(Obj.getBytesInAddress()), HasPendingSections(false),
+      UncompressedSectionsSize(0) {
+  // Compressed .debug_types sections, whose fields only stay in place once
+  // all of them are added.
+  std::vector<std::pair<CompressedSection *,
+                        std::pair<TypeSectionMap *, SectionRef>>>
+      CompressedTypesSections;
   for (const SectionRef &Section : Obj.sections()) {
     StringRef name;
     Section.getName(name);
@@ -566,20 +650,19 @@ DWARFContextInMemory::DWARFContextInMemory(const object::ObjectFile &Obj,
     name = name.substr(name.find_first_not_of("._")); // Skip . and _ prefixes.
 
     // Check if debug info section is compressed with zlib.
+    std::unique_ptr<CompressedSection> Compressed;
     if (name.startswith("zdebug_")) {
       uint64_t OriginalSize;
       if (!zlib::isAvailable() ||
           !consumeCompressedDebugSectionHeader(data, OriginalSize))
         continue;
-      UncompressedSections.resize(UncompressedSections.size() + 1);
-      if (zlib::uncompress(data, UncompressedSections.back(), OriginalSize) !=
-          zlib::StatusOK) {
-        UncompressedSections.pop_back();
-        continue;
-      }
-      // Make data point to uncompressed section contents and save its contents.
+      // Keep the compressed contents, to decompress them the first time the
+      // section is accessed; until then, the section is empty.
+      Compressed.reset(new CompressedSection());
+      Compressed->Compressed = data;
+      Compressed->UncompressedSize = OriginalSize;
       name = name.substr(1);
-      data = UncompressedSections.back();
+      data = StringRef();
     }
 
     StringRef *SectionData =
@@ -610,18 +693,27 @@ DWARFContextInMemory::DWARFContextInMemory(const object::ObjectFile &Obj,
             .Case("apple_objc", &AppleObjCSection.Data)
             // Any more debug info sections go here.
             .Default(nullptr);
+    TypeSectionMap *TypesMap = nullptr;
     if (SectionData) {
       *SectionData = data;
-      if (name == "debug_ranges") {
-        // FIXME: Use the other dwo range section when we emit it.
-        RangeDWOSection = data;
-      }
     } else if (name == "debug_types") {
       // Find debug_types data by section rather than name as there are
       // multiple, comdat grouped, debug_types sections.
-      TypesSections[Section].Data = data;
+      TypesMap = &TypesSections;
     } else if (name == "debug_types.dwo") {
-      TypesDWOSections[Section].Data = data;
+      TypesMap = &TypesDWOSections;
+    }
+    if (TypesMap)
+      (*TypesMap)[Section].Data = data;
+
+    if (Compressed && (SectionData || TypesMap)) {
+      Compressed->Data = SectionData;
+      if (SectionData)
+        PendingSections[SectionData] = Compressed.get();
+      else
+        CompressedTypesSections.push_back(std::make_pair(
+            Compressed.get(), std::make_pair(TypesMap, Section)));
+      CompressedSections.push_back(std::move(Compressed));
     }
 
     if (RelocatedSection == Obj.section_end())
@@ -755,6 +847,53 @@ DWARFContextInMemory::DWARFContextInMemory(const object::ObjectFile &Obj,
       }
     }
   }
+
+  for (const auto &Types : CompressedTypesSections) {
+    CompressedSection *Section = Types.first;
+    Section->Data = &(*Types.second.first)[Types.second.second].Data;
+    PendingSections[Section->Data] = Section;
+  }
+  HasPendingSections = !PendingSections.empty();
+}
+
+void DWARFContextInMemory::uncompressSection(CompressedSection &Section) {
+  // A section that fails to decompress stays empty, as if it were missing.
+  if (zlib::uncompress(Section.Compressed, Section.Uncompressed,
+                       Section.UncompressedSize) != zlib::StatusOK)
+    return;
+  *Section.Data = Section.Uncompressed;
+  UncompressedSectionsSize += Section.Uncompressed.size();
+}
+
+void DWARFContextInMemory::uncompressPendingSection(StringRef *Data) {
+  std::lock_guard<std::mutex> Lock(PendingSectionsMutex);
+  auto I = PendingSections.find(Data);
+  if (I == PendingSections.end())
+    return;
+  // Only clear HasPendingSections once the contents are in place, since
+  // accessors check it without taking the lock.
+  uncompressSection(*I->second);
+  PendingSections.erase(I);
+  HasPendingSections = !PendingSections.empty();
+}
+
+void DWARFContextInMemory::loadSections(ThreadPool &Pool) {
+  std::lock_guard<std::mutex> Lock(PendingSectionsMutex);
+  // A section is a single zlib stream, which cannot be split, so the
+  // sections are decompressed concurrently, the largest ones first.
+  std::vector<CompressedSection *> Sections;
+  for (const auto &Pending : PendingSections)
+    Sections.push_back(Pending.second);
+  std::sort(Sections.begin(), Sections.end(),
+            [](CompressedSection *LHS, CompressedSection *RHS) {
+              return LHS->UncompressedSize > RHS->UncompressedSize;
+            });
+  TaskGroup Group;
+  for (CompressedSection *Section : Sections)
+    Pool.async(Group, [this, Section] { uncompressSection(*Section); });
+  Pool.wait(Group);
+  PendingSections.clear();
+  HasPendingSections = false;
 }
 
 void DWARFContextInMemory::anchor() { }
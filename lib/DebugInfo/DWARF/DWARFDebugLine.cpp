@@ -11,6 +11,7 @@
 #include "llvm/Support/Dwarf.h"
 #include "llvm/Support/Format.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
 using namespace llvm;
@@ -253,6 +254,37 @@ DWARFDebugLine::getOrParseLineTable(DataExtractor debug_line_data,
   return LT;
 }
 
+void DWARFDebugLine::parseLineTables(
+    StringRef DebugLineData, bool IsLittleEndian,
+    ArrayRef<std::pair<uint32_t, uint8_t>> Tables, ThreadPool &Pool) {
+  // Insert all the tables first, so that the map does not change while they
+  // are parsed.
+  std::vector<std::pair<LineTableIter, uint8_t>> NewTables;
+  for (const auto &Table : Tables) {
+    std::pair<LineTableIter, bool> Pos =
+        LineTableMap.insert(LineTableMapTy::value_type(Table.first,
+                                                       LineTable()));
+    if (Pos.second)
+      NewTables.push_back(std::make_pair(Pos.first, Table.second));
+  }
+
+  std::vector<char> Parsed(NewTables.size());
+  TaskGroup Group;
+  for (size_t I = 0, E = NewTables.size(); I != E; ++I)
+    Pool.async(Group, [&, I] {
+      DataExtractor Data(DebugLineData, IsLittleEndian, NewTables[I].second);
+      uint32_t Offset = NewTables[I].first->first;
+      Parsed[I] = NewTables[I].first->second.parse(Data, RelocMap, &Offset);
+    });
+  Pool.wait(Group);
+
+  // Drop the tables that failed to parse, as getOrParseLineTable() would
+  // have returned null for them.
+  for (size_t I = 0, E = NewTables.size(); I != E; ++I)
+    if (!Parsed[I])
+      LineTableMap.erase(NewTables[I].first);
+}
+
 bool DWARFDebugLine::LineTable::parse(DataExtractor debug_line_data,
                                       const RelocAddrMap *RMap,
                                       uint32_t *offset_ptr) {
@@ -222,7 +222,9 @@ size_t DWARFUnit::extractDIEsIfNeeded(bool CUDieOnly) {
     return 0; // Already parsed.
 
   bool HasCUDie = DieArray.size() > 0;
+  size_t OldMemoryUsage = getDIEMemoryUsage();
   extractDIEsToVector(!HasCUDie, !CUDieOnly, DieArray);
+  Context.updateDIEMemoryUsage(int64_t(getDIEMemoryUsage()) - OldMemoryUsage);
 
   if (DieArray.empty())
     return 0;
@@ -303,6 +305,9 @@ void DWARFUnit::clearDIEs(bool KeepCUDie) {
     // Save at least the compile unit DIE
     if (KeepCUDie)
       DieArray.push_back(TmpArray.front());
+    Context.updateDIEMemoryUsage(int64_t(getDIEMemoryUsage()) -
+                                 TmpArray.capacity() *
+                                     sizeof(DWARFDebugInfoEntryMinimal));
   }
 }
 
@@ -13,11 +13,13 @@
 
 #include "Interpreter.h"
 #include "llvm/ADT/APInt.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/CodeGen/IntrinsicLowering.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/GetElementPtrTypeIterator.h"
+#include "llvm/IR/InlineAsm.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
@@ -40,7 +42,9 @@ static cl::opt<bool> PrintVolatile("interpreter-print-volatile", cl::Hidden,
 //===----------------------------------------------------------------------===//
 
 static void SetValue(Value *V, GenericValue Val, ExecutionContext &SF) {
-  SF.Values[V] = Val;
+  auto I = SF.DF->Slots.find(V);
+  assert(I != SF.DF->Slots.end() && "Value is not part of this function!");
+  SF.Values[I->second] = std::move(Val);
 }
 
 //===----------------------------------------------------------------------===//
@@ -930,14 +934,15 @@ void Interpreter::visitIndirectBrInst(IndirectBrInst &I) {
 void Interpreter::SwitchToNewBasicBlock(BasicBlock *Dest, ExecutionContext &SF){
   BasicBlock *PrevBB = SF.CurBB;      // Remember where we came from...
   SF.CurBB   = Dest;                  // Update CurBB to branch destination
-  SF.CurInst = SF.CurBB->begin();     // Update new instruction ptr...
+  SF.PC = SF.DF->BlockStart.lookup(Dest); // Update new instruction ptr...
 
-  if (!isa<PHINode>(SF.CurInst)) return;  // Nothing fancy to do
+  if (!isa<PHINode>(Dest->begin())) return;  // Nothing fancy to do
 
   // Loop over all of the PHI nodes in the current block, reading their inputs.
   std::vector<GenericValue> ResultValues;
 
-  for (; PHINode *PN = dyn_cast<PHINode>(SF.CurInst); ++SF.CurInst) {
+  for (BasicBlock::iterator I = Dest->begin();
+       PHINode *PN = dyn_cast<PHINode>(I); ++I) {
     // Search for the value corresponding to this previous bb...
     int i = PN->getBasicBlockIndex(PrevBB);
     assert(i != -1 && "PHINode doesn't contain entry for predecessor??");
@@ -948,11 +953,9 @@ void Interpreter::SwitchToNewBasicBlock(BasicBlock *Dest, ExecutionContext &SF){
   }
 
   // Now loop over all of the PHI nodes setting their values...
-  SF.CurInst = SF.CurBB->begin();
-  for (unsigned i = 0; isa<PHINode>(SF.CurInst); ++SF.CurInst, ++i) {
-    PHINode *PN = cast<PHINode>(SF.CurInst);
+  BasicBlock::iterator I = Dest->begin();
+  for (unsigned i = 0; PHINode *PN = dyn_cast<PHINode>(I); ++I, ++i)
     SetValue(PN, ResultValues[i], SF);
-  }
 }
 
 //===----------------------------------------------------------------------===//
@@ -1086,21 +1089,18 @@ void Interpreter::visitCallSite(CallSite CS) {
       // If it is an unknown intrinsic function, use the intrinsic lowering
       // class to transform it into hopefully tasty LLVM code.
       //
-      BasicBlock::iterator me(CS.getInstruction());
-      BasicBlock *Parent = CS.getInstruction()->getParent();
+      Instruction *CI = CS.getInstruction();
+      BasicBlock::iterator me(CI);
+      BasicBlock *Parent = CI->getParent();
       bool atBegin(Parent->begin() == me);
       if (!atBegin)
         --me;
-      IL->LowerIntrinsicCall(cast<CallInst>(CS.getInstruction()));
+      IL->LowerIntrinsicCall(cast<CallInst>(CI));
 
-      // Restore the CurInst pointer to the first instruction newly inserted, if
-      // any.
-      if (atBegin) {
-        SF.CurInst = Parent->begin();
-      } else {
-        SF.CurInst = me;
-        ++SF.CurInst;
-      }
+      // Resume at the first instruction newly inserted, if any.  The function
+      // changed under our feet, so decode it again.
+      BasicBlock::iterator Resume = atBegin ? Parent->begin() : std::next(me);
+      redecodeFunction(SF, CI, &*Resume);
       return;
     }
 
@@ -2062,7 +2062,10 @@ GenericValue Interpreter::getOperandValue(Value *V, ExecutionContext &SF) {
   } else if (GlobalValue *GV = dyn_cast<GlobalValue>(V)) {
     return PTOGV(getPointerToGlobal(GV));
   } else {
-    return SF.Values[V];
+    auto I = SF.DF->Slots.find(V);
+    if (I == SF.DF->Slots.end())
+      return GenericValue();
+    return SF.Values[I->second];
   }
 }
 
@@ -2091,8 +2094,10 @@ void Interpreter::callFunction(Function *F, ArrayRef<GenericValue> ArgVals) {
   }
 
   // Get pointers to first LLVM BB & Instruction in function.
+  StackFrame.DF        = getDecodedFunction(F);
   StackFrame.CurBB     = F->begin();
-  StackFrame.CurInst   = StackFrame.CurBB->begin();
+  StackFrame.PC        = 0;
+  StackFrame.Values.resize(StackFrame.DF->NumSlots);
 
   // Run through the function arguments and initialize their values...
   assert((ArgVals.size() == F->arg_size() ||
@@ -2101,47 +2106,471 @@ void Interpreter::callFunction(Function *F, ArrayRef<GenericValue> ArgVals) {
 
   // Handle non-varargs arguments...
   unsigned i = 0;
-  for (Function::arg_iterator AI = F->arg_begin(), E = F->arg_end(); 
-       AI != E; ++AI, ++i)
-    SetValue(AI, ArgVals[i], StackFrame);
+  for (unsigned e = F->arg_size(); i != e; ++i)
+    StackFrame.Values[i] = ArgVals[i]; // Arguments take the first slots.
 
   // Handle varargs arguments...
   StackFrame.VarArgs.assign(ArgVals.begin()+i, ArgVals.end());
 }
 
 
+//===----------------------------------------------------------------------===//
+//                            Function Decoding
+//===----------------------------------------------------------------------===//
+//
+// Before a function is first run, it is lowered into a DecodedFunction: a flat
+// array of DecodedInsts whose operands are dense slot numbers into the frame's
+// value vector rather than keys of a map.  The common scalar integer, memory,
+// branch and call instructions get their own opcode and are executed directly
+// by the dispatch loop in run(); everything else is Generic and goes through
+// the InstVisitor as before, so both paths share the same semantics.
+//
+
+namespace {
+class FunctionDecoder {
+  DecodedFunction &DF;
+  const DataLayout &DL;
+
+public:
+  FunctionDecoder(DecodedFunction &DF, const DataLayout &DL)
+      : DF(DF), DL(DL) {}
+
+  void decode(Function &F);
+
+private:
+  unsigned getSlot(const Value *V) {
+    auto R = DF.Slots.insert(std::make_pair(V, DF.NumSlots));
+    if (R.second)
+      ++DF.NumSlots;
+    return R.first->second;
+  }
+
+  unsigned getOperand(Value *V) {
+    if (Constant *C = dyn_cast<Constant>(V)) {
+      auto R = DF.ConstantIds.insert(std::make_pair(C, DF.Constants.size()));
+      if (R.second) {
+        DecodedFunction::ConstantEntry CE = { C, GenericValue(), false };
+        DF.Constants.push_back(CE);
+      }
+      return R.first->second | DecodedInst::ConstantOperand;
+    }
+    return getSlot(V);
+  }
+
+  unsigned addEdge(BasicBlock *From, BasicBlock *To);
+  DecodedInst decodeInst(Instruction &I);
+  bool decodeGEP(GetElementPtrInst &GEP, DecodedInst &DI);
+};
+}
+
+void FunctionDecoder::decode(Function &F) {
+  // Arguments come first, so that callFunction can fill them in by position.
+  for (Argument &A : F.args())
+    getSlot(&A);
+  for (BasicBlock &BB : F)
+    for (Instruction &I : BB)
+      getSlot(&I);
+
+  for (BasicBlock &BB : F) {
+    DF.BlockStart[&BB] = DF.Code.size();
+    for (Instruction &I : BB)
+      if (!isa<PHINode>(I))
+        DF.Code.push_back(decodeInst(I));
+  }
+
+  for (DecodedFunction::Edge &E : DF.Edges)
+    E.Target = DF.BlockStart.lookup(E.Dest);
+}
+
+unsigned FunctionDecoder::addEdge(BasicBlock *From, BasicBlock *To) {
+  DecodedFunction::Edge E;
+  E.Dest = To;
+  E.Target = 0;
+  E.MovesBegin = DF.PHIMoves.size();
+  for (BasicBlock::iterator I = To->begin(); PHINode *PN = dyn_cast<PHINode>(I);
+       ++I)
+    DF.PHIMoves.push_back(std::make_pair(
+        getSlot(PN), getOperand(PN->getIncomingValueForBlock(From))));
+  E.MovesEnd = DF.PHIMoves.size();
+  DF.Edges.push_back(E);
+  return DF.Edges.size() - 1;
+}
+
+bool FunctionDecoder::decodeGEP(GetElementPtrInst &GEP, DecodedInst &DI) {
+  if (!GEP.getType()->isPointerTy())
+    return false;
+
+  DecodedFunction::GEPInfo Info;
+  Info.ConstantOffset = 0;
+  Info.IndicesBegin = DF.GEPIndices.size();
+  for (gep_type_iterator I = gep_type_begin(GEP), E = gep_type_end(GEP);
+       I != E; ++I) {
+    if (StructType *STy = dyn_cast<StructType>(*I)) {
+      const ConstantInt *CPU = cast<ConstantInt>(I.getOperand());
+      unsigned Index = unsigned(CPU->getZExtValue());
+      Info.ConstantOffset += DL.getStructLayout(STy)->getElementOffset(Index);
+      continue;
+    }
+    IntegerType *IdxTy = dyn_cast<IntegerType>(I.getOperand()->getType());
+    if (!IdxTy || (IdxTy->getBitWidth() != 32 && IdxTy->getBitWidth() != 64)) {
+      DF.GEPIndices.resize(Info.IndicesBegin);
+      return false;
+    }
+    DecodedFunction::GEPIndex Idx;
+    Idx.Operand = getOperand(I.getOperand());
+    Idx.Scale = DL.getTypeAllocSize(cast<SequentialType>(*I)->getElementType());
+    Idx.Is32Bit = IdxTy->getBitWidth() == 32;
+    DF.GEPIndices.push_back(Idx);
+  }
+  Info.IndicesEnd = DF.GEPIndices.size();
+
+  DI.Opcode = DecodedInst::GEP;
+  DI.Ops[0] = getOperand(GEP.getPointerOperand());
+  DI.Aux = DF.GEPs.size();
+  DF.GEPs.push_back(Info);
+  return true;
+}
+
+DecodedInst FunctionDecoder::decodeInst(Instruction &I) {
+  DecodedInst DI;
+  DI.Opcode = DecodedInst::Generic;
+  DI.Dest = getSlot(&I);
+  DI.Aux = 0;
+  DI.Ops[0] = DI.Ops[1] = DI.Ops[2] = 0;
+  DI.Ty = I.getType();
+  DI.Inst = &I;
+
+  switch (I.getOpcode()) {
+  case Instruction::Br: {
+    BranchInst &BI = cast<BranchInst>(I);
+    BasicBlock *BB = BI.getParent();
+    if (BI.isUnconditional()) {
+      DI.Opcode = DecodedInst::Br;
+      DI.Aux = addEdge(BB, BI.getSuccessor(0));
+    } else {
+      DI.Opcode = DecodedInst::CondBr;
+      DI.Ops[0] = getOperand(BI.getCondition());
+      DI.Ops[1] = addEdge(BB, BI.getSuccessor(0));
+      DI.Ops[2] = addEdge(BB, BI.getSuccessor(1));
+    }
+    break;
+  }
+  case Instruction::Add:  case Instruction::Sub:  case Instruction::Mul:
+  case Instruction::UDiv: case Instruction::SDiv: case Instruction::URem:
+  case Instruction::SRem: case Instruction::And:  case Instruction::Or:
+  case Instruction::Xor:  case Instruction::Shl:  case Instruction::LShr:
+  case Instruction::AShr: {
+    if (!I.getType()->isIntegerTy())
+      break;
+    switch (I.getOpcode()) {
+    default: llvm_unreachable("Unexpected binary operator");
+    case Instruction::Add:  DI.Opcode = DecodedInst::Add;  break;
+    case Instruction::Sub:  DI.Opcode = DecodedInst::Sub;  break;
+    case Instruction::Mul:  DI.Opcode = DecodedInst::Mul;  break;
+    case Instruction::UDiv: DI.Opcode = DecodedInst::UDiv; break;
+    case Instruction::SDiv: DI.Opcode = DecodedInst::SDiv; break;
+    case Instruction::URem: DI.Opcode = DecodedInst::URem; break;
+    case Instruction::SRem: DI.Opcode = DecodedInst::SRem; break;
+    case Instruction::And:  DI.Opcode = DecodedInst::And;  break;
+    case Instruction::Or:   DI.Opcode = DecodedInst::Or;   break;
+    case Instruction::Xor:  DI.Opcode = DecodedInst::Xor;  break;
+    case Instruction::Shl:  DI.Opcode = DecodedInst::Shl;  break;
+    case Instruction::LShr: DI.Opcode = DecodedInst::LShr; break;
+    case Instruction::AShr: DI.Opcode = DecodedInst::AShr; break;
+    }
+    DI.Ops[0] = getOperand(I.getOperand(0));
+    DI.Ops[1] = getOperand(I.getOperand(1));
+    break;
+  }
+  case Instruction::ICmp: {
+    Type *OpTy = I.getOperand(0)->getType();
+    if (!OpTy->isIntegerTy() && !OpTy->isPointerTy())
+      break;
+    DI.Opcode = DecodedInst::ICmp;
+    DI.Aux = cast<ICmpInst>(I).getPredicate();
+    DI.Ty = OpTy;
+    DI.Ops[0] = getOperand(I.getOperand(0));
+    DI.Ops[1] = getOperand(I.getOperand(1));
+    break;
+  }
+  case Instruction::Select:
+    if (I.getOperand(0)->getType()->isVectorTy())
+      break;
+    DI.Opcode = DecodedInst::Select;
+    DI.Ops[0] = getOperand(I.getOperand(0));
+    DI.Ops[1] = getOperand(I.getOperand(1));
+    DI.Ops[2] = getOperand(I.getOperand(2));
+    break;
+  case Instruction::Trunc:
+  case Instruction::ZExt:
+  case Instruction::SExt:
+    if (!I.getType()->isIntegerTy())
+      break;
+    DI.Opcode = I.getOpcode() == Instruction::Trunc ? DecodedInst::Trunc
+              : I.getOpcode() == Instruction::ZExt  ? DecodedInst::ZExt
+                                                    : DecodedInst::SExt;
+    DI.Aux = I.getType()->getIntegerBitWidth();
+    DI.Ops[0] = getOperand(I.getOperand(0));
+    break;
+  case Instruction::Load:
+    // Volatile accesses stay generic so -interpreter-print-volatile works.
+    if (cast<LoadInst>(I).isVolatile())
+      break;
+    DI.Opcode = DecodedInst::Load;
+    DI.Ops[0] = getOperand(I.getOperand(0));
+    break;
+  case Instruction::Store:
+    if (cast<StoreInst>(I).isVolatile())
+      break;
+    DI.Opcode = DecodedInst::Store;
+    DI.Ty = I.getOperand(0)->getType();
+    DI.Ops[0] = getOperand(I.getOperand(0));
+    DI.Ops[1] = getOperand(I.getOperand(1));
+    break;
+  case Instruction::GetElementPtr:
+    decodeGEP(cast<GetElementPtrInst>(I), DI);
+    break;
+  case Instruction::Call: {
+    // Intrinsics and inline asm need the special handling in visitCallSite.
+    CallInst &CI = cast<CallInst>(I);
+    Value *Callee = CI.getCalledValue();
+    if (isa<InlineAsm>(Callee))
+      break;
+    if (Function *F = CI.getCalledFunction())
+      if (F->isDeclaration() && F->getIntrinsicID() != Intrinsic::not_intrinsic)
+        break;
+    DI.Opcode = DecodedInst::Call;
+    DI.Ops[0] = getOperand(Callee);
+    DI.Ops[1] = DF.CallArgs.size();
+    DI.Ops[2] = CI.getNumArgOperands();
+    for (Value *Arg : CI.arg_operands())
+      DF.CallArgs.push_back(getOperand(Arg));
+    break;
+  }
+  default:
+    break;
+  }
+  return DI;
+}
+
+std::unique_ptr<DecodedFunction>
+Interpreter::decodeFunction(Function *F, const DecodedFunction *Prev) {
+  auto DF = llvm::make_unique<DecodedFunction>();
+  // Keep the slots of values that already have one, so that the frames
+  // currently running F can carry on with their values in place.
+  if (Prev) {
+    DF->Slots = Prev->Slots;
+    DF->NumSlots = Prev->NumSlots;
+  }
+  FunctionDecoder(*DF, getDataLayout()).decode(*F);
+  return DF;
+}
+
+DecodedFunction *Interpreter::getDecodedFunction(Function *F) {
+  std::unique_ptr<DecodedFunction> &DF = DecodedFunctions[F];
+  if (!DF)
+    DF = decodeFunction(F);
+  return DF.get();
+}
+
+// redecodeFunction - The function running in SF was rewritten by lowering the
+// call Removed, and execution continues at Resume.  Decode it again and move
+// every frame running it over to the new code.
+//
+void Interpreter::redecodeFunction(ExecutionContext &SF, Instruction *Removed,
+                                   Instruction *Resume) {
+  DecodedFunction *Old = SF.DF;
+  std::unique_ptr<DecodedFunction> New = decodeFunction(SF.CurFunction, Old);
+
+  DenseMap<const Instruction *, unsigned> NewPC;
+  for (unsigned i = 0, e = New->Code.size(); i != e; ++i)
+    NewPC[New->Code[i].Inst] = i;
+
+  for (ExecutionContext &Frame : ECStack) {
+    if (Frame.DF != Old)
+      continue;
+    // Frames deeper in the stack may be waiting to resume at the lowered
+    // call too, if it was first reached through recursion.
+    Instruction *Next = nullptr;
+    if (&Frame == &SF)
+      Next = Resume;
+    else if (Frame.PC < Old->Code.size())
+      Next = Old->Code[Frame.PC].Inst == Removed ? Resume
+                                                 : Old->Code[Frame.PC].Inst;
+    Frame.PC = Next ? NewPC.lookup(Next) : New->Code.size();
+    Frame.DF = New.get();
+    Frame.Values.resize(New->NumSlots);
+  }
+
+  DecodedFunctions[SF.CurFunction] = std::move(New);
+}
+
+// getDecodedOperand - Return the value of an operand of a DecodedInst,
+// computing constants the first time they are used.
+//
+const GenericValue &Interpreter::getDecodedOperand(unsigned Op,
+                                                   ExecutionContext &SF) {
+  if (!(Op & DecodedInst::ConstantOperand))
+    return SF.Values[Op];
+  DecodedFunction::ConstantEntry &CE =
+      SF.DF->Constants[Op & ~DecodedInst::ConstantOperand];
+  if (!CE.Ready) {
+    CE.Value = getOperandValue(CE.C, SF);
+    CE.Ready = true;
+  }
+  return CE.Value;
+}
+
+// takeEdge - Branch along a decoded CFG edge, running its PHI copies.  As in
+// SwitchToNewBasicBlock, all incoming values are read before any is written.
+//
+void Interpreter::takeEdge(const DecodedFunction::Edge &E,
+                           ExecutionContext &SF) {
+  SF.CurBB = E.Dest;
+  SF.PC = E.Target;
+
+  unsigned NumMoves = E.MovesEnd - E.MovesBegin;
+  if (NumMoves == 0)
+    return;
+  const std::pair<unsigned, unsigned> *Moves = &SF.DF->PHIMoves[E.MovesBegin];
+  if (NumMoves == 1) {
+    GenericValue Val = getDecodedOperand(Moves[0].second, SF);
+    SF.Values[Moves[0].first] = std::move(Val);
+    return;
+  }
+
+  SmallVector<GenericValue, 8> ResultValues;
+  for (unsigned i = 0; i != NumMoves; ++i)
+    ResultValues.push_back(getDecodedOperand(Moves[i].second, SF));
+  for (unsigned i = 0; i != NumMoves; ++i)
+    SF.Values[Moves[i].first] = std::move(ResultValues[i]);
+}
+
+//===----------------------------------------------------------------------===//
+// run - Interpret instructions until the stack is empty.
+//
 void Interpreter::run() {
   while (!ECStack.empty()) {
     // Interpret a single instruction & increment the "PC".
     ExecutionContext &SF = ECStack.back();  // Current stack frame
-    Instruction &I = *SF.CurInst++;         // Increment before execute
+    const DecodedInst &DI = SF.DF->Code[SF.PC++]; // Increment before execute
 
     // Track the number of dynamic instructions executed.
     ++NumDynamicInsts;
 
-    DEBUG(dbgs() << "About to interpret: " << I);
-    visit(I);   // Dispatch to one of the visit* methods...
-#if 0
-    // This is not safe, as visiting the instruction could lower it and free I.
-DEBUG(
-    if (!isa<CallInst>(I) && !isa<InvokeInst>(I) && 
-        I.getType() != Type::VoidTy) {
-      dbgs() << "  --> ";
-      const GenericValue &Val = SF.Values[&I];
-      switch (I.getType()->getTypeID()) {
-      default: llvm_unreachable("Invalid GenericValue Type");
-      case Type::VoidTyID:    dbgs() << "void"; break;
-      case Type::FloatTyID:   dbgs() << "float " << Val.FloatVal; break;
-      case Type::DoubleTyID:  dbgs() << "double " << Val.DoubleVal; break;
-      case Type::PointerTyID: dbgs() << "void* " << intptr_t(Val.PointerVal);
-        break;
-      case Type::IntegerTyID: 
-        dbgs() << "i" << Val.IntVal.getBitWidth() << " "
-               << Val.IntVal.toStringUnsigned(10)
-               << " (0x" << Val.IntVal.toStringUnsigned(16) << ")\n";
-        break;
+    DEBUG(dbgs() << "About to interpret: " << *DI.Inst);
+
+    // The switch below is dense, so it compiles down to a jump table indexed
+    // by the decoded opcode.  Note that executing a Generic instruction or a
+    // call may free DI, so it must not be used after those.
+    GenericValue *Values = SF.Values.data();
+    switch (DI.Opcode) {
+    case DecodedInst::Generic:
+      visit(*DI.Inst);   // Dispatch to one of the visit* methods...
+      break;
+
+    case DecodedInst::Br:
+      takeEdge(SF.DF->Edges[DI.Aux], SF);
+      break;
+    case DecodedInst::CondBr: {
+      bool Cond = getDecodedOperand(DI.Ops[0], SF).IntVal != 0;
+      takeEdge(SF.DF->Edges[Cond ? DI.Ops[1] : DI.Ops[2]], SF);
+      break;
+    }
+
+#define IMPLEMENT_DECODED_BINOP(OPCODE, EXPR)                                  \
+    case DecodedInst::OPCODE: {                                                \
+      const APInt &A = getDecodedOperand(DI.Ops[0], SF).IntVal;                \
+      const APInt &B = getDecodedOperand(DI.Ops[1], SF).IntVal;                \
+      Values[DI.Dest].IntVal = EXPR;                                           \
+      break;                                                                   \
+    }
+    IMPLEMENT_DECODED_BINOP(Add,  A + B)
+    IMPLEMENT_DECODED_BINOP(Sub,  A - B)
+    IMPLEMENT_DECODED_BINOP(Mul,  A * B)
+    IMPLEMENT_DECODED_BINOP(UDiv, A.udiv(B))
+    IMPLEMENT_DECODED_BINOP(SDiv, A.sdiv(B))
+    IMPLEMENT_DECODED_BINOP(URem, A.urem(B))
+    IMPLEMENT_DECODED_BINOP(SRem, A.srem(B))
+    IMPLEMENT_DECODED_BINOP(And,  A & B)
+    IMPLEMENT_DECODED_BINOP(Or,   A | B)
+    IMPLEMENT_DECODED_BINOP(Xor,  A ^ B)
+    IMPLEMENT_DECODED_BINOP(Shl,  A.shl(getShiftAmount(B.getZExtValue(), A)))
+    IMPLEMENT_DECODED_BINOP(LShr, A.lshr(getShiftAmount(B.getZExtValue(), A)))
+    IMPLEMENT_DECODED_BINOP(AShr, A.ashr(getShiftAmount(B.getZExtValue(), A)))
+#undef IMPLEMENT_DECODED_BINOP
+
+    case DecodedInst::ICmp:
+      Values[DI.Dest] =
+          executeCmpInst(DI.Aux, getDecodedOperand(DI.Ops[0], SF),
+                         getDecodedOperand(DI.Ops[1], SF), DI.Ty);
+      break;
+    case DecodedInst::Select: {
+      bool Cond = getDecodedOperand(DI.Ops[0], SF).IntVal != 0;
+      GenericValue Val = getDecodedOperand(Cond ? DI.Ops[1] : DI.Ops[2], SF);
+      Values[DI.Dest] = std::move(Val);
+      break;
+    }
+
+    case DecodedInst::Trunc:
+      Values[DI.Dest].IntVal =
+          getDecodedOperand(DI.Ops[0], SF).IntVal.trunc(DI.Aux);
+      break;
+    case DecodedInst::ZExt:
+      Values[DI.Dest].IntVal =
+          getDecodedOperand(DI.Ops[0], SF).IntVal.zext(DI.Aux);
+      break;
+    case DecodedInst::SExt:
+      Values[DI.Dest].IntVal =
+          getDecodedOperand(DI.Ops[0], SF).IntVal.sext(DI.Aux);
+      break;
+
+    case DecodedInst::Load: {
+      GenericValue *Ptr =
+          (GenericValue *)GVTOP(getDecodedOperand(DI.Ops[0], SF));
+      GenericValue Result;
+      LoadValueFromMemory(Result, Ptr, DI.Ty);
+      Values[DI.Dest] = std::move(Result);
+      break;
+    }
+    case DecodedInst::Store: {
+      GenericValue *Ptr =
+          (GenericValue *)GVTOP(getDecodedOperand(DI.Ops[1], SF));
+      StoreValueToMemory(getDecodedOperand(DI.Ops[0], SF), Ptr, DI.Ty);
+      break;
+    }
+    case DecodedInst::GEP: {
+      const DecodedFunction::GEPInfo &Info = SF.DF->GEPs[DI.Aux];
+      uint64_t Total = Info.ConstantOffset;
+      for (unsigned i = Info.IndicesBegin; i != Info.IndicesEnd; ++i) {
+        const DecodedFunction::GEPIndex &Idx = SF.DF->GEPIndices[i];
+        uint64_t IdxVal =
+            getDecodedOperand(Idx.Operand, SF).IntVal.getZExtValue();
+        if (Idx.Is32Bit)
+          Total += Idx.Scale * (int64_t)(int32_t)IdxVal;
+        else
+          Total += Idx.Scale * (int64_t)IdxVal;
       }
-    });
-#endif
+      char *Base = (char *)getDecodedOperand(DI.Ops[0], SF).PointerVal;
+      Values[DI.Dest].PointerVal = Base + Total;
+      DEBUG(dbgs() << "GEP Index " << Total << " bytes.\n");
+      break;
+    }
+
+    case DecodedInst::Call: {
+      SF.Caller = CallSite(DI.Inst);
+      SmallVector<GenericValue, 8> ArgVals;
+      ArgVals.reserve(DI.Ops[2]);
+      const unsigned *Args = &SF.DF->CallArgs[DI.Ops[1]];
+      for (unsigned i = 0; i != DI.Ops[2]; ++i)
+        ArgVals.push_back(getDecodedOperand(Args[i], SF));
+
+      // To handle indirect calls, we must get the pointer value from the
+      // argument and treat it as a function pointer.
+      Function *F = (Function *)GVTOP(getDecodedOperand(DI.Ops[0], SF));
+      callFunction(F, ArgVals);
+      break;
+    }
+    }
   }
 }
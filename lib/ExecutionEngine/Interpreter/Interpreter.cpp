@@ -89,6 +89,11 @@ GenericValue Interpreter::runFunction(Function *F,
   ArrayRef<GenericValue> ActualArgs =
       ArgValues.slice(0, std::min(ArgValues.size(), ArgCount));
 
+  // The module or its global mappings may have changed since the last run, so
+  // decode functions afresh.
+  if (ECStack.empty())
+    DecodedFunctions.clear();
+
   // Set up the function call.
   callFunction(F, ActualArgs);
 
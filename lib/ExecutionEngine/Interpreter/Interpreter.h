@@ -14,6 +14,7 @@
 #ifndef LLVM_LIB_EXECUTIONENGINE_INTERPRETER_INTERPRETER_H
 #define LLVM_LIB_EXECUTIONENGINE_INTERPRETER_INTERPRETER_H
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/ExecutionEngine/GenericValue.h"
 #include "llvm/IR/CallSite.h"
@@ -26,7 +27,6 @@
 namespace llvm {
 
 class IntrinsicLowering;
-struct FunctionInfo;
 template<typename T> class generic_gep_type_iterator;
 class ConstantExpr;
 typedef generic_gep_type_iterator<User::const_op_iterator> gep_type_iterator;
@@ -59,30 +59,109 @@ public:
 
 typedef std::vector<GenericValue> ValuePlaneTy;
 
+// DecodedInst - One instruction of a function lowered for the interpreter's
+// dispatch loop.  Operands are references to either a value slot of the
+// executing frame or, if ConstantOperand is set, an entry of the decoded
+// function's constant pool.  Instructions without a dedicated fast path are
+// Generic and are executed through the InstVisitor.
+//
+struct DecodedInst {
+  enum OpcodeTy {
+    Generic,
+    Br,         // Aux: edge.
+    CondBr,     // Ops: condition, true edge, false edge.
+    Add, Sub, Mul, UDiv, SDiv, URem, SRem, And, Or, Xor, Shl, LShr, AShr,
+    ICmp,       // Aux: predicate.  Ty: operand type.
+    Select,
+    Trunc, ZExt, SExt, // Aux: destination bit width.
+    Load,       // Ops: pointer.
+    Store,      // Ops: value, pointer.
+    GEP,        // Ops: base.  Aux: entry in DecodedFunction::GEPs.
+    Call        // Ops: callee, first argument, number of arguments.
+  };
+
+  static const unsigned ConstantOperand = 1u << 31;
+
+  OpcodeTy Opcode;
+  unsigned Dest;      // The slot receiving the result.
+  unsigned Aux;
+  unsigned Ops[3];
+  Type *Ty;           // The result type, unless noted otherwise above.
+  Instruction *Inst;  // The instruction this was decoded from.
+};
+
+// DecodedFunction - The code of a function as run by the interpreter: every
+// argument and instruction is numbered with a dense slot, the blocks are laid
+// out back to back without their PHI nodes, and each CFG edge carries the PHI
+// copies it implies.
+//
+struct DecodedFunction {
+  struct Edge {
+    BasicBlock *Dest;
+    unsigned Target;            // Index of the first instruction of Dest.
+    unsigned MovesBegin, MovesEnd;
+  };
+
+  struct ConstantEntry {
+    Constant *C;
+    GenericValue Value;
+    bool Ready;                 // Value is computed on first use.
+  };
+
+  struct GEPInfo {
+    uint64_t ConstantOffset;    // Accumulated struct and constant offsets.
+    unsigned IndicesBegin, IndicesEnd;
+  };
+
+  struct GEPIndex {
+    unsigned Operand;
+    uint64_t Scale;
+    bool Is32Bit;
+  };
+
+  unsigned NumSlots;
+  DenseMap<const Value *, unsigned> Slots;
+  DenseMap<const BasicBlock *, unsigned> BlockStart;
+  std::vector<DecodedInst> Code;
+  std::vector<Edge> Edges;
+  std::vector<std::pair<unsigned, unsigned>> PHIMoves; // (slot, operand)
+  std::vector<ConstantEntry> Constants;
+  DenseMap<Constant *, unsigned> ConstantIds;
+  std::vector<GEPInfo> GEPs;
+  std::vector<GEPIndex> GEPIndices;
+  std::vector<unsigned> CallArgs;
+
+  DecodedFunction() : NumSlots(0) {}
+};
+
 // ExecutionContext struct - This struct represents one stack frame currently
 // executing.
 //
 struct ExecutionContext {
   Function             *CurFunction;// The currently executing function
+  DecodedFunction      *DF;         // The decoded body of CurFunction
   BasicBlock           *CurBB;      // The currently executing BB
-  BasicBlock::iterator  CurInst;    // The next instruction to execute
+  unsigned              PC;         // The next instruction to execute
   CallSite             Caller;     // Holds the call that called subframes.
                                    // NULL if main func or debugger invoked fn
-  std::map<Value *, GenericValue> Values; // LLVM values used in this invocation
+  ValuePlaneTy         Values;     // LLVM values used in this invocation,
+                                   // indexed by slot
   std::vector<GenericValue>  VarArgs; // Values passed through an ellipsis
   AllocaHolder Allocas;            // Track memory allocated by alloca
 
-  ExecutionContext() : CurFunction(nullptr), CurBB(nullptr), CurInst(nullptr) {}
+  ExecutionContext()
+      : CurFunction(nullptr), DF(nullptr), CurBB(nullptr), PC(0) {}
 
   ExecutionContext(ExecutionContext &&O)
-      : CurFunction(O.CurFunction), CurBB(O.CurBB), CurInst(O.CurInst),
+      : CurFunction(O.CurFunction), DF(O.DF), CurBB(O.CurBB), PC(O.PC),
         Caller(O.Caller), Values(std::move(O.Values)),
         VarArgs(std::move(O.VarArgs)), Allocas(std::move(O.Allocas)) {}
 
   ExecutionContext &operator=(ExecutionContext &&O) {
     CurFunction = O.CurFunction;
+    DF = O.DF;
     CurBB = O.CurBB;
-    CurInst = O.CurInst;
+    PC = O.PC;
     Caller = O.Caller;
     Values = std::move(O.Values);
     VarArgs = std::move(O.VarArgs);
@@ -105,6 +184,11 @@ class Interpreter : public ExecutionEngine, public InstVisitor<Interpreter> {
   // registered with the atexit() library function.
   std::vector<Function*> AtExitHandlers;
 
+  // DecodedFunctions - Functions lowered for the dispatch loop, decoded the
+  // first time they are called.
+  DenseMap<const Function *, std::unique_ptr<DecodedFunction>>
+      DecodedFunctions;
+
 public:
   explicit Interpreter(std::unique_ptr<Module> M);
   ~Interpreter() override;
@@ -214,6 +298,15 @@ private:  // Helper functions
   //
   void SwitchToNewBasicBlock(BasicBlock *Dest, ExecutionContext &SF);
 
+  // Decoding of functions for the dispatch loop.
+  DecodedFunction *getDecodedFunction(Function *F);
+  std::unique_ptr<DecodedFunction>
+  decodeFunction(Function *F, const DecodedFunction *Prev = nullptr);
+  void redecodeFunction(ExecutionContext &SF, Instruction *Removed,
+                        Instruction *Resume);
+  const GenericValue &getDecodedOperand(unsigned Op, ExecutionContext &SF);
+  void takeEdge(const DecodedFunction::Edge &E, ExecutionContext &SF);
+
   void *getPointerToFunction(Function *F) override { return (void*)F; }
 
   void initializeExecutionEngine() { }
@@ -79,6 +79,11 @@ class OrcMCJITReplacement : public ExecutionEngine {
       return ClientMM->notifyObjectLoaded(EE, O);
     }
 
+    void notifyObjectLoaded(RuntimeDyld &RTDyld,
+                            const object::ObjectFile &O) override {
+      return ClientMM->notifyObjectLoaded(RTDyld, O);
+    }
+
     bool finalizeMemory(std::string *ErrMsg = nullptr) override {
       // Each set of objects loaded will be finalized exactly once, but since
       // symbol lookup during relocation may recursively trigger the
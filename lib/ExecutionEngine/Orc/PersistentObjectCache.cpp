@@ -0,0 +1,123 @@
+//===--- PersistentObjectCache.cpp - Content-hashed on-disk object cache --===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ExecutionEngine/Orc/PersistentObjectCache.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/LockFileManager.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+
+#define DEBUG_TYPE "orc"
+
+namespace llvm {
+namespace orc {
+
+PersistentObjectCache::PersistentObjectCache(std::string CacheDir,
+                                             const TargetMachine &TM)
+    : PersistentObjectCache(
+          std::move(CacheDir),
+          (Twine(TM.getTargetTriple().str()) + "|" + TM.getTargetCPU() + "|" +
+           TM.getTargetFeatureString() + "|" + Twine(int(TM.getOptLevel())) +
+           "|" + Twine(int(TM.getRelocationModel())) + "|" +
+           Twine(int(TM.getCodeModel())))
+              .str()) {}
+
+PersistentObjectCache::PersistentObjectCache(std::string CacheDir,
+                                             std::string TargetKey)
+    : CacheDir(std::move(CacheDir)), TargetKey(std::move(TargetKey)) {}
+
+std::string PersistentObjectCache::getCachePath(const Module &M) const {
+  SmallString<0> Bitcode;
+  {
+    raw_svector_ostream OS(Bitcode);
+    WriteBitcodeToFile(&M, OS);
+  }
+
+  MD5 Hash;
+  Hash.update(TargetKey);
+  Hash.update(StringRef("", 1));
+  Hash.update(ArrayRef<uint8_t>(
+      reinterpret_cast<const uint8_t *>(Bitcode.data()), Bitcode.size()));
+  MD5::MD5Result Result;
+  Hash.final(Result);
+  SmallString<32> Name;
+  MD5::stringifyResult(Result, Name);
+  Name += ".o";
+
+  SmallString<128> Path(CacheDir);
+  sys::path::append(Path, Name);
+  return Path.str();
+}
+
+std::unique_ptr<MemoryBuffer>
+PersistentObjectCache::getObject(const Module *M) {
+  std::string Path = getCachePath(*M);
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer =
+      MemoryBuffer::getFile(Path, -1, /*RequiresNullTerminator=*/false);
+  if (!Buffer) {
+    std::lock_guard<std::mutex> Lock(PendingPathsMutex);
+    PendingPaths[M] = std::move(Path);
+    return nullptr;
+  }
+  DEBUG(dbgs() << "Loaded cached object " << Path << " for module "
+               << M->getModuleIdentifier() << "\n");
+  return std::move(*Buffer);
+}
+
+void PersistentObjectCache::notifyObjectCompiled(const Module *M,
+                                                 MemoryBufferRef Obj) {
+  std::string Path;
+  {
+    std::lock_guard<std::mutex> Lock(PendingPathsMutex);
+    auto I = PendingPaths.find(M);
+    if (I != PendingPaths.end()) {
+      Path = std::move(I->second);
+      PendingPaths.erase(I);
+    }
+  }
+  if (Path.empty())
+    Path = getCachePath(*M);
+
+  if (sys::fs::create_directories(CacheDir))
+    return;
+
+  // If another process holds the lock, it compiled the same module and is
+  // writing the same object.
+  LockFileManager Lock(Path);
+  if (Lock != LockFileManager::LFS_Owned)
+    return;
+
+  int FD;
+  SmallString<128> TempPath;
+  if (sys::fs::createUniqueFile(Path + ".tmp-%%%%%%%%", FD, TempPath))
+    return;
+  raw_fd_ostream OS(FD, /*shouldClose=*/true);
+  OS << Obj.getBuffer();
+  OS.close();
+  if (OS.has_error()) {
+    OS.clear_error();
+    sys::fs::remove(TempPath);
+    return;
+  }
+  if (sys::fs::rename(TempPath, Path)) {
+    sys::fs::remove(TempPath);
+    return;
+  }
+  DEBUG(dbgs() << "Cached object " << Path << " for module "
+               << M->getModuleIdentifier() << "\n");
+}
+
+} // End namespace orc.
+} // End namespace llvm.
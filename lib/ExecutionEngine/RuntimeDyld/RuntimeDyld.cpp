@@ -21,12 +21,16 @@
 #include "llvm/Object/COFF.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/MutexGuard.h"
+#include "llvm/Support/ThreadPool.h"
 
 using namespace llvm;
 using namespace llvm::object;
 
 #define DEBUG_TYPE "dyld"
 
+// The fewest relocations worth handing to another thread.
+static const size_t MinRelocationsPerTask = 1024;
+
 // Empty out-of-line virtual destructor as the key function.
 RuntimeDyldImpl::~RuntimeDyldImpl() {}
 
@@ -88,22 +92,29 @@ void RuntimeDyldImpl::resolveRelocations() {
       dumpSectionMemory(Sections[i], "before relocations");
   );
 
-  // First, resolve relocations associated with external symbols.
-  resolveExternalSymbols();
+  // First, look up the values of external symbols.  The symbol resolver may
+  // load more objects, so this is done before any relocation is applied.
+  ResolvedRelocationList Resolved;
+  resolveExternalSymbols(Resolved);
 
-  // Just iterate over the sections we have and resolve all the relocations
+  // Just iterate over the sections we have and collect all the relocations
   // in them. Gross overkill, but it gets the job done.
   for (int i = 0, e = Sections.size(); i != e; ++i) {
     // The Section here (Sections[i]) refers to the section in which the
     // symbol for the relocation is located.  The SectionID in the relocation
     // entry provides the section to which the relocation will be applied.
+    auto I = Relocations.find(i);
+    if (I == Relocations.end())
+      continue;
     uint64_t Addr = Sections[i].LoadAddress;
     DEBUG(dbgs() << "Resolving relocations Section #" << i << "\t"
                  << format("%p", (uintptr_t)Addr) << "\n");
-    resolveRelocationList(Relocations[i], Addr);
-    Relocations.erase(i);
+    Resolved.push_back(std::make_pair(std::move(I->second), Addr));
+    Relocations.erase(I);
   }
 
+  applyRelocations(Resolved);
+
   // Print out sections after relocation.
   DEBUG(
     for (int i = 0, e = Sections.size(); i != e; ++i)
@@ -196,6 +207,7 @@ RuntimeDyldImpl::loadObjectImpl(const object::ObjectFile &Obj) {
           RTDyldSymFlags |= JITSymbolFlags::Weak;
         if (Flags & SymbolRef::SF_Exported)
           RTDyldSymFlags |= JITSymbolFlags::Exported;
+        sys::ScopedWriter Writer(SymbolTableLock);
         GlobalSymbolTable[Name] =
           SymbolTableEntry(SectionID, SectOffset, RTDyldSymFlags);
       }
@@ -501,7 +513,7 @@ void RuntimeDyldImpl::emitCommonSymbols(const ObjectFile &Obj,
   if (!Addr)
     report_fatal_error("Unable to allocate memory for common symbols!");
   uint64_t Offset = 0;
-  Sections.push_back(SectionEntry("<common symbols>", Addr, CommonSize, 0));
+  addSection(SectionEntry("<common symbols>", Addr, CommonSize, 0));
   memset(Addr, 0, CommonSize);
 
   DEBUG(dbgs() << "emitCommonSection SectionID: " << SectionID << " new addr: "
@@ -528,8 +540,11 @@ void RuntimeDyldImpl::emitCommonSymbols(const ObjectFile &Obj,
       RTDyldSymFlags |= JITSymbolFlags::Exported;
     DEBUG(dbgs() << "Allocating common symbol " << Name << " address "
                  << format("%p", Addr) << "\n");
-    GlobalSymbolTable[Name] =
-      SymbolTableEntry(SectionID, Offset, RTDyldSymFlags);
+    {
+      sys::ScopedWriter Writer(SymbolTableLock);
+      GlobalSymbolTable[Name] =
+        SymbolTableEntry(SectionID, Offset, RTDyldSymFlags);
+    }
     Offset += Size;
     Addr += Size;
   }
@@ -624,7 +639,7 @@ unsigned RuntimeDyldImpl::emitSection(const ObjectFile &Obj,
                  << " Allocate: " << Allocate << "\n");
   }
 
-  Sections.push_back(SectionEntry(Name, Addr, DataSize, (uintptr_t)pData));
+  addSection(SectionEntry(Name, Addr, DataSize, (uintptr_t)pData));
 
   if (Checker)
     Checker->registerSection(Obj.getFileName(), SectionID);
@@ -764,6 +779,7 @@ void RuntimeDyldImpl::reassignSectionAddress(unsigned SectionID,
                << SectionID << " (" << Sections[SectionID].Name << "): "
                << format("0x%016" PRIx64, Sections[SectionID].LoadAddress) << " -> "
                << format("0x%016" PRIx64, Addr) << "\n");
+  sys::ScopedWriter Writer(SymbolTableLock);
   Sections[SectionID].LoadAddress = Addr;
 }
 
@@ -778,7 +794,55 @@ void RuntimeDyldImpl::resolveRelocationList(const RelocationList &Relocs,
   }
 }
 
-void RuntimeDyldImpl::resolveExternalSymbols() {
+void RuntimeDyldImpl::applyRelocations(
+    const ResolvedRelocationList &Resolved) {
+  size_t NumRelocations = 0;
+  for (const auto &Entry : Resolved)
+    NumRelocations += Entry.first.size();
+
+  if (!Pool || !canResolveRelocationsConcurrently() ||
+      NumRelocations < 2 * MinRelocationsPerTask) {
+    for (const auto &Entry : Resolved)
+      resolveRelocationList(Entry.first, Entry.second);
+    return;
+  }
+
+  // Shard the relocations by the section they patch.  Each section is patched
+  // by a single task, in the order the relocations would have been resolved
+  // serially, so no two threads ever write to the same section.
+  typedef std::pair<const RelocationEntry *, uint64_t> PendingRelocation;
+  std::vector<std::vector<PendingRelocation>> BySection(Sections.size());
+  for (const auto &Entry : Resolved)
+    for (const RelocationEntry &RE : Entry.first)
+      // Ignore relocations for sections that were not loaded
+      if (Sections[RE.SectionID].Address != nullptr)
+        BySection[RE.SectionID].push_back(std::make_pair(&RE, Entry.second));
+
+  auto ResolveSections = [&](unsigned Begin, unsigned End) {
+    for (unsigned SectionID = Begin; SectionID != End; ++SectionID)
+      for (const PendingRelocation &PR : BySection[SectionID])
+        resolveRelocation(*PR.first, PR.second);
+  };
+
+  // Small sections are grouped into one task, so that objects with many
+  // sections do not spend their time scheduling.
+  TaskGroup Group;
+  unsigned Begin = 0;
+  size_t NumPending = 0;
+  for (unsigned SectionID = 0, E = BySection.size(); SectionID != E;
+       ++SectionID) {
+    NumPending += BySection[SectionID].size();
+    if (NumPending < MinRelocationsPerTask && SectionID + 1 != E)
+      continue;
+    Pool->async(Group, ResolveSections, Begin, SectionID + 1);
+    Begin = SectionID + 1;
+    NumPending = 0;
+  }
+  Pool->wait(Group);
+}
+
+void RuntimeDyldImpl::resolveExternalSymbols(
+    ResolvedRelocationList &Resolved) {
   while (!ExternalSymbolRelocations.empty()) {
     StringMap<RelocationList>::iterator i = ExternalSymbolRelocations.begin();
 
@@ -787,8 +851,7 @@ void RuntimeDyldImpl::resolveExternalSymbols() {
       // This is an absolute symbol, use an address of zero.
       DEBUG(dbgs() << "Resolving absolute relocations."
                    << "\n");
-      RelocationList &Relocs = i->second;
-      resolveRelocationList(Relocs, 0);
+      Resolved.push_back(std::make_pair(std::move(i->second), 0));
     } else {
       uint64_t Addr = 0;
       RTDyldSymbolTable::const_iterator Loc = GlobalSymbolTable.find(Name);
@@ -823,8 +886,7 @@ void RuntimeDyldImpl::resolveExternalSymbols() {
                      << format("0x%lx", Addr) << "\n");
         // This list may have been updated when we called getSymbolAddress, so
         // don't change this code to get the list earlier.
-        RelocationList &Relocs = i->second;
-        resolveRelocationList(Relocs, Addr);
+        Resolved.push_back(std::make_pair(std::move(i->second), Addr));
       }
     }
 
@@ -867,6 +929,7 @@ RuntimeDyld::RuntimeDyld(RuntimeDyld::MemoryManager &MemMgr,
   // permissions are applied.
   Dyld = nullptr;
   ProcessAllSections = false;
+  Pool = nullptr;
   Checker = nullptr;
 }
 
@@ -920,12 +983,15 @@ RuntimeDyld::loadObject(const ObjectFile &Obj) {
                ProcessAllSections, Checker);
     else
       report_fatal_error("Incompatible object format!");
+    Dyld->setThreadPool(Pool);
   }
 
   if (!Dyld->isCompatibleFile(Obj))
     report_fatal_error("Incompatible object format!");
 
-  return Dyld->loadObject(Obj);
+  auto LoadedObjInfo = Dyld->loadObject(Obj);
+  MemMgr.notifyObjectLoaded(*this, Obj);
+  return LoadedObjInfo;
 }
 
 void *RuntimeDyld::getSymbolLocalAddress(StringRef Name) const {
@@ -942,6 +1008,12 @@ RuntimeDyld::SymbolInfo RuntimeDyld::getSymbol(StringRef Name) const {
 
 void RuntimeDyld::resolveRelocations() { Dyld->resolveRelocations(); }
 
+void RuntimeDyld::setThreadPool(ThreadPool *Pool) {
+  this->Pool = Pool;
+  if (Dyld)
+    Dyld->setThreadPool(Pool);
+}
+
 void RuntimeDyld::reassignSectionAddress(unsigned SectionID, uint64_t Addr) {
   Dyld->reassignSectionAddress(SectionID, Addr);
 }
@@ -1060,6 +1060,19 @@ void RuntimeDyldELF::resolveRelocation(const RelocationEntry &RE,
                            RE.SymOffset, RE.SectionID);
 }
 
+bool RuntimeDyldELF::canResolveRelocationsConcurrently() const {
+  // MIPS relocations fill in GOT entries as they are resolved.
+  switch (Arch) {
+  case Triple::mips:
+  case Triple::mipsel:
+  case Triple::mips64:
+  case Triple::mips64el:
+    return false;
+  default:
+    return true;
+  }
+}
+
 void RuntimeDyldELF::resolveRelocation(const SectionEntry &Section,
                                        uint64_t Offset, uint64_t Value,
                                        uint32_t Type, int64_t Addend,
@@ -1734,10 +1747,9 @@ uint64_t RuntimeDyldELF::allocateGOTEntries(unsigned SectionID, unsigned no)
 {
   (void)SectionID; // The GOT Section is the same for all section in the object file
   if (GOTSectionID == 0) {
-    GOTSectionID = Sections.size();
     // Reserve a section id. We'll allocate the section later
     // once we know the total size
-    Sections.push_back(SectionEntry(".got", 0, 0, 0));
+    GOTSectionID = addSection(SectionEntry(".got", 0, 0, 0));
   }
   uint64_t StartOffset = CurrentGOTIndex * getGOTEntrySize();
   CurrentGOTIndex += no;
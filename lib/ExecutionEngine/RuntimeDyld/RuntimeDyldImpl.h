@@ -27,6 +27,7 @@
 #include "llvm/Support/Format.h"
 #include "llvm/Support/Host.h"
 #include "llvm/Support/Mutex.h"
+#include "llvm/Support/RWMutex.h"
 #include "llvm/Support/SwapByteOrder.h"
 #include "llvm/Support/raw_ostream.h"
 #include <map>
@@ -45,6 +46,7 @@ inline std::error_code Check(std::error_code Err) {
   return Err;
 }
 
+class ThreadPool;
 class Twine;
 
 /// SectionEntry - represents a section emitted into memory by the dynamic
@@ -212,6 +214,13 @@ protected:
   // A global symbol table for symbols from all loaded modules.
   RTDyldSymbolTable GlobalSymbolTable;
 
+  // Readers of GlobalSymbolTable and Sections that do not hold 'lock', such as
+  // getSymbol, take this lock for reading.  Everything that adds to either of
+  // them or changes a section's load address already holds 'lock' and takes
+  // this lock for writing around the change, so lookups only wait for the
+  // change itself, never for a whole object to load.
+  mutable sys::RWMutex SymbolTableLock;
+
   // Keep a map of common symbols to their info pairs
   typedef std::vector<SymbolRef> CommonSymbolList;
 
@@ -231,6 +240,13 @@ protected:
   // modules.  This map is indexed by symbol name.
   StringMap<RelocationList> ExternalSymbolRelocations;
 
+  // Relocation lists taken out of Relocations and ExternalSymbolRelocations,
+  // each with the value its relocations resolve against.
+  typedef std::vector<std::pair<RelocationList, uint64_t>>
+      ResolvedRelocationList;
+
+  // The pool that resolveRelocations applies relocations on, if any.
+  ThreadPool *Pool;
 
   typedef std::map<RelocationValueRef, uintptr_t> StubMap;
 
@@ -351,6 +367,22 @@ protected:
   /// \brief Resolves relocations from Relocs list with address from Value.
   void resolveRelocationList(const RelocationList &Relocs, uint64_t Value);
 
+  /// \brief Resolves all the relocations in \p Resolved, on Pool if there is
+  /// one and the target allows it.
+  void applyRelocations(const ResolvedRelocationList &Resolved);
+
+  /// \brief Returns true if relocations that patch different sections may be
+  /// resolved at the same time.  Targets whose resolveRelocation touches
+  /// state other than the patched section must return false.
+  virtual bool canResolveRelocationsConcurrently() const { return false; }
+
+  /// \brief Appends \p Entry to Sections and returns its SectionID.
+  unsigned addSection(SectionEntry Entry) {
+    sys::ScopedWriter Writer(SymbolTableLock);
+    Sections.push_back(std::move(Entry));
+    return Sections.size() - 1;
+  }
+
   /// \brief A object file specific relocation resolver
   /// \param RE The relocation to be resolved
   /// \param Value Target symbol address to apply the relocation action
@@ -365,8 +397,9 @@ protected:
                        const ObjectFile &Obj, ObjSectionToIDMap &ObjSectionToID,
                        StubMap &Stubs) = 0;
 
-  /// \brief Resolve relocations to external symbols.
-  void resolveExternalSymbols();
+  /// \brief Look up the values of the external symbols that relocations
+  /// refer to, and move their relocation lists to \p Resolved.
+  void resolveExternalSymbols(ResolvedRelocationList &Resolved);
 
   // \brief Compute an upper bound of the memory that is required to load all
   // sections
@@ -383,7 +416,7 @@ protected:
 public:
   RuntimeDyldImpl(RuntimeDyld::MemoryManager &MemMgr,
                   RuntimeDyld::SymbolResolver &Resolver)
-    : MemMgr(MemMgr), Resolver(Resolver), Checker(nullptr),
+    : MemMgr(MemMgr), Resolver(Resolver), Checker(nullptr), Pool(nullptr),
       ProcessAllSections(false), HasError(false) {
   }
 
@@ -397,12 +430,15 @@ public:
     this->Checker = Checker;
   }
 
+  void setThreadPool(ThreadPool *Pool) { this->Pool = Pool; }
+
   virtual std::unique_ptr<RuntimeDyld::LoadedObjectInfo>
   loadObject(const object::ObjectFile &Obj) = 0;
 
   uint8_t* getSymbolLocalAddress(StringRef Name) const {
     // FIXME: Just look up as a function for now. Overly simple of course.
     // Work in progress.
+    sys::ScopedReader Reader(SymbolTableLock);
     RTDyldSymbolTable::const_iterator pos = GlobalSymbolTable.find(Name);
     if (pos == GlobalSymbolTable.end())
       return nullptr;
@@ -413,6 +449,7 @@ public:
   RuntimeDyld::SymbolInfo getSymbol(StringRef Name) const {
     // FIXME: Just look up as a function for now. Overly simple of course.
     // Work in progress.
+    sys::ScopedReader Reader(SymbolTableLock);
     RTDyldSymbolTable::const_iterator pos = GlobalSymbolTable.find(Name);
     if (pos == GlobalSymbolTable.end())
       return nullptr;
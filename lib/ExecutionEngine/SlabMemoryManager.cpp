@@ -0,0 +1,367 @@
+//===- SlabMemoryManager.cpp - Slab-based memory manager for JITs ---------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the slab-based memory pool and memory manager.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ExecutionEngine/SlabMemoryManager.h"
+#include "llvm/ExecutionEngine/RuntimeDyld.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Process.h"
+#include <algorithm>
+
+using namespace llvm;
+
+static ManagedStatic<SlabMemoryPool> DefaultPool;
+
+/// A mapping carved into blocks of one size class, or holding a single large
+/// block.
+struct SlabMemoryPool::Slab {
+  MemoryKind Kind;
+  /// The log2 of the block size, or 0 for a large block.
+  unsigned SizeClass;
+  size_t BlockSize;
+  sys::MemoryBlock RW;
+  /// The executable view of a dual-mapped code slab, empty otherwise.
+  sys::MemoryBlock RX;
+  size_t NumBlocks;
+  /// Blocks at index NumCarved and above have never been handed out.
+  size_t NumCarved;
+  size_t NumLive;
+  std::vector<uint8_t *> FreeBlocks;
+
+  bool isLarge() const { return SizeClass == 0; }
+  bool isFull() const { return FreeBlocks.empty() && NumCarved == NumBlocks; }
+
+  uint8_t *getExecAddress(uint8_t *Address) const {
+    if (!RX.base())
+      return Address;
+    return static_cast<uint8_t *>(RX.base()) +
+           (Address - static_cast<uint8_t *>(RW.base()));
+  }
+};
+
+SlabMemoryPool::SlabMemoryPool(size_t SlabSize, bool DualMapCode)
+    : SlabSize(SlabSize), PageSize(sys::Process::getPageSize()),
+      DualMapCode(DualMapCode) {
+  assert(isPowerOf2_64(SlabSize) && SlabSize >= PageSize &&
+         "Slab size must be a power of two of at least a page");
+
+  if (DualMapCode) {
+    sys::MemoryBlock RW, RX;
+    if (sys::Memory::allocateDualMappedMemory(PageSize, RW, RX)) {
+      this->DualMapCode = false;
+    } else {
+      sys::Memory::releaseMappedMemory(RX);
+      sys::Memory::releaseMappedMemory(RW);
+    }
+  }
+
+  // Without a second view, code blocks must not share pages so that each can
+  // be made executable while the others are still being written.
+  MinSizeClass[unsigned(MemoryKind::Data)] = 4;
+  MinSizeClass[unsigned(MemoryKind::Code)] =
+      this->DualMapCode ? 4 : Log2_64(PageSize);
+  // Requests larger than an eighth of a slab get their own mapping.
+  MaxSizeClass = Log2_64(SlabSize / 8);
+  for (auto &ClassSlabs : Available)
+    ClassSlabs.resize(MaxSizeClass + 1);
+}
+
+SlabMemoryPool::~SlabMemoryPool() {
+  for (auto &Entry : Slabs) {
+    sys::Memory::releaseMappedMemory(Entry.second->RX);
+    sys::Memory::releaseMappedMemory(Entry.second->RW);
+  }
+}
+
+SlabMemoryPool &SlabMemoryPool::getDefault() { return *DefaultPool; }
+
+SlabMemoryPool::Block SlabMemoryPool::allocate(MemoryKind Kind,
+                                               uintptr_t Size,
+                                               unsigned Alignment,
+                                               std::error_code &EC) {
+  EC = std::error_code();
+  if (!Alignment)
+    Alignment = 16;
+  assert(!(Alignment & (Alignment - 1)) && "Alignment must be a power of two.");
+
+  // Blocks are aligned to their size, up to the alignment of the slab.
+  unsigned SizeClass =
+      std::max(Log2_64_Ceil(std::max<uint64_t>(Size, Alignment)),
+               MinSizeClass[unsigned(Kind)]);
+  if (SizeClass > MaxSizeClass || Alignment > PageSize)
+    return allocateLarge(Kind, Size, Alignment, EC);
+
+  std::lock_guard<std::mutex> Lock(PoolMutex);
+  std::vector<Slab *> &ClassSlabs = getAvailable(Kind, SizeClass);
+  if (ClassSlabs.empty()) {
+    Slab *S = createSlab(Kind, size_t(1) << SizeClass, SlabSize, EC);
+    if (!S)
+      return Block();
+    S->SizeClass = SizeClass;
+    ClassSlabs.push_back(S);
+  }
+
+  Slab &S = *ClassSlabs.back();
+  uint8_t *Address;
+  if (!S.FreeBlocks.empty()) {
+    Address = S.FreeBlocks.back();
+    S.FreeBlocks.pop_back();
+  } else {
+    Address = static_cast<uint8_t *>(S.RW.base()) + S.NumCarved++ * S.BlockSize;
+  }
+  ++S.NumLive;
+  if (S.isFull())
+    ClassSlabs.pop_back();
+
+  ++Stats.NumAllocations;
+  Stats.BytesRequested += Size;
+  Stats.BytesAllocated += S.BlockSize;
+
+  Block B;
+  B.Address = Address;
+  B.ExecAddress = S.getExecAddress(Address);
+  B.Size = Size;
+  return B;
+}
+
+SlabMemoryPool::Block SlabMemoryPool::allocateLarge(MemoryKind Kind,
+                                                    uintptr_t Size,
+                                                    unsigned Alignment,
+                                                    std::error_code &EC) {
+  // Mappings are page aligned, so only larger alignments need padding.
+  uintptr_t MapSize = Size + (Alignment > PageSize ? Alignment : 0);
+
+  std::lock_guard<std::mutex> Lock(PoolMutex);
+  Slab *S = createSlab(Kind, MapSize, MapSize, EC);
+  if (!S)
+    return Block();
+  S->NumCarved = S->NumLive = 1;
+
+  uintptr_t Start = reinterpret_cast<uintptr_t>(S->RW.base());
+  uint8_t *Address =
+      reinterpret_cast<uint8_t *>(RoundUpToAlignment(Start, Alignment));
+
+  ++Stats.NumAllocations;
+  Stats.BytesRequested += Size;
+  Stats.BytesAllocated += S->BlockSize;
+
+  Block B;
+  B.Address = Address;
+  B.ExecAddress = S->getExecAddress(Address);
+  B.Size = Size;
+  return B;
+}
+
+SlabMemoryPool::Slab *SlabMemoryPool::createSlab(MemoryKind Kind,
+                                                 size_t BlockSize,
+                                                 size_t MapSize,
+                                                 std::error_code &EC) {
+  std::unique_ptr<Slab> S(new Slab());
+  S->Kind = Kind;
+  S->SizeClass = 0;
+  if (Kind == MemoryKind::Code && DualMapCode)
+    EC = sys::Memory::allocateDualMappedMemory(MapSize, S->RW, S->RX);
+  else
+    S->RW = sys::Memory::allocateMappedMemory(
+        MapSize, nullptr, sys::Memory::MF_READ | sys::Memory::MF_WRITE, EC);
+  if (EC)
+    return nullptr;
+
+  // A large block owns the whole mapping, which may be rounded up to pages.
+  S->BlockSize = BlockSize == MapSize ? S->RW.size() : BlockSize;
+  S->NumBlocks = S->RW.size() / S->BlockSize;
+  S->NumCarved = 0;
+  S->NumLive = 0;
+
+  if (BlockSize == MapSize)
+    ++Stats.NumLargeBlocks;
+  else
+    ++Stats.NumSlabs;
+  Stats.BytesMapped += S->RW.size();
+
+  Slab *Result = S.get();
+  Slabs[reinterpret_cast<uintptr_t>(S->RW.base())] = std::move(S);
+  return Result;
+}
+
+void SlabMemoryPool::releaseSlab(Slab &S) {
+  if (S.isLarge())
+    --Stats.NumLargeBlocks;
+  else
+    --Stats.NumSlabs;
+  Stats.BytesMapped -= S.RW.size();
+
+  uintptr_t Key = reinterpret_cast<uintptr_t>(S.RW.base());
+  sys::Memory::releaseMappedMemory(S.RX);
+  sys::Memory::releaseMappedMemory(S.RW);
+  Slabs.erase(Key);
+}
+
+SlabMemoryPool::Slab &SlabMemoryPool::findSlab(const uint8_t *Address) {
+  auto I = Slabs.upper_bound(reinterpret_cast<uintptr_t>(Address));
+  assert(I != Slabs.begin() && "Block was not allocated from this pool");
+  --I;
+  assert(reinterpret_cast<uintptr_t>(Address) <
+             I->first + I->second->RW.size() &&
+         "Block was not allocated from this pool");
+  return *I->second;
+}
+
+std::vector<SlabMemoryPool::Slab *> &
+SlabMemoryPool::getAvailable(MemoryKind Kind, unsigned SizeClass) {
+  return Available[unsigned(Kind)][SizeClass];
+}
+
+void SlabMemoryPool::deallocate(const Block &B) {
+  std::lock_guard<std::mutex> Lock(PoolMutex);
+  Slab &S = findSlab(B.Address);
+  Stats.BytesRequested -= B.Size;
+  Stats.BytesAllocated -= S.BlockSize;
+
+  if (S.isLarge()) {
+    releaseSlab(S);
+    return;
+  }
+
+  // The block may be reused for code that has not been written yet.
+  if (S.Kind == MemoryKind::Code && !DualMapCode)
+    sys::Memory::protectMappedMemory(sys::MemoryBlock(B.Address, S.BlockSize),
+                                     sys::Memory::MF_READ |
+                                         sys::Memory::MF_WRITE);
+
+  std::vector<Slab *> &ClassSlabs = getAvailable(S.Kind, S.SizeClass);
+  if (S.isFull())
+    ClassSlabs.push_back(&S);
+  --S.NumLive;
+  if (S.NumLive != 0) {
+    S.FreeBlocks.push_back(B.Address);
+    return;
+  }
+
+  // Keep the last slab of each class around so that a class whose blocks
+  // come and go does not map and unmap a slab every time.
+  if (ClassSlabs.size() == 1) {
+    S.FreeBlocks.clear();
+    S.NumCarved = 0;
+    return;
+  }
+  ClassSlabs.erase(std::find(ClassSlabs.begin(), ClassSlabs.end(), &S));
+  releaseSlab(S);
+}
+
+std::error_code SlabMemoryPool::makeExecutable(const Block &B) {
+  if (DualMapCode) {
+    sys::Memory::InvalidateInstructionCache(B.ExecAddress, B.Size);
+    return std::error_code();
+  }
+
+  sys::MemoryBlock MB;
+  {
+    std::lock_guard<std::mutex> Lock(PoolMutex);
+    Slab &S = findSlab(B.Address);
+    MB = S.isLarge() ? S.RW : sys::MemoryBlock(B.Address, S.BlockSize);
+  }
+  return sys::Memory::protectMappedMemory(
+      MB, sys::Memory::MF_READ | sys::Memory::MF_EXEC);
+}
+
+SlabMemoryPool::Statistics SlabMemoryPool::getStatistics() const {
+  std::lock_guard<std::mutex> Lock(PoolMutex);
+  return Stats;
+}
+
+SlabMemoryManager::SlabMemoryManager()
+    : SlabMemoryManager(SlabMemoryPool::getDefault()) {}
+
+SlabMemoryManager::SlabMemoryManager(SlabMemoryPool &Pool)
+    : Pool(Pool), NumMappedCodeBlocks(0), NumFinalizedCodeBlocks(0) {}
+
+SlabMemoryManager::~SlabMemoryManager() {
+  for (const EHFrame &Frame : RegisteredEHFrames)
+    RTDyldMemoryManager::deregisterEHFrames(Frame.Addr, Frame.LoadAddr,
+                                            Frame.Size);
+  for (const SlabMemoryPool::Block &B : CodeBlocks)
+    Pool.deallocate(B);
+  for (const SlabMemoryPool::Block &B : DataBlocks)
+    Pool.deallocate(B);
+}
+
+uint8_t *SlabMemoryManager::allocateCodeSection(uintptr_t Size,
+                                                unsigned Alignment,
+                                                unsigned SectionID,
+                                                StringRef SectionName) {
+  std::error_code EC;
+  SlabMemoryPool::Block B =
+      Pool.allocate(SlabMemoryPool::MemoryKind::Code, Size, Alignment, EC);
+  if (EC)
+    return nullptr;
+  CodeBlocks.push_back(B);
+  return B.Address;
+}
+
+uint8_t *SlabMemoryManager::allocateDataSection(uintptr_t Size,
+                                                unsigned Alignment,
+                                                unsigned SectionID,
+                                                StringRef SectionName,
+                                                bool IsReadOnly) {
+  std::error_code EC;
+  SlabMemoryPool::Block B =
+      Pool.allocate(SlabMemoryPool::MemoryKind::Data, Size, Alignment, EC);
+  if (EC)
+    return nullptr;
+  DataBlocks.push_back(B);
+  return B.Address;
+}
+
+void SlabMemoryManager::registerEHFrames(uint8_t *Addr, uint64_t LoadAddr,
+                                         size_t Size) {
+  RTDyldMemoryManager::registerEHFrames(Addr, LoadAddr, Size);
+  EHFrame Frame = {Addr, LoadAddr, Size};
+  RegisteredEHFrames.push_back(Frame);
+}
+
+void SlabMemoryManager::deregisterEHFrames(uint8_t *Addr, uint64_t LoadAddr,
+                                           size_t Size) {
+  auto I = std::find_if(
+      RegisteredEHFrames.begin(), RegisteredEHFrames.end(),
+      [&](const EHFrame &Frame) { return Frame.Addr == Addr; });
+  if (I == RegisteredEHFrames.end())
+    return;
+  RegisteredEHFrames.erase(I);
+  RTDyldMemoryManager::deregisterEHFrames(Addr, LoadAddr, Size);
+}
+
+void SlabMemoryManager::notifyObjectLoaded(RuntimeDyld &RTDyld,
+                                           const object::ObjectFile &Obj) {
+  for (size_t I = NumMappedCodeBlocks, E = CodeBlocks.size(); I != E; ++I) {
+    const SlabMemoryPool::Block &B = CodeBlocks[I];
+    if (B.ExecAddress != B.Address)
+      RTDyld.mapSectionAddress(B.Address,
+                               reinterpret_cast<uintptr_t>(B.ExecAddress));
+  }
+  NumMappedCodeBlocks = CodeBlocks.size();
+}
+
+bool SlabMemoryManager::finalizeMemory(std::string *ErrMsg) {
+  for (size_t I = NumFinalizedCodeBlocks, E = CodeBlocks.size(); I != E; ++I) {
+    if (std::error_code EC = Pool.makeExecutable(CodeBlocks[I])) {
+      if (ErrMsg)
+        *ErrMsg = EC.message();
+      return true;
+    }
+    // Only count the blocks that were made executable, so that a failed
+    // finalization can be retried.
+    NumFinalizedCodeBlocks = I + 1;
+  }
+  return false;
+}
@@ -277,6 +277,8 @@ Constant *Constant::getAggregateElement(Constant *Elt) const {
 }
 
 void Constant::destroyConstant() {
+  ContextLockGuard Lock(getContext());
+
   /// First call destroyConstantImpl on the subclass.  This gives the subclass
   /// a chance to remove the constant from any maps/pools it's contained in.
   switch (getValueID()) {
@@ -529,6 +531,7 @@ ConstantInt::ConstantInt(IntegerType *Ty, const APInt& V)
 
 ConstantInt *ConstantInt::getTrue(LLVMContext &Context) {
   LLVMContextImpl *pImpl = Context.pImpl;
+  ContextLockGuard Lock(pImpl);
   if (!pImpl->TheTrueVal)
     pImpl->TheTrueVal = ConstantInt::get(Type::getInt1Ty(Context), 1);
   return pImpl->TheTrueVal;
@@ -536,6 +539,7 @@ ConstantInt *ConstantInt::getTrue(LLVMContext &Context) {
 
 ConstantInt *ConstantInt::getFalse(LLVMContext &Context) {
   LLVMContextImpl *pImpl = Context.pImpl;
+  ContextLockGuard Lock(pImpl);
   if (!pImpl->TheFalseVal)
     pImpl->TheFalseVal = ConstantInt::get(Type::getInt1Ty(Context), 0);
   return pImpl->TheFalseVal;
@@ -569,6 +573,7 @@ Constant *ConstantInt::getFalse(Type *Ty) {
 ConstantInt *ConstantInt::get(LLVMContext &Context, const APInt &V) {
   // get an existing value or the insertion position
   LLVMContextImpl *pImpl = Context.pImpl;
+  ContextLockGuard Lock(pImpl);
   ConstantInt *&Slot = pImpl->IntConstants[V];
   if (!Slot) {
     // Get the corresponding integer type for the bit width of the value.
@@ -713,6 +718,7 @@ Constant *ConstantFP::getZeroValueForNegation(Type *Ty) {
 // ConstantFP accessors.
 ConstantFP* ConstantFP::get(LLVMContext &Context, const APFloat& V) {
   LLVMContextImpl* pImpl = Context.pImpl;
+  ContextLockGuard Lock(pImpl);
 
   ConstantFP *&Slot = pImpl->FPConstants[V];
 
@@ -873,6 +879,7 @@ ConstantArray::ConstantArray(ArrayType *T, ArrayRef<Constant *> V)
 Constant *ConstantArray::get(ArrayType *Ty, ArrayRef<Constant*> V) {
   if (Constant *C = getImpl(Ty, V))
     return C;
+  ContextLockGuard Lock(Ty->getContext());
   return Ty->getContext().pImpl->ArrayConstants.getOrCreate(Ty, V);
 }
 Constant *ConstantArray::getImpl(ArrayType *Ty, ArrayRef<Constant*> V) {
@@ -1030,6 +1037,7 @@ Constant *ConstantStruct::get(StructType *ST, ArrayRef<Constant*> V) {
   if (isUndef)
     return UndefValue::get(ST);
 
+  ContextLockGuard Lock(ST->getContext());
   return ST->getContext().pImpl->StructConstants.getOrCreate(ST, V);
 }
 
@@ -1058,6 +1066,7 @@ Constant *ConstantVector::get(ArrayRef<Constant*> V) {
   if (Constant *C = getImpl(V))
     return C;
   VectorType *Ty = VectorType::get(V.front()->getType(), V.size());
+  ContextLockGuard Lock(Ty->getContext());
   return Ty->getContext().pImpl->VectorConstants.getOrCreate(Ty, V);
 }
 Constant *ConstantVector::getImpl(ArrayRef<Constant*> V) {
@@ -1381,6 +1390,7 @@ ConstantAggregateZero *ConstantAggregateZero::get(Type *Ty) {
   assert((Ty->isStructTy() || Ty->isArrayTy() || Ty->isVectorTy()) &&
          "Cannot create an aggregate zero of non-aggregate type!");
   
+  ContextLockGuard Lock(Ty->getContext());
   ConstantAggregateZero *&Entry = Ty->getContext().pImpl->CAZConstants[Ty];
   if (!Entry)
     Entry = new ConstantAggregateZero(Ty);
@@ -1456,6 +1466,7 @@ const APInt &Constant::getUniqueInteger() const {
 //
 
 ConstantPointerNull *ConstantPointerNull::get(PointerType *Ty) {
+  ContextLockGuard Lock(Ty->getContext());
   ConstantPointerNull *&Entry = Ty->getContext().pImpl->CPNConstants[Ty];
   if (!Entry)
     Entry = new ConstantPointerNull(Ty);
@@ -1474,6 +1485,7 @@ void ConstantPointerNull::destroyConstantImpl() {
 //
 
 UndefValue *UndefValue::get(Type *Ty) {
+  ContextLockGuard Lock(Ty->getContext());
   UndefValue *&Entry = Ty->getContext().pImpl->UVConstants[Ty];
   if (!Entry)
     Entry = new UndefValue(Ty);
@@ -1497,6 +1509,7 @@ BlockAddress *BlockAddress::get(BasicBlock *BB) {
 }
 
 BlockAddress *BlockAddress::get(Function *F, BasicBlock *BB) {
+  ContextLockGuard Lock(F->getContext());
   BlockAddress *&BA =
     F->getContext().pImpl->BlockAddresses[std::make_pair(F, BB)];
   if (!BA)
@@ -1520,6 +1533,7 @@ BlockAddress *BlockAddress::lookup(const BasicBlock *BB) {
 
   const Function *F = BB->getParent();
   assert(F && "Block must have a parent");
+  ContextLockGuard Lock(F->getContext());
   BlockAddress *BA =
       F->getContext().pImpl->BlockAddresses.lookup(std::make_pair(F, BB));
   assert(BA && "Refcount and block address map disagree!");
@@ -1584,6 +1598,7 @@ static Constant *getFoldedCast(Instruction::CastOps opc, Constant *C, Type *Ty,
     return nullptr;
 
   LLVMContextImpl *pImpl = Ty->getContext().pImpl;
+  ContextLockGuard Lock(pImpl);
 
   // Look up the constant in the table first to ensure uniqueness.
   ConstantExprKeyType Key(opc, C);
@@ -1945,6 +1960,7 @@ Constant *ConstantExpr::get(unsigned Opcode, Constant *C1, Constant *C2,
   ConstantExprKeyType Key(Opcode, ArgVec, 0, Flags);
 
   LLVMContextImpl *pImpl = C1->getContext().pImpl;
+  ContextLockGuard Lock(pImpl);
   return pImpl->ExprConstants.getOrCreate(C1->getType(), Key);
 }
 
@@ -2026,6 +2042,7 @@ Constant *ConstantExpr::getSelect(Constant *C, Constant *V1, Constant *V2,
   ConstantExprKeyType Key(Instruction::Select, ArgVec);
 
   LLVMContextImpl *pImpl = C->getContext().pImpl;
+  ContextLockGuard Lock(pImpl);
   return pImpl->ExprConstants.getOrCreate(V1->getType(), Key);
 }
 
@@ -2071,6 +2088,7 @@ Constant *ConstantExpr::getGetElementPtr(Type *Ty, Constant *C,
                                 Ty);
 
   LLVMContextImpl *pImpl = C->getContext().pImpl;
+  ContextLockGuard Lock(pImpl);
   return pImpl->ExprConstants.getOrCreate(ReqTy, Key);
 }
 
@@ -2096,6 +2114,7 @@ Constant *ConstantExpr::getICmp(unsigned short pred, Constant *LHS,
     ResultTy = VectorType::get(ResultTy, VT->getNumElements());
 
   LLVMContextImpl *pImpl = LHS->getType()->getContext().pImpl;
+  ContextLockGuard Lock(pImpl);
   return pImpl->ExprConstants.getOrCreate(ResultTy, Key);
 }
 
@@ -2120,6 +2139,7 @@ Constant *ConstantExpr::getFCmp(unsigned short pred, Constant *LHS,
     ResultTy = VectorType::get(ResultTy, VT->getNumElements());
 
   LLVMContextImpl *pImpl = LHS->getType()->getContext().pImpl;
+  ContextLockGuard Lock(pImpl);
   return pImpl->ExprConstants.getOrCreate(ResultTy, Key);
 }
 
@@ -2142,6 +2162,7 @@ Constant *ConstantExpr::getExtractElement(Constant *Val, Constant *Idx,
   const ConstantExprKeyType Key(Instruction::ExtractElement, ArgVec);
 
   LLVMContextImpl *pImpl = Val->getContext().pImpl;
+  ContextLockGuard Lock(pImpl);
   return pImpl->ExprConstants.getOrCreate(ReqTy, Key);
 }
 
@@ -2165,6 +2186,7 @@ Constant *ConstantExpr::getInsertElement(Constant *Val, Constant *Elt,
   const ConstantExprKeyType Key(Instruction::InsertElement, ArgVec);
 
   LLVMContextImpl *pImpl = Val->getContext().pImpl;
+  ContextLockGuard Lock(pImpl);
   return pImpl->ExprConstants.getOrCreate(Val->getType(), Key);
 }
 
@@ -2188,6 +2210,7 @@ Constant *ConstantExpr::getShuffleVector(Constant *V1, Constant *V2,
   const ConstantExprKeyType Key(Instruction::ShuffleVector, ArgVec);
 
   LLVMContextImpl *pImpl = ShufTy->getContext().pImpl;
+  ContextLockGuard Lock(pImpl);
   return pImpl->ExprConstants.getOrCreate(ShufTy, Key);
 }
 
@@ -2212,6 +2235,7 @@ Constant *ConstantExpr::getInsertValue(Constant *Agg, Constant *Val,
   const ConstantExprKeyType Key(Instruction::InsertValue, ArgVec, 0, 0, Idxs);
 
   LLVMContextImpl *pImpl = Agg->getContext().pImpl;
+  ContextLockGuard Lock(pImpl);
   return pImpl->ExprConstants.getOrCreate(ReqTy, Key);
 }
 
@@ -2236,6 +2260,7 @@ Constant *ConstantExpr::getExtractValue(Constant *Agg, ArrayRef<unsigned> Idxs,
   const ConstantExprKeyType Key(Instruction::ExtractValue, ArgVec, 0, 0, Idxs);
 
   LLVMContextImpl *pImpl = Agg->getContext().pImpl;
+  ContextLockGuard Lock(pImpl);
   return pImpl->ExprConstants.getOrCreate(ReqTy, Key);
 }
 
@@ -2488,6 +2513,7 @@ Constant *ConstantDataSequential::getImpl(StringRef Elements, Type *Ty) {
     return ConstantAggregateZero::get(Ty);
 
   // Do a lookup to see if we have already formed one of these.
+  ContextLockGuard Lock(Ty->getContext());
   auto &Slot =
       *Ty->getContext()
            .pImpl->CDSConstants.insert(std::make_pair(Elements, nullptr))
@@ -2841,6 +2867,7 @@ Constant *ConstantDataVector::getSplatValue() const {
 /// array instance.
 ///
 void Constant::handleOperandChange(Value *From, Value *To, Use *U) {
+  ContextLockGuard Lock(getContext());
   Value *Replacement = nullptr;
   switch (getValueID()) {
   default:
@@ -586,8 +586,11 @@ public:
     auto I = find(Lookup);
     if (I == Map.end())
       Result = create(Ty, V);
-    else
+    else {
       Result = I->first;
+      if (LLVM_UNLIKELY(Ty->getContext().pImpl->Multithreaded))
+        Ty->getContext().pImpl->noteParallelLookup(Result);
+    }
     assert(Result && "Unexpected nullptr");
 
     return Result;
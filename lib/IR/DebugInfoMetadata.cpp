@@ -46,6 +46,7 @@ DILocation *DILocation::getImpl(LLVMContext &Context, unsigned Line,
   adjustColumn(Column);
 
   assert(Scope && "Expected scope");
+  ContextLockGuard Lock(Context);
   if (Storage == Uniqued) {
     if (auto *N =
             getUniqued(Context.pImpl->DILocations,
@@ -80,6 +81,7 @@ unsigned DILocation::computeNewDiscriminator() const {
   // AddDiscriminators::runOnFunction(), where it doesn't pollute the
   // LLVMContext.
   std::pair<const char *, unsigned> Key(getFilename().data(), getLine());
+  ContextLockGuard Lock(getContext());
   return ++getContext().pImpl->DiscriminatorTable[Key];
 }
 
@@ -204,6 +206,7 @@ void GenericDINode::recalculateHash() {
 #define UNWRAP_ARGS_IMPL(...) __VA_ARGS__
 #define UNWRAP_ARGS(ARGS) UNWRAP_ARGS_IMPL ARGS
 #define DEFINE_GETIMPL_LOOKUP(CLASS, ARGS)                                     \
+  ContextLockGuard Lock(Context);                                              \
   do {                                                                         \
     if (Storage == Uniqued) {                                                  \
       if (auto *N = getUniqued(Context.pImpl->CLASS##s,                        \
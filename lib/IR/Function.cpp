@@ -260,8 +260,13 @@ Function::Function(FunctionType *Ty, LinkageTypes Linkage, const Twine &name,
   if (Ty->getNumParams())
     setValueSubclassData(1);   // Set the "has lazy arguments" bit.
 
-  if (ParentModule)
+  if (ParentModule) {
+    LLVMContextImpl *pImpl = getContext().pImpl;
+    ContextLockGuard Lock(pImpl);
+    if (LLVM_UNLIKELY(pImpl->Multithreaded))
+      pImpl->addParallelGlobal(this, true);
     ParentModule->getFunctionList().push_back(this);
+  }
 
   // Ensure intrinsics have the right parameter attributes.
   // Note, the IntID field will have been set in Value::setName if this function
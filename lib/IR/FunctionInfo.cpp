@@ -0,0 +1,116 @@
+//===-- FunctionInfo.cpp - Function summary index ------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the function summary index used by ThinLTO.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/IR/FunctionInfo.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/IntrinsicInst.h"
+using namespace llvm;
+
+/// Return true if \p C is, or is built from, a local symbol or a block
+/// address.
+static bool constantRefersToLocals(const Constant *C,
+                                   SmallPtrSetImpl<const Constant *> &Visited) {
+  if (!Visited.insert(C).second)
+    return false;
+  if (auto *GV = dyn_cast<GlobalValue>(C))
+    return GV->hasLocalLinkage();
+  if (isa<BlockAddress>(C))
+    return true;
+  for (const Use &Op : C->operands())
+    if (constantRefersToLocals(cast<Constant>(Op), Visited))
+      return true;
+  return false;
+}
+
+FunctionSummary FunctionSummary::compute(const Function &F) {
+  FunctionSummary Summary(F.getLinkage(), 0, false);
+  SmallPtrSet<const Constant *, 32> Visited;
+  SmallPtrSet<const Function *, 16> Callees;
+  if (F.hasPersonalityFn())
+    Summary.RefersToLocals |=
+        constantRefersToLocals(F.getPersonalityFn(), Visited);
+
+  for (const Instruction &I : instructions(F)) {
+    if (isa<DbgInfoIntrinsic>(I))
+      continue;
+    ++Summary.InstCount;
+
+    for (const Use &Op : I.operands())
+      if (auto *C = dyn_cast<Constant>(Op))
+        Summary.RefersToLocals |= constantRefersToLocals(C, Visited);
+
+    ImmutableCallSite CS(&I);
+    if (!CS)
+      continue;
+    const Function *Callee = CS.getCalledFunction();
+    if (Callee && !Callee->isIntrinsic() && Callee->hasName() &&
+        Callees.insert(Callee).second)
+      Summary.addCall(Callee->getName());
+  }
+  return Summary;
+}
+
+void FunctionInfoIndex::addFunctionInfo(StringRef Name,
+                                        std::unique_ptr<FunctionInfo> Info) {
+  assert(ModulePathStringTable.count(Info->modulePath()) &&
+         "Function defined in a module that is not in the index");
+  FunctionMap[Name].push_back(std::move(Info));
+}
+
+const FunctionInfoList *
+FunctionInfoIndex::findFunctionInfoList(StringRef Name) const {
+  auto I = FunctionMap.find(Name);
+  if (I == FunctionMap.end())
+    return nullptr;
+  return &I->second;
+}
+
+const FunctionInfo *
+FunctionInfoIndex::findImportCandidate(StringRef Name,
+                                       StringRef ImporterPath) const {
+  const FunctionInfoList *List = findFunctionInfoList(Name);
+  if (!List)
+    return nullptr;
+  for (const auto &Info : *List)
+    if (Info->modulePath() != ImporterPath &&
+        Info->summary().isEligibleForImport())
+      return Info.get();
+  return nullptr;
+}
+
+StringRef FunctionInfoIndex::addModulePath(StringRef Path, uint64_t ModId) {
+  return ModulePathStringTable.insert(std::make_pair(Path, ModId))
+      .first->first();
+}
+
+void FunctionInfoIndex::mergeFrom(std::unique_ptr<FunctionInfoIndex> Other) {
+  // Renumber the other index's modules after ours, keeping their order.
+  std::vector<StringRef> OtherPaths(Other->ModulePathStringTable.size());
+  for (const auto &Entry : Other->ModulePathStringTable)
+    OtherPaths[Entry.second] = Entry.first();
+  for (StringRef Path : OtherPaths)
+    addModulePath(Path, ModulePathStringTable.size());
+
+  for (auto &Entry : Other->FunctionMap) {
+    FunctionInfoList &List = FunctionMap[Entry.first()];
+    for (auto &Info : Entry.second) {
+      Info->setModulePath(
+          ModulePathStringTable.find(Info->modulePath())->first());
+      List.push_back(std::move(Info));
+    }
+  }
+}
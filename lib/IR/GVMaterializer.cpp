@@ -13,6 +13,15 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/IR/GVMaterializer.h"
+#include "llvm/IR/Function.h"
 using namespace llvm;
 
 GVMaterializer::~GVMaterializer() {}
+
+std::error_code GVMaterializer::materializeFunctions(ArrayRef<Function *> Fns,
+                                                     ThreadPool *) {
+  for (Function *F : Fns)
+    if (std::error_code EC = materialize(F))
+      return EC;
+  return std::error_code();
+}
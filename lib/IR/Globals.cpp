@@ -13,6 +13,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/IR/GlobalValue.h"
+#include "LLVMContextImpl.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DerivedTypes.h"
@@ -177,6 +178,10 @@ GlobalVariable::GlobalVariable(Module &M, Type *Ty, bool constant,
     Op<0>() = InitVal;
   }
 
+  LLVMContextImpl *pImpl = getContext().pImpl;
+  ContextLockGuard Lock(pImpl);
+  if (LLVM_UNLIKELY(pImpl->Multithreaded))
+    pImpl->addParallelGlobal(this, !Before);
   if (Before)
     Before->getParent()->getGlobalList().insert(Before, this);
   else
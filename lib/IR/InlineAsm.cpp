@@ -30,6 +30,7 @@ InlineAsm *InlineAsm::get(FunctionType *FTy, StringRef AsmString,
   InlineAsmKeyType Key(AsmString, Constraints, FTy, hasSideEffects,
                        isAlignStack, asmDialect);
   LLVMContextImpl *pImpl = FTy->getContext().pImpl;
+  ContextLockGuard Lock(pImpl);
   return pImpl->InlineAsms.getOrCreate(PointerType::getUnqual(FTy), Key);
 }
 
@@ -47,6 +48,7 @@ InlineAsm::InlineAsm(FunctionType *FTy, const std::string &asmString,
 }
 
 void InlineAsm::destroyConstant() {
+  ContextLockGuard Lock(getContext());
   getType()->getContext().pImpl->InlineAsms.remove(this);
   delete this;
 }
@@ -178,6 +178,10 @@ void LLVMContext::yield() {
     pImpl->YieldCallback(this, pImpl->YieldOpaqueHandle);
 }
 
+bool LLVMContext::isRunningFunctionPassesInParallel() const {
+  return pImpl->Multithreaded;
+}
+
 void LLVMContext::emitError(const Twine &ErrorStr) {
   diagnose(DiagnosticInfoInlineAsm(ErrorStr));
 }
@@ -261,6 +265,7 @@ void LLVMContext::emitError(unsigned LocCookie, const Twine &ErrorStr) {
 /// Return a unique non-zero ID for the specified metadata kind.
 unsigned LLVMContext::getMDKindID(StringRef Name) const {
   // If this is new, assign it its ID.
+  ContextLockGuard Lock(pImpl);
   return pImpl->CustomMDKindNames.insert(
                                      std::make_pair(
                                          Name, pImpl->CustomMDKindNames.size()))
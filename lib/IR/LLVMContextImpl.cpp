@@ -46,6 +46,7 @@ LLVMContextImpl::LLVMContextImpl(LLVMContext &C)
   YieldCallback = nullptr;
   YieldOpaqueHandle = nullptr;
   NamedStructTypesUniqueID = 0;
+  Multithreaded = false;
 }
 
 namespace {
@@ -185,6 +186,120 @@ void Module::dropTriviallyDeadConstantArrays() {
   Context.pImpl->dropTriviallyDeadConstantArrays();
 }
 
+// The position of the function that the passes of this thread run on in a
+// parallel run, and the number of changes they made to shared values so far.
+static LLVM_THREAD_LOCAL unsigned ParallelRunFunction;
+static LLVM_THREAD_LOCAL unsigned ParallelRunChange;
+
+static LLVMContextImpl::ParallelRunStep nextParallelRunStep() {
+  LLVMContextImpl::ParallelRunStep Step = {ParallelRunFunction,
+                                           ParallelRunChange++};
+  return Step;
+}
+
+static bool isBefore(const LLVMContextImpl::ParallelRunStep &L,
+                     const LLVMContextImpl::ParallelRunStep &R) {
+  return L.Function < R.Function ||
+         (L.Function == R.Function && L.Change < R.Change);
+}
+
+void LLVMContextImpl::setParallelRunFunction(unsigned Position) {
+  ParallelRunFunction = Position;
+  ParallelRunChange = 0;
+}
+
+void LLVMContextImpl::startParallelRun() {
+  assert(!Multithreaded && "Function passes already run in parallel!");
+  Multithreaded = true;
+  ++Value::NumParallelContexts;
+}
+
+void LLVMContextImpl::addParallelUse(const Use &U) {
+  ParallelUses[&U] = nextParallelRunStep();
+}
+
+void LLVMContextImpl::addParallelGlobal(GlobalValue *GV, bool Appended) {
+  ParallelGlobal &PG = ParallelGlobals[GV];
+  PG.GV = GV;
+  PG.Step = nextParallelRunStep();
+  PG.Appended = Appended;
+  // Which local names are taken depends on the order the globals are named
+  // in, so they are named in serial order at the end of the run.
+  if (GV->hasLocalLinkage() && GV->hasName()) {
+    PG.Name = GV->getName();
+    GV->setName("");
+  }
+}
+
+void LLVMContextImpl::noteParallelLookup(Value *V) {
+  if (auto *GV = dyn_cast<GlobalValue>(V)) {
+    auto I = ParallelGlobals.find(GV);
+    if (I != ParallelGlobals.end() &&
+        I->second.Step.Function > ParallelRunFunction)
+      I->second.Step = nextParallelRunStep();
+    return;
+  }
+
+  // The operands of a constant are only used by it once it is created.  If a
+  // later function created it, take the uses over as if it was created now.
+  auto *C = dyn_cast<Constant>(V);
+  if (!C || !C->getNumOperands())
+    return;
+  auto I = ParallelUses.find(&C->getOperandUse(0));
+  if (I == ParallelUses.end() || I->second.Function <= ParallelRunFunction)
+    return;
+  for (const Use &U : C->operands())
+    ParallelUses[&U] = nextParallelRunStep();
+}
+
+void LLVMContextImpl::finishParallelRun() {
+  assert(Multithreaded && "Function passes do not run in parallel!");
+  --Value::NumParallelContexts;
+  Multithreaded = false;
+
+  // A serial run appends the globals to their module as it creates them.
+  std::vector<ParallelGlobal *> Globals;
+  for (auto &Entry : ParallelGlobals)
+    if (Entry.second.GV)
+      Globals.push_back(&Entry.second);
+  std::sort(Globals.begin(), Globals.end(),
+            [](const ParallelGlobal *L, const ParallelGlobal *R) {
+              return isBefore(L->Step, R->Step);
+            });
+  for (ParallelGlobal *PG : Globals) {
+    auto *GV = cast<GlobalValue>(PG->GV);
+    Module *M = GV->getParent();
+    if (M && PG->Appended) {
+      if (auto *F = dyn_cast<Function>(GV))
+        M->getFunctionList().splice(M->end(), M->getFunctionList(),
+                                    Module::iterator(F));
+      else if (auto *Var = dyn_cast<GlobalVariable>(GV))
+        M->getGlobalList().splice(M->global_end(), M->getGlobalList(),
+                                  Module::global_iterator(Var));
+    }
+    if (!PG->Name.empty())
+      GV->setName(PG->Name);
+  }
+  ParallelGlobals.clear();
+
+  // A serial run adds each use to the front of the use list, so the uses
+  // added at later steps come first, followed by the uses that were there
+  // before the run in their original order.
+  SmallPtrSet<Value *, 32> Values;
+  for (auto &Entry : ParallelUses)
+    Values.insert(Entry.first->get());
+  auto getStep = [&](const Use &U) -> const ParallelRunStep * {
+    auto I = ParallelUses.find(&U);
+    return I == ParallelUses.end() ? nullptr : &I->second;
+  };
+  for (Value *V : Values)
+    V->sortUseList([&](const Use &L, const Use &R) {
+      const ParallelRunStep *LS = getStep(L), *RS = getStep(R);
+      return LS && (!RS || isBefore(*RS, *LS));
+    });
+  ParallelUses.clear();
+}
+
 namespace llvm {
 /// \brief Make MDOperand transparent for hashing.
 ///
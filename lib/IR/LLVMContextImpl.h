@@ -32,6 +32,7 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Metadata.h"
 #include "llvm/IR/ValueHandle.h"
+#include "llvm/Support/Mutex.h"
 #include <vector>
 
 namespace llvm {
@@ -983,6 +984,62 @@ public:
   typedef DenseMap<const Function *, ReturnInst *> PrologueDataMapTy;
   PrologueDataMapTy PrologueDataMap;
 
+  /// Multithreaded - Set while function passes run concurrently on this
+  /// context.  The uniquing tables, value names, value handles, metadata
+  /// attachments and the use lists of constants are then guarded by
+  /// ContextLock; see ContextLockGuard.
+  bool Multithreaded;
+  sys::SmartMutex<true> ContextLock;
+
+  /// ParallelRunStep - A point of a serial run of function passes: the
+  /// position of the function being run, and the number of changes to shared
+  /// values that the passes made to it before.
+  struct ParallelRunStep {
+    unsigned Function;
+    unsigned Change;
+  };
+
+  /// The uses of shared values added while Multithreaded, with the step of
+  /// the serial run that would have added them.
+  DenseMap<const Use *, ParallelRunStep> ParallelUses;
+
+  /// The globals created while Multithreaded, with the step of the serial run
+  /// that would have created them and the name of the local ones, which are
+  /// only named at the end of the run.
+  struct ParallelGlobal {
+    WeakVH GV;
+    ParallelRunStep Step;
+    std::string Name;
+    bool Appended;
+  };
+  DenseMap<const GlobalValue *, ParallelGlobal> ParallelGlobals;
+
+  /// Start running function passes on several threads.
+  void startParallelRun();
+
+  /// Stop running function passes on several threads, and give the use lists
+  /// and globals they changed the order that running them on one function at
+  /// a time, in the order of the positions given to setParallelRunFunction,
+  /// would have given.
+  void finishParallelRun();
+
+  /// Set the position of the function that the passes of the calling thread
+  /// now run on.
+  static void setParallelRunFunction(unsigned Position);
+
+  /// Record the uses of shared values added and removed while Multithreaded.
+  void addParallelUse(const Use &U);
+  void removeParallelUse(const Use &U) { ParallelUses.erase(&U); }
+
+  /// Record that the global GV is about to be added to its module while
+  /// Multithreaded.  Local globals lose their name until the end of the run.
+  void addParallelGlobal(GlobalValue *GV, bool Appended);
+
+  /// Record that V was found in a uniquing table or symbol table while
+  /// Multithreaded, so a serial run would have created it at this step if no
+  /// earlier function did.
+  void noteParallelLookup(Value *V);
+
   int getOrAddScopeRecordIdxEntry(MDNode *N, int ExistingIdx);
   int getOrAddScopeInlinedAtIdxEntry(MDNode *Scope, MDNode *IA,int ExistingIdx);
 
@@ -993,6 +1050,31 @@ public:
   void dropTriviallyDeadConstantArrays();
 };
 
+/// ContextLockGuard - Hold the ContextLock of a context for the lifetime of
+/// the guard if the context is multithreaded, and do nothing otherwise.  The
+/// lock is recursive, so guarded operations may call each other freely.
+class ContextLockGuard {
+  sys::SmartMutex<true> *Lock;
+
+  ContextLockGuard(const ContextLockGuard &) = delete;
+  void operator=(const ContextLockGuard &) = delete;
+
+public:
+  explicit ContextLockGuard(LLVMContextImpl *Impl)
+      : Lock(LLVM_UNLIKELY(Impl->Multithreaded) ? &Impl->ContextLock
+                                                 : nullptr) {
+    if (Lock)
+      Lock->lock();
+  }
+  explicit ContextLockGuard(LLVMContext &Context)
+      : ContextLockGuard(Context.pImpl) {}
+
+  ~ContextLockGuard() {
+    if (Lock)
+      Lock->unlock();
+  }
+};
+
 }
 
 #endif
@@ -12,6 +12,8 @@
 //===----------------------------------------------------------------------===//
 
 
+#include "LLVMContextImpl.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/IRPrintingPasses.h"
 #include "llvm/IR/LegacyPassManager.h"
@@ -23,14 +25,21 @@
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/Mutex.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/TimeValue.h"
 #include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
+#include <atomic>
 #include <map>
 using namespace llvm;
 using namespace llvm::legacy;
 
+#define DEBUG_TYPE "parallel-function-passes"
+
+STATISTIC(NumParallelFunctions,
+          "Number of functions run through function passes in parallel");
+
 // See PassManagers.h for Pass Manager infrastructure overview.
 
 //===----------------------------------------------------------------------===//
@@ -83,6 +92,13 @@ PrintAfterAll("print-after-all",
               llvm::cl::desc("Print IR after each pass"),
               cl::init(false));
 
+// Run function pass pipelines over several functions at a time. Only passes
+// that declare themselves parallel safe are run this way.
+static cl::opt<unsigned>
+ParallelFunctionPasses("parallel-function-passes", cl::Hidden, cl::init(0),
+                       cl::desc("Run function passes on this many threads "
+                                "(0 runs them serially)"));
+
 /// This is a helper to determine whether to print IR before or
 /// after a pass.
 
@@ -245,6 +261,10 @@ public:
   /// whether any of the passes modifies the module, and if so, return true.
   bool run(Function &F);
 
+  /// runOnFunctions - Execute all of the passes scheduled for execution on
+  /// every function of M.
+  bool runOnFunctions(Module &M);
+
   /// doInitialization - Run all of the initializers for the function passes.
   ///
   bool doInitialization(Module &M) override;
@@ -580,6 +600,14 @@ AnalysisUsage *PMTopLevelManager::findAnalysisUsage(Pass *P) {
   return AnUsage;
 }
 
+void PMTopLevelManager::forgetAnalysisUsage(Pass *P) {
+  DenseMap<Pass *, AnalysisUsage *>::iterator DMI = AnUsageMap.find(P);
+  if (DMI == AnUsageMap.end())
+    return;
+  delete DMI->second;
+  AnUsageMap.erase(DMI);
+}
+
 /// Schedule pass P for execution. Make sure that passes required by
 /// P are run before P is run. Update analysis info maintained by
 /// the manager. Remove dead passes. This is a recursive function.
@@ -1105,8 +1133,12 @@ Pass *PMDataManager::findAnalysisPass(AnalysisID AID, bool SearchParent) {
     return I->second;
 
   // Search Parents through TopLevelManager
-  if (SearchParent)
-    return TPM->findAnalysisPass(AID);
+  if (SearchParent) {
+    Pass *P = TPM->findAnalysisPass(AID);
+    if (P && VisibleParentAnalyses && !VisibleParentAnalyses->count(P))
+      return nullptr;
+    return P;
+  }
 
   return nullptr;
 }
@@ -1401,6 +1433,12 @@ bool FunctionPassManager::run(Function &F) {
   return FPM->run(F);
 }
 
+bool FunctionPassManager::runOnFunctions() {
+  if (std::error_code EC = M->materializeAll())
+    report_fatal_error("Error reading bitcode file: " + EC.message());
+  return FPM->runOnFunctions(*M);
+}
+
 
 /// doInitialization - Run all of the initializers for the function passes.
 ///
@@ -1485,6 +1523,26 @@ bool FunctionPassManagerImpl::run(Function &F) {
   return Changed;
 }
 
+bool FunctionPassManagerImpl::runOnFunctions(Module &M) {
+  // Running each manager over the whole module only amounts to running them
+  // all on one function at a time if there is a single one.
+  if (getNumContainedManagers() != 1) {
+    bool Changed = false;
+    for (Function &F : M)
+      Changed |= run(F);
+    return Changed;
+  }
+
+  TimingInfo::createTheTimeInfo();
+
+  initializeAllAnalysisInfo();
+  bool Changed = getContainedManager(0)->runOnModule(M);
+  getContainedManager(0)->cleanup();
+
+  wasRun = true;
+  return Changed;
+}
+
 //===----------------------------------------------------------------------===//
 // FPPassManager implementation
 
@@ -1543,14 +1601,245 @@ bool FPPassManager::runOnFunction(Function &F) {
 }
 
 bool FPPassManager::runOnModule(Module &M) {
-  bool Changed = false;
+  if (ParallelFunctionPasses && canRunInParallel())
+    return runOnModuleInParallel(M);
 
+  bool Changed = false;
   for (Function &F : M)
     Changed |= runOnFunction(F);
 
   return Changed;
 }
 
+namespace {
+/// FPPassReplica - A private copy of the passes of a function pass manager,
+/// used by one thread under -parallel-function-passes.  The copies are created
+/// through the pass registry and do their own analysis bookkeeping, so the
+/// original manager is left untouched while the copies run.
+class FPPassReplica : public FPPassManager {
+  FPPassManager &Original;
+  Module &M;
+
+  // The passes whose last user is the pass at the same index.
+  SmallVector<SmallVector<Pass *, 4>, 16> LastUses;
+
+public:
+  FPPassReplica(FPPassManager &Original, Module &M,
+                const SmallPtrSetImpl<Pass *> &VisibleAnalyses)
+      : Original(Original), M(M) {
+    setTopLevelManager(Original.getTopLevelManager());
+    setDepth(Original.getDepth());
+    VisibleParentAnalyses = &VisibleAnalyses;
+  }
+
+  ~FPPassReplica() override {
+    // Only the original passes are finalized.
+    for (unsigned Index = 0; Index < getNumContainedPasses(); ++Index)
+      TPM->forgetAnalysisUsage(getContainedPass(Index));
+  }
+
+  /// Copy the passes of the original manager.  Return false if some copy
+  /// does not use analyses the way the original does.
+  bool initialize();
+
+  /// Run the copied passes over F.
+  bool run(Function &F);
+};
+}
+
+static bool isSameAnalysisUsage(const AnalysisUsage &LHS,
+                                const AnalysisUsage &RHS) {
+  return LHS.getPreservesAll() == RHS.getPreservesAll() &&
+         LHS.getRequiredSet() == RHS.getRequiredSet() &&
+         LHS.getRequiredTransitiveSet() == RHS.getRequiredTransitiveSet() &&
+         LHS.getPreservedSet() == RHS.getPreservedSet() &&
+         LHS.getUsedSet() == RHS.getUsedSet();
+}
+
+bool FPPassReplica::initialize() {
+  DenseMap<Pass *, Pass *> Copies;
+  for (unsigned Index = 0; Index < Original.getNumContainedPasses(); ++Index) {
+    FunctionPass *FP = Original.getContainedPass(Index);
+    Pass *P = TPM->findAnalysisPassInfo(FP->getPassID())->createPass();
+    add(P, false);
+    P->doInitialization(M);
+    // Everything the copies look up in the top level manager while running
+    // is computed here, so the threads only read from it.
+    if (!isSameAnalysisUsage(*TPM->findAnalysisUsage(P),
+                             *TPM->findAnalysisUsage(FP)))
+      return false;
+    Copies[FP] = P;
+  }
+
+  for (unsigned Index = 0; Index < Original.getNumContainedPasses(); ++Index) {
+    SmallVector<Pass *, 12> DeadPasses;
+    TPM->collectLastUses(DeadPasses, Original.getContainedPass(Index));
+    LastUses.emplace_back();
+    for (Pass *Dead : DeadPasses)
+      if (Pass *Copy = Copies.lookup(Dead))
+        LastUses.back().push_back(Copy);
+  }
+  return true;
+}
+
+bool FPPassReplica::run(Function &F) {
+  bool Changed = false;
+
+  for (unsigned Index = 0; Index < getNumContainedPasses(); ++Index) {
+    FunctionPass *FP = getContainedPass(Index);
+
+    initializeAnalysisImpl(FP);
+
+    {
+      PassManagerPrettyStackEntry X(FP, F);
+      Changed |= FP->runOnFunction(F);
+    }
+
+#ifndef NDEBUG
+    // Only verify the analyses of this copy; the shared ones may be in use by
+    // other threads.
+    const AnalysisUsage::VectorType &PreservedSet =
+        TPM->findAnalysisUsage(FP)->getPreservedSet();
+    for (AnalysisID AID : PreservedSet)
+      if (Pass *AP = findAnalysisPass(AID, false))
+        AP->verifyAnalysis();
+#endif
+
+    removeNotPreservedAnalysis(FP);
+    recordAvailableAnalysis(FP);
+    for (Pass *Dead : LastUses[Index])
+      freePass(Dead, F.getName(), ON_FUNCTION_MSG);
+  }
+  return Changed;
+}
+
+bool FPPassManager::canRunInParallel() {
+  if (PassDebugging >= Executions || TimePassesIsEnabled) {
+    DEBUG(dbgs() << "Running function passes serially: they are timed or "
+                    "traced\n");
+    return false;
+  }
+
+  // Every pass must be parallel safe and re-creatable from the registry.
+  for (Pass *P : PassVector) {
+    const PassInfo *PI = TPM->findAnalysisPassInfo(P->getPassID());
+    if (!P->isParallelSafe() || P->getAsPMDataManager() || !PI ||
+        !PI->getNormalCtor()) {
+      DEBUG(dbgs() << "Running function passes serially: '"
+                   << P->getPassName() << "' is not parallel safe\n");
+      return false;
+    }
+  }
+  return true;
+}
+
+bool FPPassManager::runOnModuleInParallel(Module &M) {
+  SmallVector<Function *, 64> Functions;
+  for (Function &F : M)
+    if (!F.isDeclaration())
+      Functions.push_back(&F);
+  if (Functions.empty())
+    return false;
+
+  // The analyses of the enclosing managers that some pass here does not
+  // preserve are only seen by the passes that run before it on the first
+  // function.  Run that one serially, so the analyses left are the same for
+  // all the others.
+  bool Changed = runOnFunction(*Functions.front());
+  ArrayRef<Function *> Rest = makeArrayRef(Functions).slice(1);
+  auto RunSerially = [&] {
+    for (Function *F : Rest)
+      Changed |= runOnFunction(*F);
+    return Changed;
+  };
+  if (Rest.empty())
+    return Changed;
+
+  // The analyses of the enclosing managers that the passes use are shared by
+  // the threads, so they must all be parallel safe.  The others are hidden
+  // from the copies, since passes only query the analyses they declare.
+  SmallPtrSet<Pass *, 16> Own(PassVector.begin(), PassVector.end());
+  SmallPtrSet<AnalysisID, 16> Computed;
+  SmallPtrSet<Pass *, 16> VisibleAnalyses;
+  for (Pass *P : PassVector) {
+    AnalysisUsage *AnUsage = TPM->findAnalysisUsage(P);
+    for (const AnalysisUsage::VectorType *IDs :
+         {&AnUsage->getRequiredSet(), &AnUsage->getRequiredTransitiveSet(),
+          &AnUsage->getUsedSet()})
+      for (AnalysisID AID : *IDs) {
+        Pass *AP = TPM->findAnalysisPass(AID);
+        if (Computed.count(AID) || !AP || Own.count(AP))
+          continue;
+        if (!AP->isParallelSafe()) {
+          DEBUG(dbgs() << "Running function passes serially: '"
+                       << P->getPassName() << "' uses '" << AP->getPassName()
+                       << "', which is not parallel safe\n");
+          return RunSerially();
+        }
+        VisibleAnalyses.insert(AP);
+      }
+
+    Computed.insert(P->getPassID());
+    const PassInfo *PI = TPM->findAnalysisPassInfo(P->getPassID());
+    for (const PassInfo *II : PI->getInterfacesImplemented())
+      Computed.insert(II->getTypeInfo());
+  }
+
+  // Deleting a block whose address is taken changes the users of its
+  // blockaddress, which may be in other functions.
+  for (Function *F : Rest)
+    for (BasicBlock &BB : *F)
+      if (BB.hasAddressTaken()) {
+        DEBUG(dbgs() << "Running function passes serially: the address of a "
+                        "block of '" << F->getName() << "' is taken\n");
+        return RunSerially();
+      }
+
+  unsigned NumThreads =
+      std::min<unsigned>(ParallelFunctionPasses, Rest.size());
+  std::vector<std::unique_ptr<FPPassReplica>> Replicas;
+  for (unsigned I = 0; I != NumThreads; ++I) {
+    Replicas.emplace_back(new FPPassReplica(*this, M, VisibleAnalyses));
+    if (!Replicas.back()->initialize()) {
+      DEBUG(dbgs() << "Running function passes serially: their copies do "
+                      "not use the same analyses\n");
+      return RunSerially();
+    }
+  }
+
+  DEBUG(dbgs() << "Running function passes on " << Rest.size()
+               << " functions on " << NumThreads << " threads\n");
+
+  // Hand out the functions one at a time, in module order.  The context
+  // records where each change to a shared value falls in a serial run, and
+  // replays that order once the threads are done.
+  std::vector<char> FunctionChanged(Rest.size());
+  std::atomic<unsigned> NextFunction(0);
+  LLVMContextImpl *Impl = M.getContext().pImpl;
+  Impl->startParallelRun();
+  {
+    ThreadPool Pool(NumThreads);
+    for (std::unique_ptr<FPPassReplica> &Replica : Replicas) {
+      FPPassReplica *R = Replica.get();
+      Pool.async([&, R] {
+        for (unsigned I = NextFunction++; I < Rest.size();
+             I = NextFunction++) {
+          LLVMContextImpl::setParallelRunFunction(I);
+          FunctionChanged[I] = R->run(*Rest[I]);
+        }
+      });
+    }
+    Pool.wait();
+  }
+  Impl->finishParallelRun();
+  Replicas.clear();
+
+  NumParallelFunctions += Rest.size();
+  for (char FC : FunctionChanged)
+    Changed |= FC;
+  return Changed;
+}
+
 bool FPPassManager::doInitialization(Module &M) {
   bool Changed = false;
 
@@ -35,6 +35,7 @@ MetadataAsValue::MetadataAsValue(Type *Ty, Metadata *MD)
 }
 
 MetadataAsValue::~MetadataAsValue() {
+  ContextLockGuard Lock(getContext());
   getType()->getContext().pImpl->MetadataAsValues.erase(MD);
   untrack();
 }
@@ -74,6 +75,7 @@ static Metadata *canonicalizeMetadataForValue(LLVMContext &Context,
 
 MetadataAsValue *MetadataAsValue::get(LLVMContext &Context, Metadata *MD) {
   MD = canonicalizeMetadataForValue(Context, MD);
+  ContextLockGuard Lock(Context);
   auto *&Entry = Context.pImpl->MetadataAsValues[MD];
   if (!Entry)
     Entry = new MetadataAsValue(Type::getMetadataTy(Context), MD);
@@ -83,6 +85,7 @@ MetadataAsValue *MetadataAsValue::get(LLVMContext &Context, Metadata *MD) {
 MetadataAsValue *MetadataAsValue::getIfExists(LLVMContext &Context,
                                               Metadata *MD) {
   MD = canonicalizeMetadataForValue(Context, MD);
+  ContextLockGuard Lock(Context);
   auto &Store = Context.pImpl->MetadataAsValues;
   return Store.lookup(MD);
 }
@@ -90,6 +93,7 @@ MetadataAsValue *MetadataAsValue::getIfExists(LLVMContext &Context,
 void MetadataAsValue::handleChangedMetadata(Metadata *MD) {
   LLVMContext &Context = getContext();
   MD = canonicalizeMetadataForValue(Context, MD);
+  ContextLockGuard Lock(Context);
   auto &Store = Context.pImpl->MetadataAsValues;
 
   // Stop tracking the old metadata.
@@ -121,6 +125,7 @@ void MetadataAsValue::untrack() {
 }
 
 void ReplaceableMetadataImpl::addRef(void *Ref, OwnerTy Owner) {
+  ContextLockGuard Lock(Context);
   bool WasInserted =
       UseMap.insert(std::make_pair(Ref, std::make_pair(Owner, NextIndex)))
           .second;
@@ -132,6 +137,7 @@ void ReplaceableMetadataImpl::addRef(void *Ref, OwnerTy Owner) {
 }
 
 void ReplaceableMetadataImpl::dropRef(void *Ref) {
+  ContextLockGuard Lock(Context);
   bool WasErased = UseMap.erase(Ref);
   (void)WasErased;
   assert(WasErased && "Expected to drop a reference");
@@ -139,6 +145,7 @@ void ReplaceableMetadataImpl::dropRef(void *Ref) {
 
 void ReplaceableMetadataImpl::moveRef(void *Ref, void *New,
                                       const Metadata &MD) {
+  ContextLockGuard Lock(Context);
   auto I = UseMap.find(Ref);
   assert(I != UseMap.end() && "Expected to move a reference");
   auto OwnerAndIndex = I->second;
@@ -159,6 +166,7 @@ void ReplaceableMetadataImpl::replaceAllUsesWith(Metadata *MD) {
   assert(!(MD && isa<MDNode>(MD) && cast<MDNode>(MD)->isTemporary()) &&
          "Expected non-temp node");
 
+  ContextLockGuard Lock(Context);
   if (UseMap.empty())
     return;
 
@@ -207,6 +215,7 @@ void ReplaceableMetadataImpl::replaceAllUsesWith(Metadata *MD) {
 }
 
 void ReplaceableMetadataImpl::resolveAllUses(bool ResolveUsers) {
+  ContextLockGuard Lock(Context);
   if (UseMap.empty())
     return;
 
@@ -252,6 +261,7 @@ ValueAsMetadata *ValueAsMetadata::get(Value *V) {
   assert(V && "Unexpected null Value");
 
   auto &Context = V->getContext();
+  ContextLockGuard Lock(Context);
   auto *&Entry = Context.pImpl->ValuesAsMetadata[V];
   if (!Entry) {
     assert((isa<Constant>(V) || isa<Argument>(V) || isa<Instruction>(V)) &&
@@ -270,12 +280,14 @@ ValueAsMetadata *ValueAsMetadata::get(Value *V) {
 
 ValueAsMetadata *ValueAsMetadata::getIfExists(Value *V) {
   assert(V && "Unexpected null Value");
+  ContextLockGuard Lock(V->getContext());
   return V->getContext().pImpl->ValuesAsMetadata.lookup(V);
 }
 
 void ValueAsMetadata::handleDeletion(Value *V) {
   assert(V && "Expected valid value");
 
+  ContextLockGuard Lock(V->getContext());
   auto &Store = V->getType()->getContext().pImpl->ValuesAsMetadata;
   auto I = Store.find(V);
   if (I == Store.end())
@@ -299,6 +311,7 @@ void ValueAsMetadata::handleRAUW(Value *From, Value *To) {
   assert(From->getType() == To->getType() && "Unexpected type change");
 
   LLVMContext &Context = From->getType()->getContext();
+  ContextLockGuard Lock(Context);
   auto &Store = Context.pImpl->ValuesAsMetadata;
   auto I = Store.find(From);
   if (I == Store.end()) {
@@ -358,6 +371,7 @@ void ValueAsMetadata::handleRAUW(Value *From, Value *To) {
 //
 
 MDString *MDString::get(LLVMContext &Context, StringRef Str) {
+  ContextLockGuard Lock(Context);
   auto &Store = Context.pImpl->MDStringCache;
   auto I = Store.find(Str);
   if (I != Store.end())
@@ -679,6 +693,7 @@ template <class NodeTy> struct MDNode::HasCachedHash {
 
 MDNode *MDNode::uniquify() {
   assert(!hasSelfReference(this) && "Cannot uniquify a self-referencing node");
+  ContextLockGuard Lock(getContext());
 
   // Try to insert into uniquing store.
   switch (getMetadataID()) {
@@ -697,6 +712,7 @@ MDNode *MDNode::uniquify() {
 }
 
 void MDNode::eraseFromStore() {
+  ContextLockGuard Lock(getContext());
   switch (getMetadataID()) {
   default:
     llvm_unreachable("Invalid or non-uniquable subclass of MDNode");
@@ -711,6 +727,7 @@ void MDNode::eraseFromStore() {
 MDTuple *MDTuple::getImpl(LLVMContext &Context, ArrayRef<Metadata *> MDs,
                           StorageType Storage, bool ShouldCreate) {
   unsigned Hash = 0;
+  ContextLockGuard Lock(Context);
   if (Storage == Uniqued) {
     MDTupleInfo::KeyTy Key(MDs);
     if (auto *N = getUniqued(Context.pImpl->MDTuples, Key))
@@ -749,6 +766,7 @@ void MDNode::storeDistinctInContext() {
 #include "llvm/IR/Metadata.def"
   }
 
+  ContextLockGuard Lock(getContext());
   getContext().pImpl->DistinctMDNodes.insert(this);
 }
 
@@ -1064,6 +1082,7 @@ void Instruction::dropUnknownNonDebugMetadata(ArrayRef<unsigned> KnownIDs) {
   if (!hasMetadataHashEntry())
     return; // Nothing to remove!
 
+  ContextLockGuard Lock(getContext());
   auto &InstructionMetadata = getContext().pImpl->InstructionMetadata;
 
   if (KnownSet.empty()) {
@@ -1097,7 +1116,8 @@ void Instruction::setMetadata(unsigned KindID, MDNode *Node) {
     DbgLoc = DebugLoc(Node);
     return;
   }
-  
+
+  ContextLockGuard Lock(getContext());
   // Handle the case when we're adding/updating metadata on an instruction.
   if (Node) {
     auto &Info = getContext().pImpl->InstructionMetadata[this];
@@ -1140,6 +1160,7 @@ MDNode *Instruction::getMetadataImpl(unsigned KindID) const {
 
   if (!hasMetadataHashEntry())
     return nullptr;
+  ContextLockGuard Lock(getContext());
   auto &Info = getContext().pImpl->InstructionMetadata[this];
   assert(!Info.empty() && "bit out of sync with hash table");
 
@@ -1157,6 +1178,7 @@ void Instruction::getAllMetadataImpl(
     if (!hasMetadataHashEntry()) return;
   }
 
+  ContextLockGuard Lock(getContext());
   assert(hasMetadataHashEntry() &&
          getContext().pImpl->InstructionMetadata.count(this) &&
          "Shouldn't have called this");
@@ -1168,6 +1190,7 @@ void Instruction::getAllMetadataImpl(
 void Instruction::getAllMetadataOtherThanDebugLocImpl(
     SmallVectorImpl<std::pair<unsigned, MDNode *>> &Result) const {
   Result.clear();
+  ContextLockGuard Lock(getContext());
   assert(hasMetadataHashEntry() &&
          getContext().pImpl->InstructionMetadata.count(this) &&
          "Shouldn't have called this");
@@ -1180,6 +1203,7 @@ void Instruction::getAllMetadataOtherThanDebugLocImpl(
 /// this instruction.
 void Instruction::clearMetadataHashEntries() {
   assert(hasMetadataHashEntry() && "Caller should check");
+  ContextLockGuard Lock(getContext());
   getContext().pImpl->InstructionMetadata.erase(this);
   setHasMetadataHashEntry(false);
 }
@@ -1187,6 +1211,7 @@ void Instruction::clearMetadataHashEntries() {
 MDNode *Function::getMetadata(unsigned KindID) const {
   if (!hasMetadata())
     return nullptr;
+  ContextLockGuard Lock(getContext());
   return getContext().pImpl->FunctionMetadata[this].lookup(KindID);
 }
 
@@ -1197,6 +1222,7 @@ MDNode *Function::getMetadata(StringRef Kind) const {
 }
 
 void Function::setMetadata(unsigned KindID, MDNode *MD) {
+  ContextLockGuard Lock(getContext());
   if (MD) {
     if (!hasMetadata())
       setHasMetadataHashEntry(true);
@@ -1228,6 +1254,7 @@ void Function::getAllMetadata(
   if (!hasMetadata())
     return;
 
+  ContextLockGuard Lock(getContext());
   getContext().pImpl->FunctionMetadata[this].getAll(MDs);
 }
 
@@ -1242,6 +1269,7 @@ void Function::dropUnknownMetadata(ArrayRef<unsigned> KnownIDs) {
   SmallSet<unsigned, 5> KnownSet;
   KnownSet.insert(KnownIDs.begin(), KnownIDs.end());
 
+  ContextLockGuard Lock(getContext());
   auto &Store = getContext().pImpl->FunctionMetadata[this];
   assert(!Store.empty());
 
@@ -1256,6 +1284,7 @@ void Function::dropUnknownMetadata(ArrayRef<unsigned> KnownIDs) {
 void Function::clearMetadata() {
   if (!hasMetadata())
     return;
+  ContextLockGuard Lock(getContext());
   getContext().pImpl->FunctionMetadata.erase(this);
   setHasMetadataHashEntry(false);
 }
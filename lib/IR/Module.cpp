@@ -12,6 +12,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/IR/Module.h"
+#include "LLVMContextImpl.h"
 #include "SymbolTableListTraitsImpl.h"
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/STLExtras.h"
@@ -86,7 +87,12 @@ RandomNumberGenerator *Module::createRNG(const Pass* P) const {
 /// the specified name, of arbitrary type.  This method returns null
 /// if a global with the specified name is not found.
 GlobalValue *Module::getNamedValue(StringRef Name) const {
-  return cast_or_null<GlobalValue>(getValueSymbolTable().lookup(Name));
+  ContextLockGuard Lock(Context);
+  GlobalValue *GV =
+      cast_or_null<GlobalValue>(getValueSymbolTable().lookup(Name));
+  if (GV && LLVM_UNLIKELY(Context.pImpl->Multithreaded))
+    Context.pImpl->noteParallelLookup(GV);
+  return GV;
 }
 
 /// getMDKindID - Return a unique non-zero ID for the specified metadata kind.
@@ -115,6 +121,8 @@ void Module::getMDKindNames(SmallVectorImpl<StringRef> &Result) const {
 Constant *Module::getOrInsertFunction(StringRef Name,
                                       FunctionType *Ty,
                                       AttributeSet AttributeList) {
+  ContextLockGuard Lock(Context);
+
   // See if we have a definition for the specified function already.
   GlobalValue *F = getNamedValue(Name);
   if (!F) {
@@ -122,6 +130,8 @@ Constant *Module::getOrInsertFunction(StringRef Name,
     Function *New = Function::Create(Ty, GlobalVariable::ExternalLinkage, Name);
     if (!New->isIntrinsic())       // Intrinsics get attrs set on construction
       New->setAttributes(AttributeList);
+    if (LLVM_UNLIKELY(Context.pImpl->Multithreaded))
+      Context.pImpl->addParallelGlobal(New, true);
     FunctionList.push_back(New);
     return New;                    // Return the new prototype.
   }
@@ -215,6 +225,8 @@ GlobalVariable *Module::getGlobalVariable(StringRef Name, bool AllowLocal) {
 ///   3. Finally, if the existing global is the correct declaration, return the
 ///      existing global.
 Constant *Module::getOrInsertGlobal(StringRef Name, Type *Ty) {
+  ContextLockGuard Lock(Context);
+
   // See if we have a definition for the specified global already.
   GlobalVariable *GV = dyn_cast_or_null<GlobalVariable>(getNamedValue(Name));
   if (!GV) {
@@ -394,6 +406,14 @@ std::error_code Module::materialize(GlobalValue *GV) {
   return Materializer->materialize(GV);
 }
 
+std::error_code Module::materializeFunctions(ArrayRef<Function *> Fns,
+                                             ThreadPool *Pool) {
+  if (!Materializer)
+    return std::error_code();
+
+  return Materializer->materializeFunctions(Fns, Pool);
+}
+
 void Module::dematerialize(GlobalValue *GV) {
   if (Materializer)
     return Materializer->dematerialize(GV);
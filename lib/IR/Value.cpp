@@ -135,6 +135,24 @@ unsigned Value::getNumUses() const {
   return (unsigned)std::distance(use_begin(), use_end());
 }
 
+std::atomic<unsigned> Value::NumParallelContexts(0);
+
+void Value::addSharedUse(Use &U) {
+  LLVMContextImpl *pImpl = getContext().pImpl;
+  ContextLockGuard Lock(pImpl);
+  U.addToList(&UseList);
+  if (pImpl->Multithreaded)
+    pImpl->addParallelUse(U);
+}
+
+void Value::removeSharedUse(Use &U) {
+  LLVMContextImpl *pImpl = getContext().pImpl;
+  ContextLockGuard Lock(pImpl);
+  U.removeFromList();
+  if (pImpl->Multithreaded)
+    pImpl->removeParallelUse(U);
+}
+
 static bool getSymTab(Value *V, ValueSymbolTable *&ST) {
   ST = nullptr;
   if (Instruction *I = dyn_cast<Instruction>(V)) {
@@ -161,6 +179,7 @@ ValueName *Value::getValueName() const {
   if (!HasName) return nullptr;
 
   LLVMContext &Ctx = getContext();
+  ContextLockGuard Lock(Ctx);
   auto I = Ctx.pImpl->ValueNames.find(this);
   assert(I != Ctx.pImpl->ValueNames.end() &&
          "No name entry found!");
@@ -170,6 +189,7 @@ ValueName *Value::getValueName() const {
 
 void Value::setValueName(ValueName *VN) {
   LLVMContext &Ctx = getContext();
+  ContextLockGuard Lock(Ctx);
 
   assert(HasName == Ctx.pImpl->ValueNames.count(this) &&
          "HasName bit out of sync!");
@@ -556,6 +576,7 @@ void ValueHandleBase::AddToExistingUseList(ValueHandleBase **List) {
 
 void ValueHandleBase::AddToExistingUseListAfter(ValueHandleBase *List) {
   assert(List && "Must insert after existing node");
+  ContextLockGuard Lock(V->getContext());
 
   Next = List->Next;
   setPrevPtr(&List->Next);
@@ -568,6 +589,7 @@ void ValueHandleBase::AddToUseList() {
   assert(V && "Null pointer doesn't have a use list!");
 
   LLVMContextImpl *pImpl = V->getContext().pImpl;
+  ContextLockGuard Lock(pImpl);
 
   if (V->HasValueHandle) {
     // If this value already has a ValueHandle, then it must be in the
@@ -610,6 +632,8 @@ void ValueHandleBase::AddToUseList() {
 void ValueHandleBase::RemoveFromUseList() {
   assert(V && V->HasValueHandle &&
          "Pointer doesn't have a use list!");
+  LLVMContextImpl *pImpl = V->getContext().pImpl;
+  ContextLockGuard Lock(pImpl);
 
   // Unlink this from its use list.
   ValueHandleBase **PrevPtr = getPrevPtr();
@@ -625,7 +649,6 @@ void ValueHandleBase::RemoveFromUseList() {
   // If the Next pointer was null, then it is possible that this was the last
   // ValueHandle watching VP.  If so, delete its entry from the ValueHandles
   // map.
-  LLVMContextImpl *pImpl = V->getContext().pImpl;
   DenseMap<Value*, ValueHandleBase*> &Handles = pImpl->ValueHandles;
   if (Handles.isPointerIntoBucketsArray(PrevPtr)) {
     Handles.erase(V);
@@ -640,6 +663,7 @@ void ValueHandleBase::ValueIsDeleted(Value *V) {
   // Get the linked list base, which is guaranteed to exist since the
   // HasValueHandle flag is set.
   LLVMContextImpl *pImpl = V->getContext().pImpl;
+  ContextLockGuard Lock(pImpl);
   ValueHandleBase *Entry = pImpl->ValueHandles[V];
   assert(Entry && "Value bit set but no entries exist");
 
@@ -700,6 +724,7 @@ void ValueHandleBase::ValueIsRAUWd(Value *Old, Value *New) {
   // Get the linked list base, which is guaranteed to exist since the
   // HasValueHandle flag is set.
   LLVMContextImpl *pImpl = Old->getContext().pImpl;
+  ContextLockGuard Lock(pImpl);
   ValueHandleBase *Entry = pImpl->ValueHandles[Old];
 
   assert(Entry && "Value bit set but no entries exist");
@@ -254,6 +254,7 @@ public:
 
     // Now that we've visited every function, verify that we never asked to
     // recover a frame index that wasn't escaped.
+    collectFrameEscapeInfo(M);
     verifyFrameRecoverIndices();
 
     for (Module::const_global_iterator I = M.global_begin(), E = M.global_end();
@@ -412,6 +413,7 @@ private:
 
   void VerifyConstantExprBitcastType(const ConstantExpr *CE);
   void VerifyStatepoint(ImmutableCallSite CS);
+  void collectFrameEscapeInfo(const Module &M);
   void verifyFrameRecoverIndices();
 
   // Module-level debug info verification...
@@ -1656,6 +1658,33 @@ void Verifier::VerifyStatepoint(ImmutableCallSite CS) {
   // about.  See example statepoint.ll in the verifier subdirectory
 }
 
+/// Collect the FrameEscapeInfo of the functions that were verified by other
+/// instances, like the copies of the pass that run in parallel.
+void Verifier::collectFrameEscapeInfo(const Module &M) {
+  for (const Function &F : M) {
+    Intrinsic::ID ID = F.getIntrinsicID();
+    if (ID != Intrinsic::localescape && ID != Intrinsic::localrecover)
+      continue;
+    for (const User *U : F.users()) {
+      ImmutableCallSite CS(U);
+      if (!CS || CS.getCalledFunction() != &F)
+        continue;
+      if (ID == Intrinsic::localescape) {
+        Function *Parent = const_cast<Function *>(CS.getParent()->getParent());
+        FrameEscapeInfo[Parent].first = CS.getNumArgOperands();
+        continue;
+      }
+      auto *Fn = dyn_cast<Function>(CS.getArgOperand(0)->stripPointerCasts());
+      auto *IdxArg = dyn_cast<ConstantInt>(CS.getArgOperand(2));
+      if (!Fn || Fn->isDeclaration() || !IdxArg)
+        continue;
+      auto &Entry = FrameEscapeInfo[const_cast<Function *>(Fn)];
+      Entry.second = unsigned(
+          std::max(uint64_t(Entry.second), IdxArg->getLimitedValue(~0U) + 1));
+    }
+  }
+}
+
 void Verifier::verifyFrameRecoverIndices() {
   for (auto &Counts : FrameEscapeInfo) {
     Function *F = Counts.first;
@@ -3932,6 +3961,9 @@ struct VerifierLegacyPass : public FunctionPass {
   void getAnalysisUsage(AnalysisUsage &AU) const override {
     AU.setPreservesAll();
   }
+
+  // The copies made for a parallel run always abort on errors.
+  bool isParallelSafe() const override { return FatalErrors; }
 };
 }
 
@@ -33,6 +33,7 @@
 #include "llvm/IR/Verifier.h"
 #include "llvm/InitializePasses.h"
 #include "llvm/LTO/LTOModule.h"
+#include "llvm/LTO/LTOObjectCache.h"
 #include "llvm/Linker/Linker.h"
 #include "llvm/MC/MCAsmInfo.h"
 #include "llvm/MC/MCContext.h"
@@ -53,6 +54,7 @@
 #include "llvm/Transforms/IPO.h"
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
 #include "llvm/Transforms/ObjCARC.h"
+#include <algorithm>
 #include <system_error>
 using namespace llvm;
 
@@ -545,6 +547,65 @@ void LTOCodeGenerator::parseCodeGenDebugOptions() {
   }
 }
 
+bool LTOCodeGenerator::addToCacheKey(LTOCacheKey &Key) const {
+  // The reciprocal settings can only be compared, not enumerated.
+  if (!(Options.Reciprocals == TargetRecip()))
+    return false;
+
+  Key.add(getVersionString());
+  Key.add(MCpu);
+  Key.add(MAttr);
+  Key.add(RelocModel);
+  Key.add(OptLevel);
+  Key.add(CGOptLevel);
+  Key.add(EmitDwarfDebugInfo);
+  Key.add(ShouldInternalize);
+  Key.add(ShouldEmbedUselists);
+  for (const std::string &Option : CodegenOptions)
+    Key.add(Option);
+
+  // The same fields as operator==(TargetOptions, TargetOptions).
+  Key.add(Options.UnsafeFPMath);
+  Key.add(Options.NoInfsFPMath);
+  Key.add(Options.NoNaNsFPMath);
+  Key.add(Options.HonorSignDependentRoundingFPMathOption);
+  Key.add(Options.NoZerosInBSS);
+  Key.add(Options.GuaranteedTailCallOpt);
+  Key.add(Options.StackAlignmentOverride);
+  Key.add(Options.EnableFastISel);
+  Key.add(Options.PositionIndependentExecutable);
+  Key.add(Options.UseInitArray);
+  Key.add(Options.TrapUnreachable);
+  Key.add(Options.EmulatedTLS);
+  Key.add(Options.FloatABIType);
+  Key.add(Options.AllowFPOpFusion);
+  Key.add(Options.JTType);
+  Key.add(Options.ThreadModel);
+  const MCTargetOptions &MCOptions = Options.MCOptions;
+  Key.add(MCOptions.SanitizeAddress);
+  Key.add(MCOptions.MCRelaxAll);
+  Key.add(MCOptions.MCNoExecStack);
+  Key.add(MCOptions.MCFatalWarnings);
+  Key.add(MCOptions.MCNoWarn);
+  Key.add(MCOptions.MCSaveTempLabels);
+  Key.add(MCOptions.MCUseDwarfDirectory);
+  Key.add(MCOptions.ShowMCEncoding);
+  Key.add(MCOptions.ShowMCInst);
+  Key.add(MCOptions.AsmVerbose);
+  Key.add(MCOptions.DwarfVersion);
+  Key.add(MCOptions.ABIName);
+
+  // The preserved symbols, in a deterministic order.
+  std::vector<StringRef> Symbols;
+  for (const auto &Entry : MustPreserveSymbols)
+    Symbols.push_back(Entry.getKey());
+  std::sort(Symbols.begin(), Symbols.end());
+  Key.add(Symbols.size());
+  for (StringRef Symbol : Symbols)
+    Key.add(Symbol);
+  return true;
+}
+
 void LTOCodeGenerator::DiagnosticHandler(const DiagnosticInfo &DI,
                                          void *Context) {
   ((LTOCodeGenerator *)Context)->DiagnosticHandler2(DI);
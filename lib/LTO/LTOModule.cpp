@@ -93,8 +93,10 @@ bool LTOModule::isBitcodeForTarget(MemoryBuffer *Buffer,
 
 LTOModule *LTOModule::createFromFile(const char *path, TargetOptions options,
                                      std::string &errMsg) {
+  // Bitcode needs no null terminator, which lets the file be mapped and read
+  // in place.
   ErrorOr<std::unique_ptr<MemoryBuffer>> BufferOrErr =
-      MemoryBuffer::getFile(path);
+      MemoryBuffer::getFile(path, -1, /*RequiresNullTerminator=*/false);
   if (std::error_code EC = BufferOrErr.getError()) {
     errMsg = EC.message();
     return nullptr;
@@ -0,0 +1,100 @@
+//===-LTOObjectCache.cpp - On-disk cache of LTO object files --------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the LTOObjectCache class.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/LTO/LTOObjectCache.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/TimeValue.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "lto-cache"
+
+void LTOCacheKey::add(StringRef Data) {
+  add(Data.size());
+  Hasher.update(Data);
+}
+
+void LTOCacheKey::add(uint64_t Value) {
+  uint8_t Bytes[8];
+  support::endian::write64le(Bytes, Value);
+  Hasher.update(Bytes);
+}
+
+std::string LTOCacheKey::final() {
+  MD5::MD5Result Result;
+  Hasher.final(Result);
+  SmallString<32> Str;
+  MD5::stringifyResult(Result, Str);
+  return Str.str();
+}
+
+LTOObjectCache::LTOObjectCache(StringRef Directory)
+    : Directory(Directory), NumHits(0), NumMisses(0) {
+  sys::fs::create_directories(Directory);
+}
+
+std::string LTOObjectCache::getEntryPath(StringRef Key) const {
+  SmallString<128> Path(Directory);
+  sys::path::append(Path, "llvmcache-" + Key);
+  return Path.str();
+}
+
+std::unique_ptr<MemoryBuffer> LTOObjectCache::lookup(StringRef Key) {
+  std::string Path = getEntryPath(Key);
+  int FD;
+  if (sys::fs::openFileForRead(Path, FD)) {
+    ++NumMisses;
+    return nullptr;
+  }
+  ErrorOr<std::unique_ptr<MemoryBuffer>> BufferOrErr =
+      MemoryBuffer::getOpenFile(FD, Path, /*FileSize=*/-1,
+                                /*RequiresNullTerminator=*/false);
+  // Record the use for the least recently used pruning of CachePruning.
+  sys::fs::setLastModificationAndAccessTime(FD, sys::TimeValue::now());
+  sys::Process::SafelyCloseFileDescriptor(FD);
+  if (!BufferOrErr || (*BufferOrErr)->getBufferSize() == 0) {
+    ++NumMisses;
+    return nullptr;
+  }
+  DEBUG(dbgs() << "Cache hit for " << Path << "\n");
+  ++NumHits;
+  return std::move(*BufferOrErr);
+}
+
+void LTOObjectCache::insert(StringRef Key, StringRef Object) {
+  // Write to a temporary file first and rename it into place, so that a
+  // concurrent lookup never sees a partial entry.
+  SmallString<128> TempPath;
+  int FD;
+  if (sys::fs::createUniqueFile(Directory + "/tmp-%%%%%%%%.o", FD, TempPath))
+    return;
+  {
+    raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    OS << Object;
+    OS.close();
+    if (OS.has_error()) {
+      OS.clear_error();
+      sys::fs::remove(TempPath);
+      return;
+    }
+  }
+  if (sys::fs::rename(TempPath, getEntryPath(Key)))
+    sys::fs::remove(TempPath);
+}
@@ -28,17 +28,25 @@
 #include "llvm/MC/MCSymbolELF.h"
 #include "llvm/MC/MCValue.h"
 #include "llvm/MC/StringTableBuilder.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Compression.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ELF.h"
 #include "llvm/Support/Endian.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/ThreadPool.h"
 #include <vector>
 using namespace llvm;
 
 #undef  DEBUG_TYPE
 #define DEBUG_TYPE "reloc-info"
 
+static cl::opt<unsigned>
+EncodingThreads("elf-encoding-threads", cl::Hidden, cl::init(0),
+                cl::desc("Build the string table, encode relocations and "
+                         "compress debug sections on this many threads "
+                         "(0 does it serially)"));
+
 namespace {
 
 typedef DenseMap<const MCSectionELF *, uint32_t> SectionIndexMapTy;
@@ -121,6 +129,18 @@ class ELFObjectWriter : public MCObjectWriter {
     std::vector<const MCSectionELF *> SectionTable;
     unsigned addToSectionTable(const MCSectionELF *Sec);
 
+    /// The contents of a debug section that is compressed before the sections
+    /// are written out.
+    struct CompressedSectionData {
+      SmallVector<char, 128> Contents;
+      /// Whether Contents holds the compressed data with its header, rather
+      /// than the uncompressed data.
+      bool IsCompressed = false;
+    };
+
+    typedef DenseMap<const MCSectionELF *, CompressedSectionData>
+        CompressedSectionsTy;
+
     // TargetObjectWriter wrappers.
     bool is64Bit() const { return TargetObjectWriter->is64Bit(); }
     bool hasRelocationAddend() const {
@@ -155,11 +175,13 @@ class ELFObjectWriter : public MCObjectWriter {
         write32(W);
     }
 
-    template <typename T> void write(T Val) {
+    template <typename T> void write(T Val) { write(getStream(), Val); }
+
+    template <typename T> void write(raw_ostream &OS, T Val) {
       if (IsLittleEndian)
-        support::endian::Writer<support::little>(getStream()).write(Val);
+        support::endian::Writer<support::little>(OS).write(Val);
       else
-        support::endian::Writer<support::big>(getStream()).write(Val);
+        support::endian::Writer<support::big>(OS).write(Val);
     }
 
     void writeHeader(const MCAssembler &Asm);
@@ -189,10 +211,12 @@ class ELFObjectWriter : public MCObjectWriter {
     /// \param Asm - The assembler.
     /// \param SectionIndexMap - Maps a section to its index.
     /// \param RevGroupMap - Maps a signature symbol to the group section.
+    /// \param Pool - The pool to build the string table on, or null.
     void computeSymbolTable(MCAssembler &Asm, const MCAsmLayout &Layout,
                             const SectionIndexMapTy &SectionIndexMap,
                             const RevGroupMapTy &RevGroupMap,
-                            SectionOffsetsTy &SectionOffsets);
+                            SectionOffsetsTy &SectionOffsets,
+                            ThreadPool *Pool);
 
     MCSectionELF *createRelocationSection(MCContext &Ctx,
                                           const MCSectionELF &Sec);
@@ -206,15 +230,23 @@ class ELFObjectWriter : public MCObjectWriter {
                             const SectionIndexMapTy &SectionIndexMap,
                             const SectionOffsetsTy &SectionOffsets);
 
+    /// Compress the debug sections that should be on \p Pool. Without a pool
+    /// they are compressed one at a time by writeSectionData instead.
+    void compressSections(MCAssembler &Asm, const MCAsmLayout &Layout,
+                          ThreadPool *Pool,
+                          CompressedSectionsTy &CompressedSections);
+
     void writeSectionData(const MCAssembler &Asm, MCSection &Sec,
-                          const MCAsmLayout &Layout);
+                          const MCAsmLayout &Layout,
+                          const CompressedSectionsTy &CompressedSections);
 
     void WriteSecHdrEntry(uint32_t Name, uint32_t Type, uint64_t Flags,
                           uint64_t Address, uint64_t Offset, uint64_t Size,
                           uint32_t Link, uint32_t Info, uint64_t Alignment,
                           uint64_t EntrySize);
 
-    void writeRelocations(const MCAssembler &Asm, const MCSectionELF &Sec);
+    void writeRelocations(const MCAssembler &Asm, const MCSectionELF &Sec,
+                          raw_ostream &OS);
 
     bool isSymbolRefDifferenceFullyResolvedImpl(const MCAssembler &Asm,
                                                 const MCSymbol &SymA,
@@ -752,7 +784,7 @@ bool ELFObjectWriter::isInSymtab(const MCAsmLayout &Layout,
 void ELFObjectWriter::computeSymbolTable(
     MCAssembler &Asm, const MCAsmLayout &Layout,
     const SectionIndexMapTy &SectionIndexMap, const RevGroupMapTy &RevGroupMap,
-    SectionOffsetsTy &SectionOffsets) {
+    SectionOffsetsTy &SectionOffsets, ThreadPool *Pool) {
   MCContext &Ctx = Asm.getContext();
   SymbolTableWriter Writer(*this, is64Bit());
 
@@ -878,7 +910,7 @@ void ELFObjectWriter::computeSymbolTable(
   for (const std::string &Name : FileNames)
     StrTabBuilder.add(Name);
 
-  StrTabBuilder.finalize(StringTableBuilder::ELF);
+  StrTabBuilder.finalize(StringTableBuilder::ELF, Pool);
 
   for (const std::string &Name : FileNames)
     Writer.writeSymbol(StrTabBuilder.getOffset(Name),
@@ -977,16 +1009,71 @@ prependCompressionHeader(uint64_t Size,
   return true;
 }
 
-void ELFObjectWriter::writeSectionData(const MCAssembler &Asm, MCSection &Sec,
-                                       const MCAsmLayout &Layout) {
-  MCSectionELF &Section = static_cast<MCSectionELF &>(Sec);
-  StringRef SectionName = Section.getSectionName();
-
+/// Whether \p Section should be compressed when debug sections are.
+static bool isCompressibleSection(const MCSectionELF &Section) {
   // Compressing debug_frame requires handling alignment fragments which is
   // more work (possibly generalizing MCAssembler.cpp:writeFragment to allow
   // for writing to arbitrary buffers) for little benefit.
+  StringRef SectionName = Section.getSectionName();
+  return SectionName.startswith(".debug_") && SectionName != ".debug_frame";
+}
+
+void ELFObjectWriter::compressSections(
+    MCAssembler &Asm, const MCAsmLayout &Layout, ThreadPool *Pool,
+    CompressedSectionsTy &CompressedSections) {
+  if (!Pool || !Asm.getContext().getAsmInfo()->compressDebugSections())
+    return;
+
+  // Lay out the contents of every debug section first. This goes through the
+  // stream of the writer, so it cannot be done concurrently.
+  std::vector<CompressedSectionData *> Worklist;
+  for (MCSection &Sec : Asm) {
+    MCSectionELF &Section = static_cast<MCSectionELF &>(Sec);
+    if (!isCompressibleSection(Section))
+      continue;
+
+    CompressedSectionData &Data = CompressedSections[&Section];
+    raw_svector_ostream VecOS(Data.Contents);
+    raw_pwrite_stream &OldStream = getStream();
+    setStream(VecOS);
+    Asm.writeSectionData(&Section, Layout);
+    setStream(OldStream);
+    Worklist.push_back(&Data);
+  }
+
+  forEachIndex(Pool, Worklist.size(), [&](unsigned I) {
+    CompressedSectionData &Data = *Worklist[I];
+    SmallVector<char, 128> CompressedContents;
+    zlib::Status Success = zlib::compress(
+        StringRef(Data.Contents.data(), Data.Contents.size()),
+        CompressedContents);
+    if (Success != zlib::StatusOK)
+      return;
+    if (!prependCompressionHeader(Data.Contents.size(), CompressedContents))
+      return;
+    Data.Contents = std::move(CompressedContents);
+    Data.IsCompressed = true;
+  });
+}
+
+void ELFObjectWriter::writeSectionData(
+    const MCAssembler &Asm, MCSection &Sec, const MCAsmLayout &Layout,
+    const CompressedSectionsTy &CompressedSections) {
+  MCSectionELF &Section = static_cast<MCSectionELF &>(Sec);
+  StringRef SectionName = Section.getSectionName();
+
+  auto I = CompressedSections.find(&Section);
+  if (I != CompressedSections.end()) {
+    const CompressedSectionData &Data = I->second;
+    if (Data.IsCompressed)
+      Asm.getContext().renameELFSection(
+          &Section, (".z" + SectionName.drop_front(1)).str());
+    getStream() << Data.Contents;
+    return;
+  }
+
   if (!Asm.getContext().getAsmInfo()->compressDebugSections() ||
-      !SectionName.startswith(".debug_") || SectionName == ".debug_frame") {
+      !isCompressibleSection(Section)) {
     Asm.writeSectionData(&Section, Layout);
     return;
   }
@@ -1035,8 +1122,11 @@ void ELFObjectWriter::WriteSecHdrEntry(uint32_t Name, uint32_t Type,
 }
 
 void ELFObjectWriter::writeRelocations(const MCAssembler &Asm,
-                                       const MCSectionELF &Sec) {
-  std::vector<ELFRelocationEntry> &Relocs = Relocations[&Sec];
+                                       const MCSectionELF &Sec,
+                                       raw_ostream &OS) {
+  // The entry was created by createRelocationSection. Look it up without
+  // inserting, as the sections may be encoded concurrently.
+  std::vector<ELFRelocationEntry> &Relocs = Relocations.find(&Sec)->second;
 
   // Sort the relocation entries. Most targets just sort by Offset, but some
   // (e.g., MIPS) have additional constraints.
@@ -1047,30 +1137,30 @@ void ELFObjectWriter::writeRelocations(const MCAssembler &Asm,
     unsigned Index = Entry.Symbol ? Entry.Symbol->getIndex() : 0;
 
     if (is64Bit()) {
-      write(Entry.Offset);
+      write(OS, Entry.Offset);
       if (TargetObjectWriter->isN64()) {
-        write(uint32_t(Index));
+        write(OS, uint32_t(Index));
 
-        write(TargetObjectWriter->getRSsym(Entry.Type));
-        write(TargetObjectWriter->getRType3(Entry.Type));
-        write(TargetObjectWriter->getRType2(Entry.Type));
-        write(TargetObjectWriter->getRType(Entry.Type));
+        write(OS, TargetObjectWriter->getRSsym(Entry.Type));
+        write(OS, TargetObjectWriter->getRType3(Entry.Type));
+        write(OS, TargetObjectWriter->getRType2(Entry.Type));
+        write(OS, TargetObjectWriter->getRType(Entry.Type));
       } else {
         struct ELF::Elf64_Rela ERE64;
         ERE64.setSymbolAndType(Index, Entry.Type);
-        write(ERE64.r_info);
+        write(OS, ERE64.r_info);
       }
       if (hasRelocationAddend())
-        write(Entry.Addend);
+        write(OS, Entry.Addend);
     } else {
-      write(uint32_t(Entry.Offset));
+      write(OS, uint32_t(Entry.Offset));
 
       struct ELF::Elf32_Rela ERE32;
       ERE32.setSymbolAndType(Index, Entry.Type);
-      write(ERE32.r_info);
+      write(OS, ERE32.r_info);
 
       if (hasRelocationAddend())
-        write(uint32_t(Entry.Addend));
+        write(OS, uint32_t(Entry.Addend));
     }
   }
 }
@@ -1176,6 +1266,13 @@ void ELFObjectWriter::writeObject(MCAssembler &Asm,
   // Write out the ELF header ...
   writeHeader(Asm);
 
+  std::unique_ptr<ThreadPool> Pool;
+  if (EncodingThreads)
+    Pool.reset(new ThreadPool(EncodingThreads));
+
+  CompressedSectionsTy CompressedSections;
+  compressSections(Asm, Layout, Pool.get(), CompressedSections);
+
   // ... then the sections ...
   SectionOffsetsTy SectionOffsets;
   std::vector<MCSectionELF *> Groups;
@@ -1189,7 +1286,7 @@ void ELFObjectWriter::writeObject(MCAssembler &Asm,
     uint64_t SecStart = getStream().tell();
 
     const MCSymbolELF *SignatureSymbol = Section.getGroup();
-    writeSectionData(Asm, Section, Layout);
+    writeSectionData(Asm, Section, Layout, CompressedSections);
 
     uint64_t SecEnd = getStream().tell();
     SectionOffsets[&Section] = std::make_pair(SecStart, SecEnd);
@@ -1238,15 +1335,25 @@ void ELFObjectWriter::writeObject(MCAssembler &Asm,
   }
 
   // Compute symbol table information.
-  computeSymbolTable(Asm, Layout, SectionIndexMap, RevGroupMap, SectionOffsets);
-
-  for (MCSectionELF *RelSection : Relocations) {
+  computeSymbolTable(Asm, Layout, SectionIndexMap, RevGroupMap, SectionOffsets,
+                     Pool.get());
+
+  // The relocation entries only depend on the symbol table indices, so the
+  // sections can be encoded independently of each other.
+  std::vector<SmallString<0>> RelocationContents(Relocations.size());
+  forEachIndex(Pool.get(), Relocations.size(), [&](unsigned I) {
+    raw_svector_ostream OS(RelocationContents[I]);
+    writeRelocations(Asm, *Relocations[I]->getAssociatedSection(), OS);
+  });
+
+  for (unsigned I = 0, E = Relocations.size(); I != E; ++I) {
+    MCSectionELF *RelSection = Relocations[I];
     align(RelSection->getAlignment());
 
     // Remember the offset into the file for this section.
     uint64_t SecStart = getStream().tell();
 
-    writeRelocations(Asm, *RelSection->getAssociatedSection());
+    getStream() << RelocationContents[I];
 
     uint64_t SecEnd = getStream().tell();
     SectionOffsets[RelSection] = std::make_pair(SecStart, SecEnd);
@@ -53,6 +53,7 @@ STATISTIC(evaluateFixup, "Number of evaluated fixups");
 STATISTIC(FragmentLayouts, "Number of fragment layouts");
 STATISTIC(ObjectBytes, "Number of emitted object file bytes");
 STATISTIC(RelaxationSteps, "Number of assembler layout and relaxation steps");
+STATISTIC(RelaxationChecks, "Number of fragments checked for relaxation");
 STATISTIC(RelaxedInstructions, "Number of relaxed instructions");
 }
 }
@@ -877,9 +878,12 @@ void MCAssembler::layout(MCAsmLayout &Layout) {
       Frag.setLayoutOrder(FragmentIndex++);
   }
 
-  // Layout until everything fits.
-  while (layoutOnce(Layout))
-    continue;
+  // Layout until everything fits. The first iteration leaves every section at
+  // a fixed point of its own, so later ones only need to look at the fragments
+  // which refer to other sections.
+  bool CheckAll = true;
+  while (layoutOnce(Layout, CheckAll))
+    CheckAll = false;
 
   DEBUG_WITH_TYPE("mc-dump", {
       llvm::errs() << "assembler backend - post-relaxation\n--\n";
@@ -1047,58 +1051,220 @@ bool MCAssembler::relaxDwarfCallFrameFragment(MCAsmLayout &Layout,
   return OldSize != Data.size();
 }
 
-bool MCAssembler::layoutSectionOnce(MCAsmLayout &Layout, MCSection &Sec) {
-  // Holds the first fragment which needed relaxing during this layout. It will
-  // remain NULL if none were relaxed.
-  // When a fragment is relaxed, all the fragments following it should get
-  // invalidated because their offset is going to change.
-  MCFragment *FirstRelaxedFragment = nullptr;
-
-  // Attempt to relax all the fragments in the section.
-  for (MCSection::iterator I = Sec.begin(), IE = Sec.end(); I != IE; ++I) {
-    // Check if this is a fragment that needs relaxation.
-    bool RelaxedFrag = false;
-    switch(I->getKind()) {
+bool MCAssembler::relaxFragment(MCAsmLayout &Layout, MCFragment &F) {
+  switch(F.getKind()) {
+  default:
+    return false;
+  case MCFragment::FT_Relaxable:
+    assert(!getRelaxAll() &&
+           "Did not expect a MCRelaxableFragment in RelaxAll mode");
+    return relaxInstruction(Layout, cast<MCRelaxableFragment>(F));
+  case MCFragment::FT_Dwarf:
+    return relaxDwarfLineAddr(Layout, cast<MCDwarfLineAddrFragment>(F));
+  case MCFragment::FT_DwarfFrame:
+    return relaxDwarfCallFrameFragment(Layout,
+                                       cast<MCDwarfCallFrameFragment>(F));
+  case MCFragment::FT_LEB:
+    return relaxLEB(Layout, cast<MCLEBFragment>(F));
+  }
+}
+
+namespace {
+/// The offsets the encoding of a relaxable fragment depends on.
+struct RelaxationDeps {
+  MCFragment *F;
+
+  /// The fragments in the same section whose offsets feed into the values of
+  /// F.
+  SmallVector<const MCFragment *, 2> Refs;
+
+  /// The offsets of F and of the fragments in Refs when F was last checked.
+  SmallVector<uint64_t, 3> SeenOffsets;
+
+  /// Whether F refers to a variable, another section or a target specific
+  /// expression, which any layout change may affect.
+  bool NonLocal;
+
+  /// Whether F only depends on the distances between its own offset and the
+  /// offsets in Refs, rather than on their absolute values.
+  bool ShiftInvariant;
+
+  /// Whether F has to be checked in the next sweep.
+  bool Pending;
+
+  explicit RelaxationDeps(MCFragment *F)
+      : F(F), NonLocal(false), ShiftInvariant(true), Pending(false) {}
+};
+}
+
+static void collectExprDeps(const MCExpr &Expr, RelaxationDeps &Deps) {
+  switch (Expr.getKind()) {
+  case MCExpr::Constant:
+    return;
+  case MCExpr::Target:
+    Deps.NonLocal = true;
+    return;
+  case MCExpr::SymbolRef: {
+    const MCSymbol &Sym = cast<MCSymbolRefExpr>(Expr).getSymbol();
+    if (Sym.isVariable()) {
+      Deps.NonLocal = true;
+      return;
+    }
+    // Undefined and absolute symbols never move.
+    const MCFragment *Frag = Sym.getFragment();
+    if (!Frag)
+      return;
+    if (Frag->getParent() != Deps.F->getParent())
+      Deps.NonLocal = true;
+    else
+      Deps.Refs.push_back(Frag);
+    return;
+  }
+  case MCExpr::Unary:
+    collectExprDeps(*cast<MCUnaryExpr>(Expr).getSubExpr(), Deps);
+    return;
+  case MCExpr::Binary: {
+    const MCBinaryExpr &BE = cast<MCBinaryExpr>(Expr);
+    collectExprDeps(*BE.getLHS(), Deps);
+    collectExprDeps(*BE.getRHS(), Deps);
+    return;
+  }
+  }
+  llvm_unreachable("Invalid assembly expression kind!");
+}
+
+static void computeRelaxationDeps(const MCAssembler &Asm,
+                                  RelaxationDeps &Deps) {
+  Deps.Refs.clear();
+  Deps.NonLocal = false;
+  Deps.ShiftInvariant = true;
+
+  MCFragment &F = *Deps.F;
+  switch (F.getKind()) {
+  default:
+    llvm_unreachable("Fragment is not relaxable!");
+  case MCFragment::FT_Relaxable:
+    for (const MCFixup &Fixup : cast<MCRelaxableFragment>(F).getFixups()) {
+      // A PC-relative value only depends on the distance to its target,
+      // unless the PC is rounded down first.
+      unsigned Flags =
+          Asm.getBackend().getFixupKindInfo(Fixup.getKind()).Flags;
+      if (!(Flags & MCFixupKindInfo::FKF_IsPCRel) ||
+          (Flags & MCFixupKindInfo::FKF_IsAlignedDownTo32Bits))
+        Deps.ShiftInvariant = false;
+      collectExprDeps(*Fixup.getValue(), Deps);
+    }
+    break;
+  // The remaining fragments encode a difference between two labels.
+  case MCFragment::FT_Dwarf:
+    collectExprDeps(cast<MCDwarfLineAddrFragment>(F).getAddrDelta(), Deps);
+    break;
+  case MCFragment::FT_DwarfFrame:
+    collectExprDeps(cast<MCDwarfCallFrameFragment>(F).getAddrDelta(), Deps);
+    break;
+  case MCFragment::FT_LEB:
+    collectExprDeps(cast<MCLEBFragment>(F).getValue(), Deps);
+    break;
+  }
+}
+
+/// Remember the offsets the values of \p Deps are computed from.
+static void recordSeenOffsets(const MCAsmLayout &Layout,
+                              RelaxationDeps &Deps) {
+  Deps.SeenOffsets.clear();
+  Deps.SeenOffsets.push_back(Layout.getFragmentOffset(Deps.F));
+  for (const MCFragment *Ref : Deps.Refs)
+    Deps.SeenOffsets.push_back(Layout.getFragmentOffset(Ref));
+}
+
+/// Check whether any value \p Deps depends on may have changed since its
+/// offsets were recorded.
+static bool dependsOnMovedOffsets(const MCAsmLayout &Layout,
+                                  const RelaxationDeps &Deps) {
+  uint64_t Delta = Layout.getFragmentOffset(Deps.F) - Deps.SeenOffsets[0];
+  if (!Deps.ShiftInvariant && Delta != 0)
+    return true;
+  for (unsigned I = 0, E = Deps.Refs.size(); I != E; ++I)
+    if (Layout.getFragmentOffset(Deps.Refs[I]) - Deps.SeenOffsets[I + 1] !=
+        Delta)
+      return true;
+  return false;
+}
+
+bool MCAssembler::layoutSection(MCAsmLayout &Layout, MCSection &Sec,
+                                bool CheckAll) {
+  // Index the relaxable fragments by the offsets their values depend on.
+  std::vector<RelaxationDeps> Worklist;
+  bool AnyPending = false;
+  for (MCFragment &F : Sec) {
+    switch (F.getKind()) {
     default:
-      break;
+      continue;
     case MCFragment::FT_Relaxable:
-      assert(!getRelaxAll() &&
-             "Did not expect a MCRelaxableFragment in RelaxAll mode");
-      RelaxedFrag = relaxInstruction(Layout, *cast<MCRelaxableFragment>(I));
-      break;
     case MCFragment::FT_Dwarf:
-      RelaxedFrag = relaxDwarfLineAddr(Layout,
-                                       *cast<MCDwarfLineAddrFragment>(I));
-      break;
     case MCFragment::FT_DwarfFrame:
-      RelaxedFrag =
-        relaxDwarfCallFrameFragment(Layout,
-                                    *cast<MCDwarfCallFrameFragment>(I));
-      break;
     case MCFragment::FT_LEB:
-      RelaxedFrag = relaxLEB(Layout, *cast<MCLEBFragment>(I));
       break;
     }
-    if (RelaxedFrag && !FirstRelaxedFragment)
-      FirstRelaxedFragment = I;
-  }
-  if (FirstRelaxedFragment) {
-    Layout.invalidateFragmentsFrom(FirstRelaxedFragment);
-    return true;
+    Worklist.emplace_back(&F);
+    RelaxationDeps &Deps = Worklist.back();
+    computeRelaxationDeps(*this, Deps);
+    Deps.Pending = CheckAll || Deps.NonLocal;
+    AnyPending |= Deps.Pending;
   }
-  return false;
-}
+  if (!AnyPending)
+    return false;
 
-bool MCAssembler::layoutOnce(MCAsmLayout &Layout) {
-  ++stats::RelaxationSteps;
+  // The section settled in the previous pass, so the fragments that are not
+  // checked again have last seen its current offsets.
+  if (!CheckAll)
+    for (RelaxationDeps &Deps : Worklist)
+      if (!Deps.Pending)
+        recordSeenOffsets(Layout, Deps);
 
   bool WasRelaxed = false;
-  for (iterator it = begin(), ie = end(); it != ie; ++it) {
-    MCSection &Sec = *it;
-    while (layoutSectionOnce(Layout, Sec))
-      WasRelaxed = true;
+  while (AnyPending) {
+    ++stats::RelaxationSteps;
+
+    bool RelaxedInSweep = false;
+    for (RelaxationDeps &Deps : Worklist) {
+      if (!Deps.Pending)
+        continue;
+      Deps.Pending = false;
+      ++stats::RelaxationChecks;
+      recordSeenOffsets(Layout, Deps);
+      if (!relaxFragment(Layout, *Deps.F))
+        continue;
+
+      // The fragments following this one moved. Invalidate them right away so
+      // that the rest of the sweep sees their new offsets.
+      Layout.invalidateFragmentsFrom(Deps.F);
+
+      // The fragment has a new encoding, which may need further relaxation.
+      computeRelaxationDeps(*this, Deps);
+      Deps.Pending = true;
+      RelaxedInSweep = true;
+    }
+    if (!RelaxedInSweep)
+      break;
+    WasRelaxed = true;
+
+    // Only check again the fragments whose values depend on offsets that
+    // moved since they were checked.
+    AnyPending = false;
+    for (RelaxationDeps &Deps : Worklist) {
+      if (!Deps.Pending)
+        Deps.Pending = Deps.NonLocal || dependsOnMovedOffsets(Layout, Deps);
+      AnyPending |= Deps.Pending;
+    }
   }
+  return WasRelaxed;
+}
 
+bool MCAssembler::layoutOnce(MCAsmLayout &Layout, bool CheckAll) {
+  bool WasRelaxed = false;
+  for (MCSection &Sec : *this)
+    WasRelaxed |= layoutSection(Layout, Sec, CheckAll);
   return WasRelaxed;
 }
 
@@ -8,12 +8,18 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/MC/StringTableBuilder.h"
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/COFF.h"
 #include "llvm/Support/Endian.h"
+#include "llvm/Support/ThreadPool.h"
+#include <limits>
+#include <vector>
 
 using namespace llvm;
 
+typedef StringMapEntry<size_t> StringEntry;
+
 static bool compareBySuffix(StringRef a, StringRef b) {
   size_t sizeA = a.size();
   size_t sizeB = b.size();
@@ -27,14 +33,139 @@ static bool compareBySuffix(StringRef a, StringRef b) {
   return sizeA > sizeB;
 }
 
-void StringTableBuilder::finalize(Kind kind) {
-  SmallVector<StringRef, 8> Strings;
-  Strings.reserve(StringIndexMap.size());
+static bool compareEntriesBySuffix(const StringEntry *A, const StringEntry *B) {
+  return compareBySuffix(A->getKey(), B->getKey());
+}
+
+/// Append \p Strings, sorted by compareBySuffix, to \p Table. A string which
+/// is a suffix of the string before it shares its storage.
+static void mergeTails(ArrayRef<StringEntry *> Strings,
+                       StringTableBuilder::Kind Kind,
+                       SmallVectorImpl<char> &Table) {
+  StringRef Previous;
+  for (StringEntry *E : Strings) {
+    StringRef S = E->getKey();
+    if (Kind == StringTableBuilder::WinCOFF)
+      assert(S.size() > COFF::NameSize && "Short string in COFF string table!");
+
+    if (Previous.endswith(S)) {
+      E->second = Table.size() - 1 - S.size();
+      continue;
+    }
+
+    E->second = Table.size();
+    Table.append(S.begin(), S.end());
+    Table.push_back('\x00');
+    Previous = S;
+  }
+}
+
+// The suffix order compares the last bytes of the strings first, so the
+// strings are sharded by their last two bytes. Shards are numbered in table
+// order: by descending last byte, then by descending second to last byte, with
+// the single byte string last.
+static const unsigned ShardsPerLastByte = 257;
+static const unsigned NumShards = 256 * ShardsPerLastByte;
+
+/// Rank \p C in [0, 256) in the order compareBySuffix puts it, which depends
+/// on whether char is signed on the host.
+static unsigned getByteRank(char C) {
+  return std::numeric_limits<char>::max() - C;
+}
+
+static unsigned getShard(StringRef S) {
+  assert(!S.empty() && "The empty string is not sharded");
+  unsigned Last = getByteRank(S.back());
+  unsigned Next = S.size() < 2 ? 256 : getByteRank(S[S.size() - 2]);
+  return Last * ShardsPerLastByte + Next;
+}
+
+/// Sort and merge \p Strings on \p Pool, and append them to \p Table.
+///
+/// The shards are sorted independently. Strings with different last bytes
+/// never share storage, so the shards with the same last byte are merged
+/// independently of the others and their tables are concatenated afterwards.
+static void finalizeInParallel(std::vector<StringEntry *> &Strings,
+                               StringTableBuilder::Kind Kind,
+                               SmallVectorImpl<char> &Table, ThreadPool &Pool) {
+  // The empty string sorts last and points at the final NUL of the table.
+  StringEntry *Empty = nullptr;
+
+  // Distribute the strings over the shards with a counting sort.
+  std::vector<size_t> ShardBegin(NumShards + 1);
+  for (StringEntry *E : Strings) {
+    if (E->getKey().empty())
+      Empty = E;
+    else
+      ++ShardBegin[getShard(E->getKey()) + 1];
+  }
+  for (unsigned I = 0; I != NumShards; ++I)
+    ShardBegin[I + 1] += ShardBegin[I];
+  std::vector<StringEntry *> Sorted(ShardBegin[NumShards]);
+  {
+    std::vector<size_t> Next(ShardBegin.begin(), ShardBegin.end() - 1);
+    for (StringEntry *E : Strings)
+      if (E != Empty)
+        Sorted[Next[getShard(E->getKey())]++] = E;
+  }
 
-  for (auto i = StringIndexMap.begin(), e = StringIndexMap.end(); i != e; ++i)
-    Strings.push_back(i->getKey());
+  // Sort runs of shards of roughly equal total size.
+  TaskGroup Group;
+  size_t TaskSize = Sorted.size() / (4 * Pool.getThreadCount()) + 1;
+  for (unsigned Begin = 0; Begin != NumShards;) {
+    unsigned End = Begin + 1;
+    while (End != NumShards &&
+           ShardBegin[End] - ShardBegin[Begin] < TaskSize)
+      ++End;
+    Pool.async(Group, [&, Begin, End] {
+      for (unsigned I = Begin; I != End; ++I)
+        std::sort(Sorted.begin() + ShardBegin[I],
+                  Sorted.begin() + ShardBegin[I + 1], compareEntriesBySuffix);
+    });
+    Begin = End;
+  }
+  Pool.wait(Group);
+
+  // Merge the strings ending in each byte into a table of their own.
+  std::vector<SmallString<0>> Tables(256);
+  for (unsigned Last = 0; Last != 256; ++Last) {
+    size_t Begin = ShardBegin[Last * ShardsPerLastByte];
+    size_t End = ShardBegin[(Last + 1) * ShardsPerLastByte];
+    if (Begin == End)
+      continue;
+    Pool.async(Group, [&, Last, Begin, End] {
+      mergeTails(makeArrayRef(Sorted).slice(Begin, End - Begin), Kind,
+                 Tables[Last]);
+    });
+  }
+  Pool.wait(Group);
+
+  // Concatenate the tables and rebase the offsets.
+  for (unsigned Last = 0; Last != 256; ++Last) {
+    size_t Begin = ShardBegin[Last * ShardsPerLastByte];
+    size_t End = ShardBegin[(Last + 1) * ShardsPerLastByte];
+    if (Begin == End)
+      continue;
+    size_t Base = Table.size();
+    Table.append(Tables[Last].begin(), Tables[Last].end());
+    Pool.async(Group, [&, Begin, End, Base] {
+      for (size_t I = Begin; I != End; ++I)
+        Sorted[I]->second += Base;
+    });
+  }
+  if (Empty) {
+    assert(Kind != StringTableBuilder::WinCOFF &&
+           "Short string in COFF string table!");
+    Empty->second = Table.size() - 1;
+  }
+  Pool.wait(Group);
+}
 
-  std::sort(Strings.begin(), Strings.end(), compareBySuffix);
+void StringTableBuilder::finalize(Kind kind, ThreadPool *Pool) {
+  std::vector<StringEntry *> Strings;
+  Strings.reserve(StringIndexMap.size());
+  for (StringEntry &E : StringIndexMap)
+    Strings.push_back(&E);
 
   switch (kind) {
   case ELF:
@@ -48,20 +179,11 @@ void StringTableBuilder::finalize(Kind kind) {
     break;
   }
 
-  StringRef Previous;
-  for (StringRef s : Strings) {
-    if (kind == WinCOFF)
-      assert(s.size() > COFF::NameSize && "Short string in COFF string table!");
-
-    if (Previous.endswith(s)) {
-      StringIndexMap[s] = StringTable.size() - 1 - s.size();
-      continue;
-    }
-
-    StringIndexMap[s] = StringTable.size();
-    StringTable += s;
-    StringTable += '\x00';
-    Previous = s;
+  if (Pool) {
+    finalizeInParallel(Strings, kind, StringTable, *Pool);
+  } else {
+    std::sort(Strings.begin(), Strings.end(), compareEntriesBySuffix);
+    mergeTails(Strings, kind, StringTable);
   }
 
   switch (kind) {
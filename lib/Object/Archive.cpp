@@ -233,7 +233,8 @@ ErrorOr<std::unique_ptr<Archive>> Archive::create(MemoryBufferRef Source) {
 
 Archive::Archive(MemoryBufferRef Source, std::error_code &ec)
     : Binary(Binary::ID_Archive, Source), SymbolTable(child_end()),
-      StringTable(child_end()), FirstRegular(child_end()) {
+      StringTable(child_end()), FirstRegular(child_end()),
+      SymbolMapBuilt(false) {
   StringRef Buffer = Data.getBuffer();
   // Check for sufficient magic.
   if (Buffer.startswith(ThinMagic)) {
@@ -529,21 +530,32 @@ uint32_t Archive::getNumberOfSymbols() const {
   return read32le(buf);
 }
 
+void Archive::buildSymbolMap() const {
+  sys::ScopedLock Lock(SymbolMapLock);
+  if (SymbolMapBuilt.load(std::memory_order_relaxed))
+    return;
+
+  // Keep the first entry for every name, which is the one a linear search of
+  // the symbol table would find.
+  if (hasSymbolTable())
+    for (const Symbol &Sym : symbols())
+      SymbolMap.insert(std::make_pair(Sym.getName(), Sym));
+  SymbolMapBuilt.store(true, std::memory_order_release);
+}
+
 Archive::child_iterator Archive::findSym(StringRef name) const {
-  Archive::symbol_iterator bs = symbol_begin();
-  Archive::symbol_iterator es = symbol_end();
-
-  for (; bs != es; ++bs) {
-    StringRef SymName = bs->getName();
-    if (SymName == name) {
-      ErrorOr<Archive::child_iterator> ResultOrErr = bs->getMember();
-      // FIXME: Should we really eat the error?
-      if (ResultOrErr.getError())
-        return child_end();
-      return ResultOrErr.get();
-    }
-  }
-  return child_end();
+  if (!SymbolMapBuilt.load(std::memory_order_acquire))
+    buildSymbolMap();
+
+  auto I = SymbolMap.find(name);
+  if (I == SymbolMap.end())
+    return child_end();
+
+  ErrorOr<Archive::child_iterator> ResultOrErr = I->second.getMember();
+  // FIXME: Should we really eat the error?
+  if (ResultOrErr.getError())
+    return child_end();
+  return ResultOrErr.get();
 }
 
 bool Archive::hasSymbolTable() const {
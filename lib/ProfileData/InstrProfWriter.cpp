@@ -17,6 +17,7 @@
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/EndianStream.h"
 #include "llvm/Support/OnDiskHashTable.h"
+#include <algorithm>
 
 using namespace llvm;
 
@@ -61,10 +62,21 @@ public:
     using namespace llvm::support;
     endian::Writer<little> LE(Out);
 
-    for (const auto &Counts : *V) {
-      LE.write<uint64_t>(Counts.first);
-      LE.write<uint64_t>(Counts.second.size());
-      for (uint64_t I : Counts.second)
+    // Emit the hashes in order, so that the output does not depend on the
+    // layout of the map.
+    typedef InstrProfWriter::CounterData::value_type HashCounts;
+    SmallVector<const HashCounts *, 1> Sorted;
+    for (const auto &Counts : *V)
+      Sorted.push_back(&Counts);
+    std::sort(Sorted.begin(), Sorted.end(),
+              [](const HashCounts *A, const HashCounts *B) {
+                return A->first < B->first;
+              });
+
+    for (const auto *Counts : Sorted) {
+      LE.write<uint64_t>(Counts->first);
+      LE.write<uint64_t>(Counts->second.size());
+      for (uint64_t I : Counts->second)
         LE.write<uint64_t>(I);
     }
   }
@@ -109,9 +121,19 @@ InstrProfWriter::addFunctionCounts(StringRef FunctionName,
 std::pair<uint64_t, uint64_t> InstrProfWriter::writeImpl(raw_ostream &OS) {
   OnDiskChainedHashTableGenerator<InstrProfRecordTrait> Generator;
 
-  // Populate the hash table generator.
+  // Populate the hash table generator in name order: the layout of the
+  // buckets depends on the order of insertion, and the layout of
+  // FunctionData on the order in which functions were added.
+  std::vector<const StringMapEntry<CounterData> *> Sorted;
   for (const auto &I : FunctionData)
-    Generator.insert(I.getKey(), &I.getValue());
+    Sorted.push_back(&I);
+  std::sort(Sorted.begin(), Sorted.end(),
+            [](const StringMapEntry<CounterData> *A,
+               const StringMapEntry<CounterData> *B) {
+              return A->getKey() < B->getKey();
+            });
+  for (const auto *I : Sorted)
+    Generator.insert(I->getKey(), &I->getValue());
 
   using namespace llvm::support;
   endian::Writer<little> LE(OS);
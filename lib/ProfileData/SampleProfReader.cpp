@@ -8,10 +8,11 @@
 //===----------------------------------------------------------------------===//
 //
 // This file implements the class that reads LLVM sample profiles. It
-// supports two file formats: text and binary. The textual representation
-// is useful for debugging and testing purposes. The binary representation
-// is more compact, resulting in smaller file sizes. However, they can
-// both be used interchangeably.
+// supports three file formats: text, binary and indexed. The textual
+// representation is useful for debugging and testing purposes. The binary
+// representation is more compact, resulting in smaller file sizes. The
+// indexed representation can be looked up one function at a time. However,
+// they can all be used interchangeably.
 //
 // NOTE: If you are making changes to the file format, please remember
 //       to document them in the Clang documentation at
@@ -92,9 +93,20 @@
 //    instruction that calls one of ``foo()``, ``bar()`` and ``baz()``,
 //    with ``baz()`` being the relatively more frequently called target.
 //
+// Indexed format
+// --------------
+//
+// The file starts with three little-endian 64-bit words: a magic number, a
+// version, and the offset of the buckets of an on-disk chained hash table
+// (see llvm/Support/OnDiskHashTable.h).  The table maps the name of each
+// function to its samples, encoded as in the binary format, less the name.
+//
 //===----------------------------------------------------------------------===//
 
 #include "llvm/ProfileData/SampleProfReader.h"
+#include "InstrProfIndexed.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/AlignOf.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorOr.h"
 #include "llvm/Support/LEB128.h"
@@ -264,62 +276,67 @@ ErrorOr<StringRef> SampleProfileReaderBinary::readString() {
   return Str;
 }
 
-std::error_code SampleProfileReaderBinary::read() {
-  while (!at_eof()) {
-    auto FName(readString());
-    if (std::error_code EC = FName.getError())
-      return EC;
+std::error_code
+SampleProfileReaderBinary::readProfile(FunctionSamples &FProfile) {
+  auto Val = readNumber<unsigned>();
+  if (std::error_code EC = Val.getError())
+    return EC;
+  FProfile.addTotalSamples(*Val);
 
-    Profiles[*FName] = FunctionSamples();
-    FunctionSamples &FProfile = Profiles[*FName];
+  Val = readNumber<unsigned>();
+  if (std::error_code EC = Val.getError())
+    return EC;
+  FProfile.addHeadSamples(*Val);
 
-    auto Val = readNumber<unsigned>();
-    if (std::error_code EC = Val.getError())
+  // Read the samples in the body.
+  auto NumRecords = readNumber<unsigned>();
+  if (std::error_code EC = NumRecords.getError())
+    return EC;
+  for (unsigned I = 0; I < *NumRecords; ++I) {
+    auto LineOffset = readNumber<uint64_t>();
+    if (std::error_code EC = LineOffset.getError())
       return EC;
-    FProfile.addTotalSamples(*Val);
 
-    Val = readNumber<unsigned>();
-    if (std::error_code EC = Val.getError())
+    auto Discriminator = readNumber<uint64_t>();
+    if (std::error_code EC = Discriminator.getError())
       return EC;
-    FProfile.addHeadSamples(*Val);
 
-    // Read the samples in the body.
-    auto NumRecords = readNumber<unsigned>();
-    if (std::error_code EC = NumRecords.getError())
+    auto NumSamples = readNumber<uint64_t>();
+    if (std::error_code EC = NumSamples.getError())
       return EC;
-    for (unsigned I = 0; I < *NumRecords; ++I) {
-      auto LineOffset = readNumber<uint64_t>();
-      if (std::error_code EC = LineOffset.getError())
-        return EC;
 
-      auto Discriminator = readNumber<uint64_t>();
-      if (std::error_code EC = Discriminator.getError())
-        return EC;
+    auto NumCalls = readNumber<unsigned>();
+    if (std::error_code EC = NumCalls.getError())
+      return EC;
 
-      auto NumSamples = readNumber<uint64_t>();
-      if (std::error_code EC = NumSamples.getError())
+    for (unsigned J = 0; J < *NumCalls; ++J) {
+      auto CalledFunction(readString());
+      if (std::error_code EC = CalledFunction.getError())
         return EC;
 
-      auto NumCalls = readNumber<unsigned>();
-      if (std::error_code EC = NumCalls.getError())
+      auto CalledFunctionSamples = readNumber<uint64_t>();
+      if (std::error_code EC = CalledFunctionSamples.getError())
         return EC;
 
-      for (unsigned J = 0; J < *NumCalls; ++J) {
-        auto CalledFunction(readString());
-        if (std::error_code EC = CalledFunction.getError())
-          return EC;
+      FProfile.addCalledTargetSamples(*LineOffset, *Discriminator,
+                                      *CalledFunction, *CalledFunctionSamples);
+    }
 
-        auto CalledFunctionSamples = readNumber<uint64_t>();
-        if (std::error_code EC = CalledFunctionSamples.getError())
-          return EC;
+    FProfile.addBodySamples(*LineOffset, *Discriminator, *NumSamples);
+  }
 
-        FProfile.addCalledTargetSamples(*LineOffset, *Discriminator,
-                                        *CalledFunction,
-                                        *CalledFunctionSamples);
-      }
+  return sampleprof_error::success;
+}
 
-      FProfile.addBodySamples(*LineOffset, *Discriminator, *NumSamples);
-    }
+std::error_code SampleProfileReaderBinary::read() {
+  while (!at_eof()) {
+    auto FName(readString());
+    if (std::error_code EC = FName.getError())
+      return EC;
+
+    Profiles[*FName] = FunctionSamples();
+    if (std::error_code EC = readProfile(Profiles[*FName]))
+      return EC;
   }
 
   return sampleprof_error::success;
@@ -353,6 +370,75 @@ bool SampleProfileReaderBinary::hasFormat(const MemoryBuffer &Buffer) {
   return Magic == SPMagic();
 }
 
+SampleProfileLookupTrait::hash_value_type
+SampleProfileLookupTrait::ComputeHash(StringRef K) {
+  return IndexedInstrProf::MD5Hash(K);
+}
+
+std::error_code SampleProfileReaderIndexed::readHeader() {
+  const uint8_t *Start =
+      reinterpret_cast<const uint8_t *>(Buffer->getBufferStart());
+  const uint8_t *Cur = Start;
+  End = Start + Buffer->getBufferSize();
+  if (End - Cur < 24)
+    return sampleprof_error::truncated;
+
+  using namespace support;
+  if (endian::readNext<uint64_t, little, unaligned>(Cur) != SPIndexedMagic())
+    return sampleprof_error::bad_magic;
+  if (endian::readNext<uint64_t, little, unaligned>(Cur) != SPIndexedVersion())
+    return sampleprof_error::unsupported_version;
+
+  // The buckets start with their count, followed by one offset per bucket.
+  // The table generator aligns them as the host aligns a uint64_t.
+  uint64_t HashOffset = endian::readNext<uint64_t, little, unaligned>(Cur);
+  if (HashOffset < 24 || HashOffset % alignOf<uint64_t>() ||
+      HashOffset + sizeof(uint64_t) * 2 > Buffer->getBufferSize())
+    return sampleprof_error::malformed;
+
+  Index.reset(SampleProfileReaderIndex::Create(Start + HashOffset, Cur, Start));
+  return sampleprof_error::success;
+}
+
+std::error_code SampleProfileReaderIndexed::readFunction(StringRef FName,
+                                                         StringRef Encoded) {
+  Data = reinterpret_cast<const uint8_t *>(Encoded.data());
+  End = Data + Encoded.size();
+  Profiles[FName] = FunctionSamples();
+  return readProfile(Profiles[FName]);
+}
+
+std::error_code SampleProfileReaderIndexed::read() {
+  for (auto I = Index->data_begin(), E = Index->data_end(); I != E; ++I) {
+    std::pair<StringRef, StringRef> Entry = *I;
+    if (std::error_code EC = readFunction(Entry.first, Entry.second))
+      return EC;
+  }
+  return sampleprof_error::success;
+}
+
+std::error_code SampleProfileReaderIndexed::readProfilesFor(const Module &M) {
+  for (const Function &F : M) {
+    if (F.isDeclaration())
+      continue;
+    auto I = Index->find(F.getName());
+    if (I == Index->end())
+      continue;
+    std::pair<StringRef, StringRef> Entry = *I;
+    if (std::error_code EC = readFunction(F.getName(), Entry.second))
+      return EC;
+  }
+  return sampleprof_error::success;
+}
+
+bool SampleProfileReaderIndexed::hasFormat(const MemoryBuffer &Buffer) {
+  if (Buffer.getBufferSize() < sizeof(uint64_t))
+    return false;
+  using namespace support;
+  return endian::read<uint64_t, little, unaligned>(Buffer.getBufferStart()) ==
+         SPIndexedMagic();
+}
+
 /// \brief Prepare a memory buffer for the contents of \p Filename.
 ///
 /// \returns an error code indicating the status of the buffer.
@@ -387,7 +473,9 @@ SampleProfileReader::create(StringRef Filename, LLVMContext &C) {
 
   auto Buffer = std::move(BufferOrError.get());
   std::unique_ptr<SampleProfileReader> Reader;
-  if (SampleProfileReaderBinary::hasFormat(*Buffer))
+  if (SampleProfileReaderIndexed::hasFormat(*Buffer))
+    Reader.reset(new SampleProfileReaderIndexed(std::move(Buffer), C));
+  else if (SampleProfileReaderBinary::hasFormat(*Buffer))
     Reader.reset(new SampleProfileReaderBinary(std::move(Buffer), C));
   else
     Reader.reset(new SampleProfileReaderText(std::move(Buffer), C));
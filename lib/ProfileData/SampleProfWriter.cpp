@@ -8,10 +8,11 @@
 //===----------------------------------------------------------------------===//
 //
 // This file implements the class that writes LLVM sample profiles. It
-// supports two file formats: text and binary. The textual representation
-// is useful for debugging and testing purposes. The binary representation
-// is more compact, resulting in smaller file sizes. However, they can
-// both be used interchangeably.
+// supports three file formats: text, binary and indexed. The textual
+// representation is useful for debugging and testing purposes. The binary
+// representation is more compact, resulting in smaller file sizes. The
+// indexed representation can be looked up one function at a time. However,
+// they can all be used interchangeably.
 //
 // See lib/ProfileData/SampleProfReader.cpp for documentation on each of the
 // supported formats.
@@ -19,16 +20,132 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/ProfileData/SampleProfWriter.h"
+#include "InstrProfIndexed.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/EndianStream.h"
 #include "llvm/Support/ErrorOr.h"
 #include "llvm/Support/LEB128.h"
 #include "llvm/Support/LineIterator.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/OnDiskHashTable.h"
 #include "llvm/Support/Regex.h"
+#include <algorithm>
 
 using namespace llvm::sampleprof;
 using namespace llvm;
 
+namespace {
+class SampleProfileRecordTrait {
+public:
+  typedef StringRef key_type;
+  typedef StringRef key_type_ref;
+
+  typedef StringRef data_type;
+  typedef StringRef data_type_ref;
+
+  typedef uint64_t hash_value_type;
+  typedef uint64_t offset_type;
+
+  static hash_value_type ComputeHash(key_type_ref K) {
+    return IndexedInstrProf::MD5Hash(K);
+  }
+
+  static std::pair<offset_type, offset_type>
+  EmitKeyDataLength(raw_ostream &Out, key_type_ref K, data_type_ref V) {
+    using namespace llvm::support;
+    endian::Writer<little> LE(Out);
+    LE.write<offset_type>(K.size());
+    LE.write<offset_type>(V.size());
+    return std::make_pair(K.size(), V.size());
+  }
+
+  static void EmitKey(raw_ostream &Out, key_type_ref K, offset_type N) {
+    Out.write(K.data(), N);
+  }
+
+  static void EmitData(raw_ostream &Out, key_type_ref, data_type_ref V,
+                       offset_type N) {
+    Out.write(V.data(), N);
+  }
+};
+}
+
+typedef BodySampleMap::value_type BodySample;
+typedef SampleRecord::CallTargetMap::value_type CallTarget;
+
+/// \brief Return the samples in the body of \p S by line location, so that
+/// the writers do not depend on the layout of the map.
+static std::vector<const BodySample *>
+sortBodySamples(const FunctionSamples &S) {
+  std::vector<const BodySample *> Sorted;
+  for (const auto &I : S.getBodySamples())
+    Sorted.push_back(&I);
+  std::sort(Sorted.begin(), Sorted.end(),
+            [](const BodySample *A, const BodySample *B) {
+              return std::make_pair(A->first.LineOffset,
+                                    A->first.Discriminator) <
+                     std::make_pair(B->first.LineOffset,
+                                    B->first.Discriminator);
+            });
+  return Sorted;
+}
+
+/// \brief Return the call targets of \p Sample by name.
+static std::vector<const CallTarget *>
+sortCallTargets(const SampleRecord &Sample) {
+  std::vector<const CallTarget *> Sorted;
+  for (const auto &I : Sample.getCallTargets())
+    Sorted.push_back(&I);
+  std::sort(Sorted.begin(), Sorted.end(),
+            [](const CallTarget *A, const CallTarget *B) {
+              return A->getKey() < B->getKey();
+            });
+  return Sorted;
+}
+
+/// \brief Write the samples of a function, less its name, in the binary
+/// encoding.
+static void writeBinaryBody(raw_ostream &OS, const FunctionSamples &S) {
+  encodeULEB128(S.getTotalSamples(), OS);
+  encodeULEB128(S.getHeadSamples(), OS);
+  encodeULEB128(S.getBodySamples().size(), OS);
+  for (const BodySample *I : sortBodySamples(S)) {
+    LineLocation Loc = I->first;
+    const SampleRecord &Sample = I->second;
+    encodeULEB128(Loc.LineOffset, OS);
+    encodeULEB128(Loc.Discriminator, OS);
+    encodeULEB128(Sample.getSamples(), OS);
+    encodeULEB128(Sample.getCallTargets().size(), OS);
+    for (const CallTarget *J : sortCallTargets(Sample)) {
+      std::string Callee = J->first();
+      unsigned CalleeSamples = J->second;
+      OS << Callee;
+      encodeULEB128(0, OS);
+      encodeULEB128(CalleeSamples, OS);
+    }
+  }
+}
+
+bool SampleProfileWriter::write(StringMap<FunctionSamples> &ProfileMap) {
+  std::vector<StringRef> Names;
+  for (const auto &I : ProfileMap)
+    Names.push_back(I.getKey());
+  std::sort(Names.begin(), Names.end());
+  for (StringRef FName : Names)
+    if (!write(FName, ProfileMap[FName]))
+      return false;
+  return true;
+}
+
+std::error_code SampleProfileWriter::finalize() {
+  OS.flush();
+  if (OS.has_error()) {
+    OS.clear_error();
+    return std::make_error_code(std::errc::io_error);
+  }
+  return sampleprof_error::success;
+}
+
 /// \brief Write samples to a text file.
 bool SampleProfileWriterText::write(StringRef FName, const FunctionSamples &S) {
   if (S.empty())
@@ -37,9 +154,9 @@ bool SampleProfileWriterText::write(StringRef FName, const FunctionSamples &S) {
   OS << FName << ":" << S.getTotalSamples() << ":" << S.getHeadSamples()
      << "\n";
 
-  for (const auto &I : S.getBodySamples()) {
-    LineLocation Loc = I.first;
-    const SampleRecord &Sample = I.second;
+  for (const BodySample *I : sortBodySamples(S)) {
+    LineLocation Loc = I->first;
+    const SampleRecord &Sample = I->second;
     if (Loc.Discriminator == 0)
       OS << Loc.LineOffset << ": ";
     else
@@ -47,8 +164,8 @@ bool SampleProfileWriterText::write(StringRef FName, const FunctionSamples &S) {
 
     OS << Sample.getSamples();
 
-    for (const auto &J : Sample.getCallTargets())
-      OS << " " << J.first() << ":" << J.second;
+    for (const CallTarget *J : sortCallTargets(Sample))
+      OS << " " << J->first() << ":" << J->second;
     OS << "\n";
   }
 
@@ -76,28 +193,52 @@ bool SampleProfileWriterBinary::write(StringRef FName,
 
   OS << FName;
   encodeULEB128(0, OS);
-  encodeULEB128(S.getTotalSamples(), OS);
-  encodeULEB128(S.getHeadSamples(), OS);
-  encodeULEB128(S.getBodySamples().size(), OS);
-  for (const auto &I : S.getBodySamples()) {
-    LineLocation Loc = I.first;
-    const SampleRecord &Sample = I.second;
-    encodeULEB128(Loc.LineOffset, OS);
-    encodeULEB128(Loc.Discriminator, OS);
-    encodeULEB128(Sample.getSamples(), OS);
-    encodeULEB128(Sample.getCallTargets().size(), OS);
-    for (const auto &J : Sample.getCallTargets()) {
-      std::string Callee = J.first();
-      unsigned CalleeSamples = J.second;
-      OS << Callee;
-      encodeULEB128(0, OS);
-      encodeULEB128(CalleeSamples, OS);
-    }
-  }
+  writeBinaryBody(OS, S);
 
   return true;
 }
 
+/// \brief Encode the samples of a function for the index.
+///
+/// \returns true if the samples were written successfully, false otherwise.
+bool SampleProfileWriterIndexed::write(StringRef FName,
+                                       const FunctionSamples &S) {
+  if (S.empty())
+    return true;
+
+  std::string &Encoded = EncodedProfiles[FName];
+  Encoded.clear();
+  raw_string_ostream EncodedOS(Encoded);
+  writeBinaryBody(EncodedOS, S);
+  EncodedOS.flush();
+  return true;
+}
+
+std::error_code SampleProfileWriterIndexed::finalize() {
+  OnDiskChainedHashTableGenerator<SampleProfileRecordTrait> Generator;
+  for (const auto &I : EncodedProfiles)
+    Generator.insert(I.getKey(), I.getValue());
+
+  // The output may be a pipe, so lay the file out in memory first and patch
+  // in the location of the buckets there.
+  std::string Data;
+  raw_string_ostream DataOS(Data);
+  using namespace support;
+  endian::Writer<little> LE(DataOS);
+  LE.write<uint64_t>(SPIndexedMagic());
+  LE.write<uint64_t>(SPIndexedVersion());
+  uint64_t HashTableStartLoc = DataOS.tell();
+  LE.write<uint64_t>(0);
+  uint64_t HashTableStart = Generator.Emit(DataOS);
+  DataOS.flush();
+
+  uint64_t Bytes = endian::byte_swap<uint64_t, little>(HashTableStart);
+  Data.replace(HashTableStartLoc, sizeof(uint64_t), (const char *)&Bytes,
+               sizeof(uint64_t));
+  OS << Data;
+  return SampleProfileWriter::finalize();
+}
+
 /// \brief Create a sample profile writer based on the specified format.
 ///
 /// \param Filename The file to create.
@@ -114,6 +255,8 @@ SampleProfileWriter::create(StringRef Filename, SampleProfileFormat Format) {
 
   if (Format == SPF_Binary)
     Writer.reset(new SampleProfileWriterBinary(Filename, EC));
+  else if (Format == SPF_Indexed)
+    Writer.reset(new SampleProfileWriterIndexed(Filename, EC));
   else if (Format == SPF_Text)
     Writer.reset(new SampleProfileWriterText(Filename, EC));
   else
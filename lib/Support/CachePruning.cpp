@@ -0,0 +1,97 @@
+//===-CachePruning.cpp - LLVM Cache Directory Pruning ---------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the pruning of a directory based cache.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/CachePruning.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/TimeValue.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <tuple>
+#include <vector>
+
+#define DEBUG_TYPE "cache-pruning"
+
+using namespace llvm;
+
+/// Update the modification time of \p Path to now, creating the file if it
+/// does not exist.
+static void touch(const Twine &Path) {
+  int FD;
+  if (sys::fs::openFileForWrite(Path, FD, sys::fs::F_Append))
+    return;
+  sys::fs::setLastModificationAndAccessTime(FD, sys::TimeValue::now());
+  sys::Process::SafelyCloseFileDescriptor(FD);
+}
+
+bool CachePruning::prune() {
+  if (Path.empty() || (!Expiration && !MaxSize))
+    return false;
+
+  bool IsDirectory;
+  if (sys::fs::is_directory(Path, IsDirectory) || !IsDirectory)
+    return false;
+
+  uint64_t Now = sys::TimeValue::now().toEpochTime();
+
+  // Skip if the last pruning is recent enough.
+  SmallString<128> TimestampFile(Path);
+  sys::path::append(TimestampFile, "llvmcache.timestamp");
+  sys::fs::file_status TimestampStatus;
+  if (Interval && !sys::fs::status(TimestampFile, TimestampStatus) &&
+      Now - TimestampStatus.getLastModificationTime().toEpochTime() <
+          Interval) {
+    DEBUG(dbgs() << "Skipping pruning of " << Path << ": last run too recent\n");
+    return false;
+  }
+  touch(TimestampFile);
+
+  // Entries that survive expiration, as (last use, size, path).
+  std::vector<std::tuple<uint64_t, uint64_t, std::string>> Entries;
+  uint64_t TotalSize = 0;
+  std::error_code EC;
+  for (sys::fs::directory_iterator File(Path, EC), FileEnd;
+       File != FileEnd && !EC; File.increment(EC)) {
+    if (!sys::path::filename(File->path()).startswith("llvmcache-"))
+      continue;
+    sys::fs::file_status Status;
+    if (File->status(Status) || !sys::fs::is_regular_file(Status))
+      continue;
+
+    uint64_t LastUse = Status.getLastModificationTime().toEpochTime();
+    if (Expiration && Now > LastUse && Now - LastUse > Expiration) {
+      DEBUG(dbgs() << "Expired " << File->path() << "\n");
+      sys::fs::remove(File->path());
+      continue;
+    }
+    Entries.emplace_back(LastUse, Status.getSize(), File->path());
+    TotalSize += Status.getSize();
+  }
+
+  if (!MaxSize || TotalSize <= MaxSize)
+    return true;
+
+  // Evict the least recently used entries until the cache fits.
+  std::sort(Entries.begin(), Entries.end());
+  for (const auto &Entry : Entries) {
+    if (TotalSize <= MaxSize)
+      break;
+    DEBUG(dbgs() << "Evicting " << std::get<2>(Entry) << "\n");
+    sys::fs::remove(std::get<2>(Entry));
+    TotalSize -= std::get<1>(Entry);
+  }
+  return true;
+}
@@ -0,0 +1,227 @@
+//===-- ThreadPool.cpp - A work-stealing ThreadPool -----------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements a work-stealing thread pool.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/Threading.h"
+#include <cassert>
+#include <deque>
+
+using namespace llvm;
+
+struct ThreadPool::Task {
+  PackagedTaskTy Fn;
+  TaskGroup *Group;
+};
+
+struct ThreadPool::WorkQueue {
+  std::mutex Lock;
+  std::deque<Task> Tasks;
+};
+
+#if LLVM_ENABLE_THREADS
+static const unsigned NoWorker = ~0U;
+
+// The pool and worker index of the current thread, if it is a pool worker.
+static LLVM_THREAD_LOCAL const ThreadPool *CurrentPool = nullptr;
+static LLVM_THREAD_LOCAL unsigned CurrentWorker = NoWorker;
+#endif
+
+ThreadPool::ThreadPool() : ThreadPool(hardware_concurrency()) {}
+
+ThreadPool::ThreadPool(unsigned ThreadCount)
+    : ThreadCount(ThreadCount ? ThreadCount : 1) {
+#if LLVM_ENABLE_THREADS
+  Queues.reserve(this->ThreadCount);
+  for (unsigned I = 0; I != this->ThreadCount; ++I)
+    Queues.emplace_back(new WorkQueue());
+
+  Threads.reserve(this->ThreadCount);
+  for (unsigned I = 0; I != this->ThreadCount; ++I)
+    Threads.emplace_back([this, I] { workerLoop(I); });
+#endif
+}
+
+ThreadPool::~ThreadPool() {
+  wait();
+#if LLVM_ENABLE_THREADS
+  {
+    std::lock_guard<std::mutex> LockGuard(Mutex);
+    ShuttingDown = true;
+  }
+  WorkAvailable.notify_all();
+  for (auto &Worker : Threads)
+    Worker.join();
+#endif
+}
+
+#if LLVM_ENABLE_THREADS
+
+/// Returns the index of the current thread in \p Pool, or NoWorker if the
+/// current thread does not belong to it.
+static unsigned getWorkerIndex(const ThreadPool *Pool) {
+  return CurrentPool == Pool ? CurrentWorker : NoWorker;
+}
+
+std::shared_future<void> ThreadPool::asyncImpl(TaskTy Fn, TaskGroup *Group) {
+  PackagedTaskTy PackagedTask(std::move(Fn));
+  std::shared_future<void> Future = PackagedTask.get_future();
+
+  // Keep work spawned by a worker local to it; spread everything else.
+  unsigned Index = getWorkerIndex(this);
+  if (Index == NoWorker) {
+    std::lock_guard<std::mutex> LockGuard(Mutex);
+    Index = NextQueue++ % Queues.size();
+  }
+  {
+    WorkQueue &Queue = *Queues[Index];
+    std::lock_guard<std::mutex> LockGuard(Queue.Lock);
+    Queue.Tasks.push_back(Task{std::move(PackagedTask), Group});
+  }
+
+  // Only publish the task once it is in a deque, so that a thread which
+  // reserves it is guaranteed to find it.
+  {
+    std::lock_guard<std::mutex> LockGuard(Mutex);
+    ++QueuedTasks;
+    ++OutstandingTasks;
+    if (Group)
+      ++Group->Pending;
+  }
+  WorkAvailable.notify_one();
+  return Future;
+}
+
+ThreadPool::Task ThreadPool::takeReservedTask(unsigned Self) {
+  unsigned NumQueues = Queues.size();
+  for (;;) {
+    // Our own deque is used as a stack, which keeps nested work hot in cache.
+    if (Self != NoWorker) {
+      WorkQueue &Queue = *Queues[Self];
+      std::lock_guard<std::mutex> LockGuard(Queue.Lock);
+      if (!Queue.Tasks.empty()) {
+        Task T = std::move(Queue.Tasks.back());
+        Queue.Tasks.pop_back();
+        return T;
+      }
+    }
+
+    // Steal the oldest task from somebody else.  The reservation guarantees
+    // that there is one, although another thread may get to it first, in
+    // which case we look again.
+    unsigned Start = Self == NoWorker ? 0 : Self + 1;
+    for (unsigned I = 0; I != NumQueues; ++I) {
+      WorkQueue &Queue = *Queues[(Start + I) % NumQueues];
+      std::lock_guard<std::mutex> LockGuard(Queue.Lock);
+      if (!Queue.Tasks.empty()) {
+        Task T = std::move(Queue.Tasks.front());
+        Queue.Tasks.pop_front();
+        return T;
+      }
+    }
+  }
+}
+
+void ThreadPool::runTask(Task &T) {
+  T.Fn();
+
+  std::lock_guard<std::mutex> LockGuard(Mutex);
+  --OutstandingTasks;
+  bool GroupDone = T.Group && --T.Group->Pending == 0;
+  if (GroupDone || OutstandingTasks == 0)
+    Completion.notify_all();
+  // Threads helping out in wait(TaskGroup &) sleep on WorkAvailable.
+  if (GroupDone)
+    WorkAvailable.notify_all();
+}
+
+void ThreadPool::workerLoop(unsigned Index) {
+  CurrentPool = this;
+  CurrentWorker = Index;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> LockGuard(Mutex);
+      WorkAvailable.wait(LockGuard,
+                         [&] { return QueuedTasks != 0 || ShuttingDown; });
+      if (QueuedTasks == 0)
+        return;
+      --QueuedTasks;
+    }
+    Task T = takeReservedTask(Index);
+    runTask(T);
+  }
+}
+
+void ThreadPool::wait() {
+  assert(getWorkerIndex(this) == NoWorker &&
+         "Waiting for the whole pool from one of its tasks would deadlock");
+  std::unique_lock<std::mutex> LockGuard(Mutex);
+  Completion.wait(LockGuard, [&] { return OutstandingTasks == 0; });
+}
+
+void ThreadPool::wait(TaskGroup &Group) {
+  unsigned Self = getWorkerIndex(this);
+  if (Self == NoWorker) {
+    std::unique_lock<std::mutex> LockGuard(Mutex);
+    Completion.wait(LockGuard, [&] { return Group.Pending == 0; });
+    return;
+  }
+
+  // A worker cannot just block: the tasks it waits for may be queued behind
+  // it.  Run queued tasks instead.
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> LockGuard(Mutex);
+      WorkAvailable.wait(LockGuard, [&] {
+        return Group.Pending == 0 || QueuedTasks != 0;
+      });
+      if (Group.Pending == 0)
+        return;
+      --QueuedTasks;
+    }
+    Task T = takeReservedTask(Self);
+    runTask(T);
+  }
+}
+
+#else // !LLVM_ENABLE_THREADS
+
+// Without threads there is nobody else to run a task, and its submitter may
+// block on the returned future without ever waiting for the pool.  So every
+// task runs before async() returns, and there is nothing left to wait for.
+std::shared_future<void> ThreadPool::asyncImpl(TaskTy Fn, TaskGroup *Group) {
+  PackagedTaskTy PackagedTask(std::move(Fn));
+  std::shared_future<void> Future = PackagedTask.get_future();
+  PackagedTask();
+  return Future;
+}
+
+void ThreadPool::wait() {}
+
+void ThreadPool::wait(TaskGroup &Group) {}
+
+#endif
+
+void llvm::forEachIndex(ThreadPool *Pool, unsigned Count,
+                        function_ref<void(unsigned)> Fn) {
+  if (!Pool || Count < 2) {
+    for (unsigned I = 0; I != Count; ++I)
+      Fn(I);
+    return;
+  }
+  TaskGroup Group;
+  for (unsigned I = 0; I != Count; ++I)
+    Pool->async(Group, [=] { Fn(I); });
+  Pool->wait(Group);
+}
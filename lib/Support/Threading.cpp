@@ -16,6 +16,7 @@
 #include "llvm/Config/config.h"
 #include "llvm/Support/Atomic.h"
 #include "llvm/Support/Mutex.h"
+#include "llvm/Support/thread.h"
 #include <cassert>
 
 using namespace llvm;
@@ -28,6 +29,14 @@ bool llvm::llvm_is_multithreaded() {
 #endif
 }
 
+unsigned llvm::hardware_concurrency() {
+#if LLVM_ENABLE_THREADS != 0
+  if (unsigned Count = thread::hardware_concurrency())
+    return Count;
+#endif
+  return 1;
+}
+
 #if LLVM_ENABLE_THREADS != 0 && defined(HAVE_PTHREAD_H)
 #include <pthread.h>
 
@@ -0,0 +1,251 @@
+//===- FunctionImport.cpp - ThinLTO Summary-based Function Import ---------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements function importing based on a combined function index:
+// the functions that a module calls but does not define are looked up in the
+// index, and the small ones are copied in from the modules that define them
+// with available_externally linkage.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Transforms/IPO/FunctionImport.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/FunctionInfo.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/IPO.h"
+using namespace llvm;
+
+#define DEBUG_TYPE "function-import"
+
+STATISTIC(NumImported, "Number of functions imported");
+
+static cl::opt<unsigned> ImportInstrLimit(
+    "import-instr-limit", cl::init(100), cl::Hidden, cl::value_desc("N"),
+    cl::desc("Only import functions with at most N instructions"));
+
+static cl::opt<std::string>
+    SummaryFile("summary-file",
+                cl::desc("The function index to use for function importing"));
+
+FunctionImporter::FunctionImporter(const FunctionInfoIndex &Index,
+                                   ModuleLoaderTy ModuleLoader,
+                                   unsigned InstLimit)
+    : Index(Index), ModuleLoader(std::move(ModuleLoader)),
+      InstLimit(InstLimit) {}
+
+FunctionImporter::FunctionImporter(const FunctionInfoIndex &Index,
+                                   ModuleLoaderTy ModuleLoader)
+    : FunctionImporter(Index, std::move(ModuleLoader), ImportInstrLimit) {}
+
+/// The functions to import into \p M are the ones that it calls without
+/// defining them and, through the call edges of the index, the ones that those
+/// call in turn.
+FunctionImporter::ImportListTy
+FunctionImporter::computeImportList(const Module &M) const {
+  ImportListTy ImportList;
+  StringSet<> Visited;
+  std::vector<std::string> Worklist;
+  for (const Function &F : M)
+    if (F.isDeclaration() && !F.isIntrinsic() && F.hasName())
+      Worklist.push_back(F.getName());
+
+  while (!Worklist.empty()) {
+    std::string Name = std::move(Worklist.back());
+    Worklist.pop_back();
+    if (!Visited.insert(Name).second)
+      continue;
+
+    const FunctionInfo *Info =
+        Index.findImportCandidate(Name, M.getModuleIdentifier());
+    if (!Info || Info->summary().getInstCount() > InstLimit)
+      continue;
+
+    DEBUG(dbgs() << "Importing " << Name << " from " << Info->modulePath()
+                 << "\n");
+    ImportList[Info->modulePath()].push_back(Name);
+    for (const std::string &Callee : Info->summary().calls()) {
+      const Function *F = M.getFunction(Callee);
+      if (!F || F->isDeclaration())
+        Worklist.push_back(Callee);
+    }
+  }
+  return ImportList;
+}
+
+/// Reduce \p SrcM to the bodies of the functions in \p Import and
+/// declarations of whatever they refer to, so that linking it into another
+/// module copies just those bodies.
+static void stripForImport(Module &SrcM, const StringSet<> &Import) {
+  for (Function &F : SrcM) {
+    if (!F.isDeclaration() && !Import.count(F.getName()))
+      F.deleteBody();
+    F.setComdat(nullptr);
+  }
+
+  for (auto I = SrcM.global_begin(), E = SrcM.global_end(); I != E;) {
+    GlobalVariable &GV = *I++;
+    if (GV.hasAppendingLinkage()) {
+      GV.eraseFromParent();
+      continue;
+    }
+    if (GV.hasInitializer()) {
+      GV.setInitializer(nullptr);
+      GV.setLinkage(GlobalValue::ExternalLinkage);
+    }
+    GV.setComdat(nullptr);
+  }
+
+  for (auto I = SrcM.alias_begin(), E = SrcM.alias_end(); I != E;) {
+    GlobalAlias &GA = *I++;
+    Type *Ty = GA.getType()->getElementType();
+    GlobalValue *Declaration;
+    if (FunctionType *FTy = dyn_cast<FunctionType>(Ty))
+      Declaration =
+          Function::Create(FTy, GlobalValue::ExternalLinkage, "", &SrcM);
+    else
+      Declaration = new GlobalVariable(SrcM, Ty, false,
+                                       GlobalValue::ExternalLinkage, nullptr);
+    Declaration->takeName(&GA);
+    GA.replaceAllUsesWith(
+        ConstantExpr::getBitCast(Declaration, GA.getType()));
+    GA.eraseFromParent();
+  }
+
+  // Named metadata, such as the compile units, describes the source module.
+  for (auto I = SrcM.named_metadata_begin(), E = SrcM.named_metadata_end();
+       I != E;) {
+    NamedMDNode &NMD = *I++;
+    if (NMD.getName() != "llvm.module.flags")
+      SrcM.eraseNamedMetadata(&NMD);
+  }
+}
+
+bool FunctionImporter::importFunctions(Module &DestModule) {
+  ImportListTy ImportList = computeImportList(DestModule);
+
+  bool Changed = false;
+  for (const auto &Entry : ImportList) {
+    std::unique_ptr<Module> SrcModule = ModuleLoader(Entry.first);
+    if (!SrcModule)
+      continue;
+    assert(&SrcModule->getContext() == &DestModule.getContext() &&
+           "Module loaded in the wrong context");
+
+    std::vector<Function *> Fns;
+    for (const std::string &Name : Entry.second) {
+      Function *F = SrcModule->getFunction(Name);
+      // The module may have changed since the index was built.
+      if (F && !F->isDeclaration())
+        Fns.push_back(F);
+    }
+    if (std::error_code EC = SrcModule->materializeFunctions(Fns)) {
+      DestModule.getContext().emitError("cannot import from '" + Entry.first +
+                                        "': " + EC.message());
+      continue;
+    }
+
+    StringSet<> Import;
+    for (Function *F : Fns) {
+      StringRef Name = F->getName();
+      // The linker only resolves declarations that the destination has.
+      GlobalValue *DestGV = DestModule.getNamedValue(Name);
+      if (DestGV && (!isa<Function>(DestGV) || !DestGV->isDeclaration()))
+        continue;
+      if (!DestGV)
+        Function::Create(F->getFunctionType(), GlobalValue::ExternalLinkage,
+                         Name, &DestModule);
+      Import.insert(Name);
+    }
+    if (Import.empty())
+      continue;
+
+    stripForImport(*SrcModule, Import);
+    if (Linker::LinkModules(&DestModule, SrcModule.get(),
+                            Linker::LinkOnlyNeeded))
+      continue;
+
+    for (const auto &Name : Import) {
+      Function *F = DestModule.getFunction(Name.getKey());
+      if (!F || F->isDeclaration())
+        continue;
+      F->setLinkage(GlobalValue::AvailableExternallyLinkage);
+      ++NumImported;
+      Changed = true;
+    }
+  }
+  return Changed;
+}
+
+namespace {
+/// Pass that imports functions into a module, using the function index in
+/// -summary-file.
+class FunctionImportPass : public ModulePass {
+public:
+  static char ID; // Pass identification, replacement for typeid
+  FunctionImportPass() : ModulePass(ID) {
+    initializeFunctionImportPassPass(*PassRegistry::getPassRegistry());
+  }
+
+  const char *getPassName() const override { return "Function Importing"; }
+
+  bool runOnModule(Module &M) override;
+};
+} // end anonymous namespace
+
+char FunctionImportPass::ID = 0;
+INITIALIZE_PASS(FunctionImportPass, "function-import",
+                "Summary Based Function Import", false, false)
+
+ModulePass *llvm::createFunctionImportPass() {
+  return new FunctionImportPass();
+}
+
+bool FunctionImportPass::runOnModule(Module &M) {
+  LLVMContext &Ctx = M.getContext();
+  if (SummaryFile.empty()) {
+    Ctx.emitError("-function-import requires -summary-file");
+    return false;
+  }
+
+  ErrorOr<std::unique_ptr<MemoryBuffer>> BufferOrErr =
+      MemoryBuffer::getFile(SummaryFile);
+  if (std::error_code EC = BufferOrErr.getError()) {
+    Ctx.emitError("cannot open summary file '" + SummaryFile +
+                  "': " + EC.message());
+    return false;
+  }
+  ErrorOr<std::unique_ptr<FunctionInfoIndex>> IndexOrErr =
+      getFunctionInfoIndex((*BufferOrErr)->getMemBufferRef());
+  if (std::error_code EC = IndexOrErr.getError()) {
+    Ctx.emitError("cannot read summary file '" + SummaryFile +
+                  "': " + EC.message());
+    return false;
+  }
+
+  auto ModuleLoader = [&Ctx](StringRef Path) -> std::unique_ptr<Module> {
+    SMDiagnostic Err;
+    std::unique_ptr<Module> Result = getLazyIRFileModule(Path, Err, Ctx);
+    if (!Result)
+      Ctx.emitError("cannot load module '" + Path + "' for function import: " +
+                    Err.getMessage());
+    return Result;
+  };
+  return FunctionImporter(**IndexOrErr, ModuleLoader).importFunctions(M);
+}
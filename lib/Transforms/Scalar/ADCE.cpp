@@ -45,6 +45,8 @@ struct ADCE : public FunctionPass {
     AU.setPreservesCFG();
     AU.addPreserved<GlobalsAAWrapperPass>();
   }
+
+  bool isParallelSafe() const override { return true; }
 };
 }
 
@@ -86,6 +86,8 @@ namespace {
     void getAnalysisUsage(AnalysisUsage &AU) const override {
       AU.setPreservesCFG();
     }
+
+    bool isParallelSafe() const override { return true; }
  };
 }
 
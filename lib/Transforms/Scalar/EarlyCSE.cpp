@@ -776,6 +776,8 @@ public:
     AU.addPreserved<GlobalsAAWrapperPass>();
     AU.setPreservesCFG();
   }
+
+  bool isParallelSafe() const override { return true; }
 };
 }
 
@@ -180,6 +180,8 @@ public:
   }
 
   bool runOnFunction(Function &F) override { return lowerExpectIntrinsic(F); }
+
+  bool isParallelSafe() const override { return true; }
 };
 }
 
@@ -4280,6 +4280,8 @@ public:
     AU.setPreservesCFG();
   }
 
+  bool isParallelSafe() const override { return true; }
+
   const char *getPassName() const override { return "SROA"; }
   static char ID;
 };
@@ -220,6 +220,12 @@ struct CFGSimplifyPass : public FunctionPass {
     AU.addRequired<TargetTransformInfoWrapperPass>();
     AU.addPreserved<GlobalsAAWrapperPass>();
   }
+
+  // The copies made for a parallel run have no predicate and use the default
+  // threshold.
+  bool isParallelSafe() const override {
+    return !PredicateFtor && BonusInstThreshold == UserBonusInstThreshold;
+  }
 };
 }
 
@@ -13,11 +13,20 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/IR/CallSite.h"
 #include "llvm/IR/Constant.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DebugInfoMetadata.h"
 #include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/InlineAsm.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/IR/TrackingMDRef.h"
 #include "llvm/Transforms/Utils/ValueMapper.h"
 #include "llvm-c/Core.h"
+#include <cstring>
 using namespace llvm;
 
 /// CloneModule - Return an exact copy of the specified module.  This is not as
@@ -166,6 +175,590 @@ Module *llvm::CloneModule(
   return New;
 }
 
+namespace {
+/// ContextCloner - Rebuilds a module inside a different LLVMContext.  Nothing
+/// that is uniqued by the source context can be shared with the copy, so
+/// types, constants, attributes and metadata are recreated in the destination
+/// context the first time they are referenced.
+class ContextCloner {
+  const Module &SrcM;
+  Module &DstM;
+  LLVMContext &Ctx;
+
+  DenseMap<Type *, Type *> MappedTypes;
+  DenseMap<const Value *, Value *> MappedValues;
+  DenseMap<const Metadata *, TrackingMDRef> MappedMDs;
+
+  /// Distinct nodes whose operands still refer to the source context.
+  SmallVector<MDNode *, 8> DistinctWorklist;
+
+  /// Metadata kind IDs are per context; this maps source kinds to ours.
+  SmallVector<unsigned, 16> MDKinds;
+
+public:
+  ContextCloner(const Module &SrcM, Module &DstM)
+      : SrcM(SrcM), DstM(DstM), Ctx(DstM.getContext()) {
+    SmallVector<StringRef, 16> Names;
+    SrcM.getContext().getMDKindNames(Names);
+    for (StringRef Name : Names)
+      MDKinds.push_back(Ctx.getMDKindID(Name));
+  }
+
+  void cloneModule();
+
+private:
+  Type *mapType(Type *Ty);
+  Value *mapValue(const Value *V);
+  Constant *mapConstant(const Constant *C) {
+    return cast<Constant>(mapValue(C));
+  }
+  Constant *cloneConstant(const Constant *C);
+  Metadata *mapMetadata(const Metadata *MD);
+  MDNode *mapMDNode(const MDNode *N) {
+    return cast_or_null<MDNode>(mapMetadata(N));
+  }
+  Metadata *mapMetadataImpl(const Metadata *MD);
+  Metadata *mapToMetadata(const Metadata *Key, Metadata *Val) {
+    MappedMDs[Key].reset(Val);
+    return Val;
+  }
+  void remapOperands(MDNode &N);
+  AttributeSet mapAttributes(AttributeSet Attrs);
+  void mapComdat(const GlobalObject &GO, GlobalObject &NewGO);
+  void cloneFunctionBody(const Function &F);
+  void remapInstruction(const Instruction &I, Instruction &NewI);
+};
+}
+
+Type *ContextCloner::mapType(Type *Ty) {
+  auto I = MappedTypes.find(Ty);
+  if (I != MappedTypes.end())
+    return I->second;
+
+  SmallVector<Type *, 8> Elts;
+  for (Type *Elt : Ty->subtypes())
+    if (!isa<StructType>(Ty) || cast<StructType>(Ty)->isLiteral())
+      Elts.push_back(mapType(Elt));
+
+  Type *NewTy;
+  switch (Ty->getTypeID()) {
+  case Type::IntegerTyID:
+    NewTy = IntegerType::get(Ctx, cast<IntegerType>(Ty)->getBitWidth());
+    break;
+  case Type::FunctionTyID:
+    NewTy = FunctionType::get(Elts[0], makeArrayRef(Elts).slice(1),
+                              cast<FunctionType>(Ty)->isVarArg());
+    break;
+  case Type::StructTyID: {
+    auto *STy = cast<StructType>(Ty);
+    if (STy->isLiteral()) {
+      NewTy = StructType::get(Ctx, Elts, STy->isPacked());
+      break;
+    }
+    // Identified structs may refer to themselves, so register the new type
+    // before mapping the body.
+    StructType *NewSTy = STy->hasName() ? StructType::create(Ctx, STy->getName())
+                                        : StructType::create(Ctx);
+    MappedTypes[Ty] = NewSTy;
+    if (!STy->isOpaque()) {
+      for (Type *Elt : STy->elements())
+        Elts.push_back(mapType(Elt));
+      NewSTy->setBody(Elts, STy->isPacked());
+    }
+    return NewSTy;
+  }
+  case Type::ArrayTyID:
+    NewTy = ArrayType::get(Elts[0], cast<ArrayType>(Ty)->getNumElements());
+    break;
+  case Type::VectorTyID:
+    NewTy = VectorType::get(Elts[0], cast<VectorType>(Ty)->getNumElements());
+    break;
+  case Type::PointerTyID:
+    NewTy = PointerType::get(Elts[0], Ty->getPointerAddressSpace());
+    break;
+  default:
+    NewTy = Type::getPrimitiveType(Ctx, Ty->getTypeID());
+    break;
+  }
+  return MappedTypes[Ty] = NewTy;
+}
+
+Value *ContextCloner::mapValue(const Value *V) {
+  // Global values, arguments, basic blocks and instructions are all seeded
+  // into the map before anything can refer to them.
+  auto I = MappedValues.find(V);
+  if (I != MappedValues.end())
+    return I->second;
+
+  Value *NewV;
+  if (const auto *IA = dyn_cast<InlineAsm>(V))
+    NewV = InlineAsm::get(cast<FunctionType>(mapType(IA->getFunctionType())),
+                          IA->getAsmString(), IA->getConstraintString(),
+                          IA->hasSideEffects(), IA->isAlignStack(),
+                          IA->getDialect());
+  else if (const auto *MDV = dyn_cast<MetadataAsValue>(V))
+    NewV = MetadataAsValue::get(Ctx, mapMetadata(MDV->getMetadata()));
+  else
+    NewV = cloneConstant(cast<Constant>(V));
+  return MappedValues[V] = NewV;
+}
+
+/// Recreate the elements of a ConstantDataSequential of the given element
+/// width in \p Ctx.
+template <typename T>
+static Constant *cloneDataElements(LLVMContext &Ctx, StringRef Raw,
+                                   bool IsVector, bool IsFP) {
+  SmallVector<T, 16> Elts(Raw.size() / sizeof(T));
+  std::memcpy(Elts.data(), Raw.data(), Raw.size());
+  if (IsVector)
+    return IsFP ? ConstantDataVector::getFP(Ctx, Elts)
+                : ConstantDataVector::get(Ctx, Elts);
+  return IsFP ? ConstantDataArray::getFP(Ctx, Elts)
+              : ConstantDataArray::get(Ctx, Elts);
+}
+
+Constant *ContextCloner::cloneConstant(const Constant *C) {
+  assert(!isa<GlobalValue>(C) && "Global value not in value map!");
+  Type *Ty = mapType(C->getType());
+
+  if (const auto *CI = dyn_cast<ConstantInt>(C))
+    return ConstantInt::get(Ctx, CI->getValue());
+  if (const auto *CFP = dyn_cast<ConstantFP>(C))
+    return ConstantFP::get(Ctx, CFP->getValueAPF());
+  if (isa<ConstantPointerNull>(C))
+    return ConstantPointerNull::get(cast<PointerType>(Ty));
+  if (isa<ConstantAggregateZero>(C))
+    return ConstantAggregateZero::get(Ty);
+  if (isa<UndefValue>(C))
+    return UndefValue::get(Ty);
+  if (const auto *BA = dyn_cast<BlockAddress>(C))
+    return BlockAddress::get(cast<Function>(mapValue(BA->getFunction())),
+                             cast<BasicBlock>(mapValue(BA->getBasicBlock())));
+
+  if (const auto *CDS = dyn_cast<ConstantDataSequential>(C)) {
+    StringRef Raw = CDS->getRawDataValues();
+    bool IsVector = isa<ConstantDataVector>(CDS);
+    bool IsFP = CDS->getElementType()->isFloatingPointTy();
+    switch (CDS->getElementByteSize()) {
+    case 1: {
+      ArrayRef<uint8_t> Bytes(Raw.bytes_begin(), Raw.bytes_end());
+      return IsVector ? ConstantDataVector::get(Ctx, Bytes)
+                      : ConstantDataArray::get(Ctx, Bytes);
+    }
+    case 2:
+      return cloneDataElements<uint16_t>(Ctx, Raw, IsVector, IsFP);
+    case 4:
+      return cloneDataElements<uint32_t>(Ctx, Raw, IsVector, IsFP);
+    case 8:
+      return cloneDataElements<uint64_t>(Ctx, Raw, IsVector, IsFP);
+    default:
+      llvm_unreachable("Unexpected ConstantDataSequential element size");
+    }
+  }
+
+  SmallVector<Constant *, 8> Ops;
+  for (unsigned I = 0, E = C->getNumOperands(); I != E; ++I)
+    Ops.push_back(mapConstant(cast<Constant>(C->getOperand(I))));
+
+  if (const auto *CE = dyn_cast<ConstantExpr>(C)) {
+    Type *SrcTy = nullptr;
+    if (const auto *GEPO = dyn_cast<GEPOperator>(CE))
+      SrcTy = mapType(GEPO->getSourceElementType());
+    return CE->getWithOperands(Ops, Ty, /*OnlyIfReduced=*/false, SrcTy);
+  }
+  if (isa<ConstantArray>(C))
+    return ConstantArray::get(cast<ArrayType>(Ty), Ops);
+  if (isa<ConstantStruct>(C))
+    return ConstantStruct::get(cast<StructType>(Ty), Ops);
+  assert(isa<ConstantVector>(C) && "Unknown constant kind");
+  return ConstantVector::get(Ops);
+}
+
+/// Create a temporary copy of \p N in \p Ctx.  The copy's operands still point
+/// into the source context and have to be remapped by the caller.
+static TempMDNode cloneNodeIntoContext(const MDNode &N, LLVMContext &Ctx) {
+  switch (N.getMetadataID()) {
+  default:
+    llvm_unreachable("Invalid MDNode subclass");
+  case Metadata::MDTupleKind:
+    return MDTuple::getTemporary(
+        Ctx, SmallVector<Metadata *, 4>(N.op_begin(), N.op_end()));
+  case Metadata::DILocationKind: {
+    const auto &L = cast<DILocation>(N);
+    return DILocation::getTemporary(Ctx, L.getLine(), L.getColumn(),
+                                    L.getRawScope(), L.getRawInlinedAt());
+  }
+  case Metadata::DIExpressionKind:
+    return DIExpression::getTemporary(Ctx,
+                                      cast<DIExpression>(N).getElements());
+  case Metadata::GenericDINodeKind: {
+    const auto &G = cast<GenericDINode>(N);
+    return GenericDINode::getTemporary(
+        Ctx, G.getTag(), G.getHeader(),
+        SmallVector<Metadata *, 4>(G.dwarf_op_begin(), G.dwarf_op_end()));
+  }
+  case Metadata::DISubrangeKind: {
+    const auto &S = cast<DISubrange>(N);
+    return DISubrange::getTemporary(Ctx, S.getCount(), S.getLowerBound());
+  }
+  case Metadata::DIEnumeratorKind: {
+    const auto &E = cast<DIEnumerator>(N);
+    return DIEnumerator::getTemporary(Ctx, E.getValue(), E.getRawName());
+  }
+  case Metadata::DIBasicTypeKind: {
+    const auto &T = cast<DIBasicType>(N);
+    return DIBasicType::getTemporary(Ctx, T.getTag(), T.getRawName(),
+                                     T.getSizeInBits(), T.getAlignInBits(),
+                                     T.getEncoding());
+  }
+  case Metadata::DIDerivedTypeKind: {
+    const auto &T = cast<DIDerivedType>(N);
+    return DIDerivedType::getTemporary(
+        Ctx, T.getTag(), T.getRawName(), T.getRawFile(), T.getLine(),
+        T.getRawScope(), T.getRawBaseType(), T.getSizeInBits(),
+        T.getAlignInBits(), T.getOffsetInBits(), T.getFlags(),
+        T.getRawExtraData());
+  }
+  case Metadata::DICompositeTypeKind: {
+    const auto &T = cast<DICompositeType>(N);
+    return DICompositeType::getTemporary(
+        Ctx, T.getTag(), T.getRawName(), T.getRawFile(), T.getLine(),
+        T.getRawScope(), T.getRawBaseType(), T.getSizeInBits(),
+        T.getAlignInBits(), T.getOffsetInBits(), T.getFlags(),
+        T.getRawElements(), T.getRuntimeLang(), T.getRawVTableHolder(),
+        T.getRawTemplateParams(), T.getRawIdentifier());
+  }
+  case Metadata::DISubroutineTypeKind: {
+    const auto &T = cast<DISubroutineType>(N);
+    return DISubroutineType::getTemporary(Ctx, T.getFlags(),
+                                          T.getRawTypeArray());
+  }
+  case Metadata::DIFileKind: {
+    const auto &F = cast<DIFile>(N);
+    return DIFile::getTemporary(Ctx, F.getRawFilename(),
+                                F.getRawDirectory());
+  }
+  case Metadata::DICompileUnitKind: {
+    const auto &CU = cast<DICompileUnit>(N);
+    return DICompileUnit::getTemporary(
+        Ctx, CU.getSourceLanguage(), CU.getRawFile(), CU.getRawProducer(),
+        CU.isOptimized(), CU.getRawFlags(), CU.getRuntimeVersion(),
+        CU.getRawSplitDebugFilename(), CU.getEmissionKind(),
+        CU.getRawEnumTypes(), CU.getRawRetainedTypes(),
+        CU.getRawSubprograms(), CU.getRawGlobalVariables(),
+        CU.getRawImportedEntities(), CU.getDWOId());
+  }
+  case Metadata::DISubprogramKind: {
+    const auto &SP = cast<DISubprogram>(N);
+    return DISubprogram::getTemporary(
+        Ctx, SP.getRawScope(), SP.getRawName(), SP.getRawLinkageName(),
+        SP.getRawFile(), SP.getLine(), SP.getRawType(), SP.isLocalToUnit(),
+        SP.isDefinition(), SP.getScopeLine(), SP.getRawContainingType(),
+        SP.getVirtuality(), SP.getVirtualIndex(), SP.getFlags(),
+        SP.isOptimized(), SP.getRawFunction(), SP.getRawTemplateParams(),
+        SP.getRawDeclaration(), SP.getRawVariables());
+  }
+  case Metadata::DILexicalBlockKind: {
+    const auto &LB = cast<DILexicalBlock>(N);
+    return DILexicalBlock::getTemporary(Ctx, LB.getRawScope(), LB.getRawFile(),
+                                        LB.getLine(), LB.getColumn());
+  }
+  case Metadata::DILexicalBlockFileKind: {
+    const auto &LBF = cast<DILexicalBlockFile>(N);
+    return DILexicalBlockFile::getTemporary(
+        Ctx, LBF.getRawScope(), LBF.getRawFile(), LBF.getDiscriminator());
+  }
+  case Metadata::DINamespaceKind: {
+    const auto &NS = cast<DINamespace>(N);
+    return DINamespace::getTemporary(Ctx, NS.getRawScope(), NS.getRawFile(),
+                                     NS.getRawName(), NS.getLine());
+  }
+  case Metadata::DIModuleKind: {
+    const auto &Mod = cast<DIModule>(N);
+    return DIModule::getTemporary(
+        Ctx, Mod.getRawScope(), Mod.getRawName(),
+        Mod.getRawConfigurationMacros(), Mod.getRawIncludePath(),
+        Mod.getRawISysRoot());
+  }
+  case Metadata::DITemplateTypeParameterKind: {
+    const auto &P = cast<DITemplateTypeParameter>(N);
+    return DITemplateTypeParameter::getTemporary(Ctx, P.getRawName(),
+                                                 P.getRawType());
+  }
+  case Metadata::DITemplateValueParameterKind: {
+    const auto &P = cast<DITemplateValueParameter>(N);
+    return DITemplateValueParameter::getTemporary(
+        Ctx, P.getTag(), P.getRawName(), P.getRawType(), P.getValue());
+  }
+  case Metadata::DIGlobalVariableKind: {
+    const auto &GV = cast<DIGlobalVariable>(N);
+    return DIGlobalVariable::getTemporary(
+        Ctx, GV.getRawScope(), GV.getRawName(), GV.getRawLinkageName(),
+        GV.getRawFile(), GV.getLine(), GV.getRawType(), GV.isLocalToUnit(),
+        GV.isDefinition(), GV.getRawVariable(),
+        GV.getRawStaticDataMemberDeclaration());
+  }
+  case Metadata::DILocalVariableKind: {
+    const auto &LV = cast<DILocalVariable>(N);
+    return DILocalVariable::getTemporary(
+        Ctx, LV.getRawScope(), LV.getRawName(), LV.getRawFile(), LV.getLine(),
+        LV.getRawType(), LV.getArg(), LV.getFlags());
+  }
+  case Metadata::DIObjCPropertyKind: {
+    const auto &P = cast<DIObjCProperty>(N);
+    return DIObjCProperty::getTemporary(
+        Ctx, P.getRawName(), P.getRawFile(), P.getLine(),
+        P.getRawGetterName(), P.getRawSetterName(), P.getAttributes(),
+        P.getRawType());
+  }
+  case Metadata::DIImportedEntityKind: {
+    const auto &IE = cast<DIImportedEntity>(N);
+    return DIImportedEntity::getTemporary(Ctx, IE.getTag(), IE.getRawScope(),
+                                          IE.getRawEntity(), IE.getLine(),
+                                          IE.getRawName());
+  }
+  }
+}
+
+/// Resolve uniquing cycles involving the given metadata.
+static void resolveCycles(Metadata *MD) {
+  if (auto *N = dyn_cast_or_null<MDNode>(MD))
+    if (!N->isResolved())
+      N->resolveCycles();
+}
+
+Metadata *ContextCloner::mapMetadata(const Metadata *MD) {
+  Metadata *NewMD = mapMetadataImpl(MD);
+
+  // Resolve cycles involving the entry metadata.
+  resolveCycles(NewMD);
+
+  // Remap the operands of distinct MDNodes.
+  while (!DistinctWorklist.empty())
+    remapOperands(*DistinctWorklist.pop_back_val());
+
+  return NewMD;
+}
+
+Metadata *ContextCloner::mapMetadataImpl(const Metadata *MD) {
+  if (!MD)
+    return nullptr;
+
+  // If the metadata already exists in the map, use it.
+  if (Metadata *NewMD = MappedMDs.lookup(MD).get())
+    return NewMD;
+
+  if (const auto *S = dyn_cast<MDString>(MD))
+    return mapToMetadata(MD, MDString::get(Ctx, S->getString()));
+
+  if (const auto *VMD = dyn_cast<ValueAsMetadata>(MD))
+    return mapToMetadata(MD, ValueAsMetadata::get(mapValue(VMD->getValue())));
+
+  const auto *N = cast<MDNode>(MD);
+  assert(N->isResolved() && "Unexpected unresolved node");
+
+  // Distinct nodes are created immediately and have their operands remapped
+  // later, which keeps the recursion shallow on large debug info graphs.
+  if (N->isDistinct()) {
+    MDNode *NewN = MDNode::replaceWithDistinct(cloneNodeIntoContext(*N, Ctx));
+    DistinctWorklist.push_back(NewN);
+    return mapToMetadata(MD, NewN);
+  }
+
+  // Map a temporary up front in case we have a uniquing cycle.  The mapping
+  // is updated through RAUW when the node is uniqued.
+  TempMDNode ClonedN = cloneNodeIntoContext(*N, Ctx);
+  mapToMetadata(MD, ClonedN.get());
+  remapOperands(*ClonedN);
+  return MDNode::replaceWithUniqued(std::move(ClonedN));
+}
+
+/// Remap the operands of a node created by cloneNodeIntoContext.
+///
+/// If \c N is distinct, uniquing cycles are resolved as they're found.
+void ContextCloner::remapOperands(MDNode &N) {
+  const bool IsDistinct = N.isDistinct();
+  for (unsigned I = 0, E = N.getNumOperands(); I != E; ++I) {
+    Metadata *Old = N.getOperand(I);
+    Metadata *New = mapMetadataImpl(Old);
+    if (Old == New)
+      continue;
+    N.replaceOperandWith(I, New);
+    if (IsDistinct)
+      resolveCycles(New);
+  }
+}
+
+AttributeSet ContextCloner::mapAttributes(AttributeSet Attrs) {
+  SmallVector<AttributeSet, 4> Slots;
+  for (unsigned I = 0, E = Attrs.getNumSlots(); I != E; ++I) {
+    unsigned Index = Attrs.getSlotIndex(I);
+    Slots.push_back(AttributeSet::get(Ctx, Index, AttrBuilder(Attrs, Index)));
+  }
+  return AttributeSet::get(Ctx, Slots);
+}
+
+void ContextCloner::mapComdat(const GlobalObject &GO, GlobalObject &NewGO) {
+  if (const Comdat *C = GO.getComdat())
+    NewGO.setComdat(DstM.getOrInsertComdat(C->getName()));
+}
+
+void ContextCloner::cloneFunctionBody(const Function &F) {
+  // Clone every instruction before remapping any operands, since operands
+  // (and LocalAsMetadata) may refer to values defined later in the function.
+  SmallVector<std::pair<const Instruction *, Instruction *>, 64> Clones;
+  for (const BasicBlock &BB : F) {
+    BasicBlock *NewBB = cast<BasicBlock>(MappedValues[&BB]);
+    for (const Instruction &I : BB) {
+      Instruction *NewI = I.clone();
+      // clone() copies the attachments into the source context.  Drop them
+      // while the instruction still belongs there; they are remapped below.
+      NewI->dropUnknownNonDebugMetadata();
+      NewI->setDebugLoc(DebugLoc());
+      NewI->mutateType(mapType(I.getType()));
+      NewBB->getInstList().push_back(NewI);
+      NewI->setName(I.getName());
+      MappedValues[&I] = NewI;
+      Clones.push_back(std::make_pair(&I, NewI));
+    }
+  }
+
+  for (const auto &Clone : Clones)
+    remapInstruction(*Clone.first, *Clone.second);
+}
+
+void ContextCloner::remapInstruction(const Instruction &I,
+                                     Instruction &NewI) {
+  for (unsigned Op = 0, E = I.getNumOperands(); Op != E; ++Op)
+    NewI.setOperand(Op, mapValue(I.getOperand(Op)));
+
+  if (const auto *PN = dyn_cast<PHINode>(&I))
+    for (unsigned Op = 0, E = PN->getNumIncomingValues(); Op != E; ++Op)
+      cast<PHINode>(NewI).setIncomingBlock(
+          Op, cast<BasicBlock>(mapValue(PN->getIncomingBlock(Op))));
+
+  SmallVector<std::pair<unsigned, MDNode *>, 4> MDs;
+  I.getAllMetadataOtherThanDebugLoc(MDs);
+  for (const auto &MD : MDs)
+    NewI.setMetadata(MDKinds[MD.first], mapMDNode(MD.second));
+  if (const DILocation *Loc = I.getDebugLoc())
+    NewI.setDebugLoc(DebugLoc(cast<DILocation>(mapMDNode(Loc))));
+
+  // Finally, remap the types that instructions keep besides their own.
+  if (auto CS = CallSite(&NewI)) {
+    ImmutableCallSite SrcCS(&I);
+    CS.mutateFunctionType(
+        cast<FunctionType>(mapType(SrcCS.getFunctionType())));
+    CS.setAttributes(mapAttributes(SrcCS.getAttributes()));
+  } else if (const auto *AI = dyn_cast<AllocaInst>(&I)) {
+    cast<AllocaInst>(NewI).setAllocatedType(mapType(AI->getAllocatedType()));
+  } else if (const auto *GEP = dyn_cast<GetElementPtrInst>(&I)) {
+    auto &NewGEP = cast<GetElementPtrInst>(NewI);
+    NewGEP.setSourceElementType(mapType(GEP->getSourceElementType()));
+    NewGEP.setResultElementType(mapType(GEP->getResultElementType()));
+  }
+}
+
+void ContextCloner::cloneModule() {
+  DstM.setDataLayout(SrcM.getDataLayout());
+  DstM.setTargetTriple(SrcM.getTargetTriple());
+  DstM.setModuleInlineAsm(SrcM.getModuleInlineAsm());
+
+  for (const auto &C : SrcM.getComdatSymbolTable())
+    DstM.getOrInsertComdat(C.getKey())
+        ->setSelectionKind(C.getValue().getSelectionKind());
+
+  // Create all of the global values first so that anything can refer to them.
+  for (const GlobalVariable &GV : SrcM.globals()) {
+    auto *NewGV = new GlobalVariable(
+        DstM, mapType(GV.getValueType()), GV.isConstant(), GV.getLinkage(),
+        (Constant *)nullptr, GV.getName(), (GlobalVariable *)nullptr,
+        GV.getThreadLocalMode(), GV.getType()->getAddressSpace());
+    NewGV->copyAttributesFrom(&GV);
+    MappedValues[&GV] = NewGV;
+  }
+
+  for (const Function &F : SrcM) {
+    Function *NF =
+        Function::Create(cast<FunctionType>(mapType(F.getFunctionType())),
+                         F.getLinkage(), F.getName(), &DstM);
+    // Function::copyAttributesFrom would share the source context's
+    // attributes and constants, so only take the context-free parts from it.
+    NF->GlobalObject::copyAttributesFrom(&F);
+    NF->setCallingConv(F.getCallingConv());
+    NF->setAttributes(mapAttributes(F.getAttributes()));
+    if (F.hasGC())
+      NF->setGC(F.getGC());
+    MappedValues[&F] = NF;
+  }
+
+  for (const GlobalAlias &GA : SrcM.aliases()) {
+    auto *NewGA = GlobalAlias::create(
+        mapType(GA.getValueType()), GA.getType()->getPointerAddressSpace(),
+        GA.getLinkage(), GA.getName(), &DstM);
+    NewGA->copyAttributesFrom(&GA);
+    MappedValues[&GA] = NewGA;
+  }
+
+  // Arguments and basic blocks may be referenced from constants (blockaddress)
+  // and metadata, so create them before mapping any initializers.
+  for (const Function &F : SrcM) {
+    if (F.isDeclaration())
+      continue;
+    Function *NF = cast<Function>(MappedValues[&F]);
+    Function::arg_iterator DestI = NF->arg_begin();
+    for (const Argument &A : F.args()) {
+      DestI->setName(A.getName());
+      MappedValues[&A] = &*DestI++;
+    }
+    for (const BasicBlock &BB : F)
+      MappedValues[&BB] = BasicBlock::Create(Ctx, BB.getName(), NF);
+  }
+
+  for (const GlobalVariable &GV : SrcM.globals()) {
+    auto *NewGV = cast<GlobalVariable>(MappedValues[&GV]);
+    mapComdat(GV, *NewGV);
+    if (GV.hasInitializer())
+      NewGV->setInitializer(mapConstant(GV.getInitializer()));
+  }
+
+  for (const Function &F : SrcM) {
+    auto *NF = cast<Function>(MappedValues[&F]);
+    mapComdat(F, *NF);
+    if (F.hasPersonalityFn())
+      NF->setPersonalityFn(mapConstant(F.getPersonalityFn()));
+    if (F.hasPrefixData())
+      NF->setPrefixData(mapConstant(F.getPrefixData()));
+    if (F.hasPrologueData())
+      NF->setPrologueData(mapConstant(F.getPrologueData()));
+
+    SmallVector<std::pair<unsigned, MDNode *>, 4> MDs;
+    F.getAllMetadata(MDs);
+    for (const auto &MD : MDs)
+      NF->setMetadata(MDKinds[MD.first], mapMDNode(MD.second));
+
+    if (!F.isDeclaration())
+      cloneFunctionBody(F);
+  }
+
+  for (const GlobalAlias &GA : SrcM.aliases())
+    if (const Constant *C = GA.getAliasee())
+      cast<GlobalAlias>(MappedValues[&GA])->setAliasee(mapConstant(C));
+
+  for (const NamedMDNode &NMD : SrcM.named_metadata()) {
+    NamedMDNode *NewNMD = DstM.getOrInsertNamedMetadata(NMD.getName());
+    for (unsigned i = 0, e = NMD.getNumOperands(); i != e; ++i)
+      NewNMD->addOperand(mapMDNode(NMD.getOperand(i)));
+  }
+}
+
+std::unique_ptr<Module> llvm::CloneModuleIntoContext(const Module *M,
+                                                     LLVMContext &Ctx) {
+  auto New = llvm::make_unique<Module>(M->getModuleIdentifier(), Ctx);
+  ContextCloner(*M, *New).cloneModule();
+  return New;
+}
+
 extern "C" {
 
 LLVMModuleRef LLVMCloneModule(LLVMModuleRef M) {
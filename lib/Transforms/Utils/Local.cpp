@@ -360,13 +360,11 @@ llvm::RecursivelyDeleteTriviallyDeadInstructions(Value *V,
       Value *OpV = I->getOperand(i);
       I->setOperand(i, nullptr);
 
-      if (!OpV->use_empty()) continue;
-
       // If the operand is an instruction that became dead as we nulled out the
       // operand, and if it is 'trivially' dead, delete it in a future loop
       // iteration.
       if (Instruction *OpI = dyn_cast<Instruction>(OpV))
-        if (isInstructionTriviallyDead(OpI, TLI))
+        if (OpI->use_empty() && isInstructionTriviallyDead(OpI, TLI))
           DeadInsts.push_back(OpI);
     }
 
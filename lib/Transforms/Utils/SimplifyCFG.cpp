@@ -529,9 +529,10 @@ Value *SimplifyCFGOpt::isValueEqualityComparison(TerminatorInst *TI) {
                                              pred_end(SI->getParent())) <= 128)
       CV = SI->getCondition();
   } else if (BranchInst *BI = dyn_cast<BranchInst>(TI))
-    if (BI->isConditional() && BI->getCondition()->hasOneUse())
+    if (BI->isConditional())
       if (ICmpInst *ICI = dyn_cast<ICmpInst>(BI->getCondition())) {
-        if (ICI->isEquality() && GetConstantInt(ICI->getOperand(1), DL))
+        if (ICI->hasOneUse() && ICI->isEquality() &&
+            GetConstantInt(ICI->getOperand(1), DL))
           CV = ICI->getOperand(0);
       }
 
@@ -2169,7 +2170,7 @@ bool llvm::FoldBranchToCommonDest(BranchInst *BI, unsigned BonusInstThreshold) {
     if (InvertPredCond) {
       Value *NewCond = PBI->getCondition();
 
-      if (NewCond->hasOneUse() && isa<CmpInst>(NewCond)) {
+      if (isa<CmpInst>(NewCond) && NewCond->hasOneUse()) {
         CmpInst *CI = cast<CmpInst>(NewCond);
         CI->setPredicate(CI->getInversePredicate());
       } else {
@@ -0,0 +1,46 @@
+; RUN: llvm-as -function-summary < %s | llvm-bcanalyzer -dump | FileCheck %s -check-prefix=BC
+; RUN: llvm-as -function-summary < %s | llvm-dis | FileCheck %s
+
+; The summary block follows the function bodies and describes each
+; definition: declarations and unnamed functions get no entry.  A NAME record
+; is emitted the first time an entry or a call refers to the name.
+
+; BC: <FNSUMMARY_OFFSET
+; BC: <FUNCTION_SUMMARY_BLOCK
+; 'foo' and 'bar'
+; BC-NEXT: <NAME {{.*}} op0=102 op1=111 op2=111/>
+; BC-NEXT: <NAME {{.*}} op0=98 op1=97 op2=114/>
+; foo has two instructions and calls bar.
+; BC-NEXT: <PERMODULE_ENTRY op0={{[0-9]+}} op1=0 op2=0 op3=0 op4=2 op5={{[0-9]+}} op6=1/>
+; 'baz'
+; BC-NEXT: <NAME {{.*}} op0=98 op1=97 op2=122/>
+; bar has two instructions too: debug intrinsics are not counted.
+; BC-NEXT: <PERMODULE_ENTRY op0={{[0-9]+}} op1=1 op2=0 op3=0 op4=2 op5={{[0-9]+}} op6=2/>
+; BC-NEXT: </FUNCTION_SUMMARY_BLOCK>
+
+; CHECK: define i32 @foo()
+define i32 @foo() {
+  %x = call i32 @bar()
+  ret i32 %x
+}
+
+; CHECK: define i32 @bar()
+define i32 @bar() {
+  %x = call i32 @baz()
+  call void @llvm.dbg.value(metadata i32 %x, i64 0, metadata !4, metadata !DIExpression()), !dbg !5
+  ret i32 %x
+}
+
+declare i32 @baz()
+
+declare void @llvm.dbg.value(metadata, i64, metadata, metadata)
+
+!llvm.module.flags = !{!6}
+
+!0 = distinct !DISubprogram(name: "bar", isDefinition: true, file: !1, scope: !1, type: !2, function: i32 ()* @bar)
+!1 = !DIFile(filename: "function-summary.c", directory: "/tmp")
+!2 = !DISubroutineType(types: !{!3})
+!3 = !DIBasicType(tag: DW_TAG_base_type, name: "int", size: 32, align: 32, encoding: DW_ATE_signed)
+!4 = !DILocalVariable(name: "x", scope: !0, file: !1, type: !3)
+!5 = !DILocation(line: 1, scope: !0)
+!6 = !{i32 1, !"Debug Info Version", i32 3}
@@ -0,0 +1,3 @@
+define i32 @FA() {
+  ret i32 0
+}
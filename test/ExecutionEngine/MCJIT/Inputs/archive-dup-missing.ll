@@ -0,0 +1,6 @@
+declare i32 @FMissing()
+
+define i32 @main() {
+  %r = call i32 @FMissing()
+  ret i32 %r
+}
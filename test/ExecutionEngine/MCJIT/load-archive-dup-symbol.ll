@@ -0,0 +1,24 @@
+; Build two objects that both define FA and put them into one archive, so
+; its symbol table lists FA twice.
+; RUN: rm -rf %t.cachedir %t.cachedir2 %t.cachedir3
+; RUN: mkdir -p %t.cachedir %t.cachedir2 %t.cachedir3
+; RUN: %lli -extra-module=%p/Inputs/archive-dup-a.ll -enable-cache-manager -object-cache-dir=%t.cachedir %s
+; RUN: not %lli -extra-module=%p/Inputs/archive-dup-b.ll -enable-cache-manager -object-cache-dir=%t.cachedir %s
+; RUN: find %t.cachedir -type f -name 'archive-dup-?.o' -exec mv -v '{}' %t.cachedir2 ';'
+; RUN: llvm-ar r %t.cachedir3/load-archive.a %t.cachedir2/archive-dup-a.o
+; RUN: llvm-ar r %t.cachedir3/load-archive.a %t.cachedir2/archive-dup-b.o
+
+; The first member that defines FA wins, so main returns 0.
+; RUN: %lli -extra-archive=%t.cachedir3/load-archive.a %s
+
+; A name that is not in the symbol table is not found in the archive.
+; RUN: not %lli -extra-archive=%t.cachedir3/load-archive.a \
+; RUN:     %p/Inputs/archive-dup-missing.ll 2>&1 | FileCheck %s
+; CHECK: Program used external function 'FMissing' which could not be resolved!
+
+declare i32 @FA()
+
+define i32 @main() {
+  %r = call i32 @FA()
+  ret i32 %r
+}
@@ -0,0 +1,35 @@
+; RUN: rm -rf %t.cache
+; RUN: lli -jit-kind=orc-lazy -orc-lazy-cache-dir=%t.cache -debug-only=orc %s 2>&1 | FileCheck -check-prefix=FIRST %s
+; RUN: lli -jit-kind=orc-lazy -orc-lazy-cache-dir=%t.cache -debug-only=orc %s 2>&1 | FileCheck -check-prefix=SECOND %s
+; REQUIRES: asserts
+;
+; The first run compiles and caches the function partitions. The second one
+; loads them instead of compiling. The stubs module refers to the addresses
+; of the trampolines of each run, so it is never reused.
+;
+; FIRST-NOT: Loaded cached object
+; FIRST-DAG: Cached object {{.*}} for module {{.*}}.main
+; FIRST-DAG: Cached object {{.*}} for module {{.*}}.foo
+; FIRST: 42
+;
+; SECOND-DAG: Loaded cached object {{.*}} for module {{.*}}.main
+; SECOND-DAG: Loaded cached object {{.*}} for module {{.*}}.foo
+; SECOND-NOT: Cached object {{.*}}.main
+; SECOND-NOT: Cached object {{.*}}.foo
+; SECOND: 42
+
+@fmt = private unnamed_addr constant [4 x i8] c"%d\0A\00"
+
+declare i32 @printf(i8*, ...)
+
+define i32 @foo() {
+entry:
+  ret i32 42
+}
+
+define i32 @main(i32 %argc, i8** %argv) {
+entry:
+  %0 = call i32 @foo()
+  %1 = call i32 (i8*, ...) @printf(i8* getelementptr inbounds ([4 x i8], [4 x i8]* @fmt, i64 0, i64 0), i32 %0)
+  ret i32 0
+}
@@ -0,0 +1,67 @@
+; RUN: lli -jit-kind=orc-lazy -orc-lazy-compile-threads=2 %s | FileCheck %s
+; RUN: lli -jit-kind=orc-lazy -orc-lazy-compile-threads=2 -debug-only=orc-cod \
+; RUN:   %s 2>&1 >/dev/null | FileCheck --check-prefix=COMPILE %s
+; RUN: lli -jit-kind=orc-lazy -orc-lazy-compile-threads=2 -debug-only=orc-cod \
+; RUN:   %s 2>&1 >/dev/null | FileCheck --check-prefix=ONCALL %s
+; REQUIRES: asserts
+;
+; The callees of main are compiled in the background while it runs. Each
+; one must still be called exactly once, with its code complete.
+;
+; CHECK: Hello
+; CHECK-NEXT: Goodbye
+; CHECK-NEXT: 42
+;
+; Only main is compiled when it is first called. Its callees, and theirs, are
+; queued for compilation before main can reach them, so their stubs wait for
+; the background compiles instead of compiling them again.
+;
+; COMPILE: Compiling main on call
+; COMPILE-DAG: Compiling hello in the background
+; COMPILE-DAG: Compiling goodbye in the background
+; COMPILE-DAG: Compiling answer in the background
+; COMPILE-DAG: Compiling add in the background
+;
+; ONCALL: Compiling main on call
+; ONCALL-NOT: on call
+
+@hello_str = private unnamed_addr constant [6 x i8] c"Hello\00"
+@goodbye_str = private unnamed_addr constant [8 x i8] c"Goodbye\00"
+@int_fmt = private unnamed_addr constant [4 x i8] c"%d\0A\00"
+
+declare i32 @puts(i8*)
+declare i32 @printf(i8*, ...)
+
+define void @hello() {
+entry:
+  %0 = call i32 @puts(i8* getelementptr inbounds ([6 x i8], [6 x i8]* @hello_str, i64 0, i64 0))
+  ret void
+}
+
+define void @goodbye() {
+entry:
+  %0 = call i32 @puts(i8* getelementptr inbounds ([8 x i8], [8 x i8]* @goodbye_str, i64 0, i64 0))
+  ret void
+}
+
+define i32 @add(i32 %a, i32 %b) {
+entry:
+  %sum = add i32 %a, %b
+  ret i32 %sum
+}
+
+define i32 @answer() {
+entry:
+  %0 = call i32 @add(i32 40, i32 1)
+  %1 = call i32 @add(i32 %0, i32 1)
+  ret i32 %1
+}
+
+define i32 @main(i32 %argc, i8** %argv) {
+entry:
+  call void @hello()
+  call void @goodbye()
+  %0 = call i32 @answer()
+  %1 = call i32 (i8*, ...) @printf(i8* getelementptr inbounds ([4 x i8], [4 x i8]* @int_fmt, i64 0, i64 0), i32 %0)
+  ret i32 0
+}
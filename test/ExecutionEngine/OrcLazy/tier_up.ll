@@ -0,0 +1,74 @@
+; RUN: lli -jit-kind=orc-lazy -orc-lazy-tier-up-threshold=10 -debug-only=orc-lazy %s 2>&1 | FileCheck %s
+; REQUIRES: asserts
+;
+; Both functions called in the loop become hot and are recompiled with full
+; optimization while main runs. The result must not change.
+;
+; CHECK-DAG: recompiled hot function square at -O2
+; CHECK-DAG: recompiled hot function sum_squares at -O2
+; CHECK-DAG: 269048
+
+@fmt = private unnamed_addr constant [4 x i8] c"%d\0A\00"
+
+declare i32 @printf(i8*, ...)
+
+define internal i32 @square(i32 %x) {
+entry:
+  %r = mul i32 %x, %x
+  ret i32 %r
+}
+
+define i32 @sum_squares(i32 %n) {
+entry:
+  %acc = alloca i32
+  %i = alloca i32
+  store i32 0, i32* %acc
+  store i32 0, i32* %i
+  br label %loop
+
+loop:
+  %iv = load i32, i32* %i
+  %done = icmp sge i32 %iv, %n
+  br i1 %done, label %exit, label %body
+
+body:
+  %sq = call i32 @square(i32 %iv)
+  %a = load i32, i32* %acc
+  %a2 = add i32 %a, %sq
+  store i32 %a2, i32* %acc
+  %iv2 = add i32 %iv, 1
+  store i32 %iv2, i32* %i
+  br label %loop
+
+exit:
+  %res = load i32, i32* %acc
+  ret i32 %res
+}
+
+define i32 @main(i32 %argc, i8** %argv) {
+entry:
+  %total = alloca i32
+  %k = alloca i32
+  store i32 0, i32* %total
+  store i32 0, i32* %k
+  br label %loop
+
+loop:
+  %kv = load i32, i32* %k
+  %done = icmp sge i32 %kv, 200
+  br i1 %done, label %exit, label %body
+
+body:
+  %s = call i32 @sum_squares(i32 %kv)
+  %t = load i32, i32* %total
+  %t2 = xor i32 %t, %s
+  store i32 %t2, i32* %total
+  %kv2 = add i32 %kv, 1
+  store i32 %kv2, i32* %k
+  br label %loop
+
+exit:
+  %r = load i32, i32* %total
+  %p = call i32 (i8*, ...) @printf(i8* getelementptr inbounds ([4 x i8], [4 x i8]* @fmt, i64 0, i64 0), i32 %r)
+  ret i32 0
+}
@@ -0,0 +1,40 @@
+# RUN: llvm-mc -triple=x86_64-pc-linux -filetype=obj -o %t %s
+# RUN: llvm-rtdyld -triple=x86_64-pc-linux -verify -check=%s %t
+# RUN: llvm-rtdyld -triple=x86_64-pc-linux -verify -threads=4 -check=%s %t
+
+# Enough relocations in each section for them to be resolved on several
+# threads when -threads is given.
+
+	.section	.text.f,"ax",@progbits
+	.globl	f
+	.align	16, 0x90
+	.type	f,@function
+f:
+	.rept	1500
+	leaq	g(%rip), %rax
+	.endr
+# rtdyld-check: decode_operand(f_last, 4) = g - next_pc(f_last)
+f_last:
+	leaq	g(%rip), %rax
+	retq
+
+	.section	.text.g,"ax",@progbits
+	.globl	g
+	.align	16, 0x90
+	.type	g,@function
+g:
+	.rept	1500
+	leaq	f(%rip), %rax
+	.endr
+# rtdyld-check: decode_operand(g_last, 4) = f - next_pc(g_last)
+g_last:
+	leaq	f(%rip), %rax
+	retq
+
+	.data
+	.rept	1500
+	.quad	f
+	.endr
+# rtdyld-check: *{8}data_last = g
+data_last:
+	.quad	g
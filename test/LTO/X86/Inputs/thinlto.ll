@@ -0,0 +1,5 @@
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @bar() {
+  ret i32 42
+}
@@ -0,0 +1,27 @@
+; RUN: rm -rf %t.cache
+; RUN: llvm-as %s -o %t.bc
+; RUN: llvm-lto -exported-symbol=foo -cache-dir=%t.cache -cache-stats -o %t.o %t.bc | FileCheck %s --check-prefix=MISS
+; RUN: llvm-lto -exported-symbol=foo -cache-dir=%t.cache -cache-stats -o %t2.o %t.bc | FileCheck %s --check-prefix=HIT
+; RUN: cmp %t.o %t2.o
+
+; Changing an option that affects the output misses.
+; RUN: llvm-lto -exported-symbol=foo -cache-dir=%t.cache -cache-stats -O3 -o %t.o %t.bc | FileCheck %s --check-prefix=MISS
+
+; Each partition is cached separately.
+; RUN: llvm-lto -exported-symbol=foo -cache-dir=%t.cache -cache-stats -j2 -o %t.o %t.bc | FileCheck %s --check-prefix=MISS2
+; RUN: llvm-lto -exported-symbol=foo -cache-dir=%t.cache -cache-stats -j2 -o %t.o %t.bc | FileCheck %s --check-prefix=HIT2
+
+; A size limit evicts the entries once the link is done.
+; RUN: llvm-lto -exported-symbol=foo -cache-dir=%t.cache -cache-max-size=1 -cache-pruning-interval=0 -o %t.o %t.bc
+; RUN: ls %t.cache | not grep llvmcache-
+
+; MISS: Cache hits: 0, misses: 1
+; HIT: Cache hits: 1, misses: 0
+; MISS2: Cache hits: 0, misses: 1
+; HIT2: Cache hits: 2, misses: 0
+
+target triple = "x86_64-unknown-linux-gnu"
+
+define void @foo() {
+  ret void
+}
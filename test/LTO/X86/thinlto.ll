@@ -0,0 +1,44 @@
+; RUN: llvm-as -function-summary %s -o %t.bc
+; RUN: llvm-as -function-summary %p/Inputs/thinlto.ll -o %t2.bc
+; RUN: llvm-lto -thinlto -o %t3 %t.bc %t2.bc
+; RUN: llvm-bcanalyzer -dump %t3.thinlto.bc | FileCheck %s --check-prefix=COMBINED
+; RUN: llvm-lto -thinlto-index=%t3.thinlto.bc -j2 -exported-symbol=main -o %t4.o %t.bc %t2.bc
+; RUN: llvm-nm %t4.o.0 | FileCheck %s --check-prefix=NM0
+; RUN: llvm-nm %t4.o.1 | FileCheck %s --check-prefix=NM1
+
+; The backends are cached separately.
+; RUN: rm -rf %t.cache
+; RUN: llvm-lto -thinlto-index=%t3.thinlto.bc -cache-dir=%t.cache -cache-stats -exported-symbol=main -o %t5.o %t.bc %t2.bc | FileCheck %s --check-prefix=MISS
+; RUN: llvm-lto -thinlto-index=%t3.thinlto.bc -cache-dir=%t.cache -cache-stats -exported-symbol=main -o %t5.o %t.bc %t2.bc | FileCheck %s --check-prefix=HIT
+; RUN: llvm-nm %t5.o.0 | FileCheck %s --check-prefix=NM0
+
+; The combined index lists the path of each module, then the names and an
+; entry for each definition, giving its module and name IDs.
+; COMBINED: <FUNCTION_SUMMARY_BLOCK
+; COMBINED-NEXT: <MODULE_PATH op0=
+; COMBINED-NEXT: <MODULE_PATH op0=
+; 'main' and 'bar'
+; COMBINED-NEXT: <NAME {{.*}} op0=109 op1=97 op2=105 op3=110/>
+; COMBINED-NEXT: <NAME {{.*}} op0=98 op1=97 op2=114/>
+; COMBINED-NEXT: <COMBINED_ENTRY op0=0 op1=0 {{.*}}/>
+; COMBINED-NEXT: <COMBINED_ENTRY op0=1 op1=1 {{.*}}/>
+; COMBINED-NEXT: </FUNCTION_SUMMARY_BLOCK>
+
+; Each backend emits only its own definitions; @bar is imported into the
+; first one and inlined there.
+; NM0: T main
+; NM0-NOT: bar
+; NM1: T bar
+; NM1-NOT: main
+
+; MISS: Cache hits: 0, misses: 2
+; HIT: Cache hits: 2, misses: 0
+
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @main() {
+  %x = call i32 @bar()
+  ret i32 %x
+}
+
+declare i32 @bar()
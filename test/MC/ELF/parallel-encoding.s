@@ -0,0 +1,36 @@
+// Encoding the relocation sections on several threads must give the same
+// object as encoding them serially.
+// RUN: llvm-mc -filetype=obj -triple x86_64-pc-linux-gnu %s -o %t
+// RUN: llvm-mc -filetype=obj -triple x86_64-pc-linux-gnu \
+// RUN:     -elf-encoding-threads=4 %s -o %t.parallel
+// RUN: cmp %t %t.parallel
+// RUN: llvm-readobj -r %t.parallel | FileCheck %s
+
+// CHECK:      Relocations [
+// CHECK-NEXT:   Section ({{[0-9]+}}) .rela.text.f1 {
+// CHECK-NEXT:     0x1 R_X86_64_PC32 g1 0xFFFFFFFFFFFFFFFC
+// CHECK-NEXT:     0x6 R_X86_64_PLT32 h 0xFFFFFFFFFFFFFFFC
+// CHECK-NEXT:   }
+// CHECK-NEXT:   Section ({{[0-9]+}}) .rela.text.f2 {
+// CHECK-NEXT:     0x1 R_X86_64_PC32 g2 0xFFFFFFFFFFFFFFFC
+// CHECK-NEXT:   }
+// CHECK-NEXT:   Section ({{[0-9]+}}) .rela.data.ptrs {
+// CHECK-NEXT:     0x0 R_X86_64_64 f1 0x0
+// CHECK-NEXT:     0x8 R_X86_64_64 f2 0x0
+// CHECK-NEXT:   }
+// CHECK-NEXT: ]
+
+        .section .text.f1,"ax",@progbits
+        .globl f1
+f1:
+        jmp g1
+        call h@PLT
+
+        .section .text.f2,"ax",@progbits
+        .globl f2
+f2:
+        jmp g2
+
+        .section .data.ptrs,"aw",@progbits
+        .quad f1
+        .quad f2
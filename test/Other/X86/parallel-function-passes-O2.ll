@@ -0,0 +1,154 @@
+; The function passes of -O2 run on several threads and give the same result
+; as a serial run, down to the names and order of the lookup tables that
+; SimplifyCFG creates and the order of the use lists.
+; REQUIRES: asserts
+; RUN: opt -S -O2 -preserve-ll-uselistorder < %s > %t.0
+; RUN: opt -S -O2 -preserve-ll-uselistorder -parallel-function-passes=4 \
+; RUN:   -stats < %s > %t.4 2> %t.stats
+; RUN: diff %t.0 %t.4
+; RUN: FileCheck %s < %t.4
+; RUN: FileCheck %s --check-prefix=STATS < %t.stats
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@g = global i32 0
+@h = global [4 x i32] zeroinitializer
+
+; CHECK: @switch.table = private unnamed_addr constant [4 x i32] [i32 7, i32 3, i32 90, i32 12]
+; CHECK-NEXT: @switch.table.1 = private unnamed_addr constant [4 x i32] [i32 8, i32 4, i32 91, i32 13]
+; CHECK-NEXT: @switch.table.2 = private unnamed_addr constant [4 x i32] [i32 9, i32 5, i32 92, i32 14]
+; CHECK-NEXT: @switch.table.3 = private unnamed_addr constant [4 x i32] [i32 6, i32 2, i32 93, i32 15]
+
+; The function pipeline of -O2 and the final verifier run on all functions but
+; the first one in parallel.  The module level function pass managers contain
+; passes that are not parallel safe, like InstCombine, so they run serially.
+; STATS: 8 parallel-function-passes - Number of functions run through function passes in parallel
+
+define i32 @t0(i32 %x) {
+entry:
+  %slot = alloca i32
+  switch i32 %x, label %def [
+    i32 0, label %a
+    i32 1, label %b
+    i32 2, label %c
+    i32 3, label %d
+  ]
+a:
+  store i32 7, i32* %slot
+  br label %out
+b:
+  store i32 3, i32* %slot
+  br label %out
+c:
+  store i32 90, i32* %slot
+  br label %out
+d:
+  store i32 12, i32* %slot
+  br label %out
+def:
+  store i32 0, i32* %slot
+  br label %out
+out:
+  %r = load i32, i32* %slot
+  store i32 %r, i32* getelementptr inbounds ([4 x i32], [4 x i32]* @h, i64 0, i64 1)
+  ret i32 %r
+}
+
+define i32 @t1(i32 %x) {
+entry:
+  %slot = alloca i32
+  switch i32 %x, label %def [
+    i32 0, label %a
+    i32 1, label %b
+    i32 2, label %c
+    i32 3, label %d
+  ]
+a:
+  store i32 8, i32* %slot
+  br label %out
+b:
+  store i32 4, i32* %slot
+  br label %out
+c:
+  store i32 91, i32* %slot
+  br label %out
+d:
+  store i32 13, i32* %slot
+  br label %out
+def:
+  store i32 0, i32* %slot
+  br label %out
+out:
+  %r = load i32, i32* %slot
+  store i32 %r, i32* getelementptr inbounds ([4 x i32], [4 x i32]* @h, i64 0, i64 2)
+  ret i32 %r
+}
+
+define i32 @t2(i32 %x) {
+entry:
+  %slot = alloca i32
+  switch i32 %x, label %def [
+    i32 0, label %a
+    i32 1, label %b
+    i32 2, label %c
+    i32 3, label %d
+  ]
+a:
+  store i32 9, i32* %slot
+  br label %out
+b:
+  store i32 5, i32* %slot
+  br label %out
+c:
+  store i32 92, i32* %slot
+  br label %out
+d:
+  store i32 14, i32* %slot
+  br label %out
+def:
+  store i32 0, i32* %slot
+  br label %out
+out:
+  %r = load i32, i32* %slot
+  store i32 %r, i32* getelementptr inbounds ([4 x i32], [4 x i32]* @h, i64 0, i64 2)
+  ret i32 %r
+}
+
+define i32 @t3(i32 %x) {
+entry:
+  %slot = alloca i32
+  switch i32 %x, label %def [
+    i32 0, label %a
+    i32 1, label %b
+    i32 2, label %c
+    i32 3, label %d
+  ]
+a:
+  store i32 6, i32* %slot
+  br label %out
+b:
+  store i32 2, i32* %slot
+  br label %out
+c:
+  store i32 93, i32* %slot
+  br label %out
+d:
+  store i32 15, i32* %slot
+  br label %out
+def:
+  store i32 0, i32* %slot
+  br label %out
+out:
+  %r = load i32, i32* %slot
+  store i32 %r, i32* @g
+  ret i32 %r
+}
+
+define i32 @main(i32 %x) {
+  %a = call i32 @t0(i32 %x)
+  %b = call i32 @t1(i32 %a)
+  %c = call i32 @t2(i32 %b)
+  %d = call i32 @t3(i32 %c)
+  ret i32 %d
+}
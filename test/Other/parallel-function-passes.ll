@@ -0,0 +1,91 @@
+; Running the function pass pipeline on several threads must give the same
+; result as running it serially, down to the order of the use lists.
+; REQUIRES: asserts
+; RUN: opt -S -preserve-ll-uselistorder -early-cse -dce < %s > %t.0
+; RUN: opt -S -preserve-ll-uselistorder -early-cse -dce \
+; RUN:   -parallel-function-passes=1 < %s > %t.1
+; RUN: opt -S -preserve-ll-uselistorder -early-cse -dce \
+; RUN:   -parallel-function-passes=4 -stats < %s > %t.4 2> %t.stats
+; RUN: diff %t.0 %t.1
+; RUN: diff %t.0 %t.4
+; RUN: FileCheck %s < %t.4
+; RUN: FileCheck %s --check-prefix=STATS < %t.stats
+
+; The first function always runs serially.
+; STATS: 5 parallel-function-passes - Number of functions run through function passes in parallel
+
+@g = global i32 0
+@h = global [4 x i32] zeroinitializer
+
+; CHECK-LABEL: @f1(
+; CHECK: %a = add i32 %x, 1
+; CHECK-NEXT: store i32 %a, i32* @g
+; CHECK-NEXT: store i32 %a, i32* getelementptr inbounds ([4 x i32], [4 x i32]* @h, i32 0, i32 1)
+; CHECK-NEXT: ret i32 %a
+define i32 @f1(i32 %x) {
+  %a = add i32 %x, 1
+  %b = add i32 %x, 1
+  %dead = mul i32 %x, 7
+  store i32 %a, i32* @g
+  store i32 %b, i32* getelementptr inbounds ([4 x i32], [4 x i32]* @h, i32 0, i32 1)
+  ret i32 %b
+}
+
+; CHECK-LABEL: @f2(
+; CHECK: %v = load i32, i32* @g
+; CHECK-NEXT: %s = add i32 %v, %v
+; CHECK-NEXT: ret i32 %s
+define i32 @f2() {
+  %v = load i32, i32* @g
+  %w = load i32, i32* @g
+  %s = add i32 %v, %w
+  ret i32 %s
+}
+
+; CHECK-LABEL: @f3(
+; CHECK: call i32 @f1(i32 %x)
+; CHECK-NEXT: store i32 {{.*}}, i32* getelementptr inbounds ([4 x i32], [4 x i32]* @h, i32 0, i32 2)
+define void @f3(i32 %x) {
+  %r = call i32 @f1(i32 %x)
+  %c = add i32 %x, %x
+  %unused = add i32 %c, 3
+  store i32 %r, i32* getelementptr inbounds ([4 x i32], [4 x i32]* @h, i32 0, i32 2)
+  ret void
+}
+
+; CHECK-LABEL: @f4(
+; CHECK: call void @f3(i32 %x)
+; CHECK-NEXT: call void @f3(i32 %x)
+; CHECK-NEXT: ret void
+define void @f4(i32 %x) {
+  call void @f3(i32 %x)
+  %t = xor i32 %x, -1
+  call void @f3(i32 %x)
+  ret void
+}
+
+; Both functions fold their GEP to the same new constant expression, and add
+; uses of the same constants.
+; CHECK-LABEL: @f5(
+; CHECK: store i32 0, i32* getelementptr inbounds ([4 x i32], [4 x i32]* @h, i32 0, i32 3)
+; CHECK-NEXT: ret void
+define void @f5(i32 %x) {
+  %i = add i32 3, 0
+  %p = getelementptr inbounds [4 x i32], [4 x i32]* @h, i32 0, i32 %i
+  %z = mul i32 %x, 0
+  store i32 %z, i32* %p
+  ret void
+}
+
+; CHECK-LABEL: @f6(
+; CHECK: store i32 0, i32* getelementptr inbounds ([4 x i32], [4 x i32]* @h, i32 0, i32 3)
+; CHECK-NEXT: store i32 0, i32* @g
+; CHECK-NEXT: ret void
+define void @f6(i32 %x) {
+  %i = add i32 1, 2
+  %p = getelementptr inbounds [4 x i32], [4 x i32]* @h, i32 0, i32 %i
+  %z = and i32 %x, 0
+  store i32 %z, i32* %p
+  store i32 %z, i32* @g
+  ret void
+}
@@ -0,0 +1,20 @@
+define i32 @small(i32 %x) {
+  %y = call i32 @callee(i32 %x)
+  ret i32 %y
+}
+
+define i32 @callee(i32 %x) {
+  %y = add i32 %x, 1
+  ret i32 %y
+}
+
+@internalvar = internal global i32 0
+
+define i32 @useslocal() {
+  %x = load i32, i32* @internalvar
+  ret i32 %x
+}
+
+define weak i32 @weakfunc() {
+  ret i32 0
+}
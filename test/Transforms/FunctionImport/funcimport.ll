@@ -0,0 +1,28 @@
+; RUN: llvm-as -function-summary %s -o %t.bc
+; RUN: llvm-as -function-summary %p/Inputs/funcimport.ll -o %t2.bc
+; RUN: llvm-lto -thinlto -o %t3 %t.bc %t2.bc
+; RUN: opt -function-import -summary-file %t3.thinlto.bc %t.bc -S | FileCheck %s
+; RUN: opt -function-import -summary-file %t3.thinlto.bc -import-instr-limit=1 %t.bc -S | FileCheck %s --check-prefix=LIMIT
+
+define i32 @main() {
+  %a = call i32 @small(i32 1)
+  %b = call i32 @useslocal()
+  %c = call i32 @weakfunc()
+  ret i32 %a
+}
+
+declare i32 @small(i32)
+declare i32 @useslocal()
+declare i32 @weakfunc()
+
+; Called functions, and the functions that those call, are imported.
+; CHECK-DAG: define available_externally i32 @small(i32 %x)
+; CHECK-DAG: define available_externally i32 @callee(i32 %x)
+
+; Functions referring to local symbols, and overridable ones, are not.
+; CHECK-DAG: declare i32 @useslocal()
+; CHECK-DAG: declare i32 @weakfunc()
+; CHECK-NOT: @internalvar
+
+; LIMIT: declare i32 @small(i32)
+; LIMIT-NOT: available_externally
@@ -168,19 +168,32 @@ BinaryHolder::MapArchiveAndGetMemberBuffers(StringRef Filename,
   return GetArchiveMemberBuffers(Filename, Timestamp);
 }
 
-ErrorOr<const object::ObjectFile &>
+ErrorOr<const std::shared_ptr<object::ObjectFile> &>
 BinaryHolder::getObjfileForArch(const Triple &T) {
   for (const auto &Obj : CurrentObjectFiles) {
     if (const auto *MachO = dyn_cast<object::MachOObjectFile>(Obj.get())) {
       if (getTriple(*MachO).str() == T.str())
-        return *MachO;
+        return Obj;
     } else if (Obj->getArch() == T.getArch())
-      return *Obj;
+      return Obj;
   }
 
   return make_error_code(object::object_error::arch_not_found);
 }
 
+ErrorOr<std::shared_ptr<const object::ObjectFile>>
+BinaryHolder::GetShared(const Triple &T) {
+  auto ErrOrObj = getObjfileForArch(T);
+  if (auto Err = ErrOrObj.getError())
+    return Err;
+  // Archive members and fat binary slices live in the mapped file, so
+  // holding on to the object and to that mapping is enough.
+  std::shared_ptr<object::ObjectFile> Obj = *ErrOrObj;
+  std::shared_ptr<MemoryBuffer> Buffer = CurrentMemoryBuffer;
+  return std::shared_ptr<const object::ObjectFile>(
+      Obj.get(), [Obj, Buffer](const object::ObjectFile *) {});
+}
+
 ErrorOr<std::vector<const object::ObjectFile *>>
 BinaryHolder::GetObjectFiles(StringRef Filename, sys::TimeValue Timestamp) {
   auto ErrOrMemBufferRefs = GetMemoryBuffersForFile(Filename, Timestamp);
@@ -36,11 +36,11 @@ namespace dsymutil {
 /// archive file (Which is always the case in debug maps).
 /// Currently it only owns one memory buffer at any given time,
 /// meaning that a mapping request will invalidate the previous memory
-/// mapping.
+/// mapping. Use GetShared() to keep an object file valid beyond that.
 class BinaryHolder {
   std::vector<std::unique_ptr<object::Archive>> CurrentArchives;
-  std::unique_ptr<MemoryBuffer> CurrentMemoryBuffer;
-  std::vector<std::unique_ptr<object::ObjectFile>> CurrentObjectFiles;
+  std::shared_ptr<MemoryBuffer> CurrentMemoryBuffer;
+  std::vector<std::shared_ptr<object::ObjectFile>> CurrentObjectFiles;
   std::unique_ptr<object::MachOUniversalBinary> CurrentFatBinary;
   bool Verbose;
 
@@ -76,7 +76,8 @@ class BinaryHolder {
   GetMemoryBuffersForFile(StringRef Filename, sys::TimeValue Timestamp);
 
   void changeBackingMemoryBuffer(std::unique_ptr<MemoryBuffer> &&MemBuf);
-  ErrorOr<const object::ObjectFile &> getObjfileForArch(const Triple &T);
+  ErrorOr<const std::shared_ptr<object::ObjectFile> &>
+  getObjfileForArch(const Triple &T);
 
 public:
   BinaryHolder(bool Verbose) : Verbose(Verbose) {}
@@ -116,9 +117,18 @@ public:
   /// successfull call to GetObjectFiles() or GetFilesAs() must have
   /// been performed before calling this.
   ErrorOr<const object::ObjectFile &> Get(const Triple &T) {
-    return getObjfileForArch(T);
+    auto ErrOrObj = getObjfileForArch(T);
+    if (auto Err = ErrOrObj.getError())
+      return Err;
+    return **ErrOrObj;
   }
 
+  /// Like Get(), but the returned ObjectFile also owns the memory
+  /// mapping it was read from. It stays valid after later requests
+  /// to this BinaryHolder invalidate the current mapping.
+  ErrorOr<std::shared_ptr<const object::ObjectFile>>
+  GetShared(const Triple &T);
+
   /// Access to a derived version of the currently owned
   /// ObjectFile. The conversion must be known to be valid.
   template <typename ObjectFileType>
@@ -35,8 +35,12 @@
 #include "llvm/Support/Dwarf.h"
 #include "llvm/Support/LEB128.h"
 #include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetOptions.h"
+#include <atomic>
+#include <condition_variable>
 #include <string>
 #include <tuple>
 
@@ -100,9 +104,12 @@ class DeclContext {
   StringRef Name;
   StringRef File;
   const DeclContext &Parent;
-  const DWARFDebugInfoEntryMinimal *LastSeenDIE;
-  uint32_t LastSeenCompileUnitID;
   uint32_t CanonicalDIEOffset;
+  /// The number of the debug map object that emits the canonical DIE,
+  /// or 0 if none was chosen yet.
+  std::atomic<unsigned> CanonicalDIEObject;
+  /// Was the canonical DIE cloned yet? Only used by its object.
+  bool CanonicalDIECloned;
 
   friend DeclMapInfo;
 
@@ -112,23 +119,26 @@ public:
   DeclContext()
       : QualifiedNameHash(0), Line(0), ByteSize(0),
         Tag(dwarf::DW_TAG_compile_unit), Name(), File(), Parent(*this),
-        LastSeenDIE(nullptr), LastSeenCompileUnitID(0), CanonicalDIEOffset(0) {}
+        CanonicalDIEOffset(0), CanonicalDIEObject(0),
+        CanonicalDIECloned(false) {}
 
   DeclContext(unsigned Hash, uint32_t Line, uint32_t ByteSize, uint16_t Tag,
-              StringRef Name, StringRef File, const DeclContext &Parent,
-              const DWARFDebugInfoEntryMinimal *LastSeenDIE = nullptr,
-              unsigned CUId = 0)
+              StringRef Name, StringRef File, const DeclContext &Parent)
       : QualifiedNameHash(Hash), Line(Line), ByteSize(ByteSize), Tag(Tag),
-        Name(Name), File(File), Parent(Parent), LastSeenDIE(LastSeenDIE),
-        LastSeenCompileUnitID(CUId), CanonicalDIEOffset(0) {}
+        Name(Name), File(File), Parent(Parent), CanonicalDIEOffset(0),
+        CanonicalDIEObject(0), CanonicalDIECloned(false) {}
 
   uint32_t getQualifiedNameHash() const { return QualifiedNameHash; }
 
-  bool setLastSeenDIE(CompileUnit &U, const DWARFDebugInfoEntryMinimal *Die);
-
   uint32_t getCanonicalDIEOffset() const { return CanonicalDIEOffset; }
   void setCanonicalDIEOffset(uint32_t Offset) { CanonicalDIEOffset = Offset; }
 
+  unsigned getCanonicalDIEObject() const { return CanonicalDIEObject; }
+  void setCanonicalDIEObject(unsigned ID) { CanonicalDIEObject = ID; }
+
+  bool isCanonicalDIECloned() const { return CanonicalDIECloned; }
+  void setCanonicalDIECloned() { CanonicalDIECloned = true; }
+
   uint16_t getTag() const { return Tag; }
   StringRef getName() const { return Name; }
 };
@@ -156,7 +166,13 @@ struct DeclMapInfo : private DenseMapInfo<DeclContext *> {
 /// This class gives a tree-like API to the DenseMap that stores the
 /// DeclContext objects. It also holds the BumpPtrAllocator where
 /// these objects will be allocated.
+///
+/// The compile units of several objects can look up their contexts
+/// concurrently. Whether a context is found or created, the result only
+/// depends on the DIE and on its unit, so it does not depend on the order
+/// of the lookups.
 class DeclContextTree {
+  std::mutex Mutex;
   BumpPtrAllocator Allocator;
   DeclContext Root;
   DeclContext::Map Contexts;
@@ -192,8 +208,8 @@ public:
     bool InDebugMap;    ///< Was this DIE's entity found in the map?
   };
 
-  CompileUnit(DWARFUnit &OrigUnit, unsigned ID, bool CanUseODR)
-      : OrigUnit(OrigUnit), ID(ID), LowPc(UINT64_MAX), HighPc(0), RangeAlloc(),
+  CompileUnit(DWARFUnit &OrigUnit, bool CanUseODR)
+      : OrigUnit(OrigUnit), LowPc(UINT64_MAX), HighPc(0), RangeAlloc(),
         Ranges(RangeAlloc) {
     Info.resize(OrigUnit.getNumDIEs());
 
@@ -218,13 +234,17 @@ public:
 
   DWARFUnit &getOrigUnit() const { return OrigUnit; }
 
-  unsigned getUniqueID() const { return ID; }
-
   DIE *getOutputUnitDIE() const { return CUDie; }
   void setOutputUnitDIE(DIE *Die) { CUDie = Die; }
 
   bool hasODR() const { return HasODR; }
 
+  /// \brief Record that \p Die is in the ODR context \p Ctxt.
+  /// \returns false, and invalidates the context of the first DIE that
+  /// was in it, if \p Ctxt was already seen in this unit.
+  bool noteDeclContext(DeclContext *Ctxt,
+                       const DWARFDebugInfoEntryMinimal *Die);
+
   DIEInfo &getInfo(unsigned Idx) { return Info[Idx]; }
   const DIEInfo &getInfo(unsigned Idx) const { return Info[Idx]; }
 
@@ -276,25 +296,20 @@ public:
   /// list in the debug_loc section.
   void noteLocationAttribute(PatchLocation Attr, int64_t PcOffset);
 
-  /// \brief Add a name accelerator entry for \p Die with \p Name
-  /// which is stored in the string table at \p Offset.
-  void addNameAccelerator(const DIE *Die, const char *Name, uint32_t Offset,
+  /// \brief Add a name accelerator entry for \p Die with \p Name.
+  void addNameAccelerator(const DIE *Die, const char *Name,
                           bool SkipPubnamesSection = false);
 
-  /// \brief Add a type accelerator entry for \p Die with \p Name
-  /// which is stored in the string table at \p Offset.
-  void addTypeAccelerator(const DIE *Die, const char *Name, uint32_t Offset);
+  /// \brief Add a type accelerator entry for \p Die with \p Name.
+  void addTypeAccelerator(const DIE *Die, const char *Name);
 
   struct AccelInfo {
     StringRef Name;      ///< Name of the entry.
     const DIE *Die;      ///< DIE this entry describes.
-    uint32_t NameOffset; ///< Offset of Name in the string pool.
     bool SkipPubSection; ///< Emit this entry only in the apple_* sections.
 
-    AccelInfo(StringRef Name, const DIE *Die, uint32_t NameOffset,
-              bool SkipPubSection = false)
-        : Name(Name), Die(Die), NameOffset(NameOffset),
-          SkipPubSection(SkipPubSection) {}
+    AccelInfo(StringRef Name, const DIE *Die, bool SkipPubSection = false)
+        : Name(Name), Die(Die), SkipPubSection(SkipPubSection) {}
   };
 
   const std::vector<AccelInfo> &getPubnames() const { return Pubnames; }
@@ -318,7 +333,6 @@ public:
 
 private:
   DWARFUnit &OrigUnit;
-  unsigned ID;
   std::vector<DIEInfo> Info; ///< DIE info indexed by DIE index.
   DIE *CUDie;                ///< Root of the linked DIE tree.
 
@@ -366,6 +380,9 @@ private:
   /// Cached resolved paths from the line table.
   std::vector<std::string> ResolvedPaths;
 
+  /// The index of the first DIE of each ODR context of the unit.
+  DenseMap<DeclContext *, uint32_t> DeclContextDIEs;
+
   /// Is this unit subject to the ODR rule?
   bool HasODR;
 };
@@ -395,10 +412,12 @@ void CompileUnit::fixupForwardReferences() {
     PatchLocation Attr;
     DeclContext *Ctxt;
     std::tie(RefDie, RefUnit, Ctxt, Attr) = Ref;
-    if (Ctxt && Ctxt->getCanonicalDIEOffset())
+    if (Ctxt && Ctxt->getCanonicalDIEOffset()) {
       Attr.set(Ctxt->getCanonicalDIEOffset());
-    else
+    } else {
+      assert(RefDie && "Reference to a canonical DIE that was not emitted");
       Attr.set(RefDie->getOffset() + RefUnit->getStartOffset());
+    }
   }
 }
 
@@ -420,18 +439,15 @@ void CompileUnit::noteLocationAttribute(PatchLocation Attr, int64_t PcOffset) {
   LocationAttributes.emplace_back(Attr, PcOffset);
 }
 
-/// \brief Add a name accelerator entry for \p Die with \p Name
-/// which is stored in the string table at \p Offset.
+/// \brief Add a name accelerator entry for \p Die with \p Name.
 void CompileUnit::addNameAccelerator(const DIE *Die, const char *Name,
-                                     uint32_t Offset, bool SkipPubSection) {
-  Pubnames.emplace_back(Name, Die, Offset, SkipPubSection);
+                                     bool SkipPubSection) {
+  Pubnames.emplace_back(Name, Die, SkipPubSection);
 }
 
-/// \brief Add a type accelerator entry for \p Die with \p Name
-/// which is stored in the string table at \p Offset.
-void CompileUnit::addTypeAccelerator(const DIE *Die, const char *Name,
-                                     uint32_t Offset) {
-  Pubtypes.emplace_back(Name, Die, Offset, false);
+/// \brief Add a type accelerator entry for \p Die with \p Name.
+void CompileUnit::addTypeAccelerator(const DIE *Die, const char *Name) {
+  Pubtypes.emplace_back(Name, Die, false);
 }
 
 /// \brief The Dwarf streaming logic
@@ -1097,11 +1113,11 @@ public:
   bool link(const DebugMap &);
 
 private:
-  /// \brief Called at the start of a debug object link.
-  void startDebugObject(DWARFContext &, DebugMapObject &);
-
-  /// \brief Called at the end of a debug object link.
-  void endDebugObject();
+  /// \brief A warning about a debug map object, optionally about one of
+  /// its DIEs, that is reported when the object is emitted.
+  typedef std::vector<std::tuple<std::string, const DWARFUnit *,
+                                 const DWARFDebugInfoEntryMinimal *>>
+      WarningList;
 
   /// Keeps track of relocations.
   class RelocationManager {
@@ -1122,6 +1138,10 @@ private:
 
     DwarfLinker &Linker;
 
+    /// \brief Where to store the warnings found while looking for the
+    /// valid relocations, to report them when the object is emitted.
+    WarningList &Warnings;
+
     /// \brief The valid relocations for the current DebugMapObject.
     /// This vector is sorted by relocation offset.
     std::vector<ValidReloc> ValidRelocs;
@@ -1134,8 +1154,8 @@ private:
     unsigned NextValidReloc;
 
   public:
-    RelocationManager(DwarfLinker &Linker)
-        : Linker(Linker), NextValidReloc(0) {}
+    RelocationManager(DwarfLinker &Linker, WarningList &Warnings)
+        : Linker(Linker), Warnings(Warnings), NextValidReloc(0) {}
 
     bool hasValidRelocs() const { return !ValidRelocs.empty(); }
     /// \brief Reset the NextValidReloc counter.
@@ -1162,17 +1182,124 @@ private:
 
     bool applyValidRelocs(MutableArrayRef<char> Data, uint32_t BaseOffset,
                           bool isLittleEndian);
+
+  private:
+    void reportWarning(const Twine &Warning) {
+      Warnings.emplace_back(Warning.str(), nullptr, nullptr);
+    }
   };
 
+  /// \brief Everything about the link of one debug map object.
+  ///
+  /// An object is prepared (loaded, its DWARF parsed and its DIEs
+  /// assigned to ODR contexts), analyzed (the DIEs to keep are marked
+  /// and the canonical DIEs of new ODR contexts are chosen), cloned and
+  /// emitted. Only the analysis depends on the previous objects, the
+  /// analyses thus run in debug map order. With a thread pool, the other
+  /// steps but the emission run concurrently for several objects. The
+  /// emission is serial and in order: it gives the cloned DIEs their
+  /// final abbreviation numbers, offsets and string offsets, so that the
+  /// output does not depend on the number of threads.
+  struct LinkContext {
+    DebugMapObject &DMO;
+    /// The number of this object in the debug map, starting at 1.
+    unsigned ID;
+    /// The object file, or null if it could not be loaded.
+    std::shared_ptr<const object::ObjectFile> ObjectFile;
+    /// The warnings to report when the object is emitted.
+    WarningList Warnings;
+    RelocationManager RelocMgr;
+    std::unique_ptr<DWARFContextInMemory> DwarfContext;
+    std::vector<CompileUnit> Units;
+
+    /// \brief This map is keyed by the entry PC of functions in that
+    /// debug object and the associated value is a pair storing the
+    /// corresponding end PC and the offset to apply to get the linked
+    /// address.
+    ///
+    /// See startDebugObject() for a more complete description of its use.
+    std::map<uint64_t, std::pair<uint64_t, int64_t>> Ranges;
+
+    /// \brief The ODR contexts whose canonical DIE is in this object,
+    /// along with the unit and the index of that DIE.
+    std::vector<std::tuple<DeclContext *, CompileUnit *, unsigned>>
+        CanonicalDIEs;
+
+    /// \defgroup ClonedDIEs The output of the cloning of this object.
+    ///
+    /// @{
+    /// \brief Allocator used for all the DIEValue objects.
+    BumpPtrAllocator DIEAlloc;
+    /// \brief DIELoc objects that need to be destructed (but not freed!).
+    std::vector<DIELoc *> DIELocs;
+    /// \brief DIEBlock objects that need to be destructed (but not freed!).
+    std::vector<DIEBlock *> DIEBlocks;
+    /// \brief The abbreviations of the cloned DIEs, numbered in the order
+    /// in which they were first used. The DIEs get their final numbers
+    /// when the object is emitted.
+    FoldingSet<DIEAbbrev> AbbreviationsSet;
+    std::vector<std::unique_ptr<DIEAbbrev>> Abbreviations;
+    /// \brief The strings of the cloned DIEs, in the order in which they
+    /// are added to the string pool, with the DW_FORM_strp attribute to
+    /// patch with their offset if there is one.
+    std::vector<std::pair<StringRef, PatchLocation>> Strings;
+    /// @}
+
+    /// \defgroup Scheduling Progress of the object when linked on a
+    /// thread pool. Guarded by the mutex of DwarfLinker::link().
+    ///
+    /// @{
+    bool Prepared;
+    bool Cloned;
+    /// @}
+
+    LinkContext(DwarfLinker &Linker, DebugMapObject &DMO, unsigned ID)
+        : DMO(DMO), ID(ID), RelocMgr(Linker, Warnings), Prepared(false),
+          Cloned(false) {}
+
+    ~LinkContext() {
+      for (auto *Block : DIEBlocks)
+        Block->~DIEBlock();
+      for (auto *Loc : DIELocs)
+        Loc->~DIELoc();
+    }
+
+    void reportWarning(const Twine &Warning, const DWARFUnit *Unit = nullptr,
+                       const DWARFDebugInfoEntryMinimal *DIE = nullptr) {
+      Warnings.emplace_back(Warning.str(), Unit, DIE);
+    }
+  };
+
+  /// \brief Load the object of \p Context and prepare it to be analyzed.
+  void prepareObject(LinkContext &Context, const DebugMap &Map);
+
+  /// \brief Called once the object of \p Context is loaded.
+  void startDebugObject(LinkContext &Context);
+
+  /// \brief Mark the DIEs of \p Context to keep, and choose the
+  /// canonical DIEs of the ODR contexts first seen in this object. This
+  /// must be done in debug map order.
+  void analyzeObject(LinkContext &Context);
+
+  /// \brief Clone the DIEs of \p Context that were chosen to be kept.
+  void cloneObject(LinkContext &Context);
+
+  /// \brief Report the warnings about \p Context, lay out its DIEs in
+  /// the output and emit its debug info. This must be done in debug map
+  /// order.
+  void emitObject(LinkContext &Context);
+
+  /// \brief Link the objects of \p Map on \p NumThreads threads.
+  void linkInParallel(const DebugMap &Map, unsigned NumThreads);
+
   /// \defgroup FindRootDIEs Find DIEs corresponding to debug map entries.
   ///
   /// @{
   /// \brief Recursively walk the \p DIE tree and look for DIEs to
   /// keep. Store that information in \p CU's DIEInfo.
-  void lookForDIEsToKeep(RelocationManager &RelocMgr,
+  void lookForDIEsToKeep(LinkContext &Context,
                          const DWARFDebugInfoEntryMinimal &DIE,
-                         const DebugMapObject &DMO, CompileUnit &CU,
-                         unsigned Flags);
+                         CompileUnit &CU, unsigned Flags);
 
   /// \brief Flags passed to DwarfLinker::lookForDIEsToKeep
   enum TravesalFlags {
@@ -1186,23 +1313,22 @@ private:
 
   /// \brief Mark the passed DIE as well as all the ones it depends on
   /// as kept.
-  void keepDIEAndDenpendencies(RelocationManager &RelocMgr,
+  void keepDIEAndDenpendencies(LinkContext &Context,
                                const DWARFDebugInfoEntryMinimal &DIE,
-                               CompileUnit::DIEInfo &MyInfo,
-                               const DebugMapObject &DMO, CompileUnit &CU,
+                               CompileUnit::DIEInfo &MyInfo, CompileUnit &CU,
                                bool UseODR);
 
-  unsigned shouldKeepDIE(RelocationManager &RelocMgr,
+  unsigned shouldKeepDIE(LinkContext &Context,
                          const DWARFDebugInfoEntryMinimal &DIE,
                          CompileUnit &Unit, CompileUnit::DIEInfo &MyInfo,
                          unsigned Flags);
 
-  unsigned shouldKeepVariableDIE(RelocationManager &RelocMgr,
+  unsigned shouldKeepVariableDIE(LinkContext &Context,
                                  const DWARFDebugInfoEntryMinimal &DIE,
                                  CompileUnit &Unit,
                                  CompileUnit::DIEInfo &MyInfo, unsigned Flags);
 
-  unsigned shouldKeepSubprogramDIE(RelocationManager &RelocMgr,
+  unsigned shouldKeepSubprogramDIE(LinkContext &Context,
                                    const DWARFDebugInfoEntryMinimal &DIE,
                                    CompileUnit &Unit,
                                    CompileUnit::DIEInfo &MyInfo,
@@ -1218,6 +1344,7 @@ private:
 
   class DIECloner {
     DwarfLinker &Linker;
+    LinkContext &Context;
     RelocationManager &RelocMgr;
     /// Allocator used for all the DIEValue objects.
     BumpPtrAllocator &DIEAlloc;
@@ -1225,11 +1352,10 @@ private:
     LinkOptions Options;
 
   public:
-    DIECloner(DwarfLinker &Linker, RelocationManager &RelocMgr,
-              BumpPtrAllocator &DIEAlloc,
-              MutableArrayRef<CompileUnit> CompileUnits, LinkOptions &Options)
-        : Linker(Linker), RelocMgr(RelocMgr), DIEAlloc(DIEAlloc),
-          CompileUnits(CompileUnits), Options(Options) {}
+    DIECloner(DwarfLinker &Linker, LinkContext &Context, LinkOptions &Options)
+        : Linker(Linker), Context(Context), RelocMgr(Context.RelocMgr),
+          DIEAlloc(Context.DIEAlloc), CompileUnits(Context.Units),
+          Options(Options) {}
 
     /// Recursively clone \p InputDIE into an tree of DIE objects
     /// where useless (as decided by lookForDIEsToKeep()) bits have been
@@ -1248,7 +1374,7 @@ private:
     /// Construct the output DIE tree by cloning the DIEs we
     /// chose to keep above. If there are no valid relocs, then there's
     /// nothing to clone/emit.
-    void cloneAllCompileUnits(DWARFContextInMemory &DwarfContext);
+    void cloneAllCompileUnits();
 
   private:
     typedef DWARFAbbreviationDeclaration::AttributeSpec AttributeSpec;
@@ -1256,8 +1382,7 @@ private:
     /// Information gathered and exchanged between the various
     /// clone*Attributes helpers about the attributes of a particular DIE.
     struct AttributesInfo {
-      const char *Name, *MangledName;         ///< Names.
-      uint32_t NameOffset, MangledNameOffset; ///< Offsets in the string pool.
+      const char *Name, *MangledName; ///< Names.
 
       uint64_t OrigLowPc;  ///< Value of AT_low_pc in the input DIE
       uint64_t OrigHighPc; ///< Value of AT_high_pc in the input DIE
@@ -1267,9 +1392,9 @@ private:
       bool IsDeclaration; ///< Is this DIE only a declaration?
 
       AttributesInfo()
-          : Name(nullptr), MangledName(nullptr), NameOffset(0),
-            MangledNameOffset(0), OrigLowPc(UINT64_MAX), OrigHighPc(0),
-            PCOffset(0), HasLowPc(false), IsDeclaration(false) {}
+          : Name(nullptr), MangledName(nullptr), OrigLowPc(UINT64_MAX),
+            OrigHighPc(0), PCOffset(0), HasLowPc(false), IsDeclaration(false) {
+      }
     };
 
     /// Helper for cloneDIE.
@@ -1324,6 +1449,9 @@ private:
     bool getDIENames(const DWARFDebugInfoEntryMinimal &Die, DWARFUnit &U,
                      AttributesInfo &Info);
 
+    /// Assign an abbreviation number, local to the object, to \p Abbrev.
+    void assignAbbrev(DIEAbbrev &Abbrev);
+
     /// Create a copy of abbreviation Abbrev.
     void copyAbbrev(const DWARFAbbreviationDeclaration &Abbrev, bool hasODR);
   };
@@ -1349,21 +1477,13 @@ private:
   /// \brief Extract the line tables fromt he original dwarf, extract
   /// the relevant parts according to the linked function ranges and
   /// emit the result in the debug_line section.
-  void patchLineTableForUnit(CompileUnit &Unit, DWARFContext &OrigDwarf);
+  void patchLineTableForUnit(CompileUnit &Unit, LinkContext &Context);
 
   /// \brief Emit the accelerator entries for \p Unit.
   void emitAcceleratorEntriesForUnit(CompileUnit &Unit);
 
   /// \brief Patch the frame info for an object file and emit it.
-  void patchFrameInfoForObject(const DebugMapObject &, DWARFContext &,
-                               unsigned AddressSize);
-
-  /// \brief DIELoc objects that need to be destructed (but not freed!).
-  std::vector<DIELoc *> DIELocs;
-  /// \brief DIEBlock objects that need to be destructed (but not freed!).
-  std::vector<DIEBlock *> DIEBlocks;
-  /// \brief Allocator used for all the DIEValue objects.
-  BumpPtrAllocator DIEAlloc;
+  void patchFrameInfoForObject(LinkContext &Context, unsigned AddressSize);
   /// @}
 
   /// ODR Contexts for that link.
@@ -1373,47 +1493,38 @@ private:
   ///
   /// @{
   const DWARFDebugInfoEntryMinimal *
-  resolveDIEReference(const DWARFFormValue &RefValue, const DWARFUnit &Unit,
+  resolveDIEReference(LinkContext &Context, const DWARFFormValue &RefValue,
+                      const DWARFUnit &Unit,
                       const DWARFDebugInfoEntryMinimal &DIE,
                       CompileUnit *&ReferencedCU);
 
-  CompileUnit *getUnitForOffset(unsigned Offset);
-
   void reportWarning(const Twine &Warning, const DWARFUnit *Unit = nullptr,
                      const DWARFDebugInfoEntryMinimal *DIE = nullptr) const;
 
   bool createStreamer(Triple TheTriple, StringRef OutputFilename);
 
-  /// \brief Attempt to load a debug object from disk.
-  ErrorOr<const object::ObjectFile &> loadObject(BinaryHolder &BinaryHolder,
-                                                 DebugMapObject &Obj,
-                                                 const DebugMap &Map);
+  /// \brief Attempt to load a debug object from disk. Failures are
+  /// added to \p Warnings.
+  ErrorOr<std::shared_ptr<const object::ObjectFile>>
+  loadObject(DebugMapObject &Obj, const DebugMap &Map, WarningList &Warnings);
   /// @}
 
 private:
   std::string OutputFilename;
   LinkOptions Options;
+  /// Loads the objects. Guarded by BinHolderMutex, as the objects can be
+  /// loaded from several threads.
   BinaryHolder BinHolder;
+  std::mutex BinHolderMutex;
   std::unique_ptr<DwarfStreamer> Streamer;
   uint64_t OutputDebugInfoSize;
 
-  /// The units of the current debug map object.
-  std::vector<CompileUnit> Units;
-
-  /// The debug map object curently under consideration.
+  /// The debug map object curently emitted.
   DebugMapObject *CurrentDebugObject;
 
   /// \brief The Dwarf string pool
   NonRelocatableStringpool StringPool;
 
-  /// \brief This map is keyed by the entry PC of functions in that
-  /// debug object and the associated value is a pair storing the
-  /// corresponding end PC and the offset to apply to get the linked
-  /// address.
-  ///
-  /// See startDebugObject() for a more complete description of its use.
-  std::map<uint64_t, std::pair<uint64_t, int64_t>> Ranges;
-
   /// \brief The CIEs that have been emitted in the output
   /// section. The actual CIE data serves a the key to this StringMap,
   /// this takes care of comparing the semantics of CIEs defined in
@@ -1427,7 +1538,8 @@ private:
 
 /// \brief Similar to DWARFUnitSection::getUnitForOffset(), but
 /// returning our CompileUnit object instead.
-CompileUnit *DwarfLinker::getUnitForOffset(unsigned Offset) {
+static CompileUnit *getUnitForOffset(std::vector<CompileUnit> &Units,
+                                     unsigned Offset) {
   auto CU =
       std::upper_bound(Units.begin(), Units.end(), Offset,
                        [](uint32_t LHS, const CompileUnit &RHS) {
@@ -1441,19 +1553,30 @@ CompileUnit *DwarfLinker::getUnitForOffset(unsigned Offset) {
 /// CompileUnit which is stored into \p ReferencedCU.
 /// \returns null if resolving fails for any reason.
 const DWARFDebugInfoEntryMinimal *DwarfLinker::resolveDIEReference(
-    const DWARFFormValue &RefValue, const DWARFUnit &Unit,
-    const DWARFDebugInfoEntryMinimal &DIE, CompileUnit *&RefCU) {
+    LinkContext &Context, const DWARFFormValue &RefValue,
+    const DWARFUnit &Unit, const DWARFDebugInfoEntryMinimal &DIE,
+    CompileUnit *&RefCU) {
   assert(RefValue.isFormClass(DWARFFormValue::FC_Reference));
   uint64_t RefOffset = *RefValue.getAsReference(&Unit);
 
-  if ((RefCU = getUnitForOffset(RefOffset)))
+  if ((RefCU = getUnitForOffset(Context.Units, RefOffset)))
     if (const auto *RefDie = RefCU->getOrigUnit().getDIEForOffset(RefOffset))
       return RefDie;
 
-  reportWarning("could not find referenced DIE", &Unit, &DIE);
+  Context.reportWarning("could not find referenced DIE", &Unit, &DIE);
   return nullptr;
 }
 
+/// \returns whether the DIE with \p Tag and \p Info in \p Unit is
+/// the root of its own valid DeclContext tree. The first such DIE
+/// cloned for a context becomes the canonical DIE of the context.
+static bool isCanonicalDIECandidate(const CompileUnit &Unit,
+                                    const CompileUnit::DIEInfo &Info,
+                                    uint16_t Tag) {
+  return Unit.hasODR() && Tag != dwarf::DW_TAG_namespace && Info.Ctxt &&
+         Info.Ctxt != Unit.getInfo(Info.ParentIdx).Ctxt;
+}
+
 /// \returns whether the passed \a Attr type might contain a DIE
 /// reference suitable for ODR uniquing.
 static bool isODRAttribute(uint16_t Attr) {
@@ -1470,8 +1593,8 @@ static bool isODRAttribute(uint16_t Attr) {
   llvm_unreachable("Improper attribute.");
 }
 
-/// Set the last DIE/CU a context was seen in and, possibly invalidate
-/// the context if it is ambiguous.
+/// Record the first DIE of the unit that is in a context and, possibly
+/// invalidate the context if it is ambiguous.
 ///
 /// In the current implementation, we don't handle overloaded
 /// functions well, because the argument types are not taken into
@@ -1484,18 +1607,15 @@ static bool isODRAttribute(uint16_t Attr) {
 ///
 /// If a context that is not a namespace appears twice in the same CU,
 /// we know it is ambiguous. Make it invalid.
-bool DeclContext::setLastSeenDIE(CompileUnit &U,
-                                 const DWARFDebugInfoEntryMinimal *Die) {
-  if (LastSeenCompileUnitID == U.getUniqueID()) {
-    DWARFUnit &OrigUnit = U.getOrigUnit();
-    uint32_t FirstIdx = OrigUnit.getDIEIndex(LastSeenDIE);
-    U.getInfo(FirstIdx).Ctxt = nullptr;
-    return false;
-  }
+bool CompileUnit::noteDeclContext(DeclContext *Ctxt,
+                                  const DWARFDebugInfoEntryMinimal *Die) {
+  auto Insertion =
+      DeclContextDIEs.insert(std::make_pair(Ctxt, OrigUnit.getDIEIndex(Die)));
+  if (Insertion.second)
+    return true;
 
-  LastSeenCompileUnitID = U.getUniqueID();
-  LastSeenDIE = Die;
-  return true;
+  getInfo(Insertion.first->second).Ctxt = nullptr;
+  return false;
 }
 
 /// Get the child context of \a Context corresponding to \a DIE.
@@ -1638,34 +1758,36 @@ PointerIntPair<DeclContext *, 1> DeclContextTree::getChildDeclContext(
 
   // Now look if this context already exists.
   DeclContext Key(Hash, Line, ByteSize, Tag, NameRef, FileRef, Context);
-  auto ContextIter = Contexts.find(&Key);
-
-  if (ContextIter == Contexts.end()) {
-    // The context wasn't found.
-    bool Inserted;
-    DeclContext *NewContext =
-        new (Allocator) DeclContext(Hash, Line, ByteSize, Tag, NameRef, FileRef,
-                                    Context, DIE, U.getUniqueID());
-    std::tie(ContextIter, Inserted) = Contexts.insert(NewContext);
-    assert(Inserted && "Failed to insert DeclContext");
-    (void)Inserted;
-  } else if (Tag != dwarf::DW_TAG_namespace &&
-             !(*ContextIter)->setLastSeenDIE(U, DIE)) {
+  DeclContext *Ctxt;
+  {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    auto ContextIter = Contexts.find(&Key);
+    if (ContextIter == Contexts.end()) {
+      // The context wasn't found.
+      Ctxt = new (Allocator)
+          DeclContext(Hash, Line, ByteSize, Tag, NameRef, FileRef, Context);
+      bool Inserted = Contexts.insert(Ctxt).second;
+      assert(Inserted && "Failed to insert DeclContext");
+      (void)Inserted;
+    } else {
+      Ctxt = *ContextIter;
+    }
+  }
+
+  if (Tag != dwarf::DW_TAG_namespace && !U.noteDeclContext(Ctxt, DIE))
     // The context was found, but it is ambiguous with another context
     // in the same file. Mark it invalid.
-    return PointerIntPair<DeclContext *, 1>(*ContextIter, /* Invalid= */ 1);
-  }
+    return PointerIntPair<DeclContext *, 1>(Ctxt, /* Invalid= */ 1);
 
-  assert(ContextIter != Contexts.end());
   // FIXME: dsymutil-classic compatibility. Union types aren't
   // uniques, but their children might be.
   if ((Tag == dwarf::DW_TAG_subprogram &&
        Context.getTag() != dwarf::DW_TAG_structure_type &&
        Context.getTag() != dwarf::DW_TAG_class_type) ||
       (Tag == dwarf::DW_TAG_union_type))
-    return PointerIntPair<DeclContext *, 1>(*ContextIter, /* Invalid= */ 1);
+    return PointerIntPair<DeclContext *, 1>(Ctxt, /* Invalid= */ 1);
 
-  return PointerIntPair<DeclContext *, 1>(*ContextIter);
+  return PointerIntPair<DeclContext *, 1>(Ctxt);
 }
 
 bool DwarfLinker::DIECloner::getDIENames(const DWARFDebugInfoEntryMinimal &Die,
@@ -1674,11 +1796,10 @@ bool DwarfLinker::DIECloner::getDIENames(const DWARFDebugInfoEntryMinimal &Die,
   // short name.
   if (!Info.MangledName &&
       (Info.MangledName = Die.getName(&U, DINameKind::LinkageName)))
-    Info.MangledNameOffset =
-        Linker.StringPool.getStringOffset(Info.MangledName);
+    Context.Strings.emplace_back(Info.MangledName, PatchLocation());
 
   if (!Info.Name && (Info.Name = Die.getName(&U, DINameKind::ShortName)))
-    Info.NameOffset = Linker.StringPool.getStringOffset(Info.Name);
+    Context.Strings.emplace_back(Info.Name, PatchLocation());
 
   return Info.Name || Info.MangledName;
 }
@@ -1758,8 +1879,7 @@ static unsigned getRefAddrSize(const DWARFUnit &U) {
   return 4;
 }
 
-void DwarfLinker::startDebugObject(DWARFContext &Dwarf, DebugMapObject &Obj) {
-  Units.reserve(Dwarf.getNumCompileUnits());
+void DwarfLinker::startDebugObject(LinkContext &Context) {
   // Iterate over the debug map entries and put all the ones that are
   // functions (because they have a size) into the Ranges map. This
   // map is very similar to the FunctionRanges that are stored in each
@@ -1774,29 +1894,15 @@ void DwarfLinker::startDebugObject(DWARFContext &Dwarf, DebugMapObject &Obj) {
   // FIXME: Once we understood exactly if that information is needed,
   // maybe totally remove this (or try to use it to do a real
   // -gline-tables-only on Darwin.
-  for (const auto &Entry : Obj.symbols()) {
+  for (const auto &Entry : Context.DMO.symbols()) {
     const auto &Mapping = Entry.getValue();
     if (Mapping.Size)
-      Ranges[Mapping.ObjectAddress] = std::make_pair(
+      Context.Ranges[Mapping.ObjectAddress] = std::make_pair(
           Mapping.ObjectAddress + Mapping.Size,
           int64_t(Mapping.BinaryAddress) - Mapping.ObjectAddress);
   }
 }
 
-void DwarfLinker::endDebugObject() {
-  Units.clear();
-  Ranges.clear();
-
-  for (auto I = DIEBlocks.begin(), E = DIEBlocks.end(); I != E; ++I)
-    (*I)->~DIEBlock();
-  for (auto I = DIELocs.begin(), E = DIELocs.end(); I != E; ++I)
-    (*I)->~DIELoc();
-
-  DIEBlocks.clear();
-  DIELocs.clear();
-  DIEAlloc.Reset();
-}
-
 /// \brief Iterate over the relocations of the given \p Section and
 /// store the ones that correspond to debug map entries into the
 /// ValidRelocs array.
@@ -1814,7 +1920,7 @@ findValidRelocsMachO(const object::SectionRef &Section,
     unsigned RelocSize = 1 << Obj.getAnyRelocationLength(MachOReloc);
     uint64_t Offset64 = Reloc.getOffset();
     if ((RelocSize != 4 && RelocSize != 8)) {
-      Linker.reportWarning(" unsupported relocation in debug_info section.");
+      reportWarning(" unsupported relocation in debug_info section.");
       continue;
     }
     uint32_t Offset = Offset64;
@@ -1825,7 +1931,7 @@ findValidRelocsMachO(const object::SectionRef &Section,
     if (Sym != Obj.symbol_end()) {
       ErrorOr<StringRef> SymbolName = Sym->getName();
       if (!SymbolName) {
-        Linker.reportWarning("error getting relocation symbol name.");
+        reportWarning("error getting relocation symbol name.");
         continue;
       }
       if (const auto *Mapping = DMO.lookupSymbol(*SymbolName))
@@ -1848,8 +1954,8 @@ bool DwarfLinker::RelocationManager::findValidRelocs(
   if (auto *MachOObj = dyn_cast<object::MachOObjectFile>(&Obj))
     findValidRelocsMachO(Section, *MachOObj, DMO);
   else
-    Linker.reportWarning(Twine("unsupported object file type: ") +
-                         Obj.getFileName());
+    reportWarning(Twine("unsupported object file type: ") +
+                  Obj.getFileName());
 
   if (ValidRelocs.empty())
     return false;
@@ -1943,7 +2049,7 @@ getAttributeOffsets(const DWARFAbbreviationDeclaration *Abbrev, unsigned Idx,
 
 /// \brief Check if a variable describing DIE should be kept.
 /// \returns updated TraversalFlags.
-unsigned DwarfLinker::shouldKeepVariableDIE(RelocationManager &RelocMgr,
+unsigned DwarfLinker::shouldKeepVariableDIE(LinkContext &Context,
                                             const DWARFDebugInfoEntryMinimal &DIE,
                                             CompileUnit &Unit,
                                             CompileUnit::DIEInfo &MyInfo,
@@ -1972,7 +2078,8 @@ unsigned DwarfLinker::shouldKeepVariableDIE(RelocationManager &RelocMgr,
   // always check in the variable has a valid relocation, so that the
   // DIEInfo is filled. However, we don't want a static variable in a
   // function to force us to keep the enclosing function.
-  if (!RelocMgr.hasValidRelocation(LocationOffset, LocationEndOffset, MyInfo) ||
+  if (!Context.RelocMgr.hasValidRelocation(LocationOffset, LocationEndOffset,
+                                           MyInfo) ||
       (Flags & TF_InFunctionScope))
     return Flags;
 
@@ -1985,7 +2092,7 @@ unsigned DwarfLinker::shouldKeepVariableDIE(RelocationManager &RelocMgr,
 /// \brief Check if a function describing DIE should be kept.
 /// \returns updated TraversalFlags.
 unsigned DwarfLinker::shouldKeepSubprogramDIE(
-    RelocationManager &RelocMgr,
+    LinkContext &Context,
     const DWARFDebugInfoEntryMinimal &DIE, CompileUnit &Unit,
     CompileUnit::DIEInfo &MyInfo, unsigned Flags) {
   const auto *Abbrev = DIE.getAbbreviationDeclarationPtr();
@@ -2006,7 +2113,7 @@ unsigned DwarfLinker::shouldKeepSubprogramDIE(
       DIE.getAttributeValueAsAddress(&OrigUnit, dwarf::DW_AT_low_pc, -1ULL);
   assert(LowPc != -1ULL && "low_pc attribute is not an address.");
   if (LowPc == -1ULL ||
-      !RelocMgr.hasValidRelocation(LowPcOffset, LowPcEndOffset, MyInfo))
+      !Context.RelocMgr.hasValidRelocation(LowPcOffset, LowPcEndOffset, MyInfo))
     return Flags;
 
   if (Options.Verbose)
@@ -2016,8 +2123,9 @@ unsigned DwarfLinker::shouldKeepSubprogramDIE(
 
   DWARFFormValue HighPcValue;
   if (!DIE.getAttributeValue(&OrigUnit, dwarf::DW_AT_high_pc, HighPcValue)) {
-    reportWarning("Function without high_pc. Range will be discarded.\n",
-                  &OrigUnit, &DIE);
+    Context.reportWarning(
+        "Function without high_pc. Range will be discarded.\n", &OrigUnit,
+        &DIE);
     return Flags;
   }
 
@@ -2030,14 +2138,14 @@ unsigned DwarfLinker::shouldKeepSubprogramDIE(
   }
 
   // Replace the debug map range with a more accurate one.
-  Ranges[LowPc] = std::make_pair(HighPc, MyInfo.AddrAdjust);
+  Context.Ranges[LowPc] = std::make_pair(HighPc, MyInfo.AddrAdjust);
   Unit.addFunctionRange(LowPc, HighPc, MyInfo.AddrAdjust);
   return Flags;
 }
 
 /// \brief Check if a DIE should be kept.
 /// \returns updated TraversalFlags.
-unsigned DwarfLinker::shouldKeepDIE(RelocationManager &RelocMgr,
+unsigned DwarfLinker::shouldKeepDIE(LinkContext &Context,
                                     const DWARFDebugInfoEntryMinimal &DIE,
                                     CompileUnit &Unit,
                                     CompileUnit::DIEInfo &MyInfo,
@@ -2045,9 +2153,9 @@ unsigned DwarfLinker::shouldKeepDIE(RelocationManager &RelocMgr,
   switch (DIE.getTag()) {
   case dwarf::DW_TAG_constant:
   case dwarf::DW_TAG_variable:
-    return shouldKeepVariableDIE(RelocMgr, DIE, Unit, MyInfo, Flags);
+    return shouldKeepVariableDIE(Context, DIE, Unit, MyInfo, Flags);
   case dwarf::DW_TAG_subprogram:
-    return shouldKeepSubprogramDIE(RelocMgr, DIE, Unit, MyInfo, Flags);
+    return shouldKeepSubprogramDIE(Context, DIE, Unit, MyInfo, Flags);
   case dwarf::DW_TAG_module:
   case dwarf::DW_TAG_imported_module:
   case dwarf::DW_TAG_imported_declaration:
@@ -2067,10 +2175,9 @@ unsigned DwarfLinker::shouldKeepDIE(RelocationManager &RelocMgr,
 /// back to lookForDIEsToKeep while adding TF_DependencyWalk to the
 /// TraversalFlags to inform it that it's not doing the primary DIE
 /// tree walk.
-void DwarfLinker::keepDIEAndDenpendencies(RelocationManager &RelocMgr,
+void DwarfLinker::keepDIEAndDenpendencies(LinkContext &Context,
                                           const DWARFDebugInfoEntryMinimal &Die,
                                           CompileUnit::DIEInfo &MyInfo,
-                                          const DebugMapObject &DMO,
                                           CompileUnit &CU, bool UseODR) {
   const DWARFUnit &Unit = CU.getOrigUnit();
   MyInfo.Keep = true;
@@ -2079,7 +2186,7 @@ void DwarfLinker::keepDIEAndDenpendencies(RelocationManager &RelocMgr,
   unsigned AncestorIdx = MyInfo.ParentIdx;
   while (!CU.getInfo(AncestorIdx).Keep) {
     unsigned ODRFlag = UseODR ? TF_ODR : 0;
-    lookForDIEsToKeep(RelocMgr, *Unit.getDIEAtIndex(AncestorIdx), DMO, CU,
+    lookForDIEsToKeep(Context, *Unit.getDIEAtIndex(AncestorIdx), CU,
                       TF_ParentWalk | TF_Keep | TF_DependencyWalk | ODRFlag);
     AncestorIdx = CU.getInfo(AncestorIdx).ParentIdx;
   }
@@ -2102,12 +2209,13 @@ void DwarfLinker::keepDIEAndDenpendencies(RelocationManager &RelocMgr,
     Val.extractValue(Data, &Offset, &Unit);
     CompileUnit *ReferencedCU;
     if (const auto *RefDIE =
-            resolveDIEReference(Val, Unit, Die, ReferencedCU)) {
+            resolveDIEReference(Context, Val, Unit, Die, ReferencedCU)) {
       uint32_t RefIdx = ReferencedCU->getOrigUnit().getDIEIndex(RefDIE);
       CompileUnit::DIEInfo &Info = ReferencedCU->getInfo(RefIdx);
-      // If the referenced DIE has a DeclContext that has already been
-      // emitted, then do not keep the one in this CU. We'll link to
-      // the canonical DIE in cloneDieReferenceAttribute.
+      // If the referenced DIE has a DeclContext that already has a
+      // canonical DIE in a previous object, then do not keep the one in
+      // this CU. We'll link to the canonical DIE in
+      // cloneDieReferenceAttribute.
       // FIXME: compatibility with dsymutil-classic. UseODR shouldn't
       // be necessary and could be advantageously replaced by
       // ReferencedCU->hasODR() && CU.hasODR().
@@ -2115,11 +2223,11 @@ void DwarfLinker::keepDIEAndDenpendencies(RelocationManager &RelocMgr,
       // reason not to unique ref_addr references.
       if (AttrSpec.Form != dwarf::DW_FORM_ref_addr && UseODR && Info.Ctxt &&
           Info.Ctxt != ReferencedCU->getInfo(Info.ParentIdx).Ctxt &&
-          Info.Ctxt->getCanonicalDIEOffset() && isODRAttribute(AttrSpec.Attr))
+          Info.Ctxt->getCanonicalDIEObject() && isODRAttribute(AttrSpec.Attr))
         continue;
 
       unsigned ODRFlag = UseODR ? TF_ODR : 0;
-      lookForDIEsToKeep(RelocMgr, *RefDIE, DMO, *ReferencedCU,
+      lookForDIEsToKeep(Context, *RefDIE, *ReferencedCU,
                         TF_Keep | TF_DependencyWalk | ODRFlag);
     }
   }
@@ -2137,10 +2245,9 @@ void DwarfLinker::keepDIEAndDenpendencies(RelocationManager &RelocMgr,
 /// also called, but during these dependency walks the file order is
 /// not respected. The TF_DependencyWalk flag tells us which kind of
 /// traversal we are currently doing.
-void DwarfLinker::lookForDIEsToKeep(RelocationManager &RelocMgr,
+void DwarfLinker::lookForDIEsToKeep(LinkContext &Context,
                                     const DWARFDebugInfoEntryMinimal &Die,
-                                    const DebugMapObject &DMO, CompileUnit &CU,
-                                    unsigned Flags) {
+                                    CompileUnit &CU, unsigned Flags) {
   unsigned Idx = CU.getOrigUnit().getDIEIndex(&Die);
   CompileUnit::DIEInfo &MyInfo = CU.getInfo(Idx);
   bool AlreadyKept = MyInfo.Keep;
@@ -2154,12 +2261,12 @@ void DwarfLinker::lookForDIEsToKeep(RelocationManager &RelocMgr,
   // We must not call shouldKeepDIE while called from keepDIEAndDenpendencies,
   // because it would screw up the relocation finding logic.
   if (!(Flags & TF_DependencyWalk))
-    Flags = shouldKeepDIE(RelocMgr, Die, CU, MyInfo, Flags);
+    Flags = shouldKeepDIE(Context, Die, CU, MyInfo, Flags);
 
   // If it is a newly kept DIE mark it as well as all its dependencies as kept.
   if (!AlreadyKept && (Flags & TF_Keep)) {
     bool UseOdr = (Flags & TF_DependencyWalk) ? (Flags & TF_ODR) : CU.hasODR();
-    keepDIEAndDenpendencies(RelocMgr, Die, MyInfo, DMO, CU, UseOdr);
+    keepDIEAndDenpendencies(Context, Die, MyInfo, CU, UseOdr);
   }
   // The TF_ParentWalk flag tells us that we are currently walking up
   // the parent chain of a required DIE, and we don't want to mark all
@@ -2175,7 +2282,7 @@ void DwarfLinker::lookForDIEsToKeep(RelocationManager &RelocMgr,
 
   for (auto *Child = Die.getFirstChild(); Child && !Child->isNULL();
        Child = Child->getSibling())
-    lookForDIEsToKeep(RelocMgr, *Child, DMO, CU, Flags);
+    lookForDIEsToKeep(Context, *Child, CU, Flags);
 }
 
 /// \brief Assign an abbreviation numer to \p Abbrev.
@@ -2208,15 +2315,43 @@ void DwarfLinker::AssignAbbrev(DIEAbbrev &Abbrev) {
   }
 }
 
+/// \brief Assign an abbreviation number to \p Abbrev, in the local
+/// table of the object being cloned.
+///
+/// The objects are cloned concurrently, so they cannot number their
+/// abbreviations in the global table. The local abbreviations are
+/// assigned their permanent numbers by AssignAbbrev() in the order in
+/// which they were first used, when the object is emitted. This gives
+/// the same numbers as a serial link.
+void DwarfLinker::DIECloner::assignAbbrev(DIEAbbrev &Abbrev) {
+  FoldingSetNodeID ID;
+  Abbrev.Profile(ID);
+  void *InsertToken;
+  DIEAbbrev *InSet =
+      Context.AbbreviationsSet.FindNodeOrInsertPos(ID, InsertToken);
+
+  if (!InSet) {
+    Context.Abbreviations.push_back(
+        llvm::make_unique<DIEAbbrev>(Abbrev.getTag(), Abbrev.hasChildren()));
+    InSet = Context.Abbreviations.back().get();
+    for (const auto &Attr : Abbrev.getData())
+      InSet->AddAttribute(Attr.getAttribute(), Attr.getForm());
+    Context.AbbreviationsSet.InsertNode(InSet, InsertToken);
+    InSet->setNumber(Context.Abbreviations.size());
+  }
+  Abbrev.setNumber(InSet->getNumber());
+}
+
 unsigned DwarfLinker::DIECloner::cloneStringAttribute(DIE &Die,
                                                       AttributeSpec AttrSpec,
                                                       const DWARFFormValue &Val,
                                                       const DWARFUnit &U) {
-  // Switch everything to out of line strings.
+  // Switch everything to out of line strings. The offset is patched in
+  // when the object is emitted.
   const char *String = *Val.getAsCString(&U);
-  unsigned Offset = Linker.StringPool.getStringOffset(String);
-  Die.addValue(DIEAlloc, dwarf::Attribute(AttrSpec.Attr), dwarf::DW_FORM_strp,
-               DIEInteger(Offset));
+  Context.Strings.emplace_back(
+      String, Die.addValue(DIEAlloc, dwarf::Attribute(AttrSpec.Attr),
+                           dwarf::DW_FORM_strp, DIEInteger(0)));
   return 4;
 }
 
@@ -2231,7 +2366,7 @@ unsigned DwarfLinker::DIECloner::cloneDieReferenceAttribute(
   DeclContext *Ctxt = nullptr;
 
   const DWARFDebugInfoEntryMinimal *RefDie =
-      Linker.resolveDIEReference(Val, U, InputDIE, RefUnit);
+      Linker.resolveDIEReference(Context, Val, U, InputDIE, RefUnit);
 
   // If the referenced DIE is not found,  drop the attribute.
   if (!RefDie)
@@ -2240,14 +2375,19 @@ unsigned DwarfLinker::DIECloner::cloneDieReferenceAttribute(
   unsigned Idx = RefUnit->getOrigUnit().getDIEIndex(RefDie);
   CompileUnit::DIEInfo &RefInfo = RefUnit->getInfo(Idx);
 
-  // If we already have emitted an equivalent DeclContext, just point
-  // at it.
+  // If we already have cloned an equivalent DeclContext, in this object
+  // or in a previous one, just point at it. Its offset is only known
+  // when this object is emitted.
   if (isODRAttribute(AttrSpec.Attr)) {
     Ctxt = RefInfo.Ctxt;
-    if (Ctxt && Ctxt->getCanonicalDIEOffset()) {
-      DIEInteger Attr(Ctxt->getCanonicalDIEOffset());
-      Die.addValue(DIEAlloc, dwarf::Attribute(AttrSpec.Attr),
-                   dwarf::DW_FORM_ref_addr, Attr);
+    unsigned CanonicalObject = Ctxt ? Ctxt->getCanonicalDIEObject() : 0;
+    if (CanonicalObject &&
+        (CanonicalObject < Context.ID ||
+         (CanonicalObject == Context.ID && Ctxt->isCanonicalDIECloned()))) {
+      Unit.noteForwardReference(
+          nullptr, nullptr, Ctxt,
+          Die.addValue(DIEAlloc, dwarf::Attribute(AttrSpec.Attr),
+                       dwarf::DW_FORM_ref_addr, DIEInteger(0xBADDEF)));
       return getRefAddrSize(U);
     }
   }
@@ -2267,22 +2407,14 @@ unsigned DwarfLinker::DIECloner::cloneDieReferenceAttribute(
     // to find the unit offset. (We don't have a DwarfDebug)
     // FIXME: we should be able to design DIEEntry reliance on
     // DwarfDebug away.
-    uint64_t Attr;
-    if (Ref < InputDIE.getOffset()) {
-      // We must have already cloned that DIE.
-      uint32_t NewRefOffset =
-          RefUnit->getStartOffset() + NewRefDie->getOffset();
-      Attr = NewRefOffset;
-      Die.addValue(DIEAlloc, dwarf::Attribute(AttrSpec.Attr),
-                   dwarf::DW_FORM_ref_addr, DIEInteger(Attr));
-    } else {
-      // A forward reference. Note and fixup later.
-      Attr = 0xBADDEF;
-      Unit.noteForwardReference(
-          NewRefDie, RefUnit, Ctxt,
-          Die.addValue(DIEAlloc, dwarf::Attribute(AttrSpec.Attr),
-                       dwarf::DW_FORM_ref_addr, DIEInteger(Attr)));
-    }
+    // The offsets of the DIEs are only known when the object is emitted,
+    // so all the references are fixed up then. A backward reference
+    // points to the DIE we have already cloned, even if a canonical DIE
+    // for its context shows up later.
+    Unit.noteForwardReference(
+        NewRefDie, RefUnit, Ref < InputDIE.getOffset() ? nullptr : Ctxt,
+        Die.addValue(DIEAlloc, dwarf::Attribute(AttrSpec.Attr),
+                     dwarf::DW_FORM_ref_addr, DIEInteger(0xBADDEF)));
     return getRefAddrSize(U);
   }
 
@@ -2302,10 +2434,10 @@ unsigned DwarfLinker::DIECloner::cloneBlockAttribute(DIE &Die,
   // Just copy the block data over.
   if (AttrSpec.Form == dwarf::DW_FORM_exprloc) {
     Loc = new (DIEAlloc) DIELoc;
-    Linker.DIELocs.push_back(Loc);
+    Context.DIELocs.push_back(Loc);
   } else {
     Block = new (DIEAlloc) DIEBlock;
-    Linker.DIEBlocks.push_back(Block);
+    Context.DIEBlocks.push_back(Block);
   }
   Attr = Loc ? static_cast<DIEValueList *>(Loc)
              : static_cast<DIEValueList *>(Block);
@@ -2389,7 +2521,7 @@ unsigned DwarfLinker::DIECloner::cloneScalarAttribute(
   else if (auto OptionalValue = Val.getAsUnsignedConstant())
     Value = *OptionalValue;
   else {
-    Linker.reportWarning(
+    Context.reportWarning(
         "Unsupported scalar attribute form. Dropping attribute.",
         &Unit.getOrigUnit(), &InputDIE);
     return 0;
@@ -2452,7 +2584,7 @@ unsigned DwarfLinker::DIECloner::cloneAttribute(
     return cloneScalarAttribute(Die, InputDIE, Unit, AttrSpec, Val, AttrSize,
                                 Info);
   default:
-    Linker.reportWarning(
+    Context.reportWarning(
         "Unsupported attribute form in cloneAttribute. Dropping.", &U,
         &InputDIE);
   }
@@ -2581,13 +2713,13 @@ DIE *DwarfLinker::DIECloner::cloneDIE(
     Die = Info.Clone = DIE::get(DIEAlloc, dwarf::Tag(InputDIE.getTag()));
   assert(Die->getTag() == InputDIE.getTag());
   Die->setOffset(OutOffset);
-  if (Unit.hasODR() && Die->getTag() != dwarf::DW_TAG_namespace && Info.Ctxt &&
-      Info.Ctxt != Unit.getInfo(Info.ParentIdx).Ctxt &&
-      !Info.Ctxt->getCanonicalDIEOffset()) {
-    // We are about to emit a DIE that is the root of its own valid
-    // DeclContext tree. Make the current offset the canonical offset
-    // for this context.
-    Info.Ctxt->setCanonicalDIEOffset(OutOffset + Unit.getStartOffset());
+  if (isCanonicalDIECandidate(Unit, Info, Die->getTag()) &&
+      Info.Ctxt->getCanonicalDIEObject() == Context.ID &&
+      !Info.Ctxt->isCanonicalDIECloned()) {
+    // We are about to emit the DIE that analyzeObject() chose as the
+    // canonical DIE of its context. From now on, the references to that
+    // context point to it.
+    Info.Ctxt->setCanonicalDIECloned();
   }
 
   // Extract and clone every attribute.
@@ -2670,14 +2802,13 @@ DIE *DwarfLinker::DIECloner::cloneDIE(
       getDIENames(InputDIE, Unit.getOrigUnit(), AttrInfo)) {
     if (AttrInfo.MangledName && AttrInfo.MangledName != AttrInfo.Name)
       Unit.addNameAccelerator(Die, AttrInfo.MangledName,
-                              AttrInfo.MangledNameOffset,
                               Tag == dwarf::DW_TAG_inlined_subroutine);
     if (AttrInfo.Name)
-      Unit.addNameAccelerator(Die, AttrInfo.Name, AttrInfo.NameOffset,
+      Unit.addNameAccelerator(Die, AttrInfo.Name,
                               Tag == dwarf::DW_TAG_inlined_subroutine);
   } else if (isTypeTag(Tag) && !AttrInfo.IsDeclaration &&
              getDIENames(InputDIE, Unit.getOrigUnit(), AttrInfo)) {
-    Unit.addTypeAccelerator(Die, AttrInfo.Name, AttrInfo.NameOffset);
+    Unit.addTypeAccelerator(Die, AttrInfo.Name);
   }
 
   DIEAbbrev NewAbbrev = Die->generateAbbrev();
@@ -2686,8 +2817,8 @@ DIE *DwarfLinker::DIECloner::cloneDIE(
   // children marker, but things won't break.
   if (InputDIE.hasChildren())
     NewAbbrev.setChildrenFlag(dwarf::DW_CHILDREN_yes);
-  // Assign a permanent abbrev number
-  Linker.AssignAbbrev(NewAbbrev);
+  // Assign an abbrev number, made permanent when the object is emitted.
+  assignAbbrev(NewAbbrev);
   Die->setAbbrevNumber(NewAbbrev.getNumber());
 
   // Add the size of the abbreviation number to the output offset.
@@ -2818,11 +2949,13 @@ static void patchStmtList(DIE &Die, DIEInteger Offset) {
   llvm_unreachable("Didn't find DW_AT_stmt_list in cloned DIE!");
 }
 
-/// \brief Extract the line table for \p Unit from \p OrigDwarf, and
-/// recreate a relocated version of these for the address ranges that
-/// are present in the binary.
+/// \brief Extract the line table for \p Unit from the DWARF of \p
+/// Context, and recreate a relocated version of these for the address
+/// ranges that are present in the binary.
 void DwarfLinker::patchLineTableForUnit(CompileUnit &Unit,
-                                        DWARFContext &OrigDwarf) {
+                                        LinkContext &Context) {
+  DWARFContext &OrigDwarf = *Context.DwarfContext;
+  const auto &Ranges = Context.Ranges;
   const DWARFDebugInfoEntryMinimal *CUDie = Unit.getOrigUnit().getUnitDIE();
   uint64_t StmtList = CUDie->getAttributeValueAsSectionOffset(
       &Unit.getOrigUnit(), dwarf::DW_AT_stmt_list, -1ULL);
@@ -2961,9 +3094,10 @@ void DwarfLinker::emitAcceleratorEntriesForUnit(CompileUnit &Unit) {
 /// This is actually pretty easy as the data of the CIEs and FDEs can
 /// be considered as black boxes and moved as is. The only thing to do
 /// is to patch the addresses in the headers.
-void DwarfLinker::patchFrameInfoForObject(const DebugMapObject &DMO,
-                                          DWARFContext &OrigDwarf,
+void DwarfLinker::patchFrameInfoForObject(LinkContext &Context,
                                           unsigned AddrSize) {
+  DWARFContext &OrigDwarf = *Context.DwarfContext;
+  const auto &Ranges = Context.Ranges;
   StringRef FrameData = OrigDwarf.getDebugFrameSection();
   if (FrameData.empty())
     return;
@@ -3052,60 +3186,283 @@ void DwarfLinker::DIECloner::copyAbbrev(
     Copy.AddAttribute(dwarf::Attribute(Attr.Attr), dwarf::Form(Form));
   }
 
-  Linker.AssignAbbrev(Copy);
+  assignAbbrev(Copy);
 }
 
-ErrorOr<const object::ObjectFile &>
-DwarfLinker::loadObject(BinaryHolder &BinaryHolder, DebugMapObject &Obj,
-                        const DebugMap &Map) {
+ErrorOr<std::shared_ptr<const object::ObjectFile>>
+DwarfLinker::loadObject(DebugMapObject &Obj, const DebugMap &Map,
+                        WarningList &Warnings) {
+  std::lock_guard<std::mutex> Lock(BinHolderMutex);
   auto ErrOrObjs =
-      BinaryHolder.GetObjectFiles(Obj.getObjectFilename(), Obj.getTimestamp());
+      BinHolder.GetObjectFiles(Obj.getObjectFilename(), Obj.getTimestamp());
   if (std::error_code EC = ErrOrObjs.getError()) {
-    reportWarning(Twine(Obj.getObjectFilename()) + ": " + EC.message());
+    Warnings.emplace_back((Obj.getObjectFilename() + ": " + EC.message()).str(),
+                          nullptr, nullptr);
     return EC;
   }
-  auto ErrOrObj = BinaryHolder.Get(Map.getTriple());
+  auto ErrOrObj = BinHolder.GetShared(Map.getTriple());
   if (std::error_code EC = ErrOrObj.getError())
-    reportWarning(Twine(Obj.getObjectFilename()) + ": " + EC.message());
+    Warnings.emplace_back((Obj.getObjectFilename() + ": " + EC.message()).str(),
+                          nullptr, nullptr);
   return ErrOrObj;
 }
 
-void DwarfLinker::DIECloner::cloneAllCompileUnits(
-    DWARFContextInMemory &DwarfContext) {
+void DwarfLinker::prepareObject(LinkContext &Context, const DebugMap &Map) {
+  if (Options.Verbose)
+    outs() << "DEBUG MAP OBJECT: " << Context.DMO.getObjectFilename() << "\n";
+  auto ErrOrObj = loadObject(Context.DMO, Map, Context.Warnings);
+  if (!ErrOrObj)
+    return;
+  Context.ObjectFile = std::move(*ErrOrObj);
+
+  // Look for relocations that correspond to debug map entries.
+  if (!Context.RelocMgr.findValidRelocsInDebugInfo(*Context.ObjectFile,
+                                                   Context.DMO)) {
+    if (Options.Verbose)
+      outs() << "No valid relocations found. Skipping.\n";
+    return;
+  }
+
+  // Setup access to the debug info.
+  Context.DwarfContext.reset(new DWARFContextInMemory(*Context.ObjectFile));
+  startDebugObject(Context);
+  Context.Units.reserve(Context.DwarfContext->getNumCompileUnits());
+
+  // In a first phase, just read in the debug info and store the DIE
+  // parent links that we will use during the next phase.
+  for (const auto &CU : Context.DwarfContext->compile_units()) {
+    auto *CUDie = CU->getUnitDIE(false);
+    if (Options.Verbose) {
+      outs() << "Input compilation unit:";
+      CUDie->dump(outs(), CU.get(), 0);
+    }
+    Context.Units.emplace_back(*CU, !Options.NoODR);
+    gatherDIEParents(CUDie, 0, Context.Units.back(), &ODRContexts.getRoot(),
+                     StringPool, ODRContexts);
+  }
+}
+
+void DwarfLinker::analyzeObject(LinkContext &Context) {
+  if (!Context.DwarfContext)
+    return;
+
+  // Then mark all the DIEs that need to be present in the linked
+  // output and collect some information about them. Note that this
+  // loop can not be merged with the previous one becaue cross-cu
+  // references require the ParentIdx to be setup for every CU in
+  // the object file before calling this.
+  for (auto &CurrentUnit : Context.Units)
+    lookForDIEsToKeep(Context, *CurrentUnit.getOrigUnit().getUnitDIE(),
+                      CurrentUnit, 0);
+
+  // The calls to applyValidRelocs inside cloneDIE will walk the
+  // reloc array again (in the same way findValidRelocsInDebugInfo()
+  // did). We need to reset the NextValidReloc index to the beginning.
+  Context.RelocMgr.resetValidRelocs();
+
+  // Nothing is cloned without an output file.
+  if (!Streamer)
+    return;
+
+  // Choose the canonical DIEs of the contexts that do not have one yet:
+  // the first candidates in the order in which cloneDIE() visits the
+  // kept DIEs, which is the order of the DIEs in their units.
+  for (auto &CurrentUnit : Context.Units) {
+    DWARFUnit &OrigUnit = CurrentUnit.getOrigUnit();
+    for (unsigned Idx = 0, E = OrigUnit.getNumDIEs(); Idx != E; ++Idx) {
+      CompileUnit::DIEInfo &Info = CurrentUnit.getInfo(Idx);
+      if (!Info.Keep ||
+          !isCanonicalDIECandidate(CurrentUnit, Info,
+                                   OrigUnit.getDIEAtIndex(Idx)->getTag()) ||
+          Info.Ctxt->getCanonicalDIEObject())
+        continue;
+      Info.Ctxt->setCanonicalDIEObject(Context.ID);
+      Context.CanonicalDIEs.emplace_back(Info.Ctxt, &CurrentUnit, Idx);
+    }
+  }
+}
+
+void DwarfLinker::cloneObject(LinkContext &Context) {
+  if (Context.DwarfContext)
+    DIECloner(*this, Context, Options).cloneAllCompileUnits();
+}
+
+void DwarfLinker::DIECloner::cloneAllCompileUnits() {
   if (!Linker.Streamer)
     return;
 
   for (auto &CurrentUnit : CompileUnits) {
     const auto *InputDIE = CurrentUnit.getOrigUnit().getUnitDIE();
-    CurrentUnit.setStartOffset(Linker.OutputDebugInfoSize);
-    DIE *OutputDIE = cloneDIE(*InputDIE, CurrentUnit, 0 /* PC offset */,
-                              11 /* Unit Header size */, 0);
-    CurrentUnit.setOutputUnitDIE(OutputDIE);
-    Linker.OutputDebugInfoSize = CurrentUnit.computeNextUnitOffset();
-    if (Linker.Options.NoOutput)
-      continue;
+    CurrentUnit.setOutputUnitDIE(cloneDIE(*InputDIE, CurrentUnit,
+                                          0 /* PC offset */,
+                                          11 /* Unit Header size */, 0));
+  }
+}
+
+/// \brief Give \p Die and its children the permanent numbers of the
+/// abbreviations they use, which are numbered by \p Abbrevs in the
+/// local table of the object, and lay them out from \p Offset.
+///
+/// cloneDIE() computed the sizes of the DIEs with the local numbers,
+/// only the size of the abbreviation numbers changes.
+/// \returns the offset following \p Die.
+static uint32_t layoutDIE(DIE &Die, uint32_t Offset,
+                          ArrayRef<std::unique_ptr<DIEAbbrev>> Abbrevs) {
+  const DIEAbbrev &Abbrev = *Abbrevs[Die.getAbbrevNumber() - 1];
+  uint32_t AttrSize = Die.getSize() - getULEB128Size(Die.getAbbrevNumber());
+  for (const DIE &Child : Die.children())
+    AttrSize -= Child.getSize();
+  if (Abbrev.hasChildren())
+    AttrSize -= sizeof(int8_t);
+
+  Die.setAbbrevNumber(Abbrev.getNumber());
+  Die.setOffset(Offset);
+  uint32_t NextOffset = Offset + getULEB128Size(Abbrev.getNumber()) + AttrSize;
+  for (DIE &Child : Die.children())
+    NextOffset = layoutDIE(Child, NextOffset, Abbrevs);
+  // Account for the end of children marker.
+  if (Abbrev.hasChildren())
+    NextOffset += sizeof(int8_t);
+  Die.setSize(NextOffset - Offset);
+  return NextOffset;
+}
+
+void DwarfLinker::emitObject(LinkContext &Context) {
+  CurrentDebugObject = &Context.DMO;
+  for (const auto &Warning : Context.Warnings)
+    reportWarning(std::get<0>(Warning), std::get<1>(Warning),
+                  std::get<2>(Warning));
+  if (!Context.DwarfContext || !Streamer)
+    return;
+
+  // Make the abbreviations and the strings of the object permanent, in
+  // the order in which the object used them.
+  for (auto &Abbrev : Context.Abbreviations)
+    AssignAbbrev(*Abbrev);
+  for (const auto &String : Context.Strings) {
+    uint32_t Offset = StringPool.getStringOffset(String.first);
+    if (String.second.I)
+      String.second.set(Offset);
+  }
+
+  for (auto &CurrentUnit : Context.Units) {
+    CurrentUnit.setStartOffset(OutputDebugInfoSize);
+    if (DIE *OutputDIE = CurrentUnit.getOutputUnitDIE())
+      layoutDIE(*OutputDIE, 11 /* Unit Header size */, Context.Abbreviations);
+    OutputDebugInfoSize = CurrentUnit.computeNextUnitOffset();
+  }
+
+  for (const auto &CanonicalDIE : Context.CanonicalDIEs) {
+    DeclContext *Ctxt;
+    CompileUnit *Unit;
+    unsigned Idx;
+    std::tie(Ctxt, Unit, Idx) = CanonicalDIE;
+    assert(Unit->getInfo(Idx).Clone && "Canonical DIE was not cloned");
+    Ctxt->setCanonicalDIEOffset(Unit->getStartOffset() +
+                                Unit->getInfo(Idx).Clone->getOffset());
+  }
+
+  for (auto &CurrentUnit : Context.Units) {
     // FIXME: for compatibility with the classic dsymutil, we emit
     // an empty line table for the unit, even if the unit doesn't
     // actually exist in the DIE tree.
-    Linker.patchLineTableForUnit(CurrentUnit, DwarfContext);
-    if (!OutputDIE)
+    patchLineTableForUnit(CurrentUnit, Context);
+    if (!CurrentUnit.getOutputUnitDIE())
       continue;
-    Linker.patchRangesForUnit(CurrentUnit, DwarfContext);
-    Linker.Streamer->emitLocationsForUnit(CurrentUnit, DwarfContext);
-    Linker.emitAcceleratorEntriesForUnit(CurrentUnit);
+    patchRangesForUnit(CurrentUnit, *Context.DwarfContext);
+    Streamer->emitLocationsForUnit(CurrentUnit, *Context.DwarfContext);
+    emitAcceleratorEntriesForUnit(CurrentUnit);
   }
 
-  if (Linker.Options.NoOutput)
-    return;
-
   // Emit all the compile unit's debug information.
-  for (auto &CurrentUnit : CompileUnits) {
-    Linker.generateUnitRanges(CurrentUnit);
+  for (auto &CurrentUnit : Context.Units) {
+    generateUnitRanges(CurrentUnit);
     CurrentUnit.fixupForwardReferences();
-    Linker.Streamer->emitCompileUnitHeader(CurrentUnit);
+    Streamer->emitCompileUnitHeader(CurrentUnit);
     if (!CurrentUnit.getOutputUnitDIE())
       continue;
-    Linker.Streamer->emitDIE(*CurrentUnit.getOutputUnitDIE());
+    Streamer->emitDIE(*CurrentUnit.getOutputUnitDIE());
+  }
+
+  if (!Context.Units.empty())
+    patchFrameInfoForObject(
+        Context, Context.Units[0].getOrigUnit().getAddressByteSize());
+}
+
+/// \brief Link the objects of \p Map on a pool of \p NumThreads threads.
+///
+/// The objects are prepared, analyzed and cloned on the pool, and
+/// emitted in order on the calling thread. An object is analyzed by the
+/// task that completes last between its own preparation and the analysis
+/// of the previous object, so that no task has to wait for another
+/// one. Only a few objects are in flight at a time to bound the memory
+/// use.
+void DwarfLinker::linkInParallel(const DebugMap &Map, unsigned NumThreads) {
+  std::vector<DebugMapObject *> Objects;
+  for (const auto &Obj : Map.objects())
+    Objects.push_back(Obj.get());
+  const size_t MaxInFlight = 2 * NumThreads;
+
+  // The state shared with the tasks, guarded by Mutex.
+  std::mutex Mutex;
+  std::condition_variable ObjectCloned;
+  std::vector<std::unique_ptr<LinkContext>> Contexts(Objects.size());
+  size_t NextToAnalyze = 0;
+  bool Analyzing = false;
+  // Declared last so that it waits for the tasks before the state they
+  // use is destroyed.
+  ThreadPool Pool(NumThreads);
+
+  auto Clone = [&](LinkContext *Context) {
+    cloneObject(*Context);
+    std::lock_guard<std::mutex> Lock(Mutex);
+    Context->Cloned = true;
+    ObjectCloned.notify_all();
+  };
+
+  auto Prepare = [&](LinkContext *Context) {
+    prepareObject(*Context, Map);
+    std::unique_lock<std::mutex> Lock(Mutex);
+    Context->Prepared = true;
+    if (Analyzing || NextToAnalyze != Context->ID - 1)
+      return;
+    // Analyze this object, and then the following ones that are already
+    // prepared.
+    Analyzing = true;
+    do {
+      LinkContext *Next = Contexts[NextToAnalyze].get();
+      Lock.unlock();
+      analyzeObject(*Next);
+      Pool.async(Clone, Next);
+      Lock.lock();
+      ++NextToAnalyze;
+    } while (NextToAnalyze != Contexts.size() && Contexts[NextToAnalyze] &&
+             Contexts[NextToAnalyze]->Prepared);
+    Analyzing = false;
+  };
+
+  size_t NextToPrepare = 0;
+  for (size_t I = 0; I != Objects.size(); ++I) {
+    for (; NextToPrepare != Objects.size() &&
+           NextToPrepare < I + MaxInFlight;
+         ++NextToPrepare) {
+      auto Context = llvm::make_unique<LinkContext>(
+          *this, *Objects[NextToPrepare], NextToPrepare + 1);
+      LinkContext *Ctx = Context.get();
+      {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        Contexts[NextToPrepare] = std::move(Context);
+      }
+      Pool.async(Prepare, Ctx);
+    }
+
+    std::unique_ptr<LinkContext> Context;
+    {
+      std::unique_lock<std::mutex> Lock(Mutex);
+      ObjectCloned.wait(Lock, [&] { return Contexts[I]->Cloned; });
+      Context = std::move(Contexts[I]);
+    }
+    emitObject(*Context);
   }
 }
 
@@ -3116,64 +3473,25 @@ bool DwarfLinker::link(const DebugMap &Map) {
 
   // Size of the DIEs (and headers) generated for the linked output.
   OutputDebugInfoSize = 0;
-  // A unique ID that identifies each compile unit.
-  unsigned UnitID = 0;
-  for (const auto &Obj : Map.objects()) {
-    CurrentDebugObject = Obj.get();
 
-    if (Options.Verbose)
-      outs() << "DEBUG MAP OBJECT: " << Obj->getObjectFilename() << "\n";
-    auto ErrOrObj = loadObject(BinHolder, *Obj, Map);
-    if (!ErrOrObj)
-      continue;
-
-    // Look for relocations that correspond to debug map entries.
-    RelocationManager RelocMgr(*this);
-    if (!RelocMgr.findValidRelocsInDebugInfo(*ErrOrObj, *Obj)) {
-      if (Options.Verbose)
-        outs() << "No valid relocations found. Skipping.\n";
-      continue;
-    }
+  // The output does not depend on the number of threads, but the
+  // verbose output needs everything to happen in order.
+  unsigned NumThreads = Options.Threads ? Options.Threads
+                                        : hardware_concurrency();
+  if (Options.Verbose)
+    NumThreads = 1;
 
-    // Setup access to the debug info.
-    DWARFContextInMemory DwarfContext(*ErrOrObj);
-    startDebugObject(DwarfContext, *Obj);
-
-    // In a first phase, just read in the debug info and store the DIE
-    // parent links that we will use during the next phase.
-    for (const auto &CU : DwarfContext.compile_units()) {
-      auto *CUDie = CU->getUnitDIE(false);
-      if (Options.Verbose) {
-        outs() << "Input compilation unit:";
-        CUDie->dump(outs(), CU.get(), 0);
-      }
-      Units.emplace_back(*CU, UnitID++, !Options.NoODR);
-      gatherDIEParents(CUDie, 0, Units.back(), &ODRContexts.getRoot(),
-                       StringPool, ODRContexts);
+  if (NumThreads > 1) {
+    linkInParallel(Map, NumThreads);
+  } else {
+    unsigned ID = 0;
+    for (const auto &Obj : Map.objects()) {
+      LinkContext Context(*this, *Obj, ++ID);
+      prepareObject(Context, Map);
+      analyzeObject(Context);
+      cloneObject(Context);
+      emitObject(Context);
     }
-
-    // Then mark all the DIEs that need to be present in the linked
-    // output and collect some information about them. Note that this
-    // loop can not be merged with the previous one becaue cross-cu
-    // references require the ParentIdx to be setup for every CU in
-    // the object file before calling this.
-    for (auto &CurrentUnit : Units)
-      lookForDIEsToKeep(RelocMgr, *CurrentUnit.getOrigUnit().getUnitDIE(), *Obj,
-                        CurrentUnit, 0);
-
-    // The calls to applyValidRelocs inside cloneDIE will walk the
-    // reloc array again (in the same way findValidRelocsInDebugInfo()
-    // did). We need to reset the NextValidReloc index to the beginning.
-    RelocMgr.resetValidRelocs();
-    if (RelocMgr.hasValidRelocs())
-      DIECloner(*this, RelocMgr, DIEAlloc, Units, Options)
-          .cloneAllCompileUnits(DwarfContext);
-    if (!Options.NoOutput && !Units.empty())
-      patchFrameInfoForObject(*Obj, DwarfContext,
-                              Units[0].getOrigUnit().getAddressByteSize());
-
-    // Clean-up before starting working on the next object.
-    endDebugObject();
   }
 
   // Emit everything that's global.
@@ -3190,6 +3508,7 @@ bool DwarfLinker::link(const DebugMap &Map) {
 /// can insert a new element or return the offset of a preexisitng
 /// one.
 uint32_t NonRelocatableStringpool::getStringOffset(StringRef S) {
+  std::lock_guard<std::mutex> Lock(Mutex);
   if (S.empty() && !Strings.empty())
     return 0;
 
@@ -3215,6 +3534,7 @@ uint32_t NonRelocatableStringpool::getStringOffset(StringRef S) {
 /// that go into the output section. A latter call to
 /// getStringOffset() with the same string will chain it though.
 StringRef NonRelocatableStringpool::internString(StringRef S) {
+  std::lock_guard<std::mutex> Lock(Mutex);
   std::pair<uint32_t, StringMapEntryBase *> Entry(0, nullptr);
   auto InsertResult = Strings.insert(std::make_pair(S, Entry));
   return InsertResult.first->getKey();
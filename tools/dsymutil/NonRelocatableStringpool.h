@@ -9,6 +9,8 @@
 #ifndef LLVM_TOOLS_DSYMUTIL_NONRELOCATABLESTRINGPOOL_H
 #define LLVM_TOOLS_DSYMUTIL_NONRELOCATABLESTRINGPOOL_H
 
+#include <mutex>
+
 namespace llvm {
 namespace dsymutil {
 
@@ -18,6 +20,10 @@ namespace dsymutil {
 /// has relocation entries for every reference to it. This class
 /// provides this ablitity by just associating offsets with
 /// strings.
+///
+/// Strings can be added concurrently from several threads.  Their offsets
+/// follow the order of the getStringOffset() calls, so these should be made
+/// in a deterministic order.
 class NonRelocatableStringpool {
 public:
   /// \brief Entries are stored into the StringMap and simply linked
@@ -58,6 +64,7 @@ public:
   uint64_t getSize() { return CurrentEndOffset; }
 
 private:
+  std::mutex Mutex;
   MapTy Strings;
   uint32_t CurrentEndOffset;
   MapTy::MapEntryTy Sentinel, *Last;
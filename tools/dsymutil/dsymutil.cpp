@@ -68,6 +68,15 @@ static opt<bool>
              desc("Do the link in memory, but do not emit the result file."),
              init(false), cat(DsymCategory));
 
+static opt<unsigned> NumThreads(
+    "num-threads",
+    desc("Number of threads loading, analyzing and cloning the objects to\n"
+         "link while others are emitted, 0 for the number of cores. The\n"
+         "output does not depend on it. Ignored with -verbose."),
+    init(1), cat(DsymCategory));
+static alias NumThreadsA("j", desc("Alias for --num-threads"),
+                         aliasopt(NumThreads));
+
 static list<std::string> ArchFlags(
     "arch",
     desc("Link DWARF debug information only for specified CPU architecture\n"
@@ -257,6 +266,7 @@ int main(int argc, char **argv) {
   Options.Verbose = Verbose;
   Options.NoOutput = NoOutput;
   Options.NoODR = NoODR;
+  Options.Threads = NumThreads;
 
   llvm::InitializeAllTargetInfos();
   llvm::InitializeAllTargetMCs();
@@ -28,8 +28,9 @@ struct LinkOptions {
   bool Verbose;  ///< Verbosity
   bool NoOutput; ///< Skip emitting output
   bool NoODR;    ///< Do not unique types according to ODR
+  unsigned Threads; ///< Number of threads, 0 for the number of cores
 
-  LinkOptions() : Verbose(false), NoOutput(false) {}
+  LinkOptions() : Verbose(false), NoOutput(false), NoODR(false), Threads(1) {}
 };
 
 /// \brief Extract the DebugMaps from the given file.
@@ -8,14 +8,25 @@
 //===----------------------------------------------------------------------===//
 
 #include "OrcLazyJIT.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
 #include "llvm/ExecutionEngine/Orc/OrcTargetSupport.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/LegacyPassManager.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/IPO/PassManagerBuilder.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include <atomic>
 #include <cstdio>
+#include <set>
 #include <system_error>
 
 using namespace llvm;
 
+#define DEBUG_TYPE "orc-lazy"
+
 namespace {
 
   enum class DumpKind { NoDump, DumpFuncsToStdOut, DumpModsToStdErr,
@@ -39,6 +50,26 @@ namespace {
                                              "working directory. (WARNING: "
                                              "will overwrite existing files)."),
                                   clEnumValEnd));
+
+  cl::opt<unsigned> OrcCompileThreads(
+      "orc-lazy-compile-threads",
+      cl::desc("Number of threads compiling the likely callees of the "
+               "functions compiled on demand, ahead of their first call "
+               "(default: 0, no speculative compilation)."),
+      cl::init(0));
+
+  cl::opt<unsigned> OrcTierUpThreshold(
+      "orc-lazy-tier-up-threshold",
+      cl::desc("Compile functions quickly at first, and recompile them at "
+               "the -O level in the background after this many calls "
+               "(default: 0, compile once at the -O level)."),
+      cl::init(0));
+
+  cl::opt<std::string> OrcCacheDir(
+      "orc-lazy-cache-dir",
+      cl::desc("Directory in which to keep the compiled objects, to reuse "
+               "them in later runs."),
+      cl::init(""));
 }
 
 OrcLazyJIT::CallbackManagerBuilder
@@ -108,6 +139,151 @@ OrcLazyJIT::TransformFtor OrcLazyJIT::createDebugDumper() {
   llvm_unreachable("Unknown DumpKind");
 }
 
+void OrcLazyJIT::addTierUpCounters(Module &M) {
+  // The functions of the optimization tier find the globals of M by name, so
+  // give every global one that will not change.
+  orc::makeAllSymbolsExternallyAccessible(M);
+
+  auto Tiered = llvm::make_unique<TieredModule>();
+  Tiered->Context = llvm::make_unique<LLVMContext>();
+  Tiered->Source = CloneModuleIntoContext(&M, *Tiered->Context);
+
+  LLVMContext &Ctx = M.getContext();
+  Type *CountTy = Type::getInt32Ty(Ctx);
+  Type *ArgTy = Type::getInt64Ty(Ctx);
+  FunctionType *HookTy =
+      FunctionType::get(Type::getVoidTy(Ctx), ArgTy, /*isVarArg=*/false);
+  Constant *Hook = ConstantExpr::getIntToPtr(
+      ConstantInt::get(ArgTy, reinterpret_cast<uintptr_t>(&tierUpHook)),
+      HookTy->getPointerTo());
+
+  for (auto &F : M) {
+    if (F.isDeclaration())
+      continue;
+
+    TieredFunctions.push_back(llvm::make_unique<TieredFunction>());
+    TieredFunction &TF = *TieredFunctions.back();
+    TF.JIT = this;
+    TF.Parent = Tiered.get();
+    TF.Name = F.getName();
+
+    // Count the calls after the static allocas, and call the hook once the
+    // count reaches the threshold. The count is not atomic: a few calls from
+    // other threads may be missed, but the hook is called at most once.
+    auto *Counter = new GlobalVariable(
+        M, CountTy, false, GlobalValue::ExternalLinkage,
+        ConstantInt::get(CountTy, 0), F.getName() + "$orc_count");
+    Counter->setVisibility(GlobalValue::HiddenVisibility);
+    BasicBlock::iterator IP = F.getEntryBlock().getFirstInsertionPt();
+    while (isa<AllocaInst>(IP))
+      ++IP;
+    IRBuilder<> Builder(&*IP);
+    Value *Count = Builder.CreateAdd(Builder.CreateLoad(Counter),
+                                     ConstantInt::get(CountTy, 1));
+    Builder.CreateStore(Count, Counter);
+    Value *IsHot =
+        Builder.CreateICmpEQ(Count, ConstantInt::get(CountTy, TierUpThreshold));
+    TerminatorInst *Then = SplitBlockAndInsertIfThen(IsHot, &*IP, false);
+    IRBuilder<>(Then).CreateCall(
+        Hook, ConstantInt::get(ArgTy, reinterpret_cast<uintptr_t>(&TF)));
+  }
+
+  TieredModules.push_back(std::move(Tiered));
+}
+
+void OrcLazyJIT::tierUpHook(uint64_t Function) {
+  auto *TF = reinterpret_cast<const TieredFunction *>(
+      static_cast<uintptr_t>(Function));
+  TF->JIT->TierUpThread->async([TF]() { TF->JIT->tierUp(*TF); });
+}
+
+void OrcLazyJIT::tierUp(const TieredFunction &TF) {
+  Module &Src = *TF.Parent->Source;
+  Function *F = Src.getFunction(TF.Name);
+  assert(F && !F->isDeclaration() && "Tiered function was not cloned");
+
+  // Clone F, along with the functions it calls directly so that they can be
+  // inlined. Everything else is referenced by name: the calls go through the
+  // stubs of the JIT, which pick up the optimized versions as they appear.
+  std::set<const GlobalValue *> Definitions;
+  Definitions.insert(F);
+  for (auto &BB : *F)
+    for (auto &I : BB)
+      if (auto CS = CallSite(&I))
+        if (auto *Callee = dyn_cast<Function>(
+                CS.getCalledValue()->stripPointerCasts()))
+          if (!Callee->isDeclaration())
+            Definitions.insert(Callee);
+
+  ValueToValueMapTy VMap;
+  std::unique_ptr<Module> M(
+      CloneModule(&Src, VMap, [&](const GlobalValue *GV) {
+        return Definitions.count(GV) != 0;
+      }));
+  for (auto &G : *M) {
+    if (G.isDeclaration())
+      G.setComdat(nullptr);
+    else if (G.getName() != TF.Name) {
+      G.setComdat(nullptr);
+      G.setLinkage(GlobalValue::AvailableExternallyLinkage);
+    }
+  }
+  for (auto I = M->global_begin(), E = M->global_end(); I != E;) {
+    GlobalVariable &GV = *I++;
+    GV.setComdat(nullptr);
+    // llvm.global_ctors and the like belong to the baseline tier.
+    if (GV.getName().startswith("llvm."))
+      GV.eraseFromParent();
+  }
+
+  // Optimize the module as the -O level would in a static compile.
+  unsigned OptLevel = OptTM->getOptLevel() == CodeGenOpt::Aggressive ? 3 : 2;
+  PassManagerBuilder Builder;
+  Builder.OptLevel = OptLevel;
+  Builder.Inliner = createFunctionInliningPass(OptLevel, 0);
+  legacy::FunctionPassManager FPM(M.get());
+  legacy::PassManager MPM;
+  FPM.add(createTargetTransformInfoWrapperPass(OptTM->getTargetIRAnalysis()));
+  MPM.add(createTargetTransformInfoWrapperPass(OptTM->getTargetIRAnalysis()));
+  Builder.populateFunctionPassManager(FPM);
+  Builder.populateModulePassManager(MPM);
+  FPM.doInitialization();
+  for (auto &G : *M)
+    FPM.run(G);
+  FPM.doFinalization();
+  MPM.run(*M);
+
+  auto Resolver = orc::createLambdaResolver(
+      [this](const std::string &Name) {
+        if (auto Sym = CODLayer.findSymbol(Name, false))
+          return RuntimeDyld::SymbolInfo(Sym.getAddress(), Sym.getFlags());
+        if (auto Sym = CXXRuntimeOverrides.searchOverrides(Name))
+          return Sym;
+        if (auto Addr = RTDyldMemoryManager::getSymbolAddressInProcess(Name))
+          return RuntimeDyld::SymbolInfo(Addr, JITSymbolFlags::Exported);
+        return RuntimeDyld::SymbolInfo(nullptr);
+      },
+      [](const std::string &Name) { return RuntimeDyld::SymbolInfo(nullptr); });
+  std::vector<std::unique_ptr<Module>> S;
+  S.push_back(std::move(M));
+  auto H = OptCompileLayer->addModuleSet(
+      std::move(S), llvm::make_unique<SectionMemoryManager>(),
+      std::move(Resolver));
+
+  auto Body = OptCompileLayer->findSymbolIn(H, mangle(TF.Name), false);
+  auto Ptr = CODLayer.findSymbol(mangle(TF.Name + "$orc_addr"), false);
+  if (!Body || !Ptr)
+    return;
+
+  // Threads running JIT'd code may be calling through the pointer.
+  auto *PtrAddr =
+      fromTargetAddress<std::atomic<uintptr_t> *>(Ptr.getAddress());
+  PtrAddr->store(static_cast<uintptr_t>(Body.getAddress()),
+                 std::memory_order_release);
+  DEBUG(dbgs() << "orc-lazy: recompiled hot function " << TF.Name << " at -O"
+               << OptLevel << "\n");
+}
+
 // Defined in lli.cpp.
 CodeGenOpt::Level getOptLevel();
 
@@ -122,7 +298,15 @@ int llvm::runOrcLazyJIT(std::unique_ptr<Module> M, int ArgC, char* ArgV[]) {
   // target-specific Orc callback manager.
   EngineBuilder EB;
   EB.setOptLevel(getOptLevel());
+  std::unique_ptr<TargetMachine> OptTM;
+  if (OrcTierUpThreshold) {
+    // The -O level is for hot functions. The others are compiled quickly.
+    OptTM.reset(EB.selectTarget());
+    EB.setOptLevel(CodeGenOpt::None);
+  }
   auto TM = std::unique_ptr<TargetMachine>(EB.selectTarget());
+  if (OrcTierUpThreshold)
+    TM->setFastISel(true);
   M->setDataLayout(TM->createDataLayout());
   auto &Context = getGlobalContext();
   auto CallbackMgrBuilder =
@@ -138,7 +322,10 @@ int llvm::runOrcLazyJIT(std::unique_ptr<Module> M, int ArgC, char* ArgV[]) {
 
   // Everything looks good. Build the JIT.
   auto &DL = M->getDataLayout();
-  OrcLazyJIT J(std::move(TM), DL, Context, CallbackMgrBuilder);
+  OrcLazyJIT J(std::move(TM), DL, Context, CallbackMgrBuilder,
+               OrcCompileThreads, std::move(OptTM), OrcTierUpThreshold);
+  if (!OrcCacheDir.empty())
+    J.setObjectCacheDir(OrcCacheDir);
 
   // Add the module, look up main and run it.
   auto MainHandle = J.addModule(std::move(M));
@@ -8,7 +8,8 @@
 //===----------------------------------------------------------------------===//
 //
 // Simple Orc-based JIT. Uses the compile-on-demand layer to break up and
-// lazily compile modules.
+// lazily compile modules, and optionally recompiles hot functions with full
+// optimization.
 //
 //===----------------------------------------------------------------------===//
 
@@ -22,8 +23,10 @@
 #include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
 #include "llvm/ExecutionEngine/Orc/IRTransformLayer.h"
 #include "llvm/ExecutionEngine/Orc/ObjectLinkingLayer.h"
+#include "llvm/ExecutionEngine/Orc/PersistentObjectCache.h"
 #include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/Support/ThreadPool.h"
 
 namespace llvm {
 
@@ -48,17 +51,42 @@ public:
   static CallbackManagerBuilder createCallbackManagerBuilder(Triple T);
   const DataLayout &DL;
 
+  /// If \p NumCompileThreads is not zero, the likely callees of the
+  /// functions compiled on demand are compiled ahead on that many threads.
+  ///
+  /// If \p TierUpThreshold is not zero, functions are compiled with \p TM,
+  /// which should be set up for fast compilation, along with a counter of
+  /// their calls. A function called \p TierUpThreshold times is recompiled
+  /// in the background with \p OptTM and the full optimization pipeline, and
+  /// its stub is repointed to the result.
   OrcLazyJIT(std::unique_ptr<TargetMachine> TM, const DataLayout &DL,
-             LLVMContext &Context, CallbackManagerBuilder &BuildCallbackMgr)
+             LLVMContext &Context, CallbackManagerBuilder &BuildCallbackMgr,
+             unsigned NumCompileThreads = 0,
+             std::unique_ptr<TargetMachine> OptTM = nullptr,
+             unsigned TierUpThreshold = 0)
       : DL(DL), TM(std::move(TM)), ObjectLayer(),
         CompileLayer(ObjectLayer, orc::SimpleCompiler(*this->TM)),
         IRDumpLayer(CompileLayer, createDebugDumper()),
         CCMgr(BuildCallbackMgr(IRDumpLayer, CCMgrMemMgr, Context)),
-        CODLayer(IRDumpLayer, *CCMgr, false),
+        CompileThreads(NumCompileThreads ? new ThreadPool(NumCompileThreads)
+                                         : nullptr),
+        CODLayer(IRDumpLayer, *CCMgr, false, CompileThreads.get()),
         CXXRuntimeOverrides(
-            [this](const std::string &S) { return mangle(S); }) {}
+            [this](const std::string &S) { return mangle(S); }),
+        OptTM(std::move(OptTM)), TierUpThreshold(TierUpThreshold) {
+    if (TierUpThreshold) {
+      assert(this->OptTM && "Tiered compilation needs a second target machine");
+      OptCompileLayer = llvm::make_unique<CompileLayerT>(
+          OptObjectLayer, orc::SimpleCompiler(*this->OptTM));
+      TierUpThread = llvm::make_unique<ThreadPool>(1);
+    }
+  }
 
   ~OrcLazyJIT() {
+    // Let the background compiles finish before the program is torn down.
+    if (TierUpThread)
+      TierUpThread->wait();
+    CODLayer.waitForBackgroundCompiles();
     // Run any destructors registered with __cxa_atexit.
     CXXRuntimeOverrides.runDestructors();
     // Run any IR destructors.
@@ -76,6 +104,9 @@ public:
     if (M->getDataLayout().isDefault())
       M->setDataLayout(DL);
 
+    if (TierUpThreshold)
+      addTierUpCounters(*M);
+
     // Record the static constructors and destructors. We have to do this before
     // we hand over ownership of the module to the JIT.
     std::vector<std::string> CtorNames, DtorNames;
@@ -123,6 +154,17 @@ public:
     return H;
   }
 
+  /// Keep the compiled objects in \p CacheDir, to reuse them in later runs.
+  void setObjectCacheDir(const std::string &CacheDir) {
+    ObjCache = llvm::make_unique<orc::PersistentObjectCache>(CacheDir, *TM);
+    CompileLayer.setObjectCache(ObjCache.get());
+    if (OptCompileLayer) {
+      OptObjCache =
+          llvm::make_unique<orc::PersistentObjectCache>(CacheDir, *OptTM);
+      OptCompileLayer->setObjectCache(OptObjCache.get());
+    }
+  }
+
   orc::JITSymbol findSymbol(const std::string &Name) {
     return CODLayer.findSymbol(mangle(Name), true);
   }
@@ -132,6 +174,31 @@ public:
   }
 
 private:
+  // The optimization tier source of a module: a copy of it, in its own
+  // context, from before the tier-up counters were added.
+  struct TieredModule {
+    std::unique_ptr<LLVMContext> Context;
+    std::unique_ptr<Module> Source;
+  };
+
+  // A function of a TieredModule that can be recompiled.
+  struct TieredFunction {
+    OrcLazyJIT *JIT;
+    TieredModule *Parent;
+    std::string Name;
+  };
+
+  /// Keep an optimization tier source of \p M, and instrument the functions
+  /// of \p M to call tierUpHook() when they become hot.
+  void addTierUpCounters(Module &M);
+
+  /// Called by the JIT'd code with the address of a hot TieredFunction.
+  static void tierUpHook(uint64_t Function);
+
+  /// Recompile \p F with full optimization and point its stub at the result.
+  /// Runs on TierUpThread.
+  void tierUp(const TieredFunction &F);
+
   std::string mangle(const std::string &Name) {
     std::string MangledName;
     {
@@ -145,15 +212,26 @@ private:
 
   std::unique_ptr<TargetMachine> TM;
   SectionMemoryManager CCMgrMemMgr;
+  std::unique_ptr<orc::PersistentObjectCache> ObjCache, OptObjCache;
 
   ObjLayerT ObjectLayer;
   CompileLayerT CompileLayer;
   IRDumpLayerT IRDumpLayer;
   std::unique_ptr<CompileCallbackMgr> CCMgr;
+  std::unique_ptr<ThreadPool> CompileThreads;
   CODLayerT CODLayer;
 
   orc::LocalCXXRuntimeOverrides CXXRuntimeOverrides;
   std::vector<orc::CtorDtorRunner<CODLayerT>> IRStaticDestructorRunners;
+
+  // The optimization tier. Only used on TierUpThread once set up.
+  std::unique_ptr<TargetMachine> OptTM;
+  unsigned TierUpThreshold;
+  ObjLayerT OptObjectLayer;
+  std::unique_ptr<CompileLayerT> OptCompileLayer;
+  std::vector<std::unique_ptr<TieredModule>> TieredModules;
+  std::vector<std::unique_ptr<TieredFunction>> TieredFunctions;
+  std::unique_ptr<ThreadPool> TierUpThread;
 };
 
 int runOrcLazyJIT(std::unique_ptr<Module> M, int ArgC, char* ArgV[]);
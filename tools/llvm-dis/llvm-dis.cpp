@@ -17,6 +17,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/IR/AssemblyAnnotationWriter.h"
 #include "llvm/IR/DebugInfo.h"
@@ -112,6 +113,23 @@ public:
   }
 };
 
+/// Streams the bytes of a buffer to the bitcode reader.
+class BufferStreamer : public DataStreamer {
+  std::unique_ptr<MemoryBuffer> Buffer;
+  size_t Pos = 0;
+
+public:
+  explicit BufferStreamer(std::unique_ptr<MemoryBuffer> Buffer)
+      : Buffer(std::move(Buffer)) {}
+
+  size_t GetBytes(unsigned char *Buf, size_t Len) override {
+    Len = std::min(Len, Buffer->getBufferSize() - Pos);
+    memcpy(Buf, Buffer->getBufferStart() + Pos, Len);
+    Pos += Len;
+    return Len;
+  }
+};
+
 } // end anon namespace
 
 static void diagnosticHandler(const DiagnosticInfo &DI, void *Context) {
@@ -144,26 +162,31 @@ int main(int argc, char **argv) {
 
   cl::ParseCommandLineOptions(argc, argv, "llvm .bc -> .ll disassembler\n");
 
-  std::string ErrorMessage;
-  std::unique_ptr<Module> M;
-
-  // Use the bitcode streaming interface
-  std::unique_ptr<DataStreamer> Streamer =
-      getDataFileStreamer(InputFilename, &ErrorMessage);
-  if (Streamer) {
-    std::string DisplayFilename;
-    if (InputFilename == "-")
-      DisplayFilename = "<stdin>";
-    else
-      DisplayFilename = InputFilename;
-    ErrorOr<std::unique_ptr<Module>> MOrErr =
-        getStreamedBitcodeModule(DisplayFilename, std::move(Streamer), Context);
-    M = std::move(*MOrErr);
-    M->materializeAllPermanently();
-  } else {
-    errs() << argv[0] << ": " << ErrorMessage << '\n';
+  // Map the input rather than streaming it, so that the reader can use the
+  // bitcode in place.
+  ErrorOr<std::unique_ptr<MemoryBuffer>> BufferOrErr =
+      InputFilename == "-"
+          ? MemoryBuffer::getSTDIN()
+          : MemoryBuffer::getFile(InputFilename, -1,
+                                  /*RequiresNullTerminator=*/false);
+  if (std::error_code EC = BufferOrErr.getError()) {
+    errs() << argv[0] << ": Could not open " << InputFilename << ": "
+           << EC.message() << '\n';
     return 1;
   }
+  // Bitcode is padded to whole words, and the in-memory reader rejects
+  // anything else outright.  Stream such a file instead, so that it is
+  // diagnosed as far as it can be read.
+  std::unique_ptr<MemoryBuffer> &Buffer = *BufferOrErr;
+  std::string Name = Buffer->getBufferIdentifier();
+  ErrorOr<std::unique_ptr<Module>> MOrErr =
+      Buffer->getBufferSize() % 4
+          ? getStreamedBitcodeModule(
+                Name, llvm::make_unique<BufferStreamer>(std::move(Buffer)),
+                Context)
+          : getLazyBitcodeModule(std::move(Buffer), Context);
+  std::unique_ptr<Module> M = std::move(*MOrErr);
+  M->materializeAllPermanently();
 
   // Just use stdout.  We won't actually print anything on it.
   if (DontPrint)
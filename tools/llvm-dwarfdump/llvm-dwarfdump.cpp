@@ -70,6 +70,11 @@ DumpType("debug-dump", cl::init(DIDT_All),
         clEnumValN(DIDT_StrOffsetsDwo, "str_offsets.dwo", ".debug_str_offsets.dwo"),
         clEnumValEnd));
 
+static cl::opt<unsigned>
+Jobs("jobs", cl::init(1), cl::value_desc("N"),
+     cl::desc("Parse the compile units on N threads before dumping "
+              "(0 for one per hardware thread)"));
+
 static void error(StringRef Filename, std::error_code EC) {
   if (!EC)
     return;
@@ -78,7 +83,9 @@ static void error(StringRef Filename, std::error_code EC) {
 }
 
 static void DumpObjectFile(ObjectFile &Obj, Twine Filename) {
-  std::unique_ptr<DIContext> DICtx(new DWARFContextInMemory(Obj));
+  std::unique_ptr<DWARFContext> DICtx(new DWARFContextInMemory(Obj));
+  if (Jobs != 1)
+    DICtx->extractCompileUnitsInParallel(Jobs);
 
   outs() << Filename.str() << ":\tfile format " << Obj.getFileFormatName()
          << "\n\n";
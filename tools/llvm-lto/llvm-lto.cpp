@@ -13,17 +13,27 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/ADT/StringSet.h"
+#include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/CodeGen/CommandFlags.h"
+#include "llvm/IR/FunctionInfo.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IRReader/IRReader.h"
 #include "llvm/LTO/LTOCodeGenerator.h"
 #include "llvm/LTO/LTOModule.h"
+#include "llvm/LTO/LTOObjectCache.h"
+#include "llvm/Support/CachePruning.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/Signals.h"
+#include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/IPO/FunctionImport.h"
+#include <atomic>
 #include <list>
 
 using namespace llvm;
@@ -86,6 +96,40 @@ static cl::opt<bool> SetMergedModule(
 static cl::opt<unsigned> Parallelism("j", cl::Prefix, cl::init(1),
                                      cl::desc("Number of backend threads"));
 
+static cl::opt<bool> ThinLTO(
+    "thinlto", cl::init(false),
+    cl::desc("Only write a combined function index of the inputs to "
+             "<output>.thinlto.bc"));
+
+static cl::opt<std::string> ThinLTOIndex(
+    "thinlto-index", cl::init(""), cl::value_desc("filename"),
+    cl::desc("Compile each input separately to <output>.<N>, importing "
+             "functions from the other inputs through the given combined "
+             "function index"));
+
+static cl::opt<std::string>
+    CacheDir("cache-dir", cl::init(""), cl::value_desc("directory"),
+             cl::desc("Reuse object files from this directory when the "
+                      "inputs and options of a link did not change"));
+
+// Not cl::opt<uint64_t>, which has no parser on LP64 hosts.
+static cl::opt<unsigned long long>
+    CacheMaxSize("cache-max-size", cl::init(0), cl::value_desc("bytes"),
+                 cl::desc("Prune the cache to at most this size (0 means no "
+                          "limit)"));
+
+static cl::opt<unsigned> CacheExpiration(
+    "cache-expiration", cl::init(7 * 24 * 3600), cl::value_desc("seconds"),
+    cl::desc("Prune cache entries unused for this long (0 means never)"));
+
+static cl::opt<unsigned> CachePruningInterval(
+    "cache-pruning-interval", cl::init(1200), cl::value_desc("seconds"),
+    cl::desc("Prune the cache at most once in this interval"));
+
+static cl::opt<bool>
+    CacheStats("cache-stats", cl::init(false),
+               cl::desc("Print the number of cache hits and misses"));
+
 namespace {
 struct ModuleInfo {
   std::vector<bool> CanBeHidden;
@@ -151,30 +195,233 @@ static int listSymbols(StringRef Command, const TargetOptions &Options) {
   return 0;
 }
 
-int main(int argc, char **argv) {
-  // Print a stack trace if we signal out.
-  sys::PrintStackTraceOnErrorSignal();
-  PrettyStackTraceProgram X(argc, argv);
+/// \brief Add to \p Key the optimization flags and the contents of the files
+/// at \p Paths.  Returns false if a file cannot be read.
+static bool addInputsToCacheKey(LTOCacheKey &Key, ArrayRef<std::string> Paths) {
+  Key.add(DisableInline);
+  Key.add(DisableGVNLoadPRE);
+  Key.add(DisableLTOVectorization);
+  for (const std::string &Path : Paths) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> BufferOrErr =
+        MemoryBuffer::getFile(Path);
+    if (!BufferOrErr)
+      return false;
+    Key.add((*BufferOrErr)->getBuffer());
+  }
+  return true;
+}
 
-  llvm_shutdown_obj Y; // Call llvm_shutdown() on exit.
-  cl::ParseCommandLineOptions(argc, argv, "llvm LTO linker\n");
+/// \brief Write the cached \p Object to \p Path.
+static bool writeCachedObject(StringRef Command, StringRef Path,
+                              const MemoryBuffer &Object) {
+  std::error_code EC;
+  tool_output_file Out(Path, EC, sys::fs::F_None);
+  if (EC) {
+    errs() << Command << ": error opening the file '" << Path
+           << "': " << EC.message() << "\n";
+    return false;
+  }
+  Out.os() << Object.getBuffer();
+  Out.keep();
+  return true;
+}
 
-  if (OptLevel < '0' || OptLevel > '3') {
-    errs() << argv[0] << ": optimization level must be between 0 and 3\n";
+/// \brief Add the object file just written to \p Out to the cache.
+static void cacheObject(LTOObjectCache &Cache, StringRef Key,
+                        tool_output_file &Out, StringRef Path) {
+  Out.os().close();
+  if (Out.os().has_error())
+    return;
+  ErrorOr<std::unique_ptr<MemoryBuffer>> BufferOrErr =
+      MemoryBuffer::getFile(Path);
+  if (BufferOrErr)
+    Cache.insert(Key, (*BufferOrErr)->getBuffer());
+}
+
+/// \brief Combine the function indexes of the inputs.
+///
+/// This is the thin link step of ThinLTO: only the summaries of the inputs
+/// are read, none of their IR.
+static int createCombinedFunctionIndex(StringRef Command) {
+  FunctionInfoIndex CombinedIndex;
+  for (auto &Filename : InputFilenames) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> BufferOrErr =
+        MemoryBuffer::getFile(Filename);
+    if (std::error_code EC = BufferOrErr.getError()) {
+      errs() << Command << ": error loading file '" << Filename
+             << "': " << EC.message() << "\n";
+      return 1;
+    }
+    ErrorOr<std::unique_ptr<FunctionInfoIndex>> IndexOrErr =
+        getFunctionInfoIndex((*BufferOrErr)->getMemBufferRef());
+    if (std::error_code EC = IndexOrErr.getError()) {
+      errs() << Command << ": error reading the function index of '"
+             << Filename << "': " << EC.message() << "\n";
+      return 1;
+    }
+    CombinedIndex.mergeFrom(std::move(*IndexOrErr));
+  }
+
+  std::string IndexFilename = OutputFilename + ".thinlto.bc";
+  std::error_code EC;
+  tool_output_file Out(IndexFilename, EC, sys::fs::F_None);
+  if (EC) {
+    errs() << Command << ": error opening the file '" << IndexFilename
+           << "': " << EC.message() << "\n";
     return 1;
   }
+  WriteFunctionSummaryToFile(CombinedIndex, Out.os());
+  Out.keep();
+  return 0;
+}
 
-  // Initialize the configured targets.
-  InitializeAllTargets();
-  InitializeAllTargetMCs();
-  InitializeAllAsmPrinters();
-  InitializeAllAsmParsers();
+/// \brief Optimize and compile the input at \p I to <output>.<I>, after
+/// importing functions from the other inputs.
+///
+/// Every backend has a context of its own, so that they can run in parallel.
+static bool compileThinBackend(StringRef Command, unsigned I,
+                               const FunctionInfoIndex &Index,
+                               const TargetOptions &Options,
+                               const std::string &Attrs,
+                               LTOObjectCache *Cache) {
+  const std::string &Filename = InputFilenames[I];
+  LTOCodeGenerator CodeGen(make_unique<LLVMContext>());
+  LLVMContext &Ctx = CodeGen.getContext();
+  if (UseDiagnosticHandler)
+    CodeGen.setDiagnosticHandler(handleDiagnostics, nullptr);
+  CodeGen.setCodePICModel(RelocModel);
+  CodeGen.setDebugInfo(LTO_DEBUG_MODEL_DWARF);
+  CodeGen.setTargetOptions(Options);
+  CodeGen.setCpu(MCPU.c_str());
+  CodeGen.setOptLevel(OptLevel - '0');
+  if (!Attrs.empty())
+    CodeGen.setAttr(Attrs.c_str());
+  CodeGen.setShouldInternalize(false);
 
-  // set up the TargetOptions for the machine
-  TargetOptions Options = InitTargetOptionsFromCodeGenFlags();
+  std::string Error;
+  std::unique_ptr<MemoryBuffer> Buffer;
+  ErrorOr<std::unique_ptr<MemoryBuffer>> BufferOrErr =
+      MemoryBuffer::getFile(Filename);
+  if (std::error_code EC = BufferOrErr.getError()) {
+    errs() << Command << ": error loading file '" << Filename
+           << "': " << EC.message() << "\n";
+    return false;
+  }
+  Buffer = std::move(*BufferOrErr);
+  std::unique_ptr<LTOModule> Module(LTOModule::createInContext(
+      Buffer->getBufferStart(), Buffer->getBufferSize(), Options, Error,
+      Filename, &Ctx));
+  if (!Module) {
+    errs() << Command << ": error loading file '" << Filename
+           << "': " << Error << "\n";
+    return false;
+  }
 
-  if (ListSymbolsOnly)
-    return listSymbols(argv[0], Options);
+  auto ModuleLoader = [&](StringRef Path) -> std::unique_ptr<llvm::Module> {
+    SMDiagnostic Err;
+    std::unique_ptr<llvm::Module> Result = getLazyIRFileModule(Path, Err, Ctx);
+    if (!Result)
+      errs() << Command << ": error loading file '" << Path
+             << "' for importing: " << Err.getMessage() << "\n";
+    return Result;
+  };
+  FunctionImporter Importer(Index, ModuleLoader);
+  std::string PartFilename = OutputFilename + "." + utostr(I);
+
+  // The object file depends on the input and on the modules that functions
+  // are imported from, but not on the rest of the program.
+  std::string CacheKey;
+  if (Cache) {
+    LTOCacheKey Key;
+    FunctionImporter::ImportListTy ImportList =
+        Importer.computeImportList(Module->getModule());
+    std::vector<std::string> Paths(1, Filename);
+    for (const auto &Entry : ImportList) {
+      Paths.push_back(Entry.first);
+      for (const std::string &Name : Entry.second)
+        Key.add(Name);
+    }
+    if (CodeGen.addToCacheKey(Key) && addInputsToCacheKey(Key, Paths))
+      CacheKey = Key.final();
+    if (!CacheKey.empty())
+      if (std::unique_ptr<MemoryBuffer> Object = Cache->lookup(CacheKey))
+        return writeCachedObject(Command, PartFilename, *Object);
+  }
+
+  Importer.importFunctions(Module->getModule());
+  CodeGen.setModule(std::move(Module));
+
+  if (!CodeGen.optimize(DisableVerify, DisableInline, DisableGVNLoadPRE,
+                        DisableLTOVectorization, Error)) {
+    errs() << Command << ": error optimizing '" << Filename << "': " << Error
+           << "\n";
+    return false;
+  }
+
+  std::error_code EC;
+  tool_output_file Out(PartFilename, EC, sys::fs::F_None);
+  if (EC) {
+    errs() << Command << ": error opening the file '" << PartFilename
+           << "': " << EC.message() << "\n";
+    return false;
+  }
+  raw_pwrite_stream *OS = &Out.os();
+  if (!CodeGen.compileOptimized(OS, Error)) {
+    errs() << Command << ": error compiling '" << Filename << "': " << Error
+           << "\n";
+    return false;
+  }
+  Out.keep();
+  if (!CacheKey.empty())
+    cacheObject(*Cache, CacheKey, Out, PartFilename);
+  return true;
+}
+
+/// \brief Run the ThinLTO backends of all the inputs, -j at a time.
+static int compileThinBackends(StringRef Command, const TargetOptions &Options,
+                               const std::string &Attrs,
+                               LTOObjectCache *Cache) {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> BufferOrErr =
+      MemoryBuffer::getFile(ThinLTOIndex);
+  if (std::error_code EC = BufferOrErr.getError()) {
+    errs() << Command << ": error loading file '" << ThinLTOIndex
+           << "': " << EC.message() << "\n";
+    return 1;
+  }
+  ErrorOr<std::unique_ptr<FunctionInfoIndex>> IndexOrErr =
+      getFunctionInfoIndex((*BufferOrErr)->getMemBufferRef());
+  if (std::error_code EC = IndexOrErr.getError()) {
+    errs() << Command << ": error reading the function index '"
+           << ThinLTOIndex << "': " << EC.message() << "\n";
+    return 1;
+  }
+  const FunctionInfoIndex &Index = **IndexOrErr;
+
+  std::atomic<bool> Failed(false);
+  {
+    ThreadPool Pool(Parallelism);
+    for (unsigned I = 0, E = InputFilenames.size(); I != E; ++I)
+      Pool.async([&, I] {
+        if (!compileThinBackend(Command, I, Index, Options, Attrs, Cache))
+          Failed = true;
+      });
+  }
+  return Failed ? 1 : 0;
+}
+
+/// \brief Link, optimize and compile the inputs as requested on the command
+/// line, reusing object files from \p Cache if it is not null.
+static int runLTO(const char *Command, const TargetOptions &Options,
+                  const std::string &attrs, LTOObjectCache *Cache) {
+  if (ThinLTO || !ThinLTOIndex.empty()) {
+    if (OutputFilename.empty()) {
+      errs() << Command << ": -thinlto and -thinlto-index require -o\n";
+      return 1;
+    }
+    if (ThinLTO)
+      return createCombinedFunctionIndex(Command);
+    return compileThinBackends(Command, Options, attrs, Cache);
+  }
 
   unsigned BaseArg = 0;
 
@@ -199,7 +446,7 @@ int main(int argc, char **argv) {
     std::unique_ptr<LTOModule> Module(
         LTOModule::createFromFile(InputFilenames[i].c_str(), Options, error));
     if (!error.empty()) {
-      errs() << argv[0] << ": error loading file '" << InputFilenames[i]
+      errs() << Command << ": error loading file '" << InputFilenames[i]
              << "': " << error << "\n";
       return 1;
     }
@@ -222,7 +469,7 @@ int main(int argc, char **argv) {
       CodeGen.setModule(std::move(Module));
     } else if (!CodeGen.addModule(Module.get())) {
       // Print a message here so that we know addModule() did not abort.
-      errs() << argv[0] << ": error adding file '" << InputFilenames[i] << "'\n";
+      errs() << Command << ": error adding file '" << InputFilenames[i] << "'\n";
       return 1;
     }
   }
@@ -240,34 +487,57 @@ int main(int argc, char **argv) {
 
   CodeGen.setOptLevel(OptLevel - '0');
 
-  std::string attrs;
-  for (unsigned i = 0; i < MAttrs.size(); ++i) {
-    if (i > 0)
-      attrs.append(",");
-    attrs.append(MAttrs[i]);
-  }
-
   if (!attrs.empty())
     CodeGen.setAttr(attrs.c_str());
 
   if (!OutputFilename.empty()) {
+    std::vector<std::string> PartFilenames;
+    for (unsigned I = 0; I != Parallelism; ++I) {
+      PartFilenames.push_back(OutputFilename);
+      if (Parallelism != 1)
+        PartFilenames.back() += "." + utostr(I);
+    }
+
+    // The merged module depends on all the inputs, so a change to any of them
+    // invalidates every partition.
+    std::string CacheKey;
+    if (Cache) {
+      LTOCacheKey Key;
+      Key.add(SetMergedModule);
+      Key.add(Parallelism);
+      if (CodeGen.addToCacheKey(Key) &&
+          addInputsToCacheKey(Key, InputFilenames))
+        CacheKey = Key.final();
+    }
+    if (!CacheKey.empty()) {
+      std::vector<std::unique_ptr<MemoryBuffer>> Objects;
+      for (unsigned I = 0; I != Parallelism; ++I) {
+        Objects.push_back(Cache->lookup(CacheKey + "-" + utostr(I)));
+        if (!Objects.back())
+          break;
+      }
+      if (Objects.size() == Parallelism && Objects.back()) {
+        for (unsigned I = 0; I != Parallelism; ++I)
+          if (!writeCachedObject(Command, PartFilenames[I], *Objects[I]))
+            return 1;
+        return 0;
+      }
+    }
+
     std::string ErrorInfo;
     if (!CodeGen.optimize(DisableVerify, DisableInline, DisableGVNLoadPRE,
                           DisableLTOVectorization, ErrorInfo)) {
-      errs() << argv[0] << ": error optimizing the code: " << ErrorInfo << "\n";
+      errs() << Command << ": error optimizing the code: " << ErrorInfo << "\n";
       return 1;
     }
 
     std::list<tool_output_file> OSs;
     std::vector<raw_pwrite_stream *> OSPtrs;
-    for (unsigned I = 0; I != Parallelism; ++I) {
-      std::string PartFilename = OutputFilename;
-      if (Parallelism != 1)
-        PartFilename += "." + utostr(I);
+    for (const std::string &PartFilename : PartFilenames) {
       std::error_code EC;
       OSs.emplace_back(PartFilename, EC, sys::fs::F_None);
       if (EC) {
-        errs() << argv[0] << ": error opening the file '" << PartFilename
+        errs() << Command << ": error opening the file '" << PartFilename
                << "': " << EC.message() << "\n";
         return 1;
       }
@@ -275,15 +545,20 @@ int main(int argc, char **argv) {
     }
 
     if (!CodeGen.compileOptimized(OSPtrs, ErrorInfo)) {
-      errs() << argv[0] << ": error compiling the code: " << ErrorInfo << "\n";
+      errs() << Command << ": error compiling the code: " << ErrorInfo << "\n";
       return 1;
     }
 
-    for (tool_output_file &OS : OSs)
+    unsigned I = 0;
+    for (tool_output_file &OS : OSs) {
       OS.keep();
+      if (!CacheKey.empty())
+        cacheObject(*Cache, CacheKey + "-" + utostr(I), OS, PartFilenames[I]);
+      ++I;
+    }
   } else {
     if (Parallelism != 1) {
-      errs() << argv[0] << ": -j must be specified together with -o\n";
+      errs() << Command << ": -j must be specified together with -o\n";
       return 1;
     }
 
@@ -292,7 +567,7 @@ int main(int argc, char **argv) {
     if (!CodeGen.compile_to_file(&OutputName, DisableVerify, DisableInline,
                                  DisableGVNLoadPRE, DisableLTOVectorization,
                                  ErrorInfo)) {
-      errs() << argv[0]
+      errs() << Command
              << ": error compiling the code: " << ErrorInfo
              << "\n";
       return 1;
@@ -303,3 +578,59 @@ int main(int argc, char **argv) {
 
   return 0;
 }
+
+int main(int argc, char **argv) {
+  // Print a stack trace if we signal out.
+  sys::PrintStackTraceOnErrorSignal();
+  PrettyStackTraceProgram X(argc, argv);
+
+  llvm_shutdown_obj Y; // Call llvm_shutdown() on exit.
+  cl::ParseCommandLineOptions(argc, argv, "llvm LTO linker\n");
+
+  if (OptLevel < '0' || OptLevel > '3') {
+    errs() << argv[0] << ": optimization level must be between 0 and 3\n";
+    return 1;
+  }
+
+  // Initialize the configured targets.
+  InitializeAllTargets();
+  InitializeAllTargetMCs();
+  InitializeAllAsmPrinters();
+  InitializeAllAsmParsers();
+
+  // set up the TargetOptions for the machine
+  TargetOptions Options = InitTargetOptionsFromCodeGenFlags();
+
+  if (ListSymbolsOnly)
+    return listSymbols(argv[0], Options);
+
+  std::string attrs;
+  for (unsigned i = 0; i < MAttrs.size(); ++i) {
+    if (i > 0)
+      attrs.append(",");
+    attrs.append(MAttrs[i]);
+  }
+
+  std::unique_ptr<LTOObjectCache> Cache;
+  if (!CacheDir.empty()) {
+    if (OutputFilename.empty()) {
+      errs() << argv[0] << ": -cache-dir must be specified together with -o\n";
+      return 1;
+    }
+    Cache.reset(new LTOObjectCache(CacheDir));
+  }
+
+  int Result = runLTO(argv[0], Options, attrs, Cache.get());
+
+  if (Cache) {
+    if (CacheStats)
+      outs() << "Cache hits: " << Cache->getNumHits()
+             << ", misses: " << Cache->getNumMisses() << "\n";
+    CachePruning(CacheDir)
+        .setPruningInterval(CachePruningInterval)
+        .setEntryExpiration(CacheExpiration)
+        .setMaxSize(CacheMaxSize)
+        .prune();
+  }
+  return Result;
+}
@@ -37,8 +37,10 @@
 #include "llvm/Support/Program.h"
 #include "llvm/Support/Signals.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
+#include <atomic>
 #include <cctype>
 #include <cerrno>
 #include <cstring>
@@ -152,18 +154,35 @@ cl::opt<bool> FormatMachOasHex("x", cl::desc("Print symbol entry in hex, "
 cl::opt<bool> NoLLVMBitcode("no-llvm-bc",
                             cl::desc("Disable LLVM bitcode reader"));
 
+cl::opt<unsigned> Threads("threads",
+                          cl::desc("Dump input files and archive members on a "
+                                   "pool of N threads (default: 0, dump them "
+                                   "on the main thread)"),
+                          cl::init(0));
+
 bool PrintAddress = true;
 
 bool MultipleFiles = false;
 
-bool HadError = false;
+std::atomic<bool> HadError(false);
 
 std::string ToolName;
 }
 
+// The pool created for -threads, if any.
+static std::unique_ptr<ThreadPool> Pool;
+
+// Where error() writes to.  Jobs that run on the pool point this at their own
+// buffer, so that errors come out in the same order as in a serial run.
+static LLVM_THREAD_LOCAL raw_ostream *ErrorStream = nullptr;
+
+static raw_ostream &getErrorStream() {
+  return ErrorStream ? *ErrorStream : errs();
+}
+
 static void error(Twine Message, Twine Path = Twine()) {
   HadError = true;
-  errs() << ToolName << ": " << Path << ": " << Message << ".\n";
+  getErrorStream() << ToolName << ": " << Path << ": " << Message << ".\n";
 }
 
 static bool error(std::error_code EC, Twine Path = Twine()) {
@@ -211,17 +230,16 @@ static char isSymbolList64Bit(SymbolicFile &Obj) {
   return cast<ELFObjectFileBase>(Obj).getBytesInAddress() == 8;
 }
 
-static StringRef CurrentFilename;
 typedef std::vector<NMSymbol> SymbolListT;
-static SymbolListT SymbolList;
 
 // darwinPrintSymbol() is used to print a symbol from a Mach-O file when the
 // the OutputFormat is darwin or we are printing Mach-O symbols in hex.  For
 // the darwin format it produces the same output as darwin's nm(1) -m output
 // and when printing Mach-O symbols in hex it produces the same output as
 // darwin's nm(1) -x format.
-static void darwinPrintSymbol(MachOObjectFile *MachO, SymbolListT::iterator I,
-                              char *SymbolAddrStr, const char *printBlanks) {
+static void darwinPrintSymbol(raw_ostream &OS, MachOObjectFile *MachO,
+                              SymbolListT::iterator I, char *SymbolAddrStr,
+                              const char *printBlanks) {
   MachO::mach_header H;
   MachO::mach_header_64 H_64;
   uint32_t Filetype, Flags;
@@ -264,54 +282,54 @@ static void darwinPrintSymbol(MachOObjectFile *MachO, SymbolListT::iterator I,
     else
       printFormat = "%08" PRIx64;
     format(printFormat, NValue).print(Str, sizeof(Str));
-    outs() << Str << ' ';
+    OS << Str << ' ';
     format("%02x", NType).print(Str, sizeof(Str));
-    outs() << Str << ' ';
+    OS << Str << ' ';
     format("%02x", NSect).print(Str, sizeof(Str));
-    outs() << Str << ' ';
+    OS << Str << ' ';
     format("%04x", NDesc).print(Str, sizeof(Str));
-    outs() << Str << ' ';
+    OS << Str << ' ';
     format("%08x", NStrx).print(Str, sizeof(Str));
-    outs() << Str << ' ';
-    outs() << I->Name << "\n";
+    OS << Str << ' ';
+    OS << I->Name << "\n";
     return;
   }
 
   if (PrintAddress) {
     if ((NType & MachO::N_TYPE) == MachO::N_INDR)
       strcpy(SymbolAddrStr, printBlanks);
-    outs() << SymbolAddrStr << ' ';
+    OS << SymbolAddrStr << ' ';
   }
 
   switch (NType & MachO::N_TYPE) {
   case MachO::N_UNDF:
     if (NValue != 0) {
-      outs() << "(common) ";
+      OS << "(common) ";
       if (MachO::GET_COMM_ALIGN(NDesc) != 0)
-        outs() << "(alignment 2^" << (int)MachO::GET_COMM_ALIGN(NDesc) << ") ";
+        OS << "(alignment 2^" << (int)MachO::GET_COMM_ALIGN(NDesc) << ") ";
     } else {
       if ((NType & MachO::N_TYPE) == MachO::N_PBUD)
-        outs() << "(prebound ";
+        OS << "(prebound ";
       else
-        outs() << "(";
+        OS << "(";
       if ((NDesc & MachO::REFERENCE_TYPE) ==
           MachO::REFERENCE_FLAG_UNDEFINED_LAZY)
-        outs() << "undefined [lazy bound]) ";
+        OS << "undefined [lazy bound]) ";
       else if ((NDesc & MachO::REFERENCE_TYPE) ==
                MachO::REFERENCE_FLAG_UNDEFINED_LAZY)
-        outs() << "undefined [private lazy bound]) ";
+        OS << "undefined [private lazy bound]) ";
       else if ((NDesc & MachO::REFERENCE_TYPE) ==
                MachO::REFERENCE_FLAG_PRIVATE_UNDEFINED_NON_LAZY)
-        outs() << "undefined [private]) ";
+        OS << "undefined [private]) ";
       else
-        outs() << "undefined) ";
+        OS << "undefined) ";
     }
     break;
   case MachO::N_ABS:
-    outs() << "(absolute) ";
+    OS << "(absolute) ";
     break;
   case MachO::N_INDR:
-    outs() << "(indirect) ";
+    OS << "(indirect) ";
     break;
   case MachO::N_SECT: {
     section_iterator Sec = *MachO->getSymbolSection(I->Sym.getRawDataRefImpl());
@@ -319,66 +337,66 @@ static void darwinPrintSymbol(MachOObjectFile *MachO, SymbolListT::iterator I,
     StringRef SectionName;
     MachO->getSectionName(Ref, SectionName);
     StringRef SegmentName = MachO->getSectionFinalSegmentName(Ref);
-    outs() << "(" << SegmentName << "," << SectionName << ") ";
+    OS << "(" << SegmentName << "," << SectionName << ") ";
     break;
   }
   default:
-    outs() << "(?) ";
+    OS << "(?) ";
     break;
   }
 
   if (NType & MachO::N_EXT) {
     if (NDesc & MachO::REFERENCED_DYNAMICALLY)
-      outs() << "[referenced dynamically] ";
+      OS << "[referenced dynamically] ";
     if (NType & MachO::N_PEXT) {
       if ((NDesc & MachO::N_WEAK_DEF) == MachO::N_WEAK_DEF)
-        outs() << "weak private external ";
+        OS << "weak private external ";
       else
-        outs() << "private external ";
+        OS << "private external ";
     } else {
       if ((NDesc & MachO::N_WEAK_REF) == MachO::N_WEAK_REF ||
           (NDesc & MachO::N_WEAK_DEF) == MachO::N_WEAK_DEF) {
         if ((NDesc & (MachO::N_WEAK_REF | MachO::N_WEAK_DEF)) ==
             (MachO::N_WEAK_REF | MachO::N_WEAK_DEF))
-          outs() << "weak external automatically hidden ";
+          OS << "weak external automatically hidden ";
         else
-          outs() << "weak external ";
+          OS << "weak external ";
       } else
-        outs() << "external ";
+        OS << "external ";
     }
   } else {
     if (NType & MachO::N_PEXT)
-      outs() << "non-external (was a private external) ";
+      OS << "non-external (was a private external) ";
     else
-      outs() << "non-external ";
+      OS << "non-external ";
   }
 
   if (Filetype == MachO::MH_OBJECT &&
       (NDesc & MachO::N_NO_DEAD_STRIP) == MachO::N_NO_DEAD_STRIP)
-    outs() << "[no dead strip] ";
+    OS << "[no dead strip] ";
 
   if (Filetype == MachO::MH_OBJECT &&
       ((NType & MachO::N_TYPE) != MachO::N_UNDF) &&
       (NDesc & MachO::N_SYMBOL_RESOLVER) == MachO::N_SYMBOL_RESOLVER)
-    outs() << "[symbol resolver] ";
+    OS << "[symbol resolver] ";
 
   if (Filetype == MachO::MH_OBJECT &&
       ((NType & MachO::N_TYPE) != MachO::N_UNDF) &&
       (NDesc & MachO::N_ALT_ENTRY) == MachO::N_ALT_ENTRY)
-    outs() << "[alt entry] ";
+    OS << "[alt entry] ";
 
   if ((NDesc & MachO::N_ARM_THUMB_DEF) == MachO::N_ARM_THUMB_DEF)
-    outs() << "[Thumb] ";
+    OS << "[Thumb] ";
 
   if ((NType & MachO::N_TYPE) == MachO::N_INDR) {
-    outs() << I->Name << " (for ";
+    OS << I->Name << " (for ";
     StringRef IndirectName;
     if (MachO->getIndirectName(I->Sym.getRawDataRefImpl(), IndirectName))
-      outs() << "?)";
+      OS << "?)";
     else
-      outs() << IndirectName << ")";
+      OS << IndirectName << ")";
   } else
-    outs() << I->Name;
+    OS << I->Name;
 
   if ((Flags & MachO::MH_TWOLEVEL) == MachO::MH_TWOLEVEL &&
       (((NType & MachO::N_TYPE) == MachO::N_UNDF && NValue == 0) ||
@@ -386,20 +404,20 @@ static void darwinPrintSymbol(MachOObjectFile *MachO, SymbolListT::iterator I,
     uint32_t LibraryOrdinal = MachO::GET_LIBRARY_ORDINAL(NDesc);
     if (LibraryOrdinal != 0) {
       if (LibraryOrdinal == MachO::EXECUTABLE_ORDINAL)
-        outs() << " (from executable)";
+        OS << " (from executable)";
       else if (LibraryOrdinal == MachO::DYNAMIC_LOOKUP_ORDINAL)
-        outs() << " (dynamically looked up)";
+        OS << " (dynamically looked up)";
       else {
         StringRef LibraryName;
         if (MachO->getLibraryShortNameByIndex(LibraryOrdinal - 1, LibraryName))
-          outs() << " (from bad library ordinal " << LibraryOrdinal << ")";
+          OS << " (from bad library ordinal " << LibraryOrdinal << ")";
         else
-          outs() << " (from " << LibraryName << ")";
+          OS << " (from " << LibraryName << ")";
       }
     }
   }
 
-  outs() << "\n";
+  OS << "\n";
 }
 
 // Table that maps Darwin's Mach-O stab constants to strings to allow printing.
@@ -450,7 +468,8 @@ static const char *getDarwinStabString(uint8_t NType) {
 
 // darwinPrintStab() prints the n_sect, n_desc along with a symbolic name of
 // a stab n_type value in a Mach-O file.
-static void darwinPrintStab(MachOObjectFile *MachO, SymbolListT::iterator I) {
+static void darwinPrintStab(raw_ostream &OS, MachOObjectFile *MachO,
+                            SymbolListT::iterator I) {
   MachO::nlist_64 STE_64;
   MachO::nlist STE;
   uint8_t NType;
@@ -471,19 +490,21 @@ static void darwinPrintStab(MachOObjectFile *MachO, SymbolListT::iterator I) {
 
   char Str[18] = "";
   format("%02x", NSect).print(Str, sizeof(Str));
-  outs() << ' ' << Str << ' ';
+  OS << ' ' << Str << ' ';
   format("%04x", NDesc).print(Str, sizeof(Str));
-  outs() << Str << ' ';
+  OS << Str << ' ';
   if (const char *stabString = getDarwinStabString(NType))
     format("%5.5s", stabString).print(Str, sizeof(Str));
   else
     format("   %02x", NType).print(Str, sizeof(Str));
-  outs() << Str;
+  OS << Str;
 }
 
-static void sortAndPrintSymbolList(SymbolicFile &Obj, bool printName,
+static void sortAndPrintSymbolList(raw_ostream &OS, SymbolicFile &Obj,
+                                   SymbolListT &SymbolList, bool printName,
                                    std::string ArchiveName,
                                    std::string ArchitectureName) {
+  StringRef CurrentFilename = Obj.getFileName();
   if (!NoSort) {
     std::function<bool(const NMSymbol &, const NMSymbol &)> Cmp;
     if (NumericSort)
@@ -500,13 +521,13 @@ static void sortAndPrintSymbolList(SymbolicFile &Obj, bool printName,
 
   if (!PrintFileName) {
     if (OutputFormat == posix && MultipleFiles && printName) {
-      outs() << '\n' << CurrentFilename << ":\n";
+      OS << '\n' << CurrentFilename << ":\n";
     } else if (OutputFormat == bsd && MultipleFiles && printName) {
-      outs() << "\n" << CurrentFilename << ":\n";
+      OS << "\n" << CurrentFilename << ":\n";
     } else if (OutputFormat == sysv) {
-      outs() << "\n\nSymbols from " << CurrentFilename << ":\n\n"
-             << "Name                  Value   Class        Type"
-             << "         Size   Line  Section\n";
+      OS << "\n\nSymbols from " << CurrentFilename << ":\n\n"
+         << "Name                  Value   Class        Type"
+         << "         Size   Line  Section\n";
     }
   }
 
@@ -531,13 +552,13 @@ static void sortAndPrintSymbolList(SymbolicFile &Obj, bool printName,
       continue;
     if (PrintFileName) {
       if (!ArchitectureName.empty())
-        outs() << "(for architecture " << ArchitectureName << "):";
+        OS << "(for architecture " << ArchitectureName << "):";
       if (!ArchiveName.empty())
-        outs() << ArchiveName << ":";
-      outs() << CurrentFilename << ": ";
+        OS << ArchiveName << ":";
+      OS << CurrentFilename << ": ";
     }
     if (JustSymbolName || (UndefinedOnly && isa<MachOObjectFile>(Obj))) {
-      outs() << I->Name << "\n";
+      OS << I->Name << "\n";
       continue;
     }
 
@@ -561,31 +582,29 @@ static void sortAndPrintSymbolList(SymbolicFile &Obj, bool printName,
     // OutputFormat bsd (see below).
     MachOObjectFile *MachO = dyn_cast<MachOObjectFile>(&Obj);
     if ((OutputFormat == darwin || FormatMachOasHex) && MachO) {
-      darwinPrintSymbol(MachO, I, SymbolAddrStr, printBlanks);
+      darwinPrintSymbol(OS, MachO, I, SymbolAddrStr, printBlanks);
     } else if (OutputFormat == posix) {
-      outs() << I->Name << " " << I->TypeChar << " " << SymbolAddrStr
-             << SymbolSizeStr << "\n";
+      OS << I->Name << " " << I->TypeChar << " " << SymbolAddrStr
+         << SymbolSizeStr << "\n";
     } else if (OutputFormat == bsd || (OutputFormat == darwin && !MachO)) {
       if (PrintAddress)
-        outs() << SymbolAddrStr << ' ';
+        OS << SymbolAddrStr << ' ';
       if (PrintSize) {
-        outs() << SymbolSizeStr;
-        outs() << ' ';
+        OS << SymbolSizeStr;
+        OS << ' ';
       }
-      outs() << I->TypeChar;
+      OS << I->TypeChar;
       if (I->TypeChar == '-' && MachO)
-        darwinPrintStab(MachO, I);
-      outs() << " " << I->Name << "\n";
+        darwinPrintStab(OS, MachO, I);
+      OS << " " << I->Name << "\n";
     } else if (OutputFormat == sysv) {
       std::string PaddedName(I->Name);
       while (PaddedName.length() < 20)
         PaddedName += " ";
-      outs() << PaddedName << "|" << SymbolAddrStr << "|   " << I->TypeChar
-             << "  |                  |" << SymbolSizeStr << "|     |\n";
+      OS << PaddedName << "|" << SymbolAddrStr << "|   " << I->TypeChar
+         << "  |                  |" << SymbolSizeStr << "|     |\n";
     }
   }
-
-  SymbolList.clear();
 }
 
 static char getSymbolNMTypeChar(ELFObjectFileBase &Obj,
@@ -817,7 +836,8 @@ static unsigned getNsectInMachO(MachOObjectFile &Obj, BasicSymbolRef Sym) {
   return 0;
 }
 
-static void dumpSymbolNamesFromObject(SymbolicFile &Obj, bool printName,
+static void dumpSymbolNamesFromObject(raw_ostream &OS, SymbolicFile &Obj,
+                                      bool printName,
                                       std::string ArchiveName = std::string(),
                                       std::string ArchitectureName =
                                         std::string()) {
@@ -832,8 +852,9 @@ static void dumpSymbolNamesFromObject(SymbolicFile &Obj, bool printName,
     Symbols =
         make_range<basic_symbol_iterator>(DynSymbols.begin(), DynSymbols.end());
   }
+  SymbolListT SymbolList;
   std::string NameBuffer;
-  raw_string_ostream OS(NameBuffer);
+  raw_string_ostream NameOS(NameBuffer);
   // If a "-s segname sectname" option was specified and this is a Mach-O
   // file get the section number for that section in this object file.
   unsigned int Nsect = 0;
@@ -875,22 +896,22 @@ static void dumpSymbolNamesFromObject(SymbolicFile &Obj, bool printName,
       S.Address = *AddressOrErr;
     }
     S.TypeChar = getNMTypeChar(Obj, Sym);
-    if (error(Sym.printName(OS)))
+    if (error(Sym.printName(NameOS)))
       break;
-    OS << '\0';
+    NameOS << '\0';
     S.Sym = Sym;
     SymbolList.push_back(S);
   }
 
-  OS.flush();
+  NameOS.flush();
   const char *P = NameBuffer.c_str();
   for (unsigned I = 0; I < SymbolList.size(); ++I) {
     SymbolList[I].Name = P;
     P += strlen(P) + 1;
   }
 
-  CurrentFilename = Obj.getFileName();
-  sortAndPrintSymbolList(Obj, printName, ArchiveName, ArchitectureName);
+  sortAndPrintSymbolList(OS, Obj, SymbolList, printName, ArchiveName,
+                         ArchitectureName);
 }
 
 // checkMachOAndArchFlags() checks to see if the SymbolicFile is a Mach-O file
@@ -923,13 +944,88 @@ static bool checkMachOAndArchFlags(SymbolicFile *O, std::string &Filename) {
   return true;
 }
 
-static void dumpSymbolNamesFromFile(std::string &Filename) {
+namespace {
+// Prints one input file or archive member.  Returning false skips the jobs
+// that follow it, like an early return from the serial loop would.
+typedef std::function<bool(raw_ostream &)> DumpJob;
+
+// The buffered output of a job that ran on the pool.
+struct DumpJobResult {
+  std::string Out;
+  std::string Err;
+  bool Continue = true;
+};
+}
+
+// Run Jobs in order, printing to OS.  With -threads the jobs run on the pool
+// into buffers that are then printed in order, so the output is the same as
+// that of a serial run.
+static void runDumpJobs(ArrayRef<DumpJob> Jobs, raw_ostream &OS) {
+  if (!Pool || Jobs.size() < 2) {
+    for (const DumpJob &Job : Jobs)
+      if (!Job(OS))
+        return;
+    return;
+  }
+
+  std::vector<DumpJobResult> Results(Jobs.size());
+  forEachIndex(Pool.get(), Jobs.size(), [&](unsigned I) {
+    DumpJobResult &R = Results[I];
+    raw_string_ostream Out(R.Out), Err(R.Err);
+    // A job waiting for its members may run other jobs on this thread, so
+    // put back the stream of the job that was running before.
+    raw_ostream *EnclosingErrorStream = ErrorStream;
+    ErrorStream = &Err;
+    R.Continue = Jobs[I](Out);
+    ErrorStream = EnclosingErrorStream;
+  });
+
+  for (const DumpJobResult &R : Results) {
+    OS << R.Out;
+    getErrorStream() << R.Err;
+    if (!R.Continue)
+      return;
+  }
+}
+
+// Bitcode is read into an LLVMContext, which only one thread may use at a
+// time, so each job gets its own context when there is a pool.
+static LLVMContext &getJobContext(std::unique_ptr<LLVMContext> &OwnedContext) {
+  if (!Pool)
+    return getGlobalContext();
+  OwnedContext.reset(new LLVMContext());
+  return *OwnedContext;
+}
+
+// Call DumpMember on each member of A that is a symbolic file, as a job of its
+// own.
+static void dumpArchiveMembers(
+    raw_ostream &OS, const Archive &A,
+    std::function<bool(raw_ostream &, SymbolicFile &)> DumpMember) {
+  std::vector<DumpJob> Jobs;
+  for (const Archive::Child &C : A.children())
+    Jobs.push_back([&DumpMember, C](raw_ostream &OS) -> bool {
+      std::unique_ptr<LLVMContext> OwnedContext;
+      ErrorOr<std::unique_ptr<Binary>> ChildOrErr =
+          C.getAsBinary(&getJobContext(OwnedContext));
+      if (ChildOrErr.getError())
+        return true;
+      if (SymbolicFile *O = dyn_cast<SymbolicFile>(&*ChildOrErr.get()))
+        return DumpMember(OS, *O);
+      return true;
+    });
+  runDumpJobs(Jobs, OS);
+}
+
+static void dumpSymbolNamesFromFile(raw_ostream &OS, std::string &Filename) {
+  std::unique_ptr<LLVMContext> OwnedContext;
+  LLVMContext &Context = getJobContext(OwnedContext);
+
   ErrorOr<std::unique_ptr<MemoryBuffer>> BufferOrErr =
       MemoryBuffer::getFileOrSTDIN(Filename);
   if (error(BufferOrErr.getError(), Filename))
     return;
 
-  LLVMContext &Context = getGlobalContext();
   ErrorOr<std::unique_ptr<Binary>> BinaryOrErr = createBinary(
       BufferOrErr.get()->getMemBufferRef(), NoLLVMBitcode ? nullptr : &Context);
   if (error(BinaryOrErr.getError(), Filename))
@@ -941,7 +1037,7 @@ static void dumpSymbolNamesFromFile(std::string &Filename) {
       Archive::symbol_iterator I = A->symbol_begin();
       Archive::symbol_iterator E = A->symbol_end();
       if (I != E) {
-        outs() << "Archive map\n";
+        OS << "Archive map\n";
         for (; I != E; ++I) {
           ErrorOr<Archive::child_iterator> C = I->getMember();
           if (error(C.getError()))
@@ -950,31 +1046,26 @@ static void dumpSymbolNamesFromFile(std::string &Filename) {
           if (error(FileNameOrErr.getError()))
             return;
           StringRef SymName = I->getName();
-          outs() << SymName << " in " << FileNameOrErr.get() << "\n";
+          OS << SymName << " in " << FileNameOrErr.get() << "\n";
         }
-        outs() << "\n";
+        OS << "\n";
       }
     }
 
-    for (Archive::child_iterator I = A->child_begin(), E = A->child_end();
-         I != E; ++I) {
-      ErrorOr<std::unique_ptr<Binary>> ChildOrErr = I->getAsBinary(&Context);
-      if (ChildOrErr.getError())
-        continue;
-      if (SymbolicFile *O = dyn_cast<SymbolicFile>(&*ChildOrErr.get())) {
-        if (!checkMachOAndArchFlags(O, Filename))
-          return;
-        if (!PrintFileName) {
-          outs() << "\n";
-          if (isa<MachOObjectFile>(O)) {
-            outs() << Filename << "(" << O->getFileName() << ")";
-          } else
-            outs() << O->getFileName();
-          outs() << ":\n";
-        }
-        dumpSymbolNamesFromObject(*O, false, Filename);
+    dumpArchiveMembers(OS, *A, [&](raw_ostream &OS, SymbolicFile &O) -> bool {
+      if (!checkMachOAndArchFlags(&O, Filename))
+        return false;
+      if (!PrintFileName) {
+        OS << "\n";
+        if (isa<MachOObjectFile>(O)) {
+          OS << Filename << "(" << O.getFileName() << ")";
+        } else
+          OS << O.getFileName();
+        OS << ":\n";
       }
-    }
+      dumpSymbolNamesFromObject(OS, O, false, Filename);
+      return true;
+    });
     return;
   }
   if (MachOUniversalBinary *UB = dyn_cast<MachOUniversalBinary>(&Bin)) {
@@ -1001,41 +1092,35 @@ static void dumpSymbolNamesFromFile(std::string &Filename) {
                 if (PrintFileName)
                   ArchitectureName = I->getArchTypeName();
                 else
-                  outs() << "\n" << Obj.getFileName() << " (for architecture "
-                         << I->getArchTypeName() << ")"
-                         << ":\n";
+                  OS << "\n" << Obj.getFileName() << " (for architecture "
+                     << I->getArchTypeName() << ")"
+                     << ":\n";
               }
-              dumpSymbolNamesFromObject(Obj, false, ArchiveName,
+              dumpSymbolNamesFromObject(OS, Obj, false, ArchiveName,
                                         ArchitectureName);
             } else if (ErrorOr<std::unique_ptr<Archive>> AOrErr =
                            I->getAsArchive()) {
               std::unique_ptr<Archive> &A = *AOrErr;
-              for (Archive::child_iterator AI = A->child_begin(),
-                                           AE = A->child_end();
-                   AI != AE; ++AI) {
-                ErrorOr<std::unique_ptr<Binary>> ChildOrErr =
-                    AI->getAsBinary(&Context);
-                if (ChildOrErr.getError())
-                  continue;
-                if (SymbolicFile *O =
-                        dyn_cast<SymbolicFile>(&*ChildOrErr.get())) {
-                  if (PrintFileName) {
-                    ArchiveName = A->getFileName();
-                    if (ArchFlags.size() > 1)
-                      ArchitectureName = I->getArchTypeName();
-                  } else {
-                    outs() << "\n" << A->getFileName();
-                    outs() << "(" << O->getFileName() << ")";
-                    if (ArchFlags.size() > 1) {
-                      outs() << " (for architecture " << I->getArchTypeName()
-                             << ")";
-                    }
-                    outs() << ":\n";
+              if (PrintFileName) {
+                ArchiveName = A->getFileName();
+                if (ArchFlags.size() > 1)
+                  ArchitectureName = I->getArchTypeName();
+              }
+              auto DumpMember = [&](raw_ostream &OS, SymbolicFile &O) -> bool {
+                if (!PrintFileName) {
+                  OS << "\n" << A->getFileName();
+                  OS << "(" << O.getFileName() << ")";
+                  if (ArchFlags.size() > 1) {
+                    OS << " (for architecture " << I->getArchTypeName()
+                       << ")";
                   }
-                  dumpSymbolNamesFromObject(*O, false, ArchiveName,
-                                            ArchitectureName);
+                  OS << ":\n";
                 }
-              }
+                dumpSymbolNamesFromObject(OS, O, false, ArchiveName,
+                                          ArchitectureName);
+                return true;
+              };
+              dumpArchiveMembers(OS, *A, DumpMember);
             }
           }
         }
@@ -1060,28 +1145,21 @@ static void dumpSymbolNamesFromFile(std::string &Filename) {
           ArchiveName.clear();
           if (ObjOrErr) {
             ObjectFile &Obj = *ObjOrErr.get();
-            dumpSymbolNamesFromObject(Obj, false);
+            dumpSymbolNamesFromObject(OS, Obj, false);
           } else if (ErrorOr<std::unique_ptr<Archive>> AOrErr =
                          I->getAsArchive()) {
             std::unique_ptr<Archive> &A = *AOrErr;
-            for (Archive::child_iterator AI = A->child_begin(),
-                                         AE = A->child_end();
-                 AI != AE; ++AI) {
-              ErrorOr<std::unique_ptr<Binary>> ChildOrErr =
-                  AI->getAsBinary(&Context);
-              if (ChildOrErr.getError())
-                continue;
-              if (SymbolicFile *O =
-                      dyn_cast<SymbolicFile>(&*ChildOrErr.get())) {
-                if (PrintFileName)
-                  ArchiveName = A->getFileName();
-                else
-                  outs() << "\n" << A->getFileName() << "(" << O->getFileName()
-                         << ")"
-                         << ":\n";
-                dumpSymbolNamesFromObject(*O, false, ArchiveName);
-              }
-            }
+            if (PrintFileName)
+              ArchiveName = A->getFileName();
+            auto DumpMember = [&](raw_ostream &OS, SymbolicFile &O) -> bool {
+              if (!PrintFileName)
+                OS << "\n" << A->getFileName() << "(" << O.getFileName()
+                   << ")"
+                   << ":\n";
+              dumpSymbolNamesFromObject(OS, O, false, ArchiveName);
+              return true;
+            };
+            dumpArchiveMembers(OS, *A, DumpMember);
           }
           return;
         }
@@ -1105,40 +1183,38 @@ static void dumpSymbolNamesFromFile(std::string &Filename) {
             ArchitectureName = I->getArchTypeName();
         } else {
           if (moreThanOneArch)
-            outs() << "\n";
-          outs() << Obj.getFileName();
+            OS << "\n";
+          OS << Obj.getFileName();
           if (isa<MachOObjectFile>(Obj) && moreThanOneArch)
-            outs() << " (for architecture " << I->getArchTypeName() << ")";
-          outs() << ":\n";
+            OS << " (for architecture " << I->getArchTypeName() << ")";
+          OS << ":\n";
         }
-        dumpSymbolNamesFromObject(Obj, false, ArchiveName, ArchitectureName);
+        dumpSymbolNamesFromObject(OS, Obj, false, ArchiveName,
+                                  ArchitectureName);
       } else if (ErrorOr<std::unique_ptr<Archive>> AOrErr = I->getAsArchive()) {
         std::unique_ptr<Archive> &A = *AOrErr;
-        for (Archive::child_iterator AI = A->child_begin(), AE = A->child_end();
-             AI != AE; ++AI) {
-          ErrorOr<std::unique_ptr<Binary>> ChildOrErr =
-              AI->getAsBinary(&Context);
-          if (ChildOrErr.getError())
-            continue;
-          if (SymbolicFile *O = dyn_cast<SymbolicFile>(&*ChildOrErr.get())) {
-            if (PrintFileName) {
-              ArchiveName = A->getFileName();
-              if (isa<MachOObjectFile>(O) && moreThanOneArch)
-                ArchitectureName = I->getArchTypeName();
-            } else {
-              outs() << "\n" << A->getFileName();
-              if (isa<MachOObjectFile>(O)) {
-                outs() << "(" << O->getFileName() << ")";
-                if (moreThanOneArch)
-                  outs() << " (for architecture " << I->getArchTypeName()
-                         << ")";
-              } else
-                outs() << ":" << O->getFileName();
-              outs() << ":\n";
-            }
-            dumpSymbolNamesFromObject(*O, false, ArchiveName, ArchitectureName);
+        if (PrintFileName)
+          ArchiveName = A->getFileName();
+        auto DumpMember = [&](raw_ostream &OS, SymbolicFile &O) -> bool {
+          std::string MemberArchitectureName;
+          if (PrintFileName) {
+            if (isa<MachOObjectFile>(O) && moreThanOneArch)
+              MemberArchitectureName = I->getArchTypeName();
+          } else {
+            OS << "\n" << A->getFileName();
+            if (isa<MachOObjectFile>(O)) {
+              OS << "(" << O.getFileName() << ")";
+              if (moreThanOneArch)
+                OS << " (for architecture " << I->getArchTypeName() << ")";
+            } else
+              OS << ":" << O.getFileName();
+            OS << ":\n";
           }
-        }
+          dumpSymbolNamesFromObject(OS, O, false, ArchiveName,
+                                    MemberArchitectureName);
+          return true;
+        };
+        dumpArchiveMembers(OS, *A, DumpMember);
       }
     }
     return;
@@ -1146,7 +1222,7 @@ static void dumpSymbolNamesFromFile(std::string &Filename) {
   if (SymbolicFile *O = dyn_cast<SymbolicFile>(&Bin)) {
     if (!checkMachOAndArchFlags(O, Filename))
       return;
-    dumpSymbolNamesFromObject(*O, true);
+    dumpSymbolNamesFromObject(OS, *O, true);
     return;
   }
   error("unrecognizable file type", Filename);
@@ -1208,8 +1284,17 @@ int main(int argc, char **argv) {
     error("bad number of arguments (must be two arguments)",
           "for the -s option");
 
-  std::for_each(InputFilenames.begin(), InputFilenames.end(),
-                dumpSymbolNamesFromFile);
+  if (Threads)
+    Pool.reset(new ThreadPool(Threads));
+
+  std::vector<DumpJob> Jobs;
+  for (std::string &Filename : InputFilenames)
+    Jobs.push_back([&Filename](raw_ostream &OS) {
+      dumpSymbolNamesFromFile(OS, Filename);
+      return true;
+    });
+  runDumpJobs(Jobs, outs());
+  Pool.reset();
 
   if (HadError)
     return 1;
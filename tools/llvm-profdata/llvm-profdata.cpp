@@ -11,6 +11,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/ProfileData/InstrProfReader.h"
@@ -20,12 +21,16 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Format.h"
+#include "llvm/Support/LineIterator.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/Signals.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
 
 using namespace llvm;
 
@@ -41,8 +46,75 @@ namespace {
 enum ProfileKinds { instr, sample };
 }
 
-static void mergeInstrProfile(const cl::list<std::string> &Inputs,
-                              StringRef OutputFilename) {
+namespace {
+/// One input of a merge, as loaded by a worker: the reader, which owns the
+/// data, and the records read from it, or the error that stopped it.
+struct InstrProfInput {
+  std::unique_ptr<InstrProfReader> Reader;
+  std::vector<InstrProfRecord> Records;
+  std::string Error;
+};
+
+struct SampleProfInput {
+  LLVMContext Context;
+  std::unique_ptr<sampleprof::SampleProfileReader> Reader;
+  std::string Error;
+};
+}
+
+/// Load each of \p Inputs with \p Load on a pool of workers, and pass them to
+/// \p Merge on this thread in input order, so that records that conflict are
+/// resolved, and diagnostics are printed, exactly as by a serial merge.  Only
+/// a window of inputs is loaded ahead of the one being merged, which bounds
+/// the memory used.
+///
+/// The tool exits on the first input that failed to load, once the records
+/// read from it before the error have been merged.
+template <typename InputT, typename LoadFn, typename MergeFn>
+static void mergeInOrder(ArrayRef<std::string> Inputs, unsigned NumThreads,
+                         LoadFn Load, MergeFn Merge) {
+  ThreadPool Pool(NumThreads ? NumThreads : hardware_concurrency());
+  size_t Window = 2 * Pool.getThreadCount();
+  std::vector<std::unique_ptr<InputT>> Loaded(Inputs.size());
+  std::vector<std::shared_future<void>> Done(Inputs.size());
+  auto Submit = [&](size_t I) {
+    Loaded[I] = llvm::make_unique<InputT>();
+    InputT *Input = Loaded[I].get();
+    StringRef Filename = Inputs[I];
+    Done[I] = Pool.async([=, &Load] { Load(Filename, *Input); });
+  };
+
+  for (size_t I = 0, E = std::min(Window, Inputs.size()); I != E; ++I)
+    Submit(I);
+  for (size_t I = 0, E = Inputs.size(); I != E; ++I) {
+    Done[I].wait();
+    if (I + Window < E)
+      Submit(I + Window);
+    Merge(Inputs[I], *Loaded[I]);
+    if (!Loaded[I]->Error.empty()) {
+      Pool.wait();
+      exitWithError(Loaded[I]->Error, Inputs[I]);
+    }
+    Loaded[I].reset();
+  }
+}
+
+static void loadInstrProfile(StringRef Filename, InstrProfInput &Input) {
+  auto ReaderOrErr = InstrProfReader::create(Filename);
+  if (std::error_code EC = ReaderOrErr.getError()) {
+    Input.Error = EC.message();
+    return;
+  }
+
+  Input.Reader = std::move(ReaderOrErr.get());
+  for (const auto &I : *Input.Reader)
+    Input.Records.push_back(I);
+  if (Input.Reader->hasError())
+    Input.Error = Input.Reader->getError().message();
+}
+
+static void mergeInstrProfile(ArrayRef<std::string> Inputs,
+                              StringRef OutputFilename, unsigned NumThreads) {
   if (OutputFilename.compare("-") == 0)
     exitWithError("Cannot write indexed profdata format to stdout.");
 
@@ -52,25 +124,35 @@ static void mergeInstrProfile(const cl::list<std::string> &Inputs,
     exitWithError(EC.message(), OutputFilename);
 
   InstrProfWriter Writer;
-  for (const auto &Filename : Inputs) {
-    auto ReaderOrErr = InstrProfReader::create(Filename);
-    if (std::error_code ec = ReaderOrErr.getError())
-      exitWithError(ec.message(), Filename);
-
-    auto Reader = std::move(ReaderOrErr.get());
-    for (const auto &I : *Reader)
-      if (std::error_code EC =
-              Writer.addFunctionCounts(I.Name, I.Hash, I.Counts))
-        errs() << Filename << ": " << I.Name << ": " << EC.message() << "\n";
-    if (Reader->hasError())
-      exitWithError(Reader->getError().message(), Filename);
-  }
+  mergeInOrder<InstrProfInput>(
+      Inputs, NumThreads, loadInstrProfile,
+      [&](StringRef Filename, InstrProfInput &Input) {
+        for (const auto &I : Input.Records)
+          if (std::error_code EC =
+                  Writer.addFunctionCounts(I.Name, I.Hash, I.Counts))
+            errs() << Filename << ": " << I.Name << ": " << EC.message()
+                   << "\n";
+      });
   Writer.write(Output);
 }
 
-static void mergeSampleProfile(const cl::list<std::string> &Inputs,
+static void loadSampleProfile(StringRef Filename, SampleProfInput &Input) {
+  using namespace sampleprof;
+  auto ReaderOrErr = SampleProfileReader::create(Filename, Input.Context);
+  if (std::error_code EC = ReaderOrErr.getError()) {
+    Input.Error = EC.message();
+    return;
+  }
+
+  Input.Reader = std::move(ReaderOrErr.get());
+  if (std::error_code EC = Input.Reader->read())
+    Input.Error = EC.message();
+}
+
+static void mergeSampleProfile(ArrayRef<std::string> Inputs,
                                StringRef OutputFilename,
-                               sampleprof::SampleProfileFormat OutputFormat) {
+                               sampleprof::SampleProfileFormat OutputFormat,
+                               unsigned NumThreads) {
   using namespace sampleprof;
   auto WriterOrErr = SampleProfileWriter::create(OutputFilename, OutputFormat);
   if (std::error_code EC = WriterOrErr.getError())
@@ -78,31 +160,39 @@ static void mergeSampleProfile(const cl::list<std::string> &Inputs,
 
   auto Writer = std::move(WriterOrErr.get());
   StringMap<FunctionSamples> ProfileMap;
-  for (const auto &Filename : Inputs) {
-    auto ReaderOrErr =
-        SampleProfileReader::create(Filename, getGlobalContext());
-    if (std::error_code EC = ReaderOrErr.getError())
-      exitWithError(EC.message(), Filename);
-
-    auto Reader = std::move(ReaderOrErr.get());
-    if (std::error_code EC = Reader->read())
-      exitWithError(EC.message(), Filename);
-
-    StringMap<FunctionSamples> &Profiles = Reader->getProfiles();
-    for (StringMap<FunctionSamples>::iterator I = Profiles.begin(),
-                                              E = Profiles.end();
-         I != E; ++I) {
-      StringRef FName = I->first();
-      FunctionSamples &Samples = I->second;
-      ProfileMap[FName].merge(Samples);
-    }
-  }
+  mergeInOrder<SampleProfInput>(
+      Inputs, NumThreads, loadSampleProfile,
+      [&](StringRef Filename, SampleProfInput &Input) {
+        if (!Input.Error.empty())
+          return;
+        for (const auto &I : Input.Reader->getProfiles())
+          ProfileMap[I.getKey()].merge(I.getValue());
+      });
   Writer->write(ProfileMap);
+  if (std::error_code EC = Writer->finalize())
+    exitWithError(EC.message(), OutputFilename);
+}
+
+/// Append to \p Inputs the file names listed, one per line, in \p ListFile.
+static void readInputFileList(StringRef ListFile,
+                              std::vector<std::string> &Inputs) {
+  auto BufferOrErr = MemoryBuffer::getFileOrSTDIN(ListFile);
+  if (std::error_code EC = BufferOrErr.getError())
+    exitWithError(EC.message(), ListFile);
+
+  for (line_iterator I(**BufferOrErr, /*SkipBlanks=*/true, '#');
+       !I.is_at_eof(); ++I)
+    Inputs.push_back(I->trim());
 }
 
 static int merge_main(int argc, const char *argv[]) {
-  cl::list<std::string> Inputs(cl::Positional, cl::Required, cl::OneOrMore,
-                               cl::desc("<filenames...>"));
+  cl::list<std::string> InputFilenames(cl::Positional, cl::ZeroOrMore,
+                                       cl::desc("<filenames...>"));
+  cl::opt<std::string> InputFileList(
+      "input-files", cl::init(""), cl::value_desc("path"),
+      cl::desc("File holding the names of more input files, one per line"));
+  cl::alias InputFileListA("f", cl::desc("Alias for --input-files"),
+                           cl::aliasopt(InputFileList));
 
   cl::opt<std::string> OutputFilename("output", cl::value_desc("output"),
                                       cl::init("-"), cl::Required,
@@ -121,14 +211,29 @@ static int merge_main(int argc, const char *argv[]) {
                             "Binary encoding (default)"),
                  clEnumValN(sampleprof::SPF_Text, "text", "Text encoding"),
                  clEnumValN(sampleprof::SPF_GCC, "gcc", "GCC encoding"),
+                 clEnumValN(sampleprof::SPF_Indexed, "indexed",
+                            "Indexed binary encoding"),
                  clEnumValEnd));
+  cl::opt<unsigned> NumThreads(
+      "num-threads", cl::init(0), cl::value_desc("N"),
+      cl::desc("Number of threads to merge with (default: one per core)"));
+  cl::alias NumThreadsA("j", cl::desc("Alias for --num-threads"),
+                        cl::aliasopt(NumThreads));
 
   cl::ParseCommandLineOptions(argc, argv, "LLVM profile data merger\n");
 
+  std::vector<std::string> Inputs(InputFilenames.begin(),
+                                  InputFilenames.end());
+  if (!InputFileList.empty())
+    readInputFileList(InputFileList, Inputs);
+  if (Inputs.empty())
+    exitWithError("No input files specified. See " +
+                  sys::path::filename(argv[0]) + " -help");
+
   if (ProfileKind == instr)
-    mergeInstrProfile(Inputs, OutputFilename);
+    mergeInstrProfile(Inputs, OutputFilename, NumThreads);
   else
-    mergeSampleProfile(Inputs, OutputFilename, OutputFormat);
+    mergeSampleProfile(Inputs, OutputFilename, OutputFormat, NumThreads);
 
   return 0;
 }
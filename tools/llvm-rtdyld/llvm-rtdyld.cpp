@@ -35,6 +35,8 @@
 #include "llvm/Support/Signals.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
 #include <list>
 #include <system_error>
@@ -127,8 +129,50 @@ DummySymbolMappings("dummy-extern",
                     cl::ZeroOrMore,
                     cl::Hidden);
 
+static cl::opt<unsigned>
+Threads("threads",
+        cl::desc("Resolve relocations on a pool of N threads (default: 0, "
+                 "resolve them on the main thread)."),
+        cl::init(0));
+
+static cl::opt<bool>
+ShowTimes("show-times",
+          cl::desc("Show times for the load and link phases."),
+          cl::init(false));
+
 /* *** */
 
+// The timers for -show-times.  They are reported when they are destroyed.
+struct RTDyldTimers {
+  TimerGroup Group;
+  Timer LoadObjects;
+  Timer ResolveRelocations;
+
+  RTDyldTimers()
+      : Group("llvm-rtdyld timers"), LoadObjects("Load objects", Group),
+        ResolveRelocations("Resolve relocations", Group) {}
+};
+
+static std::unique_ptr<RTDyldTimers> Timers;
+
+static Timer *getLoadObjectsTimer() {
+  return Timers ? &Timers->LoadObjects : nullptr;
+}
+
+static Timer *getResolveRelocationsTimer() {
+  return Timers ? &Timers->ResolveRelocations : nullptr;
+}
+
+// Create the pool requested with -threads, if any, and have Dyld resolve
+// relocations on it.
+static std::unique_ptr<ThreadPool> createThreadPool(RuntimeDyld &Dyld) {
+  if (!Threads)
+    return nullptr;
+  std::unique_ptr<ThreadPool> Pool(new ThreadPool(Threads));
+  Dyld.setThreadPool(Pool.get());
+  return Pool;
+}
+
 // A trivial memory manager that doesn't do anything fancy, just uses the
 // support library allocation routines directly.
 class TrivialMemoryManager : public RTDyldMemoryManager {
@@ -337,6 +381,7 @@ static int executeInput() {
   // Instantiate a dynamic linker.
   TrivialMemoryManager MemMgr;
   RuntimeDyld Dyld(MemMgr, MemMgr);
+  std::unique_ptr<ThreadPool> Pool = createThreadPool(Dyld);
 
   // FIXME: Preserve buffers until resolveRelocations time to work around a bug
   //        in RuntimeDyldELF.
@@ -362,14 +407,20 @@ static int executeInput() {
     InputBuffers.push_back(std::move(*InputBuffer));
 
     // Load the object file
-    Dyld.loadObject(Obj);
+    {
+      TimeRegion TR(getLoadObjectsTimer());
+      Dyld.loadObject(Obj);
+    }
     if (Dyld.hasError()) {
       return Error(Dyld.getErrorString());
     }
   }
 
   // Resolve all the relocations we can.
-  Dyld.resolveRelocations();
+  {
+    TimeRegion TR(getResolveRelocationsTimer());
+    Dyld.resolveRelocations();
+  }
   // Clear instruction cache before code will be executed.
   MemMgr.invalidateInstructionCache();
 
@@ -614,6 +665,7 @@ static int linkAndVerify() {
   TrivialMemoryManager MemMgr;
   RuntimeDyld Dyld(MemMgr, MemMgr);
   Dyld.setProcessAllSections(true);
+  std::unique_ptr<ThreadPool> Pool = createThreadPool(Dyld);
   RuntimeDyldChecker Checker(Dyld, Disassembler.get(), InstPrinter.get(),
                              llvm::dbgs());
 
@@ -643,7 +695,10 @@ static int linkAndVerify() {
     InputBuffers.push_back(std::move(*InputBuffer));
 
     // Load the object file
-    Dyld.loadObject(Obj);
+    {
+      TimeRegion TR(getLoadObjectsTimer());
+      Dyld.loadObject(Obj);
+    }
     if (Dyld.hasError()) {
       return Error(Dyld.getErrorString());
     }
@@ -654,7 +709,10 @@ static int linkAndVerify() {
   remapSectionsAndSymbols(TheTriple, MemMgr, Checker);
 
   // Resolve all the relocations we can.
-  Dyld.resolveRelocations();
+  {
+    TimeRegion TR(getResolveRelocationsTimer());
+    Dyld.resolveRelocations();
+  }
 
   // Register EH frames.
   Dyld.registerEHFrames();
@@ -682,16 +740,32 @@ int main(int argc, char **argv) {
 
   cl::ParseCommandLineOptions(argc, argv, "llvm MC-JIT tool\n");
 
+  if (ShowTimes)
+    Timers.reset(new RTDyldTimers());
+
+  int Result = 0;
   switch (Action) {
   case AC_Execute:
-    return executeInput();
+    Result = executeInput();
+    break;
   case AC_PrintDebugLineInfo:
-    return printLineInfoForInput(/* LoadObjects */ true,/* UseDebugObj */ true);
+    Result =
+        printLineInfoForInput(/* LoadObjects */ true,/* UseDebugObj */ true);
+    break;
   case AC_PrintLineInfo:
-    return printLineInfoForInput(/* LoadObjects */ true,/* UseDebugObj */false);
+    Result =
+        printLineInfoForInput(/* LoadObjects */ true,/* UseDebugObj */false);
+    break;
   case AC_PrintObjectLineInfo:
-    return printLineInfoForInput(/* LoadObjects */false,/* UseDebugObj */false);
+    Result =
+        printLineInfoForInput(/* LoadObjects */false,/* UseDebugObj */false);
+    break;
   case AC_Verify:
-    return linkAndVerify();
+    Result = linkAndVerify();
+    break;
   }
+
+  // Report the times before llvm_shutdown tears down the timer options.
+  Timers.reset();
+  return Result;
 }
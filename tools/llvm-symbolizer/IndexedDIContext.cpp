@@ -0,0 +1,346 @@
+//===-- IndexedDIContext.cpp ----------------------------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Implementation of the on-disk address index used by llvm-symbolizer.
+//
+// An index file is laid out as follows, with all integers little-endian:
+//
+//   Header:   char[8] Magic, uint32 Version, uint32 NumEntries,
+//             uint32 ChainsOffset, uint32 ChainsSize,
+//             uint32 StringsOffset, uint32 StringsSize
+//   Entries:  NumEntries x { uint64 Address, uint32 ChainOffset, uint32 0 },
+//             sorted by address
+//   Chains:   { uint32 NumFrames,
+//               NumFrames x { uint32 FunctionName, uint32 FileName,
+//                             uint32 Line, uint32 Column } }...
+//   Strings:  null-terminated strings, referred to by their offset
+//
+// An entry gives the inlined frames for the addresses from its own up to the
+// next one.  Entries are only written where the frames change, and a chain
+// without frames marks addresses with no debug info.
+//
+//===----------------------------------------------------------------------===//
+
+#include "IndexedDIContext.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/DebugInfo/DWARF/DWARFContext.h"
+#include "llvm/Object/ELFObjectFile.h"
+#include "llvm/Object/MachO.h"
+#include "llvm/Support/DataExtractor.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+
+namespace llvm {
+namespace symbolize {
+
+using namespace object;
+
+static const char IndexMagic[8] = {'L', 'L', 'V', 'M', 'S', 'I', 'D', 'X'};
+static const uint32_t IndexVersion = 1;
+static const uint32_t HeaderSize = 32;
+static const uint32_t EntrySize = 16;
+static const uint32_t FrameSize = 16;
+
+static std::string toHex(ArrayRef<uint8_t> Bytes) {
+  std::string Result;
+  raw_string_ostream OS(Result);
+  for (uint8_t Byte : Bytes)
+    OS << format_hex_no_prefix(Byte, 2);
+  return OS.str();
+}
+
+std::string getBuildIDString(const ObjectFile *Obj) {
+  if (auto *MachO = dyn_cast<MachOObjectFile>(Obj))
+    return toHex(MachO->getUuid());
+  if (!isa<ELFObjectFileBase>(Obj))
+    return std::string();
+  const uint32_t NT_GNU_BUILD_ID = 3;
+  for (const SectionRef &Section : Obj->sections()) {
+    StringRef Name, Data;
+    if (Section.getName(Name) || Name != ".note.gnu.build-id" ||
+        Section.getContents(Data))
+      continue;
+    DataExtractor DE(Data, Obj->isLittleEndian(), 0);
+    uint32_t Offset = 0;
+    // Each note is a name size, a descriptor size and a type, followed by the
+    // name and the descriptor, each padded to 4 bytes.
+    while (DE.isValidOffsetForDataOfSize(Offset, 12)) {
+      uint32_t NameSize = DE.getU32(&Offset);
+      uint32_t DescSize = DE.getU32(&Offset);
+      uint32_t Type = DE.getU32(&Offset);
+      uint32_t DescOffset = Offset + RoundUpToAlignment(NameSize, 4);
+      if (!DE.isValidOffsetForDataOfSize(DescOffset, DescSize))
+        break;
+      if (Type == NT_GNU_BUILD_ID && NameSize == 4 &&
+          Data.substr(Offset, 4) == StringRef("GNU\0", 4))
+        return toHex(ArrayRef<uint8_t>(
+            reinterpret_cast<const uint8_t *>(Data.data()) + DescOffset,
+            DescSize));
+      Offset = DescOffset + RoundUpToAlignment(DescSize, 4);
+    }
+  }
+  return std::string();
+}
+
+/// Collects the addresses where the inlining information of \p DICtx may
+/// change: the boundaries of the compile units and of the subprograms and
+/// inlined subroutines they contain, and the rows of their line tables.
+static std::vector<uint64_t> collectBreakpoints(DWARFContext &DICtx) {
+  std::vector<uint64_t> Addresses;
+  auto AddRanges = [&Addresses](const DWARFAddressRangesVector &Ranges) {
+    for (const auto &Range : Ranges) {
+      Addresses.push_back(Range.first);
+      Addresses.push_back(Range.second);
+    }
+  };
+  for (const auto &CU : DICtx.compile_units()) {
+    DWARFAddressRangesVector CURanges;
+    CU->collectAddressRanges(CURanges);
+    AddRanges(CURanges);
+    for (DWARFUnit *U : {static_cast<DWARFUnit *>(CU.get()),
+                         CU->getDWOUnit()}) {
+      if (!U)
+        continue;
+      for (unsigned I = 0, E = U->getNumDIEs(); I != E; ++I) {
+        const DWARFDebugInfoEntryMinimal *DIE = U->getDIEAtIndex(I);
+        if (DIE->isSubroutineDIE())
+          AddRanges(DIE->getAddressRanges(U));
+      }
+    }
+    if (const DWARFDebugLine::LineTable *LineTable =
+            DICtx.getLineTableForUnit(CU.get())) {
+      const auto &Rows = LineTable->Rows;
+      for (size_t I = 0, E = Rows.size(); I != E; ++I) {
+        Addresses.push_back(Rows[I].Address);
+        // A lookup at the address of several rows finds the first of them,
+        // and one at the next address finds the last.
+        if (I != 0 && Rows[I - 1].Address == Rows[I].Address)
+          Addresses.push_back(Rows[I].Address + 1);
+      }
+    }
+  }
+  std::sort(Addresses.begin(), Addresses.end());
+  Addresses.erase(std::unique(Addresses.begin(), Addresses.end()),
+                  Addresses.end());
+  return Addresses;
+}
+
+void IndexedDIContext::writeIndex(DWARFContext &DICtx, DINameKind FNKind,
+                                  raw_ostream &OS) {
+  DILineInfoSpecifier Spec(
+      DILineInfoSpecifier::FileLineInfoKind::AbsoluteFilePath, FNKind);
+
+  std::string StringsData;
+  raw_string_ostream StringsOS(StringsData);
+  StringMap<uint32_t> StringOffsets;
+  auto GetStringOffset = [&](const std::string &S) {
+    auto Insertion = StringOffsets.insert(
+        std::make_pair(S, uint32_t(StringsOS.tell())));
+    if (Insertion.second)
+      StringsOS << S << '\0';
+    return Insertion.first->second;
+  };
+
+  std::string ChainsData;
+  raw_string_ostream ChainsOS(ChainsData);
+  StringMap<uint32_t> ChainOffsets;
+
+  std::string EntriesData;
+  raw_string_ostream EntriesOS(EntriesData);
+  support::endian::Writer<support::little> EntriesWriter(EntriesOS);
+  uint32_t NumEntries = 0;
+  uint32_t LastChainOffset = 0;
+
+  for (uint64_t Address : collectBreakpoints(DICtx)) {
+    DIInliningInfo Info = DICtx.getInliningInfoForAddress(Address, Spec);
+    // Chains are identified by their encoding, so that each distinct one is
+    // written once.
+    std::string Chain;
+    raw_string_ostream ChainOS(Chain);
+    support::endian::Writer<support::little> ChainWriter(ChainOS);
+    ChainWriter.write<uint32_t>(Info.getNumberOfFrames());
+    for (uint32_t I = 0, N = Info.getNumberOfFrames(); I != N; ++I) {
+      const DILineInfo &Frame = Info.getFrame(I);
+      ChainWriter.write<uint32_t>(GetStringOffset(Frame.FunctionName));
+      ChainWriter.write<uint32_t>(GetStringOffset(Frame.FileName));
+      ChainWriter.write<uint32_t>(Frame.Line);
+      ChainWriter.write<uint32_t>(Frame.Column);
+    }
+    ChainOS.flush();
+    auto Insertion = ChainOffsets.insert(
+        std::make_pair(Chain, uint32_t(ChainsOS.tell())));
+    if (Insertion.second)
+      ChainsOS << Chain;
+    uint32_t ChainOffset = Insertion.first->second;
+
+    if (NumEntries != 0 && ChainOffset == LastChainOffset)
+      continue;
+    EntriesWriter.write<uint64_t>(Address);
+    EntriesWriter.write<uint32_t>(ChainOffset);
+    EntriesWriter.write<uint32_t>(0);
+    ++NumEntries;
+    LastChainOffset = ChainOffset;
+  }
+  StringsOS.flush();
+  ChainsOS.flush();
+  EntriesOS.flush();
+
+  support::endian::Writer<support::little> Writer(OS);
+  uint32_t ChainsOffset = HeaderSize + EntriesData.size();
+  uint32_t StringsOffset = ChainsOffset + ChainsData.size();
+  OS.write(IndexMagic, sizeof(IndexMagic));
+  Writer.write<uint32_t>(IndexVersion);
+  Writer.write<uint32_t>(NumEntries);
+  Writer.write<uint32_t>(ChainsOffset);
+  Writer.write<uint32_t>(ChainsData.size());
+  Writer.write<uint32_t>(StringsOffset);
+  Writer.write<uint32_t>(StringsData.size());
+  OS << EntriesData << ChainsData << StringsData;
+}
+
+static uint32_t readU32(StringRef Data, uint32_t Offset) {
+  return support::endian::read<uint32_t, support::little, support::unaligned>(
+      Data.data() + Offset);
+}
+
+std::unique_ptr<IndexedDIContext>
+IndexedDIContext::create(std::unique_ptr<MemoryBuffer> Buffer) {
+  StringRef Data = Buffer->getBuffer();
+  if (Data.size() < HeaderSize ||
+      !Data.startswith(StringRef(IndexMagic, sizeof(IndexMagic))) ||
+      readU32(Data, 8) != IndexVersion)
+    return nullptr;
+  uint64_t NumEntries = readU32(Data, 12);
+  uint64_t ChainsOffset = readU32(Data, 16);
+  uint64_t ChainsSize = readU32(Data, 20);
+  uint64_t StringsOffset = readU32(Data, 24);
+  uint64_t StringsSize = readU32(Data, 28);
+  if (ChainsOffset != HeaderSize + NumEntries * EntrySize ||
+      StringsOffset != ChainsOffset + ChainsSize ||
+      StringsOffset + StringsSize != Data.size() ||
+      (StringsSize != 0 && Data.back() != '\0'))
+    return nullptr;
+
+  std::unique_ptr<IndexedDIContext> Ctx(
+      new IndexedDIContext(std::move(Buffer)));
+  Ctx->NumEntries = NumEntries;
+  Ctx->Entries = Data.substr(HeaderSize, NumEntries * EntrySize);
+  Ctx->Chains = Data.substr(ChainsOffset, ChainsSize);
+  Ctx->Strings = Data.substr(StringsOffset, StringsSize);
+  return Ctx;
+}
+
+IndexedDIContext::IndexedDIContext(std::unique_ptr<MemoryBuffer> Buffer)
+    : DIContext(CK_Index), Buffer(std::move(Buffer)), NumEntries(0) {}
+
+uint64_t IndexedDIContext::getEntryAddress(uint32_t Index) const {
+  return support::endian::read<uint64_t, support::little, support::unaligned>(
+      Entries.data() + Index * EntrySize);
+}
+
+uint32_t IndexedDIContext::findEntry(uint64_t Address) const {
+  // Find the first entry above Address; the one before it covers Address.
+  uint32_t Low = 0, High = NumEntries;
+  while (Low < High) {
+    uint32_t Mid = Low + (High - Low) / 2;
+    if (getEntryAddress(Mid) <= Address)
+      Low = Mid + 1;
+    else
+      High = Mid;
+  }
+  return Low == 0 ? NumEntries : Low - 1;
+}
+
+StringRef IndexedDIContext::getString(uint32_t Offset) const {
+  if (Offset >= Strings.size())
+    return StringRef();
+  return StringRef(Strings.data() + Offset);
+}
+
+DIInliningInfo IndexedDIContext::getInliningInfoForEntry(uint32_t Index) const {
+  DIInliningInfo Info;
+  uint32_t Offset = readU32(Entries, Index * EntrySize + 8);
+  if (Offset > Chains.size() || Chains.size() - Offset < 4)
+    return Info;
+  uint32_t NumFrames = readU32(Chains, Offset);
+  Offset += 4;
+  if ((Chains.size() - Offset) / FrameSize < NumFrames)
+    return Info;
+  for (uint32_t I = 0; I != NumFrames; ++I, Offset += FrameSize) {
+    DILineInfo Frame;
+    Frame.FunctionName = getString(readU32(Chains, Offset));
+    Frame.FileName = getString(readU32(Chains, Offset + 4));
+    Frame.Line = readU32(Chains, Offset + 8);
+    Frame.Column = readU32(Chains, Offset + 12);
+    Info.addFrame(Frame);
+  }
+  return Info;
+}
+
+void IndexedDIContext::dump(raw_ostream &OS, DIDumpType DumpType) {
+  if (DumpType != DIDT_All && DumpType != DIDT_Line)
+    return;
+  for (uint32_t I = 0; I != NumEntries; ++I) {
+    OS << format_hex(getEntryAddress(I), 18) << '\n';
+    DIInliningInfo Info = getInliningInfoForEntry(I);
+    for (uint32_t F = 0, N = Info.getNumberOfFrames(); F != N; ++F) {
+      const DILineInfo &Frame = Info.getFrame(F);
+      OS << "  " << Frame.FunctionName << ' ' << Frame.FileName << ':'
+         << Frame.Line << ':' << Frame.Column << '\n';
+    }
+  }
+}
+
+DIInliningInfo
+IndexedDIContext::getInliningInfoForAddress(uint64_t Address,
+                                            DILineInfoSpecifier Specifier) {
+  uint32_t Index = findEntry(Address);
+  if (Index == NumEntries)
+    return DIInliningInfo();
+  return getInliningInfoForEntry(Index);
+}
+
+DILineInfo
+IndexedDIContext::getLineInfoForAddress(uint64_t Address,
+                                        DILineInfoSpecifier Specifier) {
+  // The innermost frame holds the line table entry for the address and the
+  // name of the function it is in.
+  DIInliningInfo Info = getInliningInfoForAddress(Address, Specifier);
+  if (Info.getNumberOfFrames() == 0)
+    return DILineInfo();
+  return Info.getFrame(0);
+}
+
+DILineInfoTable
+IndexedDIContext::getLineInfoForAddressRange(uint64_t Address, uint64_t Size,
+                                             DILineInfoSpecifier Specifier) {
+  DILineInfoTable Lines;
+  uint32_t Index = findEntry(Address);
+  if (Index == NumEntries)
+    return Lines;
+  std::string FunctionName = getLineInfoForAddress(Address).FunctionName;
+  for (; Index != NumEntries; ++Index) {
+    uint64_t EntryAddress = std::max(getEntryAddress(Index), Address);
+    if (EntryAddress - Address >= Size)
+      break;
+    DIInliningInfo Info = getInliningInfoForEntry(Index);
+    if (Info.getNumberOfFrames() == 0)
+      continue;
+    DILineInfo Line = Info.getFrame(0);
+    Line.FunctionName = FunctionName;
+    Lines.push_back(std::make_pair(EntryAddress, Line));
+  }
+  return Lines;
+}
+
+} // namespace symbolize
+} // namespace llvm
@@ -0,0 +1,94 @@
+//===-- IndexedDIContext.h -------------------------------------- C++ -----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Header for the on-disk address index used by llvm-symbolizer to answer
+// queries without parsing DWARF.
+//
+//===----------------------------------------------------------------------===//
+#ifndef LLVM_TOOLS_LLVM_SYMBOLIZER_INDEXEDDICONTEXT_H
+#define LLVM_TOOLS_LLVM_SYMBOLIZER_INDEXEDDICONTEXT_H
+
+#include "llvm/DebugInfo/DIContext.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <memory>
+#include <string>
+
+namespace llvm {
+
+class DWARFContext;
+class raw_ostream;
+
+namespace object {
+class ObjectFile;
+}
+
+namespace symbolize {
+
+/// \brief Returns the build ID of \p Obj in hexadecimal: the contents of the
+/// .note.gnu.build-id section of an ELF file, or the UUID of a Mach-O file.
+/// Returns an empty string if the object has none.
+std::string getBuildIDString(const object::ObjectFile *Obj);
+
+/// \brief A DIContext that answers queries from an index of the inlining
+/// information at every address where it may change.
+///
+/// The index is computed once from the DWARF of a module and is then
+/// searched in place, typically in a memory mapped file, so that looking up
+/// an address in a module costs a binary search instead of a parse of its
+/// .debug_info and .debug_line sections.  File names are absolute, function
+/// names are of the kind the index was written for.
+class IndexedDIContext : public DIContext {
+public:
+  /// \brief Writes the index of \p DICtx to \p OS, with function names of
+  /// kind \p FNKind.
+  static void writeIndex(DWARFContext &DICtx, DINameKind FNKind,
+                         raw_ostream &OS);
+
+  /// \brief Returns a context reading from \p Buffer, or null if it does not
+  /// hold a valid index.
+  static std::unique_ptr<IndexedDIContext>
+  create(std::unique_ptr<MemoryBuffer> Buffer);
+
+  static bool classof(const DIContext *DICtx) {
+    return DICtx->getKind() == CK_Index;
+  }
+
+  void dump(raw_ostream &OS, DIDumpType DumpType = DIDT_All) override;
+
+  DILineInfo getLineInfoForAddress(
+      uint64_t Address,
+      DILineInfoSpecifier Specifier = DILineInfoSpecifier()) override;
+  DILineInfoTable getLineInfoForAddressRange(
+      uint64_t Address, uint64_t Size,
+      DILineInfoSpecifier Specifier = DILineInfoSpecifier()) override;
+  DIInliningInfo getInliningInfoForAddress(
+      uint64_t Address,
+      DILineInfoSpecifier Specifier = DILineInfoSpecifier()) override;
+
+private:
+  IndexedDIContext(std::unique_ptr<MemoryBuffer> Buffer);
+
+  uint64_t getEntryAddress(uint32_t Index) const;
+  /// Returns the index of the last entry at or below \p Address, or
+  /// NumEntries if there is none.
+  uint32_t findEntry(uint64_t Address) const;
+  DIInliningInfo getInliningInfoForEntry(uint32_t Index) const;
+  StringRef getString(uint32_t Offset) const;
+
+  std::unique_ptr<MemoryBuffer> Buffer;
+  uint32_t NumEntries;
+  StringRef Entries;
+  StringRef Chains;
+  StringRef Strings;
+};
+
+} // namespace symbolize
+} // namespace llvm
+
+#endif
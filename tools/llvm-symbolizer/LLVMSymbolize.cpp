@@ -12,6 +12,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "LLVMSymbolize.h"
+#include "IndexedDIContext.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/Config/config.h"
 #include "llvm/DebugInfo/DWARF/DWARFContext.h"
@@ -150,6 +151,7 @@ DILineInfo ModuleInfo::symbolizeCode(
     uint64_t ModuleOffset, const LLVMSymbolizer::Options &Opts) const {
   DILineInfo LineInfo;
   if (DebugInfoContext) {
+    std::lock_guard<std::mutex> Lock(DebugInfoMutex);
     LineInfo = DebugInfoContext->getLineInfoForAddress(
         ModuleOffset, getDILineInfoSpecifier(Opts));
   }
@@ -170,6 +172,7 @@ DIInliningInfo ModuleInfo::symbolizeInlinedCode(
   DIInliningInfo InlinedContext;
 
   if (DebugInfoContext) {
+    std::lock_guard<std::mutex> Lock(DebugInfoMutex);
     InlinedContext = DebugInfoContext->getInliningInfoForAddress(
         ModuleOffset, getDILineInfoSpecifier(Opts));
   }
@@ -243,7 +246,7 @@ std::string LLVMSymbolizer::symbolizeData(const std::string &ModuleName,
 }
 
 void LLVMSymbolizer::flush() {
-  DeleteContainerSeconds(Modules);
+  Modules.clear();
   ObjectPairForPathArch.clear();
   ObjectFileForArch.clear();
 }
@@ -445,9 +448,19 @@ LLVMSymbolizer::getObjectFileFromBinary(Binary *Bin,
 
 ModuleInfo *
 LLVMSymbolizer::getOrCreateModuleInfo(const std::string &ModuleName) {
-  const auto &I = Modules.find(ModuleName);
-  if (I != Modules.end())
-    return I->second;
+  ModuleEntry *Entry;
+  {
+    std::lock_guard<std::mutex> Lock(ModulesMutex);
+    std::unique_ptr<ModuleEntry> &E = Modules[ModuleName];
+    if (!E)
+      E.reset(new ModuleEntry());
+    Entry = E.get();
+  }
+  std::lock_guard<std::mutex> Lock(Entry->Mutex);
+  if (Entry->Loaded)
+    return Entry->Info.get();
+  Entry->Loaded = true;
+
   std::string BinaryName = ModuleName;
   std::string ArchName = Opts.DefaultArch;
   size_t ColonPos = ModuleName.find_last_of(':');
@@ -459,11 +472,14 @@ LLVMSymbolizer::getOrCreateModuleInfo(const std::string &ModuleName) {
       ArchName = ArchStr;
     }
   }
-  ObjectPair Objects = getOrCreateObjects(BinaryName, ArchName);
+  ObjectPair Objects;
+  {
+    std::lock_guard<std::mutex> Lock(ObjectsMutex);
+    Objects = getOrCreateObjects(BinaryName, ArchName);
+  }
 
   if (!Objects.first) {
     // Failed to find valid object file.
-    Modules.insert(make_pair(ModuleName, (ModuleInfo *)nullptr));
     return nullptr;
   }
   DIContext *Context = nullptr;
@@ -478,12 +494,62 @@ LLVMSymbolizer::getOrCreateModuleInfo(const std::string &ModuleName) {
                                Opts.RelativeAddresses);
     }
   }
+  if (!Context && !Opts.CacheDir.empty())
+    Context = getOrCreateIndexedContext(Objects.first, *Objects.second);
   if (!Context)
     Context = new DWARFContextInMemory(*Objects.second);
   assert(Context);
-  ModuleInfo *Info = new ModuleInfo(Objects.first, Context);
-  Modules.insert(make_pair(ModuleName, Info));
-  return Info;
+  Entry->Info.reset(new ModuleInfo(Objects.first, Context));
+  return Entry->Info.get();
+}
+
+DIContext *
+LLVMSymbolizer::getOrCreateIndexedContext(const ObjectFile *Obj,
+                                          const ObjectFile &DbgObj) const {
+  std::string BuildID = getBuildIDString(Obj);
+  if (BuildID.empty())
+    return nullptr;
+  // The index holds function names of a single kind.
+  const char *KindName = "none";
+  if (Opts.PrintFunctions == FunctionNameKind::ShortName)
+    KindName = "short";
+  else if (Opts.PrintFunctions == FunctionNameKind::LinkageName)
+    KindName = "linkage";
+  SmallString<128> IndexPath(Opts.CacheDir);
+  sys::path::append(IndexPath, BuildID + "." + KindName + ".symidx");
+
+  ErrorOr<std::unique_ptr<MemoryBuffer>> BufferOrErr =
+      MemoryBuffer::getFile(IndexPath, -1, false);
+  if (BufferOrErr) {
+    if (auto Ctx = IndexedDIContext::create(std::move(BufferOrErr.get())))
+      return Ctx.release();
+  }
+
+  std::string IndexData;
+  {
+    DWARFContextInMemory DWARFCtx(DbgObj);
+    raw_string_ostream OS(IndexData);
+    IndexedDIContext::writeIndex(DWARFCtx, Opts.PrintFunctions, OS);
+  }
+  // Write to a temporary file first, so that concurrent runs never see a
+  // partial index. Failing to do so only costs rebuilding it next time.
+  SmallString<128> TempPath;
+  int FD;
+  if (!sys::fs::create_directories(Opts.CacheDir) &&
+      !sys::fs::createUniqueFile(IndexPath + "-%%%%%%.tmp", FD, TempPath)) {
+    bool Failed;
+    {
+      raw_fd_ostream OS(FD, /*shouldClose=*/true);
+      OS << IndexData;
+      OS.close();
+      Failed = OS.has_error();
+      OS.clear_error();
+    }
+    if (Failed || sys::fs::rename(TempPath, IndexPath))
+      sys::fs::remove(TempPath);
+  }
+  return IndexedDIContext::create(
+             MemoryBuffer::getMemBufferCopy(IndexData, IndexPath)).release();
 }
 
 std::string LLVMSymbolizer::printDILineInfo(DILineInfo LineInfo,
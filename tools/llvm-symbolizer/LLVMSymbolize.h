@@ -21,6 +21,7 @@
 #include "llvm/Support/MemoryBuffer.h"
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 
 namespace llvm {
@@ -42,6 +43,9 @@ public:
     bool RelativeAddresses : 1;
     std::string DefaultArch;
     std::vector<std::string> DsymHints;
+    // If not empty, the directory where an index of the debug info of each
+    // module with a build ID is cached between runs.
+    std::string CacheDir;
     Options(FunctionNameKind PrintFunctions = FunctionNameKind::LinkageName,
             bool UseSymbolTable = true, bool PrintInlining = true,
             bool Demangle = true, bool RelativeAddresses = false,
@@ -57,11 +61,15 @@ public:
   }
 
   // Returns the result of symbolization for module name/offset as
-  // a string (possibly containing newlines).
+  // a string (possibly containing newlines). These may be called from
+  // several threads at once; requests for different modules proceed in
+  // parallel.
   std::string
   symbolizeCode(const std::string &ModuleName, uint64_t ModuleOffset);
   std::string
   symbolizeData(const std::string &ModuleName, uint64_t ModuleOffset);
+  // Releases all the modules. Must not be called concurrently with
+  // symbolization requests.
   void flush();
   static std::string DemangleName(const std::string &Name, ModuleInfo *ModInfo);
 
@@ -79,6 +87,12 @@ private:
   /// universal binary (or the binary itself if it is an object file).
   ObjectFile *getObjectFileFromBinary(Binary *Bin, const std::string &ArchName);
 
+  /// \brief Returns a context answering from the cached index of the debug
+  /// info of \p DbgObj, building the index first if needed. Returns null if
+  /// \p Obj has no build ID.
+  DIContext *getOrCreateIndexedContext(const ObjectFile *Obj,
+                                       const ObjectFile &DbgObj) const;
+
   std::string printDILineInfo(DILineInfo LineInfo, ModuleInfo *ModInfo) const;
 
   // Owns all the parsed binaries and object files.
@@ -92,8 +106,19 @@ private:
     MemoryBuffers.push_back(std::move(MemBuf));
   }
 
-  // Owns module info objects.
-  std::map<std::string, ModuleInfo *> Modules;
+  struct ModuleEntry {
+    // Held while the module is being loaded.
+    std::mutex Mutex;
+    bool Loaded = false;
+    std::unique_ptr<ModuleInfo> Info;
+  };
+
+  // Owns module info objects. Guarded by ModulesMutex; the entries
+  // themselves are not, so that modules can be loaded in parallel.
+  std::map<std::string, std::unique_ptr<ModuleEntry>> Modules;
+  std::mutex ModulesMutex;
+  // Guards the parsed binaries and the object caches below.
+  std::mutex ObjectsMutex;
   std::map<std::pair<MachOUniversalBinary *, std::string>, ObjectFile *>
       ObjectFileForArch;
   std::map<std::pair<std::string, std::string>, ObjectPair>
@@ -128,6 +153,8 @@ private:
                  uint64_t OpdAddress = 0);
   ObjectFile *Module;
   std::unique_ptr<DIContext> DebugInfoContext;
+  // DIContext queries are not thread-safe.
+  mutable std::mutex DebugInfoMutex;
 
   struct SymbolDesc {
     uint64_t Addr;
@@ -25,10 +25,15 @@
 #include "llvm/Support/Path.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/Signals.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/raw_ostream.h"
+#include <condition_variable>
 #include <cstdio>
 #include <cstring>
+#include <deque>
 #include <string>
+#include <thread>
 
 using namespace llvm;
 using namespace symbolize;
@@ -74,6 +79,16 @@ ClDsymHint("dsym-hint", cl::ZeroOrMore,
            cl::desc("Path to .dSYM bundles to search for debug info for the "
                     "object files"));
 
+static cl::opt<std::string>
+ClCacheDir("cache-dir", cl::init(""),
+           cl::desc("Directory where an index of the debug info of each "
+                    "binary with a build ID is kept between runs"));
+
+static cl::opt<unsigned>
+ClJobs("jobs", cl::init(1),
+       cl::desc("Number of requests to symbolize in parallel (0 = number of "
+                "hardware threads)"));
+
 static bool parseCommand(bool &IsData, std::string &ModuleName,
                          uint64_t &ModuleOffset) {
   const char *kDataCmd = "DATA ";
@@ -123,6 +138,76 @@ static bool parseCommand(bool &IsData, std::string &ModuleName,
   return true;
 }
 
+namespace {
+/// A request read from the input, and its result once it is symbolized.
+struct PendingRequest {
+  std::string Result;
+  std::shared_future<void> Done;
+};
+}
+
+// Symbolizes the requests on NumJobs threads, and prints the results in the
+// order of the requests.  Each result is printed as soon as it and all those
+// before it are ready, so this can also serve a client that waits for every
+// answer before sending its next request.
+static int symbolizeInParallel(LLVMSymbolizer &Symbolizer, unsigned NumJobs) {
+  // Bound the number of requests read ahead of the output.
+  const size_t MaxPending = 1024;
+  ThreadPool Pool(NumJobs);
+  std::deque<std::unique_ptr<PendingRequest>> Pending;
+  std::mutex PendingMutex;
+  std::condition_variable PendingChanged;
+  bool InputDone = false;
+
+  std::thread Printer([&] {
+    while (true) {
+      PendingRequest *Request;
+      {
+        std::unique_lock<std::mutex> Lock(PendingMutex);
+        PendingChanged.wait(Lock,
+                            [&] { return InputDone || !Pending.empty(); });
+        if (Pending.empty())
+          return;
+        Request = Pending.front().get();
+      }
+      Request->Done.wait();
+      outs() << Request->Result << "\n";
+      outs().flush();
+      {
+        std::lock_guard<std::mutex> Lock(PendingMutex);
+        Pending.pop_front();
+      }
+      PendingChanged.notify_all();
+    }
+  });
+
+  bool IsData = false;
+  std::string ModuleName;
+  uint64_t ModuleOffset;
+  while (parseCommand(IsData, ModuleName, ModuleOffset)) {
+    std::unique_ptr<PendingRequest> Request(new PendingRequest());
+    PendingRequest *R = Request.get();
+    R->Done = Pool.async([&Symbolizer, R, IsData, ModuleName, ModuleOffset] {
+      R->Result = IsData ? Symbolizer.symbolizeData(ModuleName, ModuleOffset)
+                         : Symbolizer.symbolizeCode(ModuleName, ModuleOffset);
+    });
+    {
+      std::unique_lock<std::mutex> Lock(PendingMutex);
+      PendingChanged.wait(Lock, [&] { return Pending.size() < MaxPending; });
+      Pending.push_back(std::move(Request));
+    }
+    PendingChanged.notify_all();
+  }
+
+  {
+    std::lock_guard<std::mutex> Lock(PendingMutex);
+    InputDone = true;
+  }
+  PendingChanged.notify_all();
+  Printer.join();
+  return 0;
+}
+
 int main(int argc, char **argv) {
   // Print stack trace if we signal out.
   sys::PrintStackTraceOnErrorSignal();
@@ -143,8 +228,13 @@ int main(int argc, char **argv) {
                 "\" (must have the '.dSYM' extension).\n";
     }
   }
+  Opts.CacheDir = ClCacheDir;
   LLVMSymbolizer Symbolizer(Opts);
 
+  unsigned NumJobs = ClJobs ? ClJobs : hardware_concurrency();
+  if (NumJobs > 1)
+    return symbolizeInParallel(Symbolizer, NumJobs);
+
   bool IsData = false;
   std::string ModuleName;
   uint64_t ModuleOffset;
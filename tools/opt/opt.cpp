@@ -573,8 +573,7 @@ int main(int argc, char **argv) {
 
   if (OptLevelO1 || OptLevelO2 || OptLevelOs || OptLevelOz || OptLevelO3) {
     FPasses->doInitialization();
-    for (Function &F : *M)
-      FPasses->run(F);
+    FPasses->runOnFunctions();
     FPasses->doFinalization();
   }
 
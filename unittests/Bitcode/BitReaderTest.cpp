@@ -23,7 +23,10 @@
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/StreamingMemoryObject.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/raw_ostream.h"
 #include "gtest/gtest.h"
+#include <chrono>
 
 using namespace llvm;
 
@@ -310,4 +313,174 @@ TEST(BitReaderTest, MaterializeFunctionsForBlockAddrInFunctionAfter) {
   EXPECT_FALSE(verifyModule(*M, &dbgs()));
 }
 
+TEST(BitReaderTest, MaterializeFunctionsInBatch) {
+  const char *Assembly = "@g = global i32 0\n"
+                         "define i32 @f(i32 %x) {\n"
+                         "  %y = add i32 %x, 42\n"
+                         "  %z = call i32 @h(i32 %y), !prof !0\n"
+                         "  ret i32 %z\n"
+                         "}\n"
+                         "define i32 @h(i32 %x) {\n"
+                         "  %p = load i32, i32* @g\n"
+                         "  %y = mul i32 %x, %p\n"
+                         "  ret i32 %y\n"
+                         "}\n"
+                         "define void @other() {\n"
+                         "  unreachable\n"
+                         "}\n"
+                         "define i64 @j(i64 %x) {\n"
+                         "entry:\n"
+                         "  br label %loop\n"
+                         "loop:\n"
+                         "  %i = phi i64 [ 0, %entry ], [ %n, %loop ]\n"
+                         "  %n = add i64 %i, 1000000000000\n"
+                         "  %c = icmp ult i64 %n, %x\n"
+                         "  br i1 %c, label %loop, label %exit\n"
+                         "exit:\n"
+                         "  ret i64 %n\n"
+                         "}\n"
+                         "!0 = !{!\"branch_weights\", i32 1}\n";
+  auto printFunctions = [](const Module &M) {
+    std::string Str;
+    raw_string_ostream OS(Str);
+    for (const Function &F : M)
+      F.print(OS);
+    return OS.str();
+  };
+  std::string Expected = printFunctions(*parseAssembly(Assembly));
+
+  for (unsigned Threads : {0, 1, 3}) {
+    SmallString<1024> Mem;
+    LLVMContext Context;
+    std::unique_ptr<Module> M =
+        getLazyModuleFromAssembly(Context, Mem, Assembly);
+    std::unique_ptr<ThreadPool> Pool;
+    if (Threads)
+      Pool.reset(new ThreadPool(Threads));
+
+    Function *Fns[] = {M->getFunction("j"), M->getFunction("f"),
+                       M->getFunction("h"), M->getFunction("j")};
+    EXPECT_FALSE(M->materializeFunctions(Fns, Pool.get()));
+    EXPECT_TRUE(M->getFunction("other")->empty());
+    EXPECT_FALSE(verifyModule(*M, &dbgs()));
+
+    EXPECT_FALSE(M->materializeAll());
+    EXPECT_EQ(Expected, printFunctions(*M));
+  }
+}
+
+// Benchmark for reading a whole module, from memory and through a streamer.
+// It is disabled by default; run it with --gtest_also_run_disabled_tests.
+TEST(BitReaderTest, DISABLED_ReadBitcodeBenchmark) {
+  const unsigned NumFunctions = 2000, NumRuns = 10;
+  std::string Assembly;
+  raw_string_ostream AsmOS(Assembly);
+  AsmOS << "@g = global i32 0\n";
+  for (unsigned I = 0; I != NumFunctions; ++I)
+    AsmOS << "define i32 @function_with_a_long_name_" << I << "(i32 %x) {\n"
+          << "  %p = load i32, i32* @g\n"
+          << "  %y = mul i32 %x, %p\n"
+          << "  %z = add i32 %y, " << I << ", !annotation !" << I << "\n"
+          << "  ret i32 %z\n"
+          << "}\n";
+  for (unsigned I = 0; I != NumFunctions; ++I)
+    AsmOS << "!" << I << " = !{!\"/path/to/some/source/directory/file" << I
+          << ".cpp\"}\n";
+  SmallString<1024> Mem;
+  writeModuleToBuffer(parseAssembly(AsmOS.str().c_str()), Mem);
+
+  typedef std::chrono::microseconds us;
+  auto Start = std::chrono::steady_clock::now();
+  for (unsigned I = 0; I != NumRuns; ++I) {
+    LLVMContext Context;
+    ErrorOr<std::unique_ptr<Module>> ModuleOrErr = parseBitcodeFile(
+        MemoryBufferRef(Mem.str(), "test"), Context);
+    ASSERT_TRUE(bool(ModuleOrErr));
+  }
+  auto Direct = std::chrono::steady_clock::now() - Start;
+
+  Start = std::chrono::steady_clock::now();
+  for (unsigned I = 0; I != NumRuns; ++I) {
+    LLVMContext Context;
+    auto Streamer = llvm::make_unique<BufferDataStreamer>(
+        MemoryBuffer::getMemBuffer(Mem.str(), "test", false));
+    ErrorOr<std::unique_ptr<Module>> ModuleOrErr =
+        getStreamedBitcodeModule("test", std::move(Streamer), Context);
+    ASSERT_TRUE(bool(ModuleOrErr));
+    EXPECT_FALSE((*ModuleOrErr)->materializeAll());
+  }
+  auto Streamed = std::chrono::steady_clock::now() - Start;
+
+  outs() << "bitcode:  " << Mem.size() << " bytes\n"
+         << "direct:   "
+         << std::chrono::duration_cast<us>(Direct).count() / NumRuns
+         << " us/module\n"
+         << "streamed: "
+         << std::chrono::duration_cast<us>(Streamed).count() / NumRuns
+         << " us/module\n";
+}
+
+TEST(BitReaderTest, LazyLoadMetadataNodes) {
+  const char *Assembly = "@a = global i32 0\n"
+                         "@b = global i32 0\n"
+                         "define void @f() {\n"
+                         "  ret void, !foo !0\n"
+                         "}\n"
+                         "define void @g() {\n"
+                         "  ret void, !foo !1\n"
+                         "}\n"
+                         "!named = !{!2}\n"
+                         "!0 = !{i32* @a, !\"f\"}\n"
+                         "!1 = distinct !{i32* @b, !3}\n"
+                         "!2 = !{!\"named\"}\n"
+                         "!3 = !{!1}\n";
+  std::unique_ptr<Module> Original = parseAssembly(Assembly);
+  Original->setModuleIdentifier("test");
+  std::string Expected;
+  raw_string_ostream ExpectedOS(Expected);
+  Original->print(ExpectedOS, nullptr);
+
+  SmallString<1024> Mem;
+  writeModuleToBuffer(std::move(Original), Mem);
+  LLVMContext Context;
+  std::unique_ptr<MemoryBuffer> Buffer =
+      MemoryBuffer::getMemBuffer(Mem.str(), "test", false);
+  ErrorOr<std::unique_ptr<Module>> ModuleOrErr = getLazyBitcodeModule(
+      std::move(Buffer), Context, nullptr, /*ShouldLazyLoadMetadata=*/true);
+  ASSERT_TRUE(bool(ModuleOrErr));
+  std::unique_ptr<Module> M = std::move(ModuleOrErr.get());
+  GlobalVariable *A = M->getGlobalVariable("a");
+  GlobalVariable *B = M->getGlobalVariable("b");
+  EXPECT_FALSE(A->isUsedByMetadata());
+  EXPECT_FALSE(B->isUsedByMetadata());
+
+  // Reading @f reads only the nodes that it refers to.
+  EXPECT_FALSE(M->getFunction("f")->materialize());
+  EXPECT_TRUE(A->isUsedByMetadata());
+  EXPECT_FALSE(B->isUsedByMetadata());
+  EXPECT_FALSE(M->getNamedMetadata("named"));
+
+  EXPECT_FALSE(M->materializeMetadata());
+  EXPECT_TRUE(M->getNamedMetadata("named"));
+  EXPECT_FALSE(B->isUsedByMetadata());
+
+  // The cycle through the attachment of @g is read and resolved.
+  EXPECT_FALSE(M->materializeAll());
+  EXPECT_TRUE(B->isUsedByMetadata());
+  Instruction *Ret = M->getFunction("g")->getEntryBlock().getTerminator();
+  MDNode *N1 = Ret->getMetadata("foo");
+  ASSERT_TRUE(N1);
+  EXPECT_TRUE(N1->isResolved());
+  auto *N3 = dyn_cast<MDNode>(N1->getOperand(1));
+  ASSERT_TRUE(N3);
+  EXPECT_TRUE(N3->isResolved());
+  EXPECT_EQ(N1, N3->getOperand(0));
+  EXPECT_FALSE(verifyModule(*M, &dbgs()));
+
+  std::string Actual;
+  raw_string_ostream ActualOS(Actual);
+  M->print(ActualOS, nullptr);
+  EXPECT_EQ(ExpectedOS.str(), ActualOS.str());
+}
+
 } // end namespace
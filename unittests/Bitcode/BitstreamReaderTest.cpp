@@ -7,7 +7,9 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "llvm/ADT/SmallString.h"
 #include "llvm/Bitcode/BitstreamReader.h"
+#include "llvm/Bitcode/BitstreamWriter.h"
 #include "gtest/gtest.h"
 
 using namespace llvm;
@@ -53,4 +55,61 @@ TEST(BitstreamReaderTest, AtEndOfStreamEmpty) {
   EXPECT_TRUE(Cursor.AtEndOfStream());
 }
 
+TEST(BitstreamReaderTest, DirectReadsMatchMemoryObject) {
+  uint8_t Bytes[44];
+  for (unsigned I = 0; I != sizeof(Bytes); ++I)
+    Bytes[I] = I * 37 + 11;
+  BitstreamReader Direct(std::begin(Bytes), std::end(Bytes));
+  BitstreamReader Indirect(std::unique_ptr<MemoryObject>(
+      getNonStreamedMemoryObject(std::begin(Bytes), std::end(Bytes))));
+  EXPECT_FALSE(Direct.getDirectBytes().empty());
+  EXPECT_TRUE(Indirect.getDirectBytes().empty());
+
+  BitstreamCursor DirectCursor(Direct), IndirectCursor(Indirect);
+  for (unsigned Width : {3, 17, 32, 1, 64, 7, 29, 63, 13, 5, 24, 11}) {
+    EXPECT_EQ(IndirectCursor.Read(Width), DirectCursor.Read(Width));
+    EXPECT_EQ(IndirectCursor.GetCurrentBitNo(), DirectCursor.GetCurrentBitNo());
+  }
+  EXPECT_EQ(IndirectCursor.AtEndOfStream(), DirectCursor.AtEndOfStream());
+
+  DirectCursor.JumpToBit(100);
+  IndirectCursor.JumpToBit(100);
+  EXPECT_EQ(IndirectCursor.Read(50), DirectCursor.Read(50));
+}
+
+TEST(BitstreamReaderTest, BlobPointsIntoBuffer) {
+  SmallString<64> Buffer;
+  StringRef BlobIn = "a blob that is read in place";
+  {
+    BitstreamWriter Writer(Buffer);
+    Writer.EnterSubblock(8, 3);
+    BitCodeAbbrev *Abbrev = new BitCodeAbbrev();
+    Abbrev->Add(BitCodeAbbrevOp(1));
+    Abbrev->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Blob));
+    unsigned AbbrevID = Writer.EmitAbbrev(Abbrev);
+    unsigned Record[] = {1};
+    Writer.EmitRecordWithBlob(AbbrevID, Record, BlobIn);
+    Writer.ExitBlock();
+  }
+
+  const uint8_t *Start = (const uint8_t *)Buffer.data();
+  BitstreamReader Reader(Start, Start + Buffer.size());
+  BitstreamCursor Cursor(Reader);
+  BitstreamEntry Entry = Cursor.advance();
+  ASSERT_EQ(BitstreamEntry::SubBlock, Entry.Kind);
+  ASSERT_EQ(8U, Entry.ID);
+  ASSERT_FALSE(Cursor.EnterSubBlock(8));
+  Entry = Cursor.advance();
+  ASSERT_EQ(BitstreamEntry::Record, Entry.Kind);
+
+  SmallVector<uint64_t, 1> Vals;
+  StringRef BlobOut;
+  EXPECT_EQ(1U, Cursor.readRecord(Entry.ID, Vals, &BlobOut));
+  EXPECT_TRUE(Vals.empty());
+  EXPECT_EQ(BlobIn, BlobOut);
+  EXPECT_TRUE(BlobOut.data() >= Buffer.data() &&
+              BlobOut.data() + BlobOut.size() <= Buffer.data() + Buffer.size());
+  EXPECT_EQ(BitstreamEntry::EndBlock, Cursor.advance().Kind);
+}
+
 } // end anonymous namespace
@@ -0,0 +1,395 @@
+//===- llvm/unittest/DebugInfo/DWARFContextTest.cpp -----------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/DebugInfo/DWARF/DWARFContext.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Support/Compression.h"
+#include "llvm/Support/Dwarf.h"
+#include "llvm/Support/ELF.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+#include <chrono>
+using namespace llvm;
+using namespace dwarf;
+
+namespace {
+
+/// DWARF for a synthetic program of NumUnits compile units, each with
+/// NumFunctions subprograms of 16 bytes and a line table row per function.
+struct SyntheticDWARF {
+  std::string Abbrev, Info, Line;
+
+  static uint64_t functionAddress(unsigned Unit, unsigned Function,
+                                  unsigned NumFunctions) {
+    return 0x1000 + (uint64_t(Unit) * NumFunctions + Function) * 16;
+  }
+
+  SyntheticDWARF(unsigned NumUnits, unsigned NumFunctions) {
+    static const uint8_t AbbrevBytes[] = {
+        1, DW_TAG_compile_unit, DW_CHILDREN_yes, DW_AT_name, DW_FORM_string,
+        DW_AT_stmt_list, DW_FORM_data4, DW_AT_low_pc, DW_FORM_addr,
+        DW_AT_high_pc, DW_FORM_addr, 0, 0,
+        2, DW_TAG_subprogram, DW_CHILDREN_no, DW_AT_name, DW_FORM_string,
+        DW_AT_low_pc, DW_FORM_addr, DW_AT_high_pc, DW_FORM_addr, 0, 0, 0};
+    Abbrev.assign(std::begin(AbbrevBytes), std::end(AbbrevBytes));
+
+    raw_string_ostream InfoOS(Info), LineOS(Line);
+    support::endian::Writer<support::little> InfoW(InfoOS), LineW(LineOS);
+    for (unsigned U = 0; U != NumUnits; ++U) {
+      uint64_t LowPC = functionAddress(U, 0, NumFunctions);
+      uint64_t HighPC = functionAddress(U + 1, 0, NumFunctions);
+
+      std::string Body;
+      raw_string_ostream BodyOS(Body);
+      support::endian::Writer<support::little> BodyW(BodyOS);
+      BodyW.write<uint16_t>(4);      // Version
+      BodyW.write<uint32_t>(0);      // Abbreviation offset
+      BodyW.write<uint8_t>(8);       // Address size
+      BodyW.write<uint8_t>(1);
+      BodyOS << "unit" << U << '\0';
+      BodyW.write<uint32_t>(LineOS.tell());
+      BodyW.write<uint64_t>(LowPC);
+      BodyW.write<uint64_t>(HighPC);
+      for (unsigned F = 0; F != NumFunctions; ++F) {
+        BodyW.write<uint8_t>(2);
+        BodyOS << "function" << U << '_' << F << '\0';
+        BodyW.write<uint64_t>(functionAddress(U, F, NumFunctions));
+        BodyW.write<uint64_t>(functionAddress(U, F, NumFunctions) + 16);
+      }
+      BodyW.write<uint8_t>(0);
+      BodyOS.flush();
+      InfoW.write<uint32_t>(Body.size());
+      InfoOS << Body;
+
+      // A version 2 line table with one file, and a row on line F + 1 at the
+      // start of each function F.
+      static const uint8_t HeaderBytes[] = {
+          1, 1, uint8_t(-5), 14, 13,             // Line program parameters
+          0, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 1,    // Standard opcode lengths
+          0,                                     // No include directories
+          'u', 'n', 'i', 't', '.', 'c', 0, 0, 0, 0,
+          0};                                    // End of file names
+      std::string Header(std::begin(HeaderBytes), std::end(HeaderBytes));
+      std::string Program;
+      raw_string_ostream ProgramOS(Program);
+      support::endian::Writer<support::little> ProgramW(ProgramOS);
+      ProgramOS << '\0' << '\x09' << char(DW_LNE_set_address);
+      ProgramW.write<uint64_t>(LowPC);
+      for (unsigned F = 0; F != NumFunctions; ++F) {
+        if (F != 0) {
+          ProgramOS << char(DW_LNS_advance_pc);
+          encodeULEB128(16, ProgramOS);
+          ProgramOS << char(DW_LNS_advance_line);
+          encodeSLEB128(1, ProgramOS);
+        }
+        ProgramOS << char(DW_LNS_copy);
+      }
+      ProgramOS << char(DW_LNS_advance_pc);
+      encodeULEB128(16, ProgramOS);
+      ProgramOS << '\0' << '\x01' << char(DW_LNE_end_sequence);
+      ProgramOS.flush();
+      LineW.write<uint32_t>(2 + 4 + Header.size() + Program.size());
+      LineW.write<uint16_t>(2);
+      LineW.write<uint32_t>(Header.size());
+      LineOS << Header << Program;
+    }
+    InfoOS.flush();
+    LineOS.flush();
+  }
+};
+
+/// A DWARFContext over the sections of a SyntheticDWARF.
+class SyntheticDWARFContext : public DWARFContext {
+  DWARFSection InfoSection, LineSection, Empty;
+  StringRef AbbrevSection;
+  TypeSectionMap NoTypes;
+
+public:
+  SyntheticDWARFContext(const SyntheticDWARF &DWARF)
+      : AbbrevSection(DWARF.Abbrev) {
+    InfoSection.Data = DWARF.Info;
+    LineSection.Data = DWARF.Line;
+  }
+
+  bool isLittleEndian() const override { return true; }
+  uint8_t getAddressSize() const override { return 8; }
+  const DWARFSection &getInfoSection() override { return InfoSection; }
+  const TypeSectionMap &getTypesSections() override { return NoTypes; }
+  StringRef getAbbrevSection() override { return AbbrevSection; }
+  const DWARFSection &getLocSection() override { return Empty; }
+  StringRef getARangeSection() override { return StringRef(); }
+  StringRef getDebugFrameSection() override { return StringRef(); }
+  const DWARFSection &getLineSection() override { return LineSection; }
+  StringRef getStringSection() override { return StringRef(); }
+  StringRef getRangeSection() override { return StringRef(); }
+  StringRef getPubNamesSection() override { return StringRef(); }
+  StringRef getPubTypesSection() override { return StringRef(); }
+  StringRef getGnuPubNamesSection() override { return StringRef(); }
+  StringRef getGnuPubTypesSection() override { return StringRef(); }
+  const DWARFSection &getInfoDWOSection() override { return Empty; }
+  const TypeSectionMap &getTypesDWOSections() override { return NoTypes; }
+  StringRef getAbbrevDWOSection() override { return StringRef(); }
+  const DWARFSection &getLineDWOSection() override { return Empty; }
+  const DWARFSection &getLocDWOSection() override { return Empty; }
+  StringRef getStringDWOSection() override { return StringRef(); }
+  StringRef getStringOffsetDWOSection() override { return StringRef(); }
+  StringRef getRangeDWOSection() override { return StringRef(); }
+  StringRef getAddrSection() override { return StringRef(); }
+  const DWARFSection &getAppleNamesSection() override { return Empty; }
+  const DWARFSection &getAppleTypesSection() override { return Empty; }
+  const DWARFSection &getAppleNamespacesSection() override { return Empty; }
+  const DWARFSection &getAppleObjCSection() override { return Empty; }
+};
+
+/// A little-endian ELF64 relocatable object with a zlib-compressed .zdebug_*
+/// section for each of \p Sections, given by name without the "debug_"
+/// prefix.
+std::string
+compressedObject(ArrayRef<std::pair<StringRef, StringRef>> Sections) {
+  std::string Contents, Names(1, '\0');
+  raw_string_ostream ContentsOS(Contents);
+  support::endian::Writer<support::little> ContentsW(ContentsOS);
+  struct Header {
+    uint32_t Name;
+    uint64_t Offset, Size;
+  };
+  std::vector<Header> Headers;
+  for (const auto &Section : Sections) {
+    SmallString<128> Compressed;
+    if (zlib::compress(Section.second, Compressed) != zlib::StatusOK)
+      return std::string();
+    Headers.push_back({uint32_t(Names.size()), 64 + ContentsOS.tell(),
+                       12 + Compressed.size()});
+    Names += ".zdebug_" + Section.first.str() + '\0';
+    ContentsOS << "ZLIB";
+    support::endian::Writer<support::big>(ContentsOS)
+        .write<uint64_t>(Section.second.size());
+    ContentsOS << Compressed;
+  }
+  Headers.push_back({uint32_t(Names.size()), 64 + ContentsOS.tell(),
+                     sizeof(".shstrtab") + Names.size()});
+  Names += ".shstrtab";
+  Names += '\0';
+  ContentsOS << Names;
+  while (ContentsOS.tell() % 8)
+    ContentsOS << '\0';
+  uint64_t SectionHeadersOffset = 64 + ContentsOS.tell();
+
+  // The null section, then the sections above.
+  ContentsOS << std::string(64, '\0');
+  for (const Header &H : Headers) {
+    bool IsNames = &H == &Headers.back();
+    ContentsW.write<uint32_t>(H.Name);
+    ContentsW.write<uint32_t>(IsNames ? ELF::SHT_STRTAB : ELF::SHT_PROGBITS);
+    ContentsW.write<uint64_t>(0);        // Flags
+    ContentsW.write<uint64_t>(0);        // Address
+    ContentsW.write<uint64_t>(H.Offset);
+    ContentsW.write<uint64_t>(H.Size);
+    ContentsW.write<uint32_t>(0);        // Link
+    ContentsW.write<uint32_t>(0);        // Info
+    ContentsW.write<uint64_t>(1);        // Alignment
+    ContentsW.write<uint64_t>(0);        // Entry size
+  }
+  ContentsOS.flush();
+
+  std::string Object;
+  raw_string_ostream ObjectOS(Object);
+  support::endian::Writer<support::little> ObjectW(ObjectOS);
+  ObjectOS << ELF::ElfMagic << char(ELF::ELFCLASS64) << char(ELF::ELFDATA2LSB)
+           << char(ELF::EV_CURRENT) << std::string(9, '\0');
+  ObjectW.write<uint16_t>(ELF::ET_REL);
+  ObjectW.write<uint16_t>(ELF::EM_X86_64);
+  ObjectW.write<uint32_t>(ELF::EV_CURRENT);
+  ObjectW.write<uint64_t>(0);            // Entry point
+  ObjectW.write<uint64_t>(0);            // Program headers
+  ObjectW.write<uint64_t>(SectionHeadersOffset);
+  ObjectW.write<uint32_t>(0);            // Flags
+  ObjectW.write<uint16_t>(64);           // ELF header size
+  ObjectW.write<uint16_t>(0);            // Program header size
+  ObjectW.write<uint16_t>(0);            // Number of program headers
+  ObjectW.write<uint16_t>(64);           // Section header size
+  ObjectW.write<uint16_t>(Headers.size() + 1);
+  ObjectW.write<uint16_t>(Headers.size()); // Section names section
+  ObjectOS << Contents;
+  ObjectOS.flush();
+  return Object;
+}
+
+DILineInfoSpecifier lineAndFunction() {
+  return DILineInfoSpecifier(DILineInfoSpecifier::FileLineInfoKind::Default,
+                             DINameKind::ShortName);
+}
+
+TEST(DWARFContextTest, ExtractInParallel) {
+  const unsigned NumUnits = 20, NumFunctions = 30;
+  SyntheticDWARF DWARF(NumUnits, NumFunctions);
+  SyntheticDWARFContext Serial(DWARF), Parallel(DWARF);
+  Parallel.extractCompileUnitsInParallel(4);
+  ASSERT_EQ(NumUnits, Parallel.getNumCompileUnits());
+  EXPECT_LT(0U, Parallel.getDIEMemoryUsage());
+
+  for (unsigned U = 0; U != NumUnits; ++U) {
+    DWARFCompileUnit *SerialCU = Serial.getCompileUnitAtIndex(U);
+    DWARFCompileUnit *ParallelCU = Parallel.getCompileUnitAtIndex(U);
+    // The parallel context needs no more parsing.
+    size_t Usage = Parallel.getDIEMemoryUsage();
+    ASSERT_EQ(NumFunctions + 2, ParallelCU->getNumDIEs());
+    EXPECT_EQ(Usage, Parallel.getDIEMemoryUsage());
+    ASSERT_EQ(SerialCU->getNumDIEs(), ParallelCU->getNumDIEs());
+    for (unsigned I = 0, E = SerialCU->getNumDIEs(); I != E; ++I)
+      EXPECT_EQ(SerialCU->getDIEAtIndex(I)->getOffset(),
+                ParallelCU->getDIEAtIndex(I)->getOffset());
+
+    const DWARFDebugLine::LineTable *LT = Parallel.getLineTableForUnit(
+        ParallelCU);
+    ASSERT_TRUE(LT != nullptr);
+    EXPECT_EQ(NumFunctions + 1, LT->Rows.size());
+  }
+
+  for (unsigned U = 0; U != NumUnits; ++U)
+    for (unsigned F = 0; F < NumFunctions; F += 7) {
+      uint64_t Address =
+          SyntheticDWARF::functionAddress(U, F, NumFunctions) + 4;
+      DILineInfo Expected =
+          Serial.getLineInfoForAddress(Address, lineAndFunction());
+      DILineInfo Actual =
+          Parallel.getLineInfoForAddress(Address, lineAndFunction());
+      EXPECT_EQ(Expected, Actual);
+      EXPECT_EQ(F + 1, Actual.Line);
+      EXPECT_EQ("function" + std::to_string(U) + "_" + std::to_string(F),
+                Actual.FunctionName);
+    }
+}
+
+TEST(DWARFContextTest, DIEMemoryLimit) {
+  const unsigned NumUnits = 8, NumFunctions = 50;
+  SyntheticDWARF DWARF(NumUnits, NumFunctions);
+  SyntheticDWARFContext Context(DWARF);
+
+  // Find out the memory used by one unit.
+  Context.getCompileUnitAtIndex(0)->getNumDIEs();
+  uint64_t UnitUsage = Context.getDIEMemoryUsage();
+  Context.getCompileUnitAtIndex(0)->releaseDIEs();
+  uint64_t Baseline = Context.getDIEMemoryUsage();
+  ASSERT_LT(Baseline, UnitUsage);
+
+  // Room for the DIEs of two units.
+  Context.setDIEMemoryLimit(2 * UnitUsage);
+  for (unsigned Round = 0; Round != 2; ++Round)
+    for (unsigned U = 0; U != NumUnits; ++U) {
+      uint64_t Address = SyntheticDWARF::functionAddress(U, U, NumFunctions);
+      DILineInfo Info = Context.getLineInfoForAddress(Address,
+                                                      lineAndFunction());
+      EXPECT_EQ(U + 1, Info.Line);
+      EXPECT_EQ("function" + std::to_string(U) + "_" + std::to_string(U),
+                Info.FunctionName);
+      // The query may parse one unit more than the limit allows; the next
+      // one releases it.
+      EXPECT_GE(3 * UnitUsage, Context.getDIEMemoryUsage());
+      if (U >= 3) {
+        // The least recently used units were released.
+        EXPECT_EQ(sizeof(DWARFDebugInfoEntryMinimal),
+                  Context.getCompileUnitAtIndex(U - 3)->getDIEMemoryUsage());
+        EXPECT_LT(sizeof(DWARFDebugInfoEntryMinimal),
+                  Context.getCompileUnitAtIndex(U - 1)->getDIEMemoryUsage());
+      }
+    }
+
+  // Parsing ahead stops at the limit, except for the unit DIEs, which are
+  // needed to find the line tables.
+  SyntheticDWARFContext Limited(DWARF);
+  Limited.setDIEMemoryLimit(2 * UnitUsage);
+  Limited.extractCompileUnitsInParallel(2);
+  EXPECT_GE(2 * UnitUsage + NumUnits * Baseline, Limited.getDIEMemoryUsage());
+  EXPECT_LT(sizeof(DWARFDebugInfoEntryMinimal),
+            Limited.getCompileUnitAtIndex(0)->getDIEMemoryUsage());
+  EXPECT_EQ(sizeof(DWARFDebugInfoEntryMinimal),
+            Limited.getCompileUnitAtIndex(NumUnits - 1)->getDIEMemoryUsage());
+}
+
+TEST(DWARFContextTest, CompressedSections) {
+  if (!zlib::isAvailable())
+    return;
+  const unsigned NumUnits = 4, NumFunctions = 10;
+  SyntheticDWARF DWARF(NumUnits, NumFunctions);
+  std::pair<StringRef, StringRef> Sections[] = {
+      {"abbrev", DWARF.Abbrev}, {"info", DWARF.Info}, {"line", DWARF.Line}};
+  std::string Object = compressedObject(Sections);
+  auto Obj = object::ObjectFile::createObjectFile(
+      MemoryBufferRef(Object, "compressed.o"));
+  ASSERT_TRUE(bool(Obj));
+
+  // Nothing is decompressed or parsed up front.
+  DWARFContextInMemory Context(**Obj);
+  EXPECT_EQ(0U, Context.getUncompressedSectionsSize());
+  EXPECT_EQ(0U, Context.getDIEMemoryUsage());
+
+  // Finding the units decompresses .debug_info and .debug_abbrev only, and
+  // parses no DIEs until a unit's DIEs are asked for.
+  ASSERT_EQ(NumUnits, Context.getNumCompileUnits());
+  EXPECT_EQ(DWARF.Info.size() + DWARF.Abbrev.size(),
+            Context.getUncompressedSectionsSize());
+  DWARFCompileUnit *CU = Context.getCompileUnitAtIndex(2);
+  EXPECT_EQ(0U, CU->getDIEMemoryUsage());
+  ASSERT_EQ(NumFunctions + 2, CU->getNumDIEs());
+  EXPECT_EQ(CU->getDIEMemoryUsage(), Context.getDIEMemoryUsage());
+  EXPECT_EQ(0U, Context.getCompileUnitAtIndex(1)->getDIEMemoryUsage());
+
+  // The line table is decompressed when it is first needed, and only once.
+  DILineInfo Info = Context.getLineInfoForAddress(
+      SyntheticDWARF::functionAddress(2, 3, NumFunctions), lineAndFunction());
+  EXPECT_EQ(4U, Info.Line);
+  EXPECT_EQ("function2_3", Info.FunctionName);
+  uint64_t Total = DWARF.Info.size() + DWARF.Abbrev.size() + DWARF.Line.size();
+  EXPECT_EQ(Total, Context.getUncompressedSectionsSize());
+  Context.getLineInfoForAddress(
+      SyntheticDWARF::functionAddress(3, 0, NumFunctions), lineAndFunction());
+  EXPECT_EQ(Total, Context.getUncompressedSectionsSize());
+
+  // Parsing ahead decompresses all the sections at once.
+  DWARFContextInMemory Parallel(**Obj);
+  Parallel.extractCompileUnitsInParallel(2);
+  EXPECT_EQ(Total, Parallel.getUncompressedSectionsSize());
+  EXPECT_EQ(NumFunctions + 2,
+            Parallel.getCompileUnitAtIndex(NumUnits - 1)->getNumDIEs());
+}
+
+// Benchmark for parsing the DIEs and line tables of a large synthetic file,
+// serially and in parallel.  It is disabled by default; run it with
+// --gtest_also_run_disabled_tests.
+TEST(DWARFContextTest, DISABLED_ParseBenchmark) {
+  const unsigned NumUnits = 1000, NumFunctions = 1000;
+  SyntheticDWARF DWARF(NumUnits, NumFunctions);
+  typedef std::chrono::milliseconds ms;
+
+  auto Start = std::chrono::steady_clock::now();
+  SyntheticDWARFContext Serial(DWARF);
+  for (const auto &CU : Serial.compile_units()) {
+    CU->getNumDIEs();
+    Serial.getLineTableForUnit(CU.get());
+  }
+  auto SerialMs = std::chrono::duration_cast<ms>(
+                      std::chrono::steady_clock::now() - Start).count();
+
+  Start = std::chrono::steady_clock::now();
+  SyntheticDWARFContext Parallel(DWARF);
+  Parallel.extractCompileUnitsInParallel();
+  auto ParallelMs = std::chrono::duration_cast<ms>(
+                        std::chrono::steady_clock::now() - Start).count();
+
+  EXPECT_EQ(Serial.getDIEMemoryUsage(), Parallel.getDIEMemoryUsage());
+  outs() << ".debug_info: " << DWARF.Info.size() / (1 << 20) << " MiB\n"
+         << "serial:      " << SerialMs << " ms\n"
+         << "parallel:    " << ParallelMs << " ms\n";
+}
+
+} // end anonymous namespace
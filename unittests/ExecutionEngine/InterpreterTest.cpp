@@ -0,0 +1,258 @@
+//===- InterpreterTest.cpp - Unit tests for the IR interpreter ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ExecutionEngine/Interpreter.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/ExecutionEngine/GenericValue.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+#include <chrono>
+
+using namespace llvm;
+
+namespace {
+
+class InterpreterTest : public testing::Test {
+protected:
+  void parse(const char *Assembly) {
+    SMDiagnostic Error;
+    std::unique_ptr<Module> Owner = parseAssemblyString(Assembly, Error, Ctx);
+    std::string ErrMsg;
+    raw_string_ostream OS(ErrMsg);
+    Error.print("", OS);
+    ASSERT_TRUE(Owner != nullptr) << OS.str();
+    M = Owner.get();
+    Engine.reset(EngineBuilder(std::move(Owner))
+                     .setEngineKind(EngineKind::Interpreter)
+                     .setErrorStr(&ErrMsg)
+                     .create());
+    ASSERT_TRUE(Engine != nullptr) << ErrMsg;
+  }
+
+  uint64_t run(StringRef Name, ArrayRef<uint64_t> Args) {
+    Function *F = M->getFunction(Name);
+    std::vector<GenericValue> ArgValues;
+    for (unsigned i = 0, e = Args.size(); i != e; ++i) {
+      GenericValue GV;
+      GV.IntVal = APInt(F->getFunctionType()->getParamType(i)
+                            ->getIntegerBitWidth(), Args[i]);
+      ArgValues.push_back(GV);
+    }
+    return Engine->runFunction(F, ArgValues).IntVal.getZExtValue();
+  }
+
+  LLVMContext Ctx;
+  Module *M; // Owned by the ExecutionEngine.
+  std::unique_ptr<ExecutionEngine> Engine;
+};
+
+const char FibAssembly[] =
+    "define i32 @fib(i32 %n) {\n"
+    "entry:\n"
+    "  %small = icmp slt i32 %n, 2\n"
+    "  br i1 %small, label %done, label %recurse\n"
+    "recurse:\n"
+    "  %n1 = sub i32 %n, 1\n"
+    "  %f1 = call i32 @fib(i32 %n1)\n"
+    "  %n2 = sub i32 %n, 2\n"
+    "  %f2 = call i32 @fib(i32 %n2)\n"
+    "  %sum = add i32 %f1, %f2\n"
+    "  ret i32 %sum\n"
+    "done:\n"
+    "  ret i32 %n\n"
+    "}\n";
+
+const char SieveAssembly[] =
+    "define i32 @sieve(i32 %n) {\n"
+    "entry:\n"
+    "  %flags = alloca i8, i32 %n\n"
+    "  br label %init\n"
+    "init:\n"
+    "  %i = phi i32 [ 0, %entry ], [ %i.next, %init ]\n"
+    "  %p = getelementptr i8, i8* %flags, i32 %i\n"
+    "  store i8 1, i8* %p\n"
+    "  %i.next = add i32 %i, 1\n"
+    "  %init.done = icmp eq i32 %i.next, %n\n"
+    "  br i1 %init.done, label %outer, label %init\n"
+    "outer:\n"
+    "  %k = phi i32 [ 2, %init ], [ %k.next, %outer.latch ]\n"
+    "  %count = phi i32 [ 0, %init ], [ %count.next, %outer.latch ]\n"
+    "  %kp = getelementptr i8, i8* %flags, i32 %k\n"
+    "  %flag = load i8, i8* %kp\n"
+    "  %prime = icmp ne i8 %flag, 0\n"
+    "  %inc = zext i1 %prime to i32\n"
+    "  %count.next = add i32 %count, %inc\n"
+    "  br i1 %prime, label %strike, label %outer.latch\n"
+    "strike:\n"
+    "  %m = phi i32 [ %k, %outer ], [ %m.next, %strike ]\n"
+    "  %mp = getelementptr i8, i8* %flags, i32 %m\n"
+    "  store i8 0, i8* %mp\n"
+    "  %m.next = add i32 %m, %k\n"
+    "  %strike.done = icmp uge i32 %m.next, %n\n"
+    "  br i1 %strike.done, label %outer.latch, label %strike\n"
+    "outer.latch:\n"
+    "  %k.next = add i32 %k, 1\n"
+    "  %outer.done = icmp eq i32 %k.next, %n\n"
+    "  br i1 %outer.done, label %exit, label %outer\n"
+    "exit:\n"
+    "  ret i32 %count.next\n"
+    "}\n";
+
+TEST_F(InterpreterTest, Recursion) {
+  parse(FibAssembly);
+  EXPECT_EQ(6765u, run("fib", 20));
+}
+
+TEST_F(InterpreterTest, MemoryAndLoops) {
+  parse(SieveAssembly);
+  EXPECT_EQ(25u, run("sieve", 100));
+  EXPECT_EQ(168u, run("sieve", 1000));
+}
+
+// The PHI nodes of a block are evaluated as a group, so swapping values
+// through them must not see half-updated inputs.
+TEST_F(InterpreterTest, PHISwap) {
+  parse("define i32 @swap(i32 %n) {\n"
+        "entry:\n"
+        "  br label %loop\n"
+        "loop:\n"
+        "  %a = phi i32 [ 1, %entry ], [ %b, %loop ]\n"
+        "  %b = phi i32 [ 2, %entry ], [ %a, %loop ]\n"
+        "  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]\n"
+        "  %i.next = add i32 %i, 1\n"
+        "  %done = icmp eq i32 %i.next, %n\n"
+        "  br i1 %done, label %exit, label %loop\n"
+        "exit:\n"
+        "  %r = mul i32 %a, 10\n"
+        "  %s = add i32 %r, %b\n"
+        "  ret i32 %s\n"
+        "}\n");
+  EXPECT_EQ(21u, run("swap", 2));
+  EXPECT_EQ(12u, run("swap", 3));
+}
+
+TEST_F(InterpreterTest, ScalarOperations) {
+  parse("%pair = type { i16, i64 }\n"
+        "@g = global %pair { i16 3, i64 -7 }\n"
+        "define i64 @ops(i64 %x) {\n"
+        "  %p = getelementptr %pair, %pair* @g, i32 0, i32 1\n"
+        "  %v = load i64, i64* %p\n"
+        "  %q = sdiv i64 %v, 2\n"
+        "  %r = srem i64 %x, 5\n"
+        "  %s = shl i64 %r, 4\n"
+        "  %t = ashr i64 %q, 1\n"
+        "  %u = xor i64 %s, %t\n"
+        "  %w = trunc i64 %u to i8\n"
+        "  %neg = icmp slt i8 %w, 0\n"
+        "  %z = sext i8 %w to i64\n"
+        "  %sel = select i1 %neg, i64 %z, i64 %u\n"
+        "  store i64 %sel, i64* %p\n"
+        "  ret i64 %sel\n"
+        "}\n");
+  // (-7 sdiv 2) = -3, ashr 1 = -2; (13 srem 5) << 4 = 48; 48 ^ -2 = -50.
+  EXPECT_EQ(uint64_t(-50), run("ops", 13));
+  // The stored value feeds the next run: -25 ashr 1 = -13; -13 ^ 48 = -61.
+  EXPECT_EQ(uint64_t(-61), run("ops", 13));
+}
+
+// Unknown intrinsics are lowered into regular IR the first time they are
+// executed.  This must work even while other activations of the same function
+// are waiting to resume at the lowered call.
+TEST_F(InterpreterTest, IntrinsicLoweringDuringRecursion) {
+  parse("declare i32 @llvm.ctpop.i32(i32)\n"
+        "define i32 @bits(i32 %n) {\n"
+        "entry:\n"
+        "  %zero = icmp eq i32 %n, 0\n"
+        "  br i1 %zero, label %done, label %recurse\n"
+        "recurse:\n"
+        "  %n1 = sub i32 %n, 1\n"
+        "  %r = call i32 @bits(i32 %n1)\n"
+        "  %c = call i32 @llvm.ctpop.i32(i32 %n)\n"
+        "  %sum = add i32 %r, %c\n"
+        "  ret i32 %sum\n"
+        "done:\n"
+        "  ret i32 0\n"
+        "}\n");
+  // Total number of set bits in 1..16.
+  EXPECT_EQ(33u, run("bits", 16));
+  EXPECT_EQ(33u, run("bits", 16));
+}
+
+TEST_F(InterpreterTest, ExternalFunctions) {
+  parse("@fmt = private constant [6 x i8] c\"%d-%d\\00\"\n"
+        "declare i32 @sprintf(i8*, i8*, ...)\n"
+        "define i32 @format(i32 %x) {\n"
+        "  %buf = alloca [16 x i8]\n"
+        "  %b = getelementptr [16 x i8], [16 x i8]* %buf, i32 0, i32 0\n"
+        "  %f = getelementptr [6 x i8], [6 x i8]* @fmt, i32 0, i32 0\n"
+        "  %y = mul i32 %x, 3\n"
+        "  call i32 (i8*, i8*, ...) @sprintf(i8* %b, i8* %f,"
+        " i32 %x, i32 %y)\n"
+        "  %p2 = getelementptr i8, i8* %b, i32 2\n"
+        "  %c2 = load i8, i8* %p2\n"
+        "  %p5 = getelementptr i8, i8* %b, i32 5\n"
+        "  %c5 = load i8, i8* %p5\n"
+        "  %hi = zext i8 %c2 to i32\n"
+        "  %lo = zext i8 %c5 to i32\n"
+        "  %r = shl i32 %hi, 8\n"
+        "  %s = or i32 %r, %lo\n"
+        "  ret i32 %s\n"
+        "}\n");
+  // The buffer holds "42-126".
+  EXPECT_EQ(unsigned('-') << 8 | '6', run("format", 42));
+}
+
+// Benchmarks for the dispatch loop.  They are disabled by default; run them
+// with --gtest_also_run_disabled_tests.
+static void reportBenchmark(StringRef Name,
+                            std::chrono::steady_clock::duration Time) {
+  typedef std::chrono::microseconds us;
+  outs() << Name << ": " << std::chrono::duration_cast<us>(Time).count()
+         << " us\n";
+}
+
+TEST_F(InterpreterTest, DISABLED_FibBenchmark) {
+  parse(FibAssembly);
+  auto Start = std::chrono::steady_clock::now();
+  EXPECT_EQ(75025u, run("fib", 25));
+  reportBenchmark("fib(25)", std::chrono::steady_clock::now() - Start);
+}
+
+TEST_F(InterpreterTest, DISABLED_SieveBenchmark) {
+  parse(SieveAssembly);
+  auto Start = std::chrono::steady_clock::now();
+  EXPECT_EQ(78498u, run("sieve", 1000000));
+  reportBenchmark("sieve(1000000)", std::chrono::steady_clock::now() - Start);
+}
+
+TEST_F(InterpreterTest, DISABLED_LoopBenchmark) {
+  parse("define i64 @loop(i64 %n) {\n"
+        "entry:\n"
+        "  br label %loop\n"
+        "loop:\n"
+        "  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]\n"
+        "  %acc = phi i64 [ 0, %entry ], [ %acc.next, %loop ]\n"
+        "  %sq = mul i64 %i, %i\n"
+        "  %m = and i64 %sq, 255\n"
+        "  %acc.next = add i64 %acc, %m\n"
+        "  %i.next = add i64 %i, 1\n"
+        "  %done = icmp eq i64 %i.next, %n\n"
+        "  br i1 %done, label %exit, label %loop\n"
+        "exit:\n"
+        "  ret i64 %acc.next\n"
+        "}\n");
+  auto Start = std::chrono::steady_clock::now();
+  run("loop", 5000000);
+  reportBenchmark("loop(5000000)", std::chrono::steady_clock::now() - Start);
+}
+
+} // end anonymous namespace
@@ -0,0 +1,299 @@
+//===- MCJITSlabMemoryManagerTest.cpp - Tests for the slab memory manager -===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ExecutionEngine/SlabMemoryManager.h"
+#include "MCJITTestBase.h"
+#include "llvm/ExecutionEngine/MCJIT.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <deque>
+#include <random>
+
+using namespace llvm;
+
+namespace {
+
+const size_t TestSlabSize = 64 * 1024;
+
+TEST(SlabMemoryManagerTest, BasicAllocations) {
+  SlabMemoryPool Pool(TestSlabSize);
+  SlabMemoryManager MemMgr(Pool);
+
+  uint8_t *code1 = MemMgr.allocateCodeSection(256, 0, 1, "");
+  uint8_t *data1 = MemMgr.allocateDataSection(256, 0, 2, "", true);
+  uint8_t *code2 = MemMgr.allocateCodeSection(256, 0, 3, "");
+  uint8_t *data2 = MemMgr.allocateDataSection(256, 0, 4, "", false);
+
+  EXPECT_NE((uint8_t*)nullptr, code1);
+  EXPECT_NE((uint8_t*)nullptr, code2);
+  EXPECT_NE((uint8_t*)nullptr, data1);
+  EXPECT_NE((uint8_t*)nullptr, data2);
+
+  for (unsigned i = 0; i < 256; ++i) {
+    code1[i] = 1;
+    code2[i] = 2;
+    data1[i] = 3;
+    data2[i] = 4;
+  }
+
+  // Verify the data (this is checking for overlaps in the addresses)
+  for (unsigned i = 0; i < 256; ++i) {
+    EXPECT_EQ(1, code1[i]);
+    EXPECT_EQ(2, code2[i]);
+    EXPECT_EQ(3, data1[i]);
+    EXPECT_EQ(4, data2[i]);
+  }
+
+  std::string Error;
+  EXPECT_FALSE(MemMgr.finalizeMemory(&Error));
+
+  SlabMemoryPool::Statistics Stats = Pool.getStatistics();
+  EXPECT_EQ(4U, Stats.NumAllocations);
+  EXPECT_EQ(4U * 256, Stats.BytesRequested);
+  EXPECT_EQ(0U, Stats.NumLargeBlocks);
+}
+
+TEST(SlabMemoryManagerTest, CodeIsVisibleFromExecAddress) {
+  SlabMemoryPool Pool(TestSlabSize);
+  std::error_code EC;
+  SlabMemoryPool::Block B =
+      Pool.allocate(SlabMemoryPool::MemoryKind::Code, 64, 16, EC);
+  ASSERT_FALSE(EC);
+  if (Pool.isCodeDualMapped())
+    EXPECT_NE(B.Address, B.ExecAddress);
+  else
+    EXPECT_EQ(B.Address, B.ExecAddress);
+
+  for (unsigned i = 0; i < 64; ++i)
+    B.Address[i] = i;
+  EXPECT_FALSE(Pool.makeExecutable(B));
+  for (unsigned i = 0; i < 64; ++i)
+    EXPECT_EQ(i, B.ExecAddress[i]);
+  Pool.deallocate(B);
+}
+
+TEST(SlabMemoryManagerTest, Alignment) {
+  SlabMemoryPool Pool(TestSlabSize);
+  SlabMemoryManager MemMgr(Pool);
+  size_t PageSize = sys::Process::getPageSize();
+
+  for (unsigned Alignment = 1; Alignment <= 4 * PageSize; Alignment *= 2) {
+    uint8_t *Code = MemMgr.allocateCodeSection(3, Alignment, 0, "");
+    uint8_t *Data = MemMgr.allocateDataSection(3, Alignment, 0, "", false);
+    ASSERT_NE((uint8_t*)nullptr, Code);
+    ASSERT_NE((uint8_t*)nullptr, Data);
+    EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(Code) % Alignment);
+    EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(Data) % Alignment);
+  }
+}
+
+TEST(SlabMemoryManagerTest, ReclaimsMemoryOfDestroyedManagers) {
+  SlabMemoryPool Pool(TestSlabSize);
+
+  std::unique_ptr<SlabMemoryManager> MemMgr(new SlabMemoryManager(Pool));
+  for (unsigned i = 0; i < 100; ++i) {
+    EXPECT_NE((uint8_t*)nullptr, MemMgr->allocateCodeSection(100, 0, i, ""));
+    EXPECT_NE((uint8_t*)nullptr,
+              MemMgr->allocateDataSection(100, 0, i, "", false));
+  }
+  EXPECT_FALSE(MemMgr->finalizeMemory());
+  SlabMemoryPool::Statistics Before = Pool.getStatistics();
+  EXPECT_EQ(200U * 100, Before.BytesRequested);
+
+  MemMgr.reset();
+  SlabMemoryPool::Statistics After = Pool.getStatistics();
+  EXPECT_EQ(0U, After.BytesRequested);
+  EXPECT_EQ(0U, After.BytesAllocated);
+
+  // The same allocations from a new manager reuse the freed blocks.
+  MemMgr.reset(new SlabMemoryManager(Pool));
+  for (unsigned i = 0; i < 100; ++i) {
+    MemMgr->allocateCodeSection(100, 0, i, "");
+    MemMgr->allocateDataSection(100, 0, i, "", false);
+  }
+  EXPECT_EQ(Before.BytesMapped, Pool.getStatistics().BytesMapped);
+}
+
+TEST(SlabMemoryManagerTest, ReleasesEmptySlabs) {
+  SlabMemoryPool Pool(TestSlabSize);
+  std::vector<SlabMemoryPool::Block> Blocks;
+  std::error_code EC;
+
+  // Enough 1K blocks to fill several slabs.
+  for (unsigned i = 0; i < 4 * TestSlabSize / 1024; ++i) {
+    Blocks.push_back(
+        Pool.allocate(SlabMemoryPool::MemoryKind::Data, 1024, 16, EC));
+    ASSERT_FALSE(EC);
+  }
+  EXPECT_EQ(4U, Pool.getStatistics().NumSlabs);
+
+  for (const SlabMemoryPool::Block &B : Blocks)
+    Pool.deallocate(B);
+  SlabMemoryPool::Statistics Stats = Pool.getStatistics();
+  EXPECT_EQ(1U, Stats.NumSlabs);
+  EXPECT_EQ(TestSlabSize, Stats.BytesMapped);
+}
+
+TEST(SlabMemoryManagerTest, LargeAllocations) {
+  SlabMemoryPool Pool(TestSlabSize);
+  {
+    SlabMemoryManager MemMgr(Pool);
+    uint8_t *Code = MemMgr.allocateCodeSection(0x100000, 0, 1, "");
+    uint8_t *Data = MemMgr.allocateDataSection(0x100000, 0, 2, "", false);
+    ASSERT_NE((uint8_t*)nullptr, Code);
+    ASSERT_NE((uint8_t*)nullptr, Data);
+    for (unsigned i = 0; i < 0x100000; ++i) {
+      Code[i] = 1;
+      Data[i] = 2;
+    }
+    for (unsigned i = 0; i < 0x100000; ++i) {
+      EXPECT_EQ(1, Code[i]);
+      EXPECT_EQ(2, Data[i]);
+    }
+    EXPECT_FALSE(MemMgr.finalizeMemory());
+    EXPECT_EQ(2U, Pool.getStatistics().NumLargeBlocks);
+  }
+  SlabMemoryPool::Statistics Stats = Pool.getStatistics();
+  EXPECT_EQ(0U, Stats.NumLargeBlocks);
+  EXPECT_EQ(0U, Stats.BytesMapped);
+}
+
+TEST(SlabMemoryManagerTest, SingleMappedCode) {
+  SlabMemoryPool Pool(TestSlabSize, /*DualMapCode=*/false);
+  EXPECT_FALSE(Pool.isCodeDualMapped());
+  size_t PageSize = sys::Process::getPageSize();
+
+  SlabMemoryManager MemMgr(Pool);
+  uint8_t *Code1 = MemMgr.allocateCodeSection(16, 0, 1, "");
+  uint8_t *Code2 = MemMgr.allocateCodeSection(16, 0, 2, "");
+  // Each code block has pages of its own, so that its protections can be
+  // changed independently.
+  EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(Code1) % PageSize);
+  EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(Code2) % PageSize);
+  Code1[0] = 1;
+  Code2[0] = 2;
+  EXPECT_FALSE(MemMgr.finalizeMemory());
+  EXPECT_EQ(1, Code1[0]);
+  EXPECT_EQ(2, Code2[0]);
+
+  // Code allocated after finalization is still writable.
+  uint8_t *Code3 = MemMgr.allocateCodeSection(16, 0, 3, "");
+  Code3[0] = 3;
+  EXPECT_FALSE(MemMgr.finalizeMemory());
+}
+
+class SlabMemoryManagerMCJITTest : public testing::TestWithParam<bool>,
+                                   public MCJITTestBase {
+protected:
+  SlabMemoryManagerMCJITTest() : Pool(TestSlabSize, GetParam()) {
+    M.reset(createEmptyModule("<main>"));
+    MM.reset(new SlabMemoryManager(Pool));
+  }
+
+  ~SlabMemoryManagerMCJITTest() override {
+    // The memory manager must go back to the pool before the pool goes away.
+    TheJIT.reset();
+    MM.reset();
+  }
+
+  SlabMemoryPool Pool;
+};
+
+TEST_P(SlabMemoryManagerMCJITTest, CallFunction) {
+  SKIP_UNSUPPORTED_PLATFORM;
+
+  int32_t InitialValue = 5;
+  GlobalValue *Global =
+      insertGlobalInt32(M.get(), "test_global", InitialValue);
+  Function *F = insertAddFunction(M.get());
+  Function *Caller = startFunction<int32_t(int32_t)>(M.get(), "caller");
+  Value *Arg = &*Caller->arg_begin();
+  Value *Loaded = Builder.CreateLoad(Global);
+  Value *Args[] = {Arg, Loaded};
+  endFunctionWithRet(Caller, Builder.CreateCall(F, Args));
+  createJIT(std::move(M));
+
+  uint64_t CallerPtr = TheJIT->getFunctionAddress("caller");
+  ASSERT_NE(0U, CallerPtr);
+  int32_t (*CallerFn)(int32_t) = (int32_t(*)(int32_t))CallerPtr;
+  EXPECT_EQ(12, CallerFn(7));
+  EXPECT_EQ(-5, CallerFn(-10));
+  EXPECT_NE(0U, Pool.getStatistics().BytesRequested);
+
+  TheJIT.reset();
+  EXPECT_EQ(0U, Pool.getStatistics().BytesRequested);
+}
+
+INSTANTIATE_TEST_CASE_P(DualMapping, SlabMemoryManagerMCJITTest,
+                        testing::Bool());
+
+// Simulates a JIT that keeps a window of live modules and discards the
+// oldest one each time it adds one, and reports allocation throughput and
+// how much of the mapped memory is in use.  Run with
+// --gtest_also_run_disabled_tests.
+TEST(SlabMemoryManagerTest, DISABLED_StressBenchmark) {
+  const unsigned NumModules = 200000;
+  const unsigned LiveModules = 1000;
+  const unsigned SectionsPerModule = 4;
+
+  SlabMemoryPool Pool;
+  std::deque<std::unique_ptr<SlabMemoryManager>> Window;
+  std::mt19937 Rand(0);
+  // Most sections are small, a few are large.
+  std::geometric_distribution<unsigned> SizeDist(1.0 / 256);
+  uint64_t NumSections = 0;
+  double MinUtilization = 1.0;
+
+  auto Start = std::chrono::steady_clock::now();
+  for (unsigned I = 0; I != NumModules; ++I) {
+    std::unique_ptr<SlabMemoryManager> MemMgr(new SlabMemoryManager(Pool));
+    for (unsigned S = 0; S != SectionsPerModule; ++S, ++NumSections) {
+      uintptr_t Size = SizeDist(Rand) + 1;
+      uint8_t *Addr = S % 2 ? MemMgr->allocateDataSection(Size, 16, S, "",
+                                                          false)
+                            : MemMgr->allocateCodeSection(Size, 16, S, "");
+      ASSERT_NE((uint8_t*)nullptr, Addr);
+      Addr[0] = Addr[Size - 1] = 0xcc;
+    }
+    MemMgr->finalizeMemory();
+    Window.push_back(std::move(MemMgr));
+    if (Window.size() > LiveModules)
+      Window.pop_front();
+
+    if (I % 1000 == 0 && I >= LiveModules) {
+      SlabMemoryPool::Statistics Stats = Pool.getStatistics();
+      MinUtilization =
+          std::min(MinUtilization,
+                   double(Stats.BytesRequested) / Stats.BytesMapped);
+    }
+  }
+  std::chrono::duration<double> Elapsed =
+      std::chrono::steady_clock::now() - Start;
+
+  SlabMemoryPool::Statistics Stats = Pool.getStatistics();
+  outs() << "sections:          " << NumSections << "\n"
+         << "sections/s:        " << uint64_t(NumSections / Elapsed.count())
+         << "\n"
+         << "dual-mapped code:  " << (Pool.isCodeDualMapped() ? "yes" : "no")
+         << "\n"
+         << "bytes requested:   " << Stats.BytesRequested << "\n"
+         << "bytes allocated:   " << Stats.BytesAllocated << "\n"
+         << "bytes mapped:      " << Stats.BytesMapped << "\n"
+         << "slabs:             " << Stats.NumSlabs << "\n"
+         << "large blocks:      " << Stats.NumLargeBlocks << "\n"
+         << "min utilization:   " << format("%.3f", MinUtilization) << "\n";
+
+  Window.clear();
+  EXPECT_EQ(0U, Pool.getStatistics().BytesRequested);
+}
+
+} // end anonymous namespace
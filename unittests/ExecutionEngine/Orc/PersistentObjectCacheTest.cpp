@@ -0,0 +1,100 @@
+//===- PersistentObjectCacheTest.cpp - Unit tests for the object cache ----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ExecutionEngine/Orc/PersistentObjectCache.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+using namespace llvm::orc;
+
+namespace {
+
+std::unique_ptr<Module> createModule(LLVMContext &Context, StringRef Name,
+                                     StringRef FunctionName) {
+  auto M = llvm::make_unique<Module>(Name, Context);
+  Function::Create(FunctionType::get(Type::getVoidTy(Context), false),
+                   GlobalValue::ExternalLinkage, FunctionName, M.get());
+  return M;
+}
+
+class PersistentObjectCacheTest : public testing::Test {
+protected:
+  void SetUp() override {
+    ASSERT_FALSE(sys::fs::createUniqueDirectory("orc-object-cache", CacheDir));
+  }
+
+  void TearDown() override {
+    std::error_code EC;
+    for (sys::fs::directory_iterator I(CacheDir, EC), E; I != E && !EC;
+         I.increment(EC))
+      sys::fs::remove(I->path());
+    sys::fs::remove(CacheDir);
+  }
+
+  SmallString<128> CacheDir;
+  LLVMContext Context;
+};
+
+TEST_F(PersistentObjectCacheTest, HitAfterStore) {
+  auto M = createModule(Context, "a", "f");
+  {
+    PersistentObjectCache Cache(CacheDir.str(), "x86_64-unknown-linux-gnu");
+    EXPECT_EQ(nullptr, Cache.getObject(M.get()));
+    auto Obj = MemoryBuffer::getMemBuffer("object bytes", "", false);
+    Cache.notifyObjectCompiled(M.get(), Obj->getMemBufferRef());
+    EXPECT_TRUE(sys::fs::exists(Cache.getCachePath(*M)));
+  }
+
+  // Another cache on the same directory, as in a later process, finds the
+  // object of an identical module.
+  PersistentObjectCache Cache(CacheDir.str(), "x86_64-unknown-linux-gnu");
+  LLVMContext OtherContext;
+  auto Same = createModule(OtherContext, "a", "f");
+  std::unique_ptr<MemoryBuffer> Obj = Cache.getObject(Same.get());
+  ASSERT_NE(nullptr, Obj);
+  EXPECT_EQ("object bytes", Obj->getBuffer());
+}
+
+TEST_F(PersistentObjectCacheTest, KeyCoversModuleAndTarget) {
+  auto M = createModule(Context, "a", "f");
+  PersistentObjectCache Cache(CacheDir.str(), "x86_64-unknown-linux-gnu");
+  EXPECT_EQ(nullptr, Cache.getObject(M.get()));
+  auto Obj = MemoryBuffer::getMemBuffer("object bytes", "", false);
+  Cache.notifyObjectCompiled(M.get(), Obj->getMemBufferRef());
+
+  auto Changed = createModule(Context, "b", "g");
+  EXPECT_NE(Cache.getCachePath(*M), Cache.getCachePath(*Changed));
+  EXPECT_EQ(nullptr, Cache.getObject(Changed.get()));
+
+  PersistentObjectCache OtherTarget(CacheDir.str(), "i386-unknown-linux-gnu");
+  EXPECT_NE(Cache.getCachePath(*M), OtherTarget.getCachePath(*M));
+  EXPECT_EQ(nullptr, OtherTarget.getObject(M.get()));
+}
+
+TEST_F(PersistentObjectCacheTest, KeyIsComputedBeforeCompiling) {
+  auto M = createModule(Context, "a", "f");
+  PersistentObjectCache Cache(CacheDir.str(), "x86_64-unknown-linux-gnu");
+  std::string Path = Cache.getCachePath(*M);
+  EXPECT_EQ(nullptr, Cache.getObject(M.get()));
+
+  // Code generation may change the module before the object is stored.
+  Function::Create(FunctionType::get(Type::getVoidTy(Context), false),
+                   GlobalValue::ExternalLinkage, "added", M.get());
+  auto Obj = MemoryBuffer::getMemBuffer("object bytes", "", false);
+  Cache.notifyObjectCompiled(M.get(), Obj->getMemBufferRef());
+  EXPECT_TRUE(sys::fs::exists(Path));
+}
+
+} // end anonymous namespace
@@ -8,9 +8,14 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/MC/StringTableBuilder.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/Endian.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/raw_ostream.h"
 #include "gtest/gtest.h"
+#include <chrono>
 #include <string>
+#include <vector>
 
 using namespace llvm;
 
@@ -68,4 +73,85 @@ TEST(StringTableBuilderTest, BasicWinCOFF) {
   EXPECT_EQ(23U, B.getOffset("river horse"));
 }
 
+// Mangled names with lots of shared suffixes, like the symbol tables of C++
+// objects.
+static std::vector<std::string> makeSymbolCorpus(unsigned Count) {
+  static const char *const Namespaces[] = {"4llvm", "3std", "5clang", "3lld"};
+  static const char *const Classes[] = {"5Value", "4Type", "6Module",
+                                        "8Function", "10BasicBlock"};
+  static const char *const Params[] = {"Ev", "ERKS0_", "Ej", "EPKcm",
+                                       "ENS_9StringRefE", "ERNS_11raw_ostreamE"};
+  std::vector<std::string> Corpus;
+  for (unsigned I = 0; I != Count; ++I) {
+    std::string Name = "_ZN";
+    Name += Namespaces[I % 4];
+    Name += Classes[I / 4 % 5];
+    std::string Method = "method" + utostr(I / 120);
+    Name += utostr(Method.size()) + Method;
+    Name += Params[I / 20 % 6];
+    Corpus.push_back(Name);
+  }
+  return Corpus;
+}
+
+static void expectParallelMatchesSerial(StringTableBuilder::Kind Kind,
+                                        const std::vector<std::string> &Strs) {
+  StringTableBuilder Serial, Parallel;
+  for (const std::string &S : Strs) {
+    Serial.add(S);
+    Parallel.add(S);
+  }
+  ThreadPool Pool(4);
+  Serial.finalize(Kind);
+  Parallel.finalize(Kind, &Pool);
+
+  EXPECT_EQ(Serial.data(), Parallel.data());
+  for (const std::string &S : Strs)
+    EXPECT_EQ(Serial.getOffset(S), Parallel.getOffset(S)) << S;
+}
+
+TEST(StringTableBuilderTest, ParallelELF) {
+  std::vector<std::string> Strs = makeSymbolCorpus(2000);
+  // Strings which only differ in their first or last bytes, single bytes and
+  // the empty string all land on the edges of the shards.
+  for (unsigned C = 1; C < 256; C += 7) {
+    Strs.push_back(std::string(1, char(C)));
+    Strs.push_back(std::string(1, char(C)) + "tail");
+    Strs.push_back("head" + std::string(1, char(C)));
+    Strs.push_back("a" + std::string(1, char(C)));
+  }
+  Strs.push_back("");
+  Strs.push_back("bar");
+  Strs.push_back("foobar");
+  Strs.push_back("ar");
+  Strs.push_back("r");
+  expectParallelMatchesSerial(StringTableBuilder::ELF, Strs);
+  expectParallelMatchesSerial(StringTableBuilder::MachO, Strs);
+}
+
+TEST(StringTableBuilderTest, ParallelWinCOFF) {
+  expectParallelMatchesSerial(StringTableBuilder::WinCOFF,
+                              makeSymbolCorpus(2000));
+}
+
+// Benchmark for finalizing large tables.  It is disabled by default; run it
+// with --gtest_also_run_disabled_tests.
+TEST(StringTableBuilderTest, DISABLED_FinalizeBenchmark) {
+  typedef std::chrono::microseconds us;
+  std::vector<std::string> Corpus = makeSymbolCorpus(2000000);
+  for (unsigned Threads : {0, 2, 4, 8}) {
+    StringTableBuilder B;
+    for (const std::string &S : Corpus)
+      B.add(S);
+    std::unique_ptr<ThreadPool> Pool;
+    if (Threads)
+      Pool.reset(new ThreadPool(Threads));
+    auto Start = std::chrono::steady_clock::now();
+    B.finalize(StringTableBuilder::ELF, Pool.get());
+    auto Time = std::chrono::steady_clock::now() - Start;
+    outs() << "finalize, " << Threads << " threads: "
+           << std::chrono::duration_cast<us>(Time).count() << " us\n";
+  }
+}
+
 }
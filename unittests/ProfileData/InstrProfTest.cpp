@@ -101,4 +101,22 @@ TEST_F(InstrProfTest, get_max_function_count) {
   ASSERT_EQ(1ULL << 63, Reader->getMaximumFunctionCount());
 }
 
+// The output depends only on the counts, not on the order they came in.
+TEST_F(InstrProfTest, write_is_order_independent) {
+  InstrProfWriter Reversed;
+  std::vector<std::string> Names;
+  for (unsigned I = 0; I != 200; ++I)
+    Names.push_back("f" + std::to_string(I));
+  for (unsigned I = 0; I != Names.size(); ++I) {
+    Writer.addFunctionCounts(Names[I], I, {I});
+    Writer.addFunctionCounts(Names[I], I + 1, {I + 1});
+  }
+  for (unsigned I = Names.size(); I--;) {
+    Reversed.addFunctionCounts(Names[I], I + 1, {I + 1});
+    Reversed.addFunctionCounts(Names[I], I, {I});
+  }
+  ASSERT_EQ(Writer.writeBuffer()->getBuffer(),
+            Reversed.writeBuffer()->getBuffer());
+}
+
 } // end anonymous namespace
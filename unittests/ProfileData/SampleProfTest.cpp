@@ -0,0 +1,121 @@
+//===- unittest/ProfileData/SampleProfTest.cpp ------------------------------=//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/ProfileData/SampleProfReader.h"
+#include "llvm/ProfileData/SampleProfWriter.h"
+#include "llvm/Support/FileSystem.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+using namespace sampleprof;
+
+static ::testing::AssertionResult NoError(std::error_code EC) {
+  if (!EC)
+    return ::testing::AssertionSuccess();
+  return ::testing::AssertionFailure() << "error " << EC.value()
+                                       << ": " << EC.message();
+}
+
+namespace {
+
+struct SampleProfTest : ::testing::Test {
+  LLVMContext Context;
+  SmallString<128> ProfilePath;
+
+  void SetUp() override {
+    ASSERT_TRUE(NoError(
+        sys::fs::createTemporaryFile("SampleProfTest", "prof", ProfilePath)));
+  }
+
+  void TearDown() override { sys::fs::remove(ProfilePath); }
+
+  void writeProfile(SampleProfileFormat Format) {
+    StringMap<FunctionSamples> Profiles;
+    Profiles["foo"].addTotalSamples(100);
+    Profiles["foo"].addHeadSamples(10);
+    Profiles["foo"].addBodySamples(1, 0, 60);
+    Profiles["foo"].addCalledTargetSamples(1, 0, "bar", 40);
+    Profiles["foo"].addBodySamples(2, 3, 20);
+    Profiles["bar"].addTotalSamples(50);
+    Profiles["bar"].addBodySamples(1, 0, 50);
+    Profiles["baz"].addTotalSamples(7);
+    Profiles["baz"].addBodySamples(4, 0, 7);
+
+    auto WriterOrErr = SampleProfileWriter::create(ProfilePath, Format);
+    ASSERT_TRUE(NoError(WriterOrErr.getError()));
+    ASSERT_TRUE((*WriterOrErr)->write(Profiles));
+    ASSERT_TRUE(NoError((*WriterOrErr)->finalize()));
+  }
+
+  std::unique_ptr<SampleProfileReader> createReader() {
+    auto ReaderOrErr = SampleProfileReader::create(ProfilePath, Context);
+    EXPECT_TRUE(NoError(ReaderOrErr.getError()));
+    if (!ReaderOrErr)
+      return nullptr;
+    return std::move(*ReaderOrErr);
+  }
+};
+
+TEST_F(SampleProfTest, IndexedRoundTrip) {
+  writeProfile(SPF_Indexed);
+  std::unique_ptr<SampleProfileReader> Reader = createReader();
+  ASSERT_TRUE(Reader != nullptr);
+  ASSERT_TRUE(NoError(Reader->read()));
+
+  StringMap<FunctionSamples> &Profiles = Reader->getProfiles();
+  ASSERT_EQ(3U, Profiles.size());
+  FunctionSamples &Foo = Profiles["foo"];
+  EXPECT_EQ(100U, Foo.getTotalSamples());
+  EXPECT_EQ(10U, Foo.getHeadSamples());
+  EXPECT_EQ(60U, Foo.samplesAt(1, 0));
+  EXPECT_EQ(20U, Foo.samplesAt(2, 3));
+  EXPECT_EQ(40U, Foo.sampleRecordAt(LineLocation(1, 0))
+                     .getCallTargets()
+                     .lookup("bar"));
+  EXPECT_EQ(50U, Profiles["bar"].getTotalSamples());
+  EXPECT_EQ(7U, Profiles["baz"].samplesAt(4, 0));
+}
+
+// Only the functions defined in the module are decoded.
+TEST_F(SampleProfTest, IndexedReadsModuleFunctionsOnly) {
+  writeProfile(SPF_Indexed);
+  std::unique_ptr<SampleProfileReader> Reader = createReader();
+  ASSERT_TRUE(Reader != nullptr);
+
+  Module M("m", Context);
+  FunctionType *FTy = FunctionType::get(Type::getVoidTy(Context), false);
+  Function *Foo =
+      Function::Create(FTy, GlobalValue::ExternalLinkage, "foo", &M);
+  BasicBlock::Create(Context, "entry", Foo);
+  Function::Create(FTy, GlobalValue::ExternalLinkage, "bar", &M);
+  Function *Qux =
+      Function::Create(FTy, GlobalValue::ExternalLinkage, "qux", &M);
+  BasicBlock::Create(Context, "entry", Qux);
+
+  ASSERT_TRUE(NoError(Reader->readProfilesFor(M)));
+  StringMap<FunctionSamples> &Profiles = Reader->getProfiles();
+  EXPECT_EQ(1U, Profiles.size());
+  EXPECT_EQ(100U, Reader->getSamplesFor(*Foo)->getTotalSamples());
+  EXPECT_TRUE(Reader->getSamplesFor(*Qux)->empty());
+}
+
+// Readers of the other formats read everything.
+TEST_F(SampleProfTest, BinaryReadsWholeFileForModule) {
+  writeProfile(SPF_Binary);
+  std::unique_ptr<SampleProfileReader> Reader = createReader();
+  ASSERT_TRUE(Reader != nullptr);
+
+  Module M("m", Context);
+  ASSERT_TRUE(NoError(Reader->readProfilesFor(M)));
+  EXPECT_EQ(3U, Reader->getProfiles().size());
+}
+
+} // end anonymous namespace
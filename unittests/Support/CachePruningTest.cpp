@@ -0,0 +1,122 @@
+//===- llvm/unittest/Support/CachePruningTest.cpp - unit tests ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/CachePruning.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/TimeValue.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace {
+
+class CachePruningTest : public testing::Test {
+protected:
+  SmallString<128> Dir;
+
+  void SetUp() override {
+    ASSERT_FALSE(sys::fs::createUniqueDirectory("CachePruning-test", Dir));
+  }
+
+  void TearDown() override {
+    std::error_code EC;
+    for (sys::fs::directory_iterator File(Dir, EC), FileEnd;
+         File != FileEnd && !EC; File.increment(EC))
+      sys::fs::remove(File->path());
+    sys::fs::remove(Dir);
+  }
+
+  std::string path(StringRef Name) {
+    SmallString<128> Path(Dir);
+    sys::path::append(Path, Name);
+    return Path.str();
+  }
+
+  /// Create \p Name with \p Size bytes, last modified \p Age seconds ago.
+  void createFile(StringRef Name, size_t Size, unsigned Age) {
+    std::string Path = path(Name);
+    {
+      std::error_code EC;
+      raw_fd_ostream OS(Path, EC, sys::fs::F_None);
+      ASSERT_FALSE(EC);
+      OS << std::string(Size, 'x');
+    }
+    int FD;
+    ASSERT_FALSE(sys::fs::openFileForWrite(Path, FD, sys::fs::F_Append));
+    sys::TimeValue Time = sys::TimeValue::now() - sys::TimeValue(Age, 0);
+    ASSERT_FALSE(sys::fs::setLastModificationAndAccessTime(FD, Time));
+    sys::Process::SafelyCloseFileDescriptor(FD);
+  }
+
+  bool exists(StringRef Name) { return sys::fs::exists(path(Name)); }
+};
+
+TEST_F(CachePruningTest, NothingToDo) {
+  createFile("llvmcache-a", 10, 1000);
+  EXPECT_FALSE(CachePruning(Dir).prune());
+  EXPECT_TRUE(exists("llvmcache-a"));
+}
+
+TEST_F(CachePruningTest, Expiration) {
+  createFile("llvmcache-old", 10, 1000);
+  createFile("llvmcache-new", 10, 10);
+  createFile("other-old", 10, 1000);
+  EXPECT_TRUE(CachePruning(Dir).setEntryExpiration(100).prune());
+  EXPECT_FALSE(exists("llvmcache-old"));
+  EXPECT_TRUE(exists("llvmcache-new"));
+  // Files that are not cache entries are never removed.
+  EXPECT_TRUE(exists("other-old"));
+}
+
+TEST_F(CachePruningTest, MaxSize) {
+  createFile("llvmcache-a", 100, 300);
+  createFile("llvmcache-b", 100, 200);
+  createFile("llvmcache-c", 100, 100);
+  createFile("other", 1000, 400);
+  EXPECT_TRUE(CachePruning(Dir).setMaxSize(250).prune());
+  // The least recently used entry goes first, until the entries fit.
+  EXPECT_FALSE(exists("llvmcache-a"));
+  EXPECT_TRUE(exists("llvmcache-b"));
+  EXPECT_TRUE(exists("llvmcache-c"));
+  EXPECT_TRUE(exists("other"));
+
+  EXPECT_TRUE(CachePruning(Dir).setMaxSize(100).prune());
+  EXPECT_FALSE(exists("llvmcache-b"));
+  EXPECT_TRUE(exists("llvmcache-c"));
+}
+
+TEST_F(CachePruningTest, Interval) {
+  auto Prune = [&] {
+    return CachePruning(Dir).setPruningInterval(100).setEntryExpiration(100)
+        .prune();
+  };
+  createFile("llvmcache-a", 10, 1000);
+  // A recent timestamp file means pruning already ran.
+  createFile("llvmcache.timestamp", 0, 10);
+  EXPECT_FALSE(Prune());
+  EXPECT_TRUE(exists("llvmcache-a"));
+
+  // Once the interval has passed, pruning runs and refreshes the timestamp.
+  createFile("llvmcache.timestamp", 0, 200);
+  EXPECT_TRUE(Prune());
+  EXPECT_FALSE(exists("llvmcache-a"));
+  createFile("llvmcache-b", 10, 1000);
+  EXPECT_FALSE(Prune());
+  EXPECT_TRUE(exists("llvmcache-b"));
+
+  // An interval of 0 always prunes.
+  EXPECT_TRUE(CachePruning(Dir).setEntryExpiration(100).prune());
+  EXPECT_FALSE(exists("llvmcache-b"));
+}
+
+} // end anonymous namespace
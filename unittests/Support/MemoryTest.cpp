@@ -362,4 +362,26 @@ INSTANTIATE_TEST_CASE_P(AllocationTests,
 			MappedMemoryTest,
 			::testing::ValuesIn(MemoryFlags));
 
+TEST(DualMappedMemoryTest, WriteThroughRWView) {
+  MemoryBlock RW, RX;
+  std::error_code EC = Memory::allocateDualMappedMemory(100, RW, RX);
+  if (EC == std::errc::not_supported)
+    return;
+  ASSERT_EQ(std::error_code(), EC);
+
+  EXPECT_LE(100U, RW.size());
+  EXPECT_EQ(RW.size(), RX.size());
+  EXPECT_NE(RW.base(), RX.base());
+
+  int *Writable = static_cast<int *>(RW.base());
+  const int *Executable = static_cast<const int *>(RX.base());
+  Writable[0] = 42;
+  Writable[1] = 7;
+  EXPECT_EQ(42, Executable[0]);
+  EXPECT_EQ(7, Executable[1]);
+
+  EXPECT_FALSE(Memory::releaseMappedMemory(RX));
+  EXPECT_FALSE(Memory::releaseMappedMemory(RW));
+}
+
 }  // anonymous namespace
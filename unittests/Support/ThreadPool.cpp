@@ -0,0 +1,158 @@
+//========- unittests/Support/ThreadPool.cpp - ThreadPool.h tests ---------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+TEST(ThreadPoolTest, AsyncBarrier) {
+  std::atomic_int Count(0);
+  ThreadPool Pool(4);
+  for (int I = 0; I < 100; ++I)
+    Pool.async([&Count] { ++Count; });
+  Pool.wait();
+  EXPECT_EQ(100, Count);
+}
+
+static void addToCount(std::atomic_int &Count, int Amount) { Count += Amount; }
+
+TEST(ThreadPoolTest, AsyncWithArgs) {
+  std::atomic_int Count(0);
+  ThreadPool Pool(2);
+  for (int I = 1; I <= 10; ++I)
+    Pool.async(addToCount, std::ref(Count), I);
+  Pool.wait();
+  EXPECT_EQ(55, Count);
+}
+
+TEST(ThreadPoolTest, GetFuture) {
+  int Value = 0;
+  ThreadPool Pool(2);
+  std::shared_future<void> Future = Pool.async([&Value] { Value = 42; });
+  Future.wait();
+  EXPECT_EQ(42, Value);
+}
+
+// Blocking on the futures alone has to be enough for the tasks to run, also
+// when LLVM is built without threads.
+TEST(ThreadPoolTest, WaitForFuturesOnly) {
+  int Values[8] = {0};
+  ThreadPool Pool(2);
+  std::vector<std::shared_future<void>> Futures;
+  for (int I = 0; I < 8; ++I)
+    Futures.push_back(Pool.async([&Values, I] { Values[I] = I + 1; }));
+  for (int I = 7; I >= 0; --I) {
+    Futures[I].wait();
+    EXPECT_EQ(I + 1, Values[I]);
+  }
+}
+
+TEST(ThreadPoolTest, DefaultSize) {
+  ThreadPool Pool;
+  EXPECT_LE(1U, Pool.getThreadCount());
+}
+
+TEST(ThreadPoolTest, WaitForGroup) {
+  std::atomic_int InGroup(0), Other(0);
+  ThreadPool Pool(3);
+  TaskGroup Group;
+  for (int I = 0; I < 50; ++I) {
+    Pool.async(Group, [&InGroup] { ++InGroup; });
+    Pool.async([&Other] { ++Other; });
+  }
+  Pool.wait(Group);
+  EXPECT_EQ(50, InGroup);
+  Pool.wait();
+  EXPECT_EQ(50, Other);
+}
+
+// Tasks that wait for groups of their own children must not deadlock, even
+// when there are more of them than there are workers.
+TEST(ThreadPoolTest, NestedGroups) {
+  std::atomic_int Count(0);
+  ThreadPool Pool(2);
+  for (int I = 0; I < 8; ++I)
+    Pool.async([&Pool, &Count] {
+      TaskGroup Children;
+      for (int J = 0; J < 8; ++J)
+        Pool.async(Children, [&Count] { ++Count; });
+      Pool.wait(Children);
+    });
+  Pool.wait();
+  EXPECT_EQ(64, Count);
+}
+
+TEST(ThreadPoolTest, DestructorWaits) {
+  std::atomic_int Count(0);
+  {
+    ThreadPool Pool(4);
+    for (int I = 0; I < 100; ++I)
+      Pool.async([&Count] { ++Count; });
+  }
+  EXPECT_EQ(100, Count);
+}
+
+TEST(ThreadPoolTest, ForEachIndex) {
+  std::vector<int> Values(20);
+  ThreadPool Pool(3);
+  forEachIndex(&Pool, Values.size(), [&Values](unsigned I) { Values[I] = I; });
+  for (int I = 0; I < 20; ++I)
+    EXPECT_EQ(I, Values[I]);
+
+  // Without a pool the calls run in order on the calling thread.
+  std::vector<unsigned> Order;
+  forEachIndex(nullptr, 3, [&Order](unsigned I) { Order.push_back(I); });
+  EXPECT_EQ(std::vector<unsigned>({0, 1, 2}), Order);
+}
+
+// Microbenchmark for the per-task cost of scheduling.  It is disabled by
+// default; run it with --gtest_also_run_disabled_tests.
+TEST(ThreadPoolTest, DISABLED_SchedulingOverhead) {
+  const unsigned NumTasks = 1000000;
+  ThreadPool Pool;
+  std::atomic_int Count(0);
+
+  auto Start = std::chrono::steady_clock::now();
+  for (unsigned I = 0; I != NumTasks; ++I)
+    Pool.async([&Count] { ++Count; });
+  Pool.wait();
+  auto Flat = std::chrono::steady_clock::now() - Start;
+
+  // The same amount of work spawned from inside the pool, which exercises the
+  // per-worker deques and stealing rather than the round-robin submission.
+  const unsigned NumParents = 1000;
+  Start = std::chrono::steady_clock::now();
+  for (unsigned I = 0; I != NumParents; ++I)
+    Pool.async([&Pool, &Count] {
+      TaskGroup Children;
+      for (unsigned J = 0; J != NumTasks / NumParents; ++J)
+        Pool.async(Children, [&Count] { ++Count; });
+      Pool.wait(Children);
+    });
+  Pool.wait();
+  auto Nested = std::chrono::steady_clock::now() - Start;
+
+  EXPECT_EQ(int(2 * NumTasks), Count);
+  typedef std::chrono::nanoseconds ns;
+  auto FlatNs = std::chrono::duration_cast<ns>(Flat).count();
+  auto NestedNs = std::chrono::duration_cast<ns>(Nested).count();
+  outs() << "threads: " << Pool.getThreadCount() << "\n"
+         << "flat:    " << FlatNs / NumTasks << " ns/task\n"
+         << "nested:  " << NestedNs / NumTasks << " ns/task\n";
+}
+
+} // end anonymous namespace
@@ -11,6 +11,7 @@
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/AsmParser/Parser.h"
 #include "llvm/IR/Argument.h"
 #include "llvm/IR/Constant.h"
 #include "llvm/IR/DIBuilder.h"
@@ -23,6 +24,8 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
 #include "gtest/gtest.h"
 
 using namespace llvm;
@@ -450,4 +453,87 @@ TEST_F(CloneModule, Verify) {
   EXPECT_FALSE(verifyModule(*NewM));
 }
 
+static std::string printModule(const Module &M) {
+  std::string Str;
+  raw_string_ostream OS(Str);
+  M.print(OS, nullptr);
+  return OS.str();
+}
+
+TEST(CloneModuleIntoContext, PrintsIdentically) {
+  const char *IR =
+      "%list = type { i32, %list* }\n"
+      "%opaque = type opaque\n"
+      "$c = comdat any\n"
+      "@g = global %list { i32 1, %list* @g }, comdat($c), align 8\n"
+      "@str = private unnamed_addr constant [6 x i8] c\"hello\\00\"\n"
+      "@arr = global [2 x double] [double 1.0, double 2.0]\n"
+      "@vec = global <4 x i16> <i16 1, i16 2, i16 3, i16 4>\n"
+      "@ba = global i8* blockaddress(@f, %next)\n"
+      "@gep = global i32* getelementptr (%list, %list* @g, i64 0, i32 0)\n"
+      "@a = alias %list, %list* @g\n"
+      "declare void @ext(%opaque*, i8* nocapture) nounwind\n"
+      "declare i32 @__gxx_personality_v0(...)\n"
+      "declare void @llvm.dbg.value(metadata, i64, metadata, metadata)\n"
+      "define i32 @f(i32 %x) #0 personality i32 (...)* @__gxx_personality_v0 "
+      "{\n"
+      "entry:\n"
+      "  %p = alloca %list, align 8\n"
+      "  %q = getelementptr inbounds %list, %list* %p, i64 0, i32 1\n"
+      "  call void @llvm.dbg.value(metadata i32 %x, i64 0, metadata !8, "
+      "metadata !DIExpression()), !dbg !9\n"
+      "  invoke void @ext(%opaque* null, i8* getelementptr ([6 x i8], "
+      "[6 x i8]* @str, i64 0, i64 0)) to label %next unwind label %lpad, "
+      "!mykind !10\n"
+      "next:\n"
+      "  %r = phi i32 [ %x, %entry ], [ %s, %next ]\n"
+      "  %s = add nsw i32 %r, 1\n"
+      "  call void asm sideeffect \"nop\", \"\"()\n"
+      "  switch i32 %s, label %next [ i32 7, label %done ]\n"
+      "lpad:\n"
+      "  %lp = landingpad { i8*, i32 } cleanup\n"
+      "  resume { i8*, i32 } %lp\n"
+      "done:\n"
+      "  ret i32 %s, !dbg !9\n"
+      "}\n"
+      "attributes #0 = { nounwind \"custom\"=\"value\" }\n"
+      "!llvm.dbg.cu = !{!0}\n"
+      "!llvm.module.flags = !{!5}\n"
+      "!named = !{!6, !7}\n"
+      "!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, "
+      "producer: \"clang\", isOptimized: false, runtimeVersion: 0, "
+      "emissionKind: 1, subprograms: !2)\n"
+      "!1 = !DIFile(filename: \"t.c\", directory: \"/tmp\")\n"
+      "!2 = !{!3}\n"
+      "!3 = distinct !DISubprogram(name: \"f\", scope: !1, file: !1, "
+      "line: 1, type: !4, isLocal: false, isDefinition: true, scopeLine: 1, "
+      "isOptimized: false, function: i32 (i32)* @f)\n"
+      "!4 = !DISubroutineType(types: !{null})\n"
+      "!5 = !{i32 2, !\"Debug Info Version\", i32 3}\n"
+      "!6 = distinct !{!6, !7}\n"
+      "!7 = !{!\"str\", i32 42, %list* @g}\n"
+      "!8 = !DILocalVariable(name: \"x\", arg: 1, scope: !3, file: !1, "
+      "line: 1)\n"
+      "!9 = !DILocation(line: 2, column: 3, scope: !3)\n"
+      "!10 = !{!6}\n";
+
+  auto SrcCtx = llvm::make_unique<LLVMContext>();
+  SMDiagnostic Err;
+  std::unique_ptr<Module> M = parseAssemblyString(IR, Err, *SrcCtx);
+  ASSERT_TRUE(M != nullptr);
+  ASSERT_FALSE(verifyModule(*M, &errs()));
+
+  LLVMContext DstCtx;
+  std::unique_ptr<Module> Clone = CloneModuleIntoContext(M.get(), DstCtx);
+  EXPECT_EQ(&DstCtx, &Clone->getContext());
+  EXPECT_FALSE(verifyModule(*Clone, &errs()));
+  EXPECT_EQ(printModule(*M), printModule(*Clone));
+
+  // The clone must not depend on anything owned by the source context.
+  std::string Expected = printModule(*M);
+  M.reset();
+  SrcCtx.reset();
+  EXPECT_EQ(Expected, printModule(*Clone));
+}
+
 }
@@ -0,0 +1,47 @@
+#!/usr/bin/env python
+"""An assembler relaxation stress test generator.
+
+This is a python program that creates x86-64 assembly with a single section
+holding the given number of relaxable fragments.  Each block has a forward
+conditional branch and a backward jump which just fit in a short encoding,
+and a load from a jump table.  The padding in front of the tables pushes some
+branches out of range, and relaxing those pushes out the branches around them,
+so relaxation ripples through the whole section.
+
+It is meant to check that the assembler's layout stays close to linear in the
+number of fragments, e.g.:
+
+  create_relaxation_stress.py 1000000 > stress.s
+  time llvm-mc -triple x86_64-unknown-linux -filetype=obj stress.s -o stress.o
+"""
+
+import argparse
+def main():
+  parser = argparse.ArgumentParser(description=__doc__,
+      formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument('fragments', type=int,
+                      help="Number of relaxable fragments to create")
+  parser.add_argument('--span', type=int, default=7,
+                      help="Number of blocks each forward branch jumps over")
+  args = parser.parse_args()
+  blocks = max(args.fragments // 2, 1)
+  print("  .text")
+  print("  .globl stress")
+  print("stress:")
+  for i in range(blocks):
+    target = min(i + args.span, blocks)
+    print(".Lblock%d:" % i)
+    print("  cmpl $%d, %%edi" % (i % 128))
+    print("  je .Lblock%d" % target)
+    print("  movq .Ltable%d(,%%rdi,8), %%rax" % (i // 64))
+    print("  addl $1, %esi")
+    print("  jmp .Lblock%d" % max(i - args.span + 1, 0))
+    if i % 64 == 63 or i == blocks - 1:
+      print("  .p2align 3")
+      print(".Ltable%d:" % (i // 64))
+      print("  .quad .Lblock%d" % i)
+  print(".Lblock%d:" % blocks)
+  print("  retq")
+
+if __name__ == '__main__':
+  main()